@@ -0,0 +1,182 @@
+/**
+ * @file ota_host.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : app_main of the firmware on Linux, flash in a file, the phone on a local socket
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <signal.h>
+#include <unistd.h>
+#include <getopt.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+#include "driver/uart.h"
+#include "host/ble_hs.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "ota_session.h"
+#include "heap_tag.h"
+#include "task_layout.h"
+#include "ota_turbo.h"
+
+/*---------------------------- User define -------------------------------*/
+#define HOST_FLASH_FILE		"ota_host_flash.bin"
+#define HOST_NVS_MAX		8
+#define HOST_BLOB_MAX		8192		// TLS_PEM_MAX
+
+typedef struct {
+	char ns[NVS_KEY_NAME_MAX_SIZE];
+	char key[NVS_KEY_NAME_MAX_SIZE];
+	const char *path;
+} host_nvs_t;
+
+/*---------------------------- Variables ---------------------------------*/
+static const char *host_flash = HOST_FLASH_FILE;
+static const char *host_backend;
+static host_nvs_t host_nvs[HOST_NVS_MAX];
+static int host_nvs_count;
+
+/*-------------------------- Function declares ---------------------------*/
+
+static void usage(const char *name)
+{
+	fprintf(stderr,
+		"Usage : %s [--flash FILE] [--backend flash|null|sim] [--nvs NS:KEY=FILE]...\n"
+		"  --flash    8 MB flash image, made 0xFF filled when missing (default " HOST_FLASH_FILE ")\n"
+		"  --backend  OTA write backend, like the 'ota backend' console command\n"
+		"  --nvs      store FILE as blob KEY of namespace NS at boot (TLS certificate, image key)\n"
+		"The console is stdin/stdout, the BLE phone link is TCP 127.0.0.1:%d.\n", name, BLE_HOST_PHONE_PORT);
+	exit(2);
+}
+
+static void parse_nvs(const char *arg, const char *name)
+{
+	host_nvs_t *n = &host_nvs[host_nvs_count];
+	const char *colon = strchr(arg, ':'), *eq = colon ? strchr(colon, '=') : NULL;
+
+	if(host_nvs_count == HOST_NVS_MAX || colon == NULL || eq == NULL
+		|| colon - arg >= NVS_KEY_NAME_MAX_SIZE || eq - colon - 1 >= NVS_KEY_NAME_MAX_SIZE)
+	{
+		usage(name);
+	}
+	memcpy(n->ns, arg, colon - arg);
+	memcpy(n->key, colon + 1, eq - colon - 1);
+	n->path = eq + 1;
+	host_nvs_count++;
+}
+
+static void parse_args(int argc, char **argv)
+{
+	static const struct option options[] = {
+		{ "flash", required_argument, NULL, 'f' },
+		{ "backend", required_argument, NULL, 'b' },
+		{ "nvs", required_argument, NULL, 'n' },
+		{ "help", no_argument, NULL, 'h' },
+		{ NULL, 0, NULL, 0 }
+	};
+	int c;
+
+	while((c = getopt_long(argc, argv, "f:b:n:h", options, NULL)) != -1)
+	{
+		switch(c)
+		{
+			case 'f':	host_flash = optarg;			break;
+			case 'b':	host_backend = optarg;			break;
+			case 'n':	parse_nvs(optarg, argv[0]);		break;
+			default:	usage(argv[0]);
+		}
+	}
+}
+
+// What flashing an NVS partition image does on the device
+static void load_nvs(void)
+{
+	static uint8_t blob[HOST_BLOB_MAX];
+	nvs_handle_t nvs;
+	size_t len;
+	FILE *f;
+	int i;
+
+	for(i = 0; i < host_nvs_count; i++)
+	{
+		f = fopen(host_nvs[i].path, "rb");
+		if(f == NULL)
+		{
+			LOGE("NVS blob file %s : not found", host_nvs[i].path);
+			continue;
+		}
+		len = fread(blob, 1, sizeof(blob), f);
+		fclose(f);
+
+		if(nvs_open(host_nvs[i].ns, NVS_READWRITE, &nvs) != ESP_OK) continue;
+		if(nvs_set_blob(nvs, host_nvs[i].key, blob, len) == ESP_OK) nvs_commit(nvs);
+		nvs_close(nvs);
+		LOGI("NVS %s:%s : %d bytes from %s", host_nvs[i].ns, host_nvs[i].key, (int)len, host_nvs[i].path);
+	}
+}
+
+// app_main() of main.c, without Wi-Fi : the sockets are the ones of the host
+static void app_main(void)
+{
+	esp_err_t ret;
+	int prev_tag;
+
+	heap_tag_init();
+	uart_driver_install(UART_NUM_0, 1024, 0, 0, NULL, 0);
+
+	ret = nvs_flash_init();
+	LOGI("NVS default partition init : %d, %s", ret, esp_err_to_name(ret));
+	ESP_ERROR_CHECK(ret);
+	load_nvs();
+	task_layout_init();
+	ota_turbo_init();
+
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	LOGI("Running partition : %s (offset 0x%x)", running->label, (unsigned int)running->address);
+
+	if(host_backend != NULL && ota_set_backend(host_backend) != 0)
+	{
+		LOGE("Unknown OTA backend : %s", host_backend);
+	}
+
+	prev_tag = heap_tag_push(HEAP_TAG_BLE);
+	bt_ble_init();
+	heap_tag_pop(prev_tag);
+
+	usleep(10000);
+	InitOta();
+	InitDebug();
+}
+
+int main(int argc, char **argv)
+{
+	parse_args(argc, argv);
+
+	// lwIP reports a closed peer as an error, it has no SIGPIPE
+	signal(SIGPIPE, SIG_IGN);
+	setvbuf(stdout, NULL, _IOLBF, 0);
+
+	esp_restart_host_args(argv);
+	if(esp_partition_host_init(host_flash) != ESP_OK)
+	{
+		fprintf(stderr, "flash file %s : can not open\n", host_flash);
+		return 1;
+	}
+
+	app_main();
+
+	// the main task ends, the others keep the process running
+	vTaskDelete(NULL);
+	return 0;
+}
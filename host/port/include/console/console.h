@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : console/console.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by bt_ble.c, nothing of it is used
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_CONSOLE_CONSOLE_H__)
+
+#define __HOST_CONSOLE_CONSOLE_H__
+
+#include <stddef.h>
+
+#endif  /* End_of __HOST_CONSOLE_CONSOLE_H__ */
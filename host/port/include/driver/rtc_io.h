@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : driver/rtc_io.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by debug.c, nothing of it is used
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_DRIVER_RTC_IO_H__)
+
+#define __HOST_DRIVER_RTC_IO_H__
+
+#include "esp_err.h"
+
+#endif  /* End_of __HOST_DRIVER_RTC_IO_H__ */
@@ -0,0 +1,45 @@
+/****************************************************************************/
+//  File    : driver/uart.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             UART 0 is the terminal : stdin and stdout
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_DRIVER_UART_H__)
+
+#define __HOST_DRIVER_UART_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef int uart_port_t;
+
+#define UART_NUM_0	0
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+		void *uart_queue, int intr_alloc_flags);
+esp_err_t uart_driver_delete(uart_port_t uart_num);
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_DRIVER_UART_H__ */
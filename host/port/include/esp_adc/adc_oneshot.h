@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : esp_adc/adc_oneshot.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by debug.c, nothing of it is used
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_ADC_ADC_ONESHOT_H__)
+
+#define __HOST_ESP_ADC_ADC_ONESHOT_H__
+
+#include "esp_err.h"
+
+#endif  /* End_of __HOST_ESP_ADC_ADC_ONESHOT_H__ */
@@ -0,0 +1,55 @@
+/****************************************************************************/
+//  File    : esp_app_desc.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Application description, same 256 byte layout as in the image
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_APP_DESC_H__)
+
+#define __HOST_ESP_APP_DESC_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define ESP_APP_DESC_MAGIC_WORD		0xABCD5432
+
+typedef struct {
+	uint32_t magic_word;
+	uint32_t secure_version;
+	uint32_t reserv1[2];
+	char version[32];
+	char project_name[32];
+	char time[16];
+	char date[16];
+	char idf_ver[32];
+	uint8_t app_elf_sha256[32];
+	uint16_t min_efuse_blk_rev_full;
+	uint16_t max_efuse_blk_rev_full;
+	uint8_t mmu_page_size;
+	uint8_t reserv3[3];
+	uint32_t reserv2[18];
+} esp_app_desc_t;
+
+_Static_assert(sizeof(esp_app_desc_t) == 256, "esp_app_desc_t must be 256 bytes");
+
+/*-------------------------- Function declares ---------------------------*/
+const esp_app_desc_t *esp_app_get_description(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_APP_DESC_H__ */
@@ -0,0 +1,27 @@
+/****************************************************************************/
+//  File    : esp_attr.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Placement attributes, no meaning on the host
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_ATTR_H__)
+
+#define __HOST_ESP_ATTR_H__
+
+#define IRAM_ATTR
+#define DRAM_ATTR
+#define RTC_DATA_ATTR
+#define RTC_NOINIT_ATTR
+#define NOINIT_ATTR
+#define EXT_RAM_BSS_ATTR
+
+#endif  /* End_of __HOST_ESP_ATTR_H__ */
@@ -0,0 +1,51 @@
+/****************************************************************************/
+//  File    : esp_chip_info.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Chip of the firmware : ESP32-S3, 2 cores
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_CHIP_INFO_H__)
+
+#define __HOST_ESP_CHIP_INFO_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef enum {
+	CHIP_ESP32 = 1,
+	CHIP_ESP32S2 = 2,
+	CHIP_ESP32S3 = 9,
+} esp_chip_model_t;
+
+#define CHIP_FEATURE_EMB_FLASH	(1UL << 0)
+#define CHIP_FEATURE_WIFI_BGN	(1UL << 1)
+#define CHIP_FEATURE_BLE		(1UL << 4)
+
+typedef struct {
+	esp_chip_model_t model;
+	uint32_t features;
+	uint16_t revision;		// MXX : major * 100 + minor
+	uint8_t cores;
+} esp_chip_info_t;
+
+/*-------------------------- Function declares ---------------------------*/
+void esp_chip_info(esp_chip_info_t *out_info);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_CHIP_INFO_H__ */
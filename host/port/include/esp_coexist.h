@@ -0,0 +1,41 @@
+/****************************************************************************/
+//  File    : esp_coexist.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Wi-Fi/BT coexistence preference, no radio on the host
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_COEXIST_H__)
+
+#define __HOST_ESP_COEXIST_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef enum {
+	ESP_COEX_PREFER_WIFI = 0,
+	ESP_COEX_PREFER_BT,
+	ESP_COEX_PREFER_BALANCE,
+	ESP_COEX_PREFER_NUM,
+} esp_coex_prefer_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t esp_coex_preference_set(esp_coex_prefer_t prefer);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_COEXIST_H__ */
@@ -0,0 +1,37 @@
+/****************************************************************************/
+//  File    : esp_cpu.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Cycle counter and core id of the calling task
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_CPU_H__)
+
+#define __HOST_ESP_CPU_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef uint32_t esp_cpu_cycle_count_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void);
+int esp_cpu_get_core_id(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_CPU_H__ */
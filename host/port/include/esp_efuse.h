@@ -0,0 +1,36 @@
+/****************************************************************************/
+//  File    : esp_efuse.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Secure version eFuse, always 0 on the host
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_EFUSE_H__)
+
+#define __HOST_ESP_EFUSE_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+uint32_t esp_efuse_read_secure_version(void);
+bool esp_efuse_check_secure_version(uint32_t secure_version);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_EFUSE_H__ */
@@ -0,0 +1,86 @@
+/****************************************************************************/
+//  File    : esp_err.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Error codes, same values as ESP-IDF so the logs read the same
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_ERR_H__)
+
+#define __HOST_ESP_ERR_H__
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef int esp_err_t;
+
+#define ESP_OK						0
+#define ESP_FAIL					-1
+
+#define ESP_ERR_NO_MEM				0x101
+#define ESP_ERR_INVALID_ARG			0x102
+#define ESP_ERR_INVALID_STATE		0x103
+#define ESP_ERR_INVALID_SIZE		0x104
+#define ESP_ERR_NOT_FOUND			0x105
+#define ESP_ERR_NOT_SUPPORTED		0x106
+#define ESP_ERR_TIMEOUT				0x107
+#define ESP_ERR_INVALID_RESPONSE	0x108
+#define ESP_ERR_INVALID_CRC			0x109
+#define ESP_ERR_INVALID_VERSION		0x10A
+#define ESP_ERR_NOT_ALLOWED			0x10D
+
+#define ESP_ERR_NVS_BASE				0x1100
+#define ESP_ERR_NVS_NOT_INITIALIZED		(ESP_ERR_NVS_BASE + 0x01)
+#define ESP_ERR_NVS_NOT_FOUND			(ESP_ERR_NVS_BASE + 0x02)
+#define ESP_ERR_NVS_INVALID_HANDLE		(ESP_ERR_NVS_BASE + 0x07)
+#define ESP_ERR_NVS_NOT_ENOUGH_SPACE	(ESP_ERR_NVS_BASE + 0x05)
+#define ESP_ERR_NVS_INVALID_LENGTH		(ESP_ERR_NVS_BASE + 0x0c)
+#define ESP_ERR_NVS_NO_FREE_PAGES		(ESP_ERR_NVS_BASE + 0x0d)
+#define ESP_ERR_NVS_NEW_VERSION_FOUND	(ESP_ERR_NVS_BASE + 0x10)
+
+#define ESP_ERR_OTA_BASE				0x1500
+#define ESP_ERR_OTA_PARTITION_CONFLICT	(ESP_ERR_OTA_BASE + 0x01)
+#define ESP_ERR_OTA_SELECT_INFO_INVALID	(ESP_ERR_OTA_BASE + 0x02)
+#define ESP_ERR_OTA_VALIDATE_FAILED		(ESP_ERR_OTA_BASE + 0x03)
+#define ESP_ERR_OTA_SMALL_SEC_VER		(ESP_ERR_OTA_BASE + 0x04)
+
+#define ESP_ERR_IMAGE_BASE				0x2000
+#define ESP_ERR_IMAGE_FLASH_FAIL		(ESP_ERR_IMAGE_BASE + 1)
+#define ESP_ERR_IMAGE_INVALID			(ESP_ERR_IMAGE_BASE + 2)
+
+#define ESP_ERROR_CHECK(x) do { \
+		esp_err_t err_rc_ = (x); \
+		if(err_rc_ != ESP_OK) \
+		{ \
+			fprintf(stderr, "ESP_ERROR_CHECK failed: esp_err_t 0x%x (%s) at %s:%d\n", err_rc_, \
+					esp_err_to_name(err_rc_), __FILE__, __LINE__); \
+			abort(); \
+		} \
+	} while(0)
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+const char *esp_err_to_name(esp_err_t code);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_ERR_H__ */
@@ -0,0 +1,62 @@
+/****************************************************************************/
+//  File    : esp_heap_caps.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             heap_caps over malloc, with the allocation hooks of CONFIG_HEAP_USE_HOOKS
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_HEAP_CAPS_H__)
+
+#define __HOST_ESP_HEAP_CAPS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "sdkconfig.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define MALLOC_CAP_EXEC			(1 << 0)
+#define MALLOC_CAP_32BIT		(1 << 1)
+#define MALLOC_CAP_8BIT			(1 << 2)
+#define MALLOC_CAP_DMA			(1 << 3)
+#define MALLOC_CAP_SPIRAM		(1 << 10)
+#define MALLOC_CAP_INTERNAL		(1 << 11)
+#define MALLOC_CAP_DEFAULT		(1 << 12)
+
+typedef void (*esp_alloc_failed_hook_t)(size_t size, uint32_t caps, const char *function_name);
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void *heap_caps_malloc(size_t size, uint32_t caps);
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps);
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps);
+void heap_caps_free(void *ptr);
+size_t heap_caps_get_free_size(uint32_t caps);
+size_t heap_caps_get_minimum_free_size(uint32_t caps);
+size_t heap_caps_get_largest_free_block(uint32_t caps);
+esp_err_t heap_caps_register_failed_alloc_callback(esp_alloc_failed_hook_t callback);
+
+#if (CONFIG_HEAP_USE_HOOKS)
+// Weak defaults in port/src/esp_heap_caps.c, heap_tag.c has the real ones
+void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps);
+void esp_heap_trace_free_hook(void *ptr);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_HEAP_CAPS_H__ */
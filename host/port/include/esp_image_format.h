@@ -0,0 +1,91 @@
+/****************************************************************************/
+//  File    : esp_image_format.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             App image header and esp_image_verify() over the flash file
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_IMAGE_FORMAT_H__)
+
+#define __HOST_ESP_IMAGE_FORMAT_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_app_desc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define ESP_IMAGE_HEADER_MAGIC		0xE9
+#define ESP_IMAGE_MAX_SEGMENTS		16
+#define ESP_IMAGE_HASH_LEN			32
+
+typedef enum {
+	ESP_CHIP_ID_ESP32 = 0x0000,
+	ESP_CHIP_ID_ESP32S2 = 0x0002,
+	ESP_CHIP_ID_ESP32C3 = 0x0005,
+	ESP_CHIP_ID_ESP32S3 = 0x0009,
+	ESP_CHIP_ID_INVALID = 0xFFFF
+} __attribute__((packed)) esp_chip_id_t;
+
+typedef struct {
+	uint8_t magic;
+	uint8_t segment_count;
+	uint8_t spi_mode;
+	uint8_t spi_speed: 4;
+	uint8_t spi_size: 4;
+	uint32_t entry_addr;
+	uint8_t wp_pin;
+	uint8_t spi_pin_drv[3];
+	esp_chip_id_t chip_id;
+	uint8_t min_chip_rev;
+	uint16_t min_chip_rev_full;
+	uint16_t max_chip_rev_full;
+	uint8_t reserved[4];
+	uint8_t hash_appended;
+} __attribute__((packed)) esp_image_header_t;
+
+_Static_assert(sizeof(esp_image_header_t) == 24, "esp_image_header_t must be 24 bytes");
+
+typedef struct {
+	uint32_t load_addr;
+	uint32_t data_len;
+} esp_image_segment_header_t;
+
+typedef struct {
+	uint32_t offset;
+	uint32_t size;
+} esp_partition_pos_t;
+
+typedef struct {
+	uint32_t start_addr;
+	esp_image_header_t image;
+	esp_image_segment_header_t segments[ESP_IMAGE_MAX_SEGMENTS];
+	uint32_t segment_data[ESP_IMAGE_MAX_SEGMENTS];
+	uint32_t image_len;		// header to checksum, and the SHA-256 when appended
+	uint8_t image_digest[32];
+} esp_image_metadata_t;
+
+typedef enum {
+	ESP_IMAGE_VERIFY,
+	ESP_IMAGE_VERIFY_SILENT,
+} esp_image_load_mode_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_IMAGE_FORMAT_H__ */
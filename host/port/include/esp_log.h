@@ -0,0 +1,60 @@
+/****************************************************************************/
+//  File    : esp_log.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             ESP_LOGx to stdout in the ESP-IDF line format
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_LOG_H__)
+
+#define __HOST_ESP_LOG_H__
+
+#include <stdint.h>
+#include <stdarg.h>
+#include <ctype.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef enum {
+	ESP_LOG_NONE,
+	ESP_LOG_ERROR,
+	ESP_LOG_WARN,
+	ESP_LOG_INFO,
+	ESP_LOG_DEBUG,
+	ESP_LOG_VERBOSE
+} esp_log_level_t;
+
+#define ESP_LOG_LEVEL(level, letter, tag, format, ...) do { \
+		if((level) <= CONFIG_LOG_DEFAULT_LEVEL) \
+			esp_log_write(level, tag, letter " (%u) %s: " format "\n", (unsigned int)esp_log_timestamp(), tag, ##__VA_ARGS__); \
+	} while(0)
+
+#define ESP_LOGE(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_ERROR, "E", tag, format, ##__VA_ARGS__)
+#define ESP_LOGW(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_WARN, "W", tag, format, ##__VA_ARGS__)
+#define ESP_LOGI(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_INFO, "I", tag, format, ##__VA_ARGS__)
+#define ESP_LOGD(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_DEBUG, "D", tag, format, ##__VA_ARGS__)
+#define ESP_LOGV(tag, format, ...)	ESP_LOG_LEVEL(ESP_LOG_VERBOSE, "V", tag, format, ##__VA_ARGS__)
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+uint32_t esp_log_timestamp(void);
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...) __attribute__((format(printf, 3, 4)));
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_LOG_H__ */
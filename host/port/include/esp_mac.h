@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : esp_mac.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by bt_ble.c, the MAC address is not read
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_MAC_H__)
+
+#define __HOST_ESP_MAC_H__
+
+#include "esp_err.h"
+
+#endif  /* End_of __HOST_ESP_MAC_H__ */
@@ -0,0 +1,51 @@
+/****************************************************************************/
+//  File    : esp_ota_ops.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             esp_ota_ops with the ESP-IDF rules, otadata in the flash file
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_OTA_OPS_H__)
+
+#define __HOST_ESP_OTA_OPS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_app_desc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define OTA_SIZE_UNKNOWN			0xffffffff
+#define OTA_WITH_SEQUENTIAL_WRITES	0xfffffffe
+
+typedef uint32_t esp_ota_handle_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle);
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size);
+esp_err_t esp_ota_end(esp_ota_handle_t handle);
+esp_err_t esp_ota_abort(esp_ota_handle_t handle);
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition);
+const esp_partition_t *esp_ota_get_boot_partition(void);
+const esp_partition_t *esp_ota_get_running_partition(void);
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_OTA_OPS_H__ */
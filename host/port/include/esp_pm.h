@@ -0,0 +1,52 @@
+/****************************************************************************/
+//  File    : esp_pm.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Power management locks, counted only
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_PM_H__)
+
+#define __HOST_ESP_PM_H__
+
+#include <stdbool.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef enum {
+	ESP_PM_CPU_FREQ_MAX,
+	ESP_PM_APB_FREQ_MAX,
+	ESP_PM_NO_LIGHT_SLEEP,
+} esp_pm_lock_type_t;
+
+typedef struct esp_pm_lock *esp_pm_lock_handle_t;
+
+typedef struct {
+	int max_freq_mhz;
+	int min_freq_mhz;
+	bool light_sleep_enable;
+} esp_pm_config_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t esp_pm_configure(const void *config);
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle);
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle);
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_PM_H__ */
@@ -0,0 +1,35 @@
+/****************************************************************************/
+//  File    : esp_random.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             esp_random() from getrandom()
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_RANDOM_H__)
+
+#define __HOST_ESP_RANDOM_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+uint32_t esp_random(void);
+void esp_fill_random(void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_RANDOM_H__ */
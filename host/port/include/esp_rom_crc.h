@@ -0,0 +1,33 @@
+/****************************************************************************/
+//  File    : esp_rom_crc.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             ROM CRC32, same polynomial and conventions as zlib crc32()
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_ROM_CRC_H__)
+
+#define __HOST_ESP_ROM_CRC_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_ROM_CRC_H__ */
@@ -0,0 +1,34 @@
+/****************************************************************************/
+//  File    : esp_rom_sys.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             ROM delay and CPU clock : the host cycle counter counts nanoseconds
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_ROM_SYS_H__)
+
+#define __HOST_ESP_ROM_SYS_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+void esp_rom_delay_us(uint32_t us);
+uint32_t esp_rom_get_cpu_ticks_per_us(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_ROM_SYS_H__ */
@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : esp_system.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Restart and heap size queries (port/src/esp_system.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_SYSTEM_H__)
+
+#define __HOST_ESP_SYSTEM_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_attr.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+// Runs the program again (same arguments) : the new boot reads the otadata of the flash file
+void esp_restart(void) __attribute__((noreturn));
+// Host only : arguments of the next boot
+void esp_restart_host_args(char **argv);
+uint32_t esp_get_free_heap_size(void);
+uint32_t esp_get_minimum_free_heap_size(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_SYSTEM_H__ */
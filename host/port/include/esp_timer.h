@@ -0,0 +1,34 @@
+/****************************************************************************/
+//  File    : esp_timer.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             esp_timer_get_time() on CLOCK_MONOTONIC
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_TIMER_H__)
+
+#define __HOST_ESP_TIMER_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+int64_t esp_timer_get_time(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_TIMER_H__ */
@@ -0,0 +1,56 @@
+/****************************************************************************/
+//  File    : esp_tls.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             esp-tls server side on OpenSSL libssl, TLS 1.2 like the device (port/src/esp_tls.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_TLS_H__)
+
+#define __HOST_ESP_TLS_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define ESP_TLS_ERR_SSL_WANT_READ		-0x6900
+#define ESP_TLS_ERR_SSL_WANT_WRITE		-0x6880
+
+typedef struct esp_tls esp_tls_t;
+
+typedef struct {
+	const unsigned char *servercert_buf;
+	unsigned int servercert_bytes;
+	const unsigned char *serverkey_buf;
+	unsigned int serverkey_bytes;
+	void *ticket_ctx;		// set by esp_tls_cfg_server_session_tickets_init()
+	void *ssl_ctx;			// SSL_CTX, made on the first session
+} esp_tls_cfg_server_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_tls_t *esp_tls_init(void);
+esp_err_t esp_tls_cfg_server_session_tickets_init(esp_tls_cfg_server_t *cfg);
+int esp_tls_server_session_create(esp_tls_cfg_server_t *cfg, int sockfd, esp_tls_t *tls);
+void esp_tls_server_session_delete(esp_tls_t *tls);
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen);
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_TLS_H__ */
@@ -0,0 +1,41 @@
+/****************************************************************************/
+//  File    : esp_wifi.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Wi-Fi power save of OTA turbo : no radio, the setting is only kept
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_ESP_WIFI_H__)
+
+#define __HOST_ESP_WIFI_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef enum {
+	WIFI_PS_NONE,
+	WIFI_PS_MIN_MODEM,
+	WIFI_PS_MAX_MODEM,
+} wifi_ps_type_t;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type);
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_ESP_WIFI_H__ */
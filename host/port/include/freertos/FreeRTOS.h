@@ -0,0 +1,82 @@
+/****************************************************************************/
+//  File    : freertos/FreeRTOS.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             FreeRTOS types and port macros over pthreads (port/src/freertos.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_FREERTOS_FREERTOS_H__)
+
+#define __HOST_FREERTOS_FREERTOS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include "sdkconfig.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef int32_t BaseType_t;
+typedef uint32_t UBaseType_t;
+typedef uint32_t TickType_t;
+typedef uint32_t configSTACK_DEPTH_TYPE;
+
+#define configTICK_RATE_HZ				CONFIG_FREERTOS_HZ
+#define configMAX_PRIORITIES			25
+#define configNUMBER_OF_CORES			CONFIG_FREERTOS_NUMBER_OF_CORES
+#define portNUM_PROCESSORS				configNUMBER_OF_CORES
+#define configUSE_TRACE_FACILITY		CONFIG_FREERTOS_USE_TRACE_FACILITY
+#define configGENERATE_RUN_TIME_STATS	CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS
+#define configTASKLIST_INCLUDE_COREID	1
+
+#define portTICK_PERIOD_MS		((TickType_t)1000 / configTICK_RATE_HZ)
+#define portMAX_DELAY			((TickType_t)0xffffffffUL)
+#define pdMS_TO_TICKS(ms)		((TickType_t)(((TickType_t)(ms) * (TickType_t)configTICK_RATE_HZ) / (TickType_t)1000U))
+
+#define pdFALSE			((BaseType_t)0)
+#define pdTRUE			((BaseType_t)1)
+#define pdPASS			(pdTRUE)
+#define pdFAIL			(pdFALSE)
+#define errQUEUE_FULL	((BaseType_t)0)
+
+#define tskNO_AFFINITY	((BaseType_t)0x7FFFFFFF)
+#define PRO_CPU_NUM		(0)
+#define APP_CPU_NUM		(1)
+
+// Critical sections : one process wide recursive lock, the spinlock argument is unused
+typedef struct {
+	int unused;
+} portMUX_TYPE;
+
+#define portMUX_INITIALIZER_UNLOCKED	{ 0 }
+#define portENTER_CRITICAL(mux)			vPortEnterCritical(mux)
+#define portEXIT_CRITICAL(mux)			vPortExitCritical(mux)
+#define portENTER_CRITICAL_ISR(mux)		vPortEnterCritical(mux)
+#define portEXIT_CRITICAL_ISR(mux)		vPortExitCritical(mux)
+#define taskENTER_CRITICAL(mux)			vPortEnterCritical(mux)
+#define taskEXIT_CRITICAL(mux)			vPortExitCritical(mux)
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void vPortEnterCritical(portMUX_TYPE *mux);
+void vPortExitCritical(portMUX_TYPE *mux);
+BaseType_t xPortInIsrContext(void);
+BaseType_t xPortGetCoreID(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_FREERTOS_FREERTOS_H__ */
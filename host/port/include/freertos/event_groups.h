@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : freertos/event_groups.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by debug.c and ota.c, no event group is used
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_FREERTOS_EVENT_GROUPS_H__)
+
+#define __HOST_FREERTOS_EVENT_GROUPS_H__
+
+#include "freertos/FreeRTOS.h"
+
+#endif  /* End_of __HOST_FREERTOS_EVENT_GROUPS_H__ */
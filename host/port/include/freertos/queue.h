@@ -0,0 +1,45 @@
+/****************************************************************************/
+//  File    : freertos/queue.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Queues : ring buffer under a mutex, waits on condition variables
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_FREERTOS_QUEUE_H__)
+
+#define __HOST_FREERTOS_QUEUE_H__
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef struct QueueDefinition *QueueHandle_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size);
+void vQueueDelete(QueueHandle_t queue);
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks);
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks);
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t queue);
+BaseType_t xQueueReset(QueueHandle_t queue);
+
+#define xQueueSendToBack(queue, item, ticks)	xQueueSend(queue, item, ticks)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_FREERTOS_QUEUE_H__ */
@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : freertos/semphr.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Semaphores are queues of zero size items, as in FreeRTOS
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_FREERTOS_SEMPHR_H__)
+
+#define __HOST_FREERTOS_SEMPHR_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef QueueHandle_t SemaphoreHandle_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+SemaphoreHandle_t xSemaphoreCreateBinary(void);
+SemaphoreHandle_t xSemaphoreCreateMutex(void);
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks);
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem);
+
+#define vSemaphoreDelete(sem)	vQueueDelete(sem)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_FREERTOS_SEMPHR_H__ */
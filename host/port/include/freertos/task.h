@@ -0,0 +1,91 @@
+/****************************************************************************/
+//  File    : freertos/task.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Tasks are pthreads, priority and core are recorded for the task list
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_FREERTOS_TASK_H__)
+
+#define __HOST_FREERTOS_TASK_H__
+
+#include "freertos/FreeRTOS.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef struct tskTaskControlBlock *TaskHandle_t;
+typedef void (*TaskFunction_t)(void *);
+
+typedef enum {
+	eRunning = 0,
+	eReady,
+	eBlocked,
+	eSuspended,
+	eDeleted,
+	eInvalid
+} eTaskState;
+
+typedef struct {
+	TaskHandle_t xHandle;
+	const char *pcTaskName;
+	UBaseType_t xTaskNumber;
+	eTaskState eCurrentState;
+	UBaseType_t uxCurrentPriority;
+	UBaseType_t uxBasePriority;
+	uint32_t ulRunTimeCounter;		// us of thread CPU time
+	void *pxStackBase;
+	configSTACK_DEPTH_TYPE usStackHighWaterMark;
+	BaseType_t xCoreID;
+} TaskStatus_t;
+
+#define configMAX_TASK_NAME_LEN		16
+
+#define taskSCHEDULER_SUSPENDED		((BaseType_t)0)
+#define taskSCHEDULER_NOT_STARTED	((BaseType_t)1)
+#define taskSCHEDULER_RUNNING		((BaseType_t)2)
+
+#define taskYIELD()		vPortYield()
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle, const BaseType_t core);
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, const configSTACK_DEPTH_TYPE stack, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle);
+void vTaskDelete(TaskHandle_t task);
+void vTaskDelay(const TickType_t ticks);
+void vTaskSuspend(TaskHandle_t task);
+void vTaskResume(TaskHandle_t task);
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority);
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task);
+TaskHandle_t xTaskGetCurrentTaskHandle(void);
+TaskHandle_t xTaskGetHandle(const char *name);
+char *pcTaskGetName(TaskHandle_t task);
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task);
+TickType_t xTaskGetTickCount(void);
+UBaseType_t uxTaskGetNumberOfTasks(void);
+BaseType_t xTaskGetSchedulerState(void);
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, const UBaseType_t count, uint32_t *total_runtime);
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index);
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value);
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks);
+BaseType_t xTaskNotifyGive(TaskHandle_t task);
+void vPortYield(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_FREERTOS_TASK_H__ */
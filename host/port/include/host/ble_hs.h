@@ -0,0 +1,245 @@
+/****************************************************************************/
+//  File    : host/ble_hs.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             NimBLE host API of bt_ble.c, the link is a local phone socket (port/src/nimble.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_HOST_BLE_HS_H__)
+
+#define __HOST_HOST_BLE_HS_H__
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/queue.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+// Phone side : TCP on 127.0.0.1, each frame is a 16 bit LE length and the bytes of one GATT write
+// to the RX characteristic (length 0 : empty write). Length 0xFFFF + 16 bit MTU : MTU exchange.
+// Notifications of the TX characteristic come back framed the same way.
+#define BLE_HOST_PHONE_PORT		12224
+#define BLE_HOST_FRAME_MTU		0xFFFF
+#define BLE_HOST_MBUF_SIZE		256		// msys block payload, longer writes become chains
+#define BLE_HOST_MBUF_COUNT		12
+#define BLE_HOST_CONN_MAX		2		// a second phone replaces the first, as bt_ble.c does
+
+#define BLE_ATT_ATTR_MAX_LEN	512
+
+#define BLE_HS_EALREADY			2
+#define BLE_HS_EINVAL			3
+#define BLE_HS_EMSGSIZE			4
+#define BLE_HS_ENOMEM			6
+#define BLE_HS_ENOTCONN			7
+#define BLE_HS_EUNKNOWN			17
+#define BLE_HS_FOREVER			INT32_MAX
+#define BLE_HS_CONN_HANDLE_NONE	0xffff
+
+#define BLE_HS_ERR_HCI_BASE				0x200
+#define BLE_HS_HCI_ERR(x)				(BLE_HS_ERR_HCI_BASE + (x))
+#define BLE_ERR_REM_USER_CONN_TERM		0x13
+#define BLE_ERR_CONN_TERM_LOCAL			0x16
+#define BLE_HCI_LE_PHY_1M_PREF_MASK		0x01
+#define BLE_HCI_LE_PHY_2M_PREF_MASK		0x02
+
+struct os_mbuf {
+	uint8_t *om_data;
+	uint8_t om_flags;
+	uint8_t om_pkthdr_len;
+	uint16_t om_len;
+	void *om_omp;
+	SLIST_ENTRY(os_mbuf) om_next;
+	uint8_t om_databuf[0];
+};
+
+#define BLE_UUID_TYPE_16	16
+#define BLE_UUID_TYPE_128	128
+
+typedef struct {
+	uint8_t type;
+} ble_uuid_t;
+
+typedef struct {
+	ble_uuid_t u;
+	uint8_t value[16];
+} ble_uuid128_t;
+
+#define BLE_UUID128_INIT(uuid128...)	{ .u = { .type = BLE_UUID_TYPE_128 }, .value = { uuid128 } }
+
+#define BLE_GATT_ACCESS_OP_READ_CHR		0
+#define BLE_GATT_ACCESS_OP_WRITE_CHR	1
+
+struct ble_gatt_access_ctxt {
+	uint8_t op;
+	struct os_mbuf *om;
+	const void *chr;
+};
+
+typedef int ble_gatt_access_fn(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg);
+
+#define BLE_GATT_CHR_F_READ				0x0002
+#define BLE_GATT_CHR_F_WRITE_NO_RSP		0x0004
+#define BLE_GATT_CHR_F_WRITE			0x0008
+#define BLE_GATT_CHR_F_NOTIFY			0x0010
+
+#define BLE_GATT_SVC_TYPE_END			0
+#define BLE_GATT_SVC_TYPE_PRIMARY		1
+
+struct ble_gatt_chr_def {
+	const ble_uuid_t *uuid;
+	ble_gatt_access_fn *access_cb;
+	void *arg;
+	void *descriptors;
+	uint16_t flags;
+	uint8_t min_key_size;
+	uint16_t *val_handle;
+};
+
+struct ble_gatt_svc_def {
+	uint8_t type;
+	const ble_uuid_t *uuid;
+	const struct ble_gatt_svc_def **includes;
+	const struct ble_gatt_chr_def *characteristics;
+};
+
+#define BLE_HS_ADV_F_DISC_LTD			0x01
+#define BLE_HS_ADV_F_DISC_GEN			0x02
+#define BLE_HS_ADV_F_BREDR_UNSUP		0x04
+#define BLE_HS_ADV_TX_PWR_LVL_AUTO		(-128)
+
+struct ble_hs_adv_fields {
+	uint8_t flags;
+	const ble_uuid128_t *uuids128;
+	uint8_t num_uuids128;
+	unsigned uuids128_is_complete:1;
+	const uint8_t *name;
+	uint8_t name_len;
+	unsigned name_is_complete:1;
+	int8_t tx_pwr_lvl;
+	unsigned tx_pwr_lvl_is_present:1;
+};
+
+#define BLE_GAP_CONN_MODE_NON			0
+#define BLE_GAP_CONN_MODE_DIR			1
+#define BLE_GAP_CONN_MODE_UND			2
+#define BLE_GAP_DISC_MODE_NON			0
+#define BLE_GAP_DISC_MODE_LTD			1
+#define BLE_GAP_DISC_MODE_GEN			2
+
+struct ble_gap_adv_params {
+	uint8_t conn_mode;
+	uint8_t disc_mode;
+	uint16_t itvl_min;
+	uint16_t itvl_max;
+	uint8_t channel_map;
+	uint8_t filter_policy;
+	uint8_t high_duty_cycle:1;
+};
+
+struct ble_gap_sec_state {
+	unsigned encrypted:1;
+	unsigned authenticated:1;
+	unsigned bonded:1;
+	unsigned key_size:5;
+};
+
+struct ble_gap_conn_desc {
+	struct ble_gap_sec_state sec_state;
+	uint16_t conn_handle;
+	uint16_t conn_itvl;
+	uint16_t conn_latency;
+	uint16_t supervision_timeout;
+};
+
+struct ble_gap_upd_params {
+	uint16_t itvl_min;
+	uint16_t itvl_max;
+	uint16_t latency;
+	uint16_t supervision_timeout;
+	uint16_t min_ce_len;
+	uint16_t max_ce_len;
+};
+
+#define BLE_GAP_EVENT_CONNECT				0
+#define BLE_GAP_EVENT_DISCONNECT			1
+#define BLE_GAP_EVENT_CONN_UPDATE			3
+#define BLE_GAP_EVENT_ADV_COMPLETE			9
+#define BLE_GAP_EVENT_SUBSCRIBE				14
+#define BLE_GAP_EVENT_MTU					15
+#define BLE_GAP_EVENT_PHY_UPDATE_COMPLETE	26
+
+struct ble_gap_event {
+	uint8_t type;
+	union {
+		struct {
+			int status;
+			uint16_t conn_handle;
+		} connect;
+		struct {
+			int reason;
+			struct ble_gap_conn_desc conn;
+		} disconnect;
+		struct {
+			int status;
+			uint16_t conn_handle;
+		} conn_update;
+		struct {
+			uint16_t conn_handle;
+			uint16_t channel_id;
+			uint16_t value;
+		} mtu;
+		struct {
+			int status;
+			uint16_t conn_handle;
+			uint8_t tx_phy;
+			uint8_t rx_phy;
+		} phy_updated;
+	};
+};
+
+typedef int ble_gap_event_fn(struct ble_gap_event *event, void *arg);
+
+typedef void ble_hs_sync_fn(void);
+
+struct ble_hs_cfg {
+	ble_hs_sync_fn *sync_cb;
+};
+
+/*---------------------------- Variables ---------------------------------*/
+extern struct ble_hs_cfg ble_hs_cfg;
+
+/*-------------------------- Function declares ---------------------------*/
+int ble_hs_synced(void);
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs);
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *svcs);
+int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *adv_fields);
+int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *rsp_fields);
+int ble_gap_adv_start(uint8_t own_addr_type, const void *direct_addr, int32_t duration_ms,
+		const struct ble_gap_adv_params *adv_params, ble_gap_event_fn *cb, void *cb_arg);
+int ble_gap_adv_stop(void);
+int ble_gap_adv_active(void);
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc);
+int ble_gap_update_params(uint16_t conn_handle, const struct ble_gap_upd_params *params);
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason);
+int ble_gap_set_prefered_default_le_phy(uint8_t tx_phys_mask, uint8_t rx_phys_mask);
+int ble_gap_read_le_phy(uint16_t conn_handle, uint8_t *tx_phy, uint8_t *rx_phy);
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len);
+int os_mbuf_free_chain(struct os_mbuf *om);
+int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle, struct os_mbuf *om);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_HOST_BLE_HS_H__ */
@@ -0,0 +1,33 @@
+/****************************************************************************/
+//  File    : host/util/util.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Own address type
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_HOST_UTIL_UTIL_H__)
+
+#define __HOST_HOST_UTIL_UTIL_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_HOST_UTIL_UTIL_H__ */
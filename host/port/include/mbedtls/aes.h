@@ -0,0 +1,50 @@
+/****************************************************************************/
+//  File    : mbedtls/aes.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             AES of mbedTLS on OpenSSL libcrypto (port/src/mbedtls.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_MBEDTLS_AES_H__)
+
+#define __HOST_MBEDTLS_AES_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define MBEDTLS_AES_ENCRYPT		1
+#define MBEDTLS_AES_DECRYPT		0
+
+#define MBEDTLS_ERR_AES_INVALID_KEY_LENGTH		-0x0020
+#define MBEDTLS_ERR_AES_BAD_INPUT_DATA			-0x0021
+
+typedef struct {
+	void *ecb;				// EVP_CIPHER_CTX, AES-ECB encrypt of the counter blocks
+	unsigned int keybits;
+} mbedtls_aes_context;
+
+/*-------------------------- Function declares ---------------------------*/
+void mbedtls_aes_init(mbedtls_aes_context *ctx);
+void mbedtls_aes_free(mbedtls_aes_context *ctx);
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits);
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context *ctx, size_t length, size_t *nc_off, unsigned char nonce_counter[16],
+		unsigned char stream_block[16], const unsigned char *input, unsigned char *output);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_MBEDTLS_AES_H__ */
@@ -0,0 +1,22 @@
+/****************************************************************************/
+//  File    : mbedtls/base64.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Included by json.c, nothing of it is used
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_MBEDTLS_BASE64_H__)
+
+#define __HOST_MBEDTLS_BASE64_H__
+
+#include <stddef.h>
+
+#endif  /* End_of __HOST_MBEDTLS_BASE64_H__ */
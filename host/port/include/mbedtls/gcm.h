@@ -0,0 +1,65 @@
+/****************************************************************************/
+//  File    : mbedtls/gcm.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             AES-GCM of mbedTLS 3.x on OpenSSL libcrypto (port/src/mbedtls.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_MBEDTLS_GCM_H__)
+
+#define __HOST_MBEDTLS_GCM_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define MBEDTLS_GCM_ENCRYPT		1
+#define MBEDTLS_GCM_DECRYPT		0
+
+#define MBEDTLS_ERR_GCM_AUTH_FAILED		-0x0012
+#define MBEDTLS_ERR_GCM_BAD_INPUT		-0x0014
+
+typedef enum {
+	MBEDTLS_CIPHER_ID_NONE = 0,
+	MBEDTLS_CIPHER_ID_NULL,
+	MBEDTLS_CIPHER_ID_AES,
+} mbedtls_cipher_id_t;
+
+// The tag mbedtls_gcm_finish() returns is the one of the ciphertext : on decrypt
+// a second context encrypts the plaintext again, its tag is that one
+typedef struct {
+	void *cipher;		// EVP_CIPHER_CTX of the requested direction
+	void *tag;			// EVP_CIPHER_CTX encrypting, decrypt only
+	int mode;
+	unsigned char key[32];
+	unsigned int keybits;
+} mbedtls_gcm_context;
+
+/*-------------------------- Function declares ---------------------------*/
+void mbedtls_gcm_init(mbedtls_gcm_context *ctx);
+void mbedtls_gcm_free(mbedtls_gcm_context *ctx);
+int mbedtls_gcm_setkey(mbedtls_gcm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key, unsigned int keybits);
+int mbedtls_gcm_starts(mbedtls_gcm_context *ctx, int mode, const unsigned char *iv, size_t iv_len);
+int mbedtls_gcm_update_ad(mbedtls_gcm_context *ctx, const unsigned char *add, size_t add_len);
+int mbedtls_gcm_update(mbedtls_gcm_context *ctx, const unsigned char *input, size_t input_length,
+		unsigned char *output, size_t output_size, size_t *output_length);
+int mbedtls_gcm_finish(mbedtls_gcm_context *ctx, unsigned char *output, size_t output_size, size_t *output_length,
+		unsigned char *tag, size_t tag_len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_MBEDTLS_GCM_H__ */
@@ -0,0 +1,33 @@
+/****************************************************************************/
+//  File    : mbedtls/platform_util.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             mbedtls_platform_zeroize()
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_MBEDTLS_PLATFORM_UTIL_H__)
+
+#define __HOST_MBEDTLS_PLATFORM_UTIL_H__
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+void mbedtls_platform_zeroize(void *buf, size_t len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_MBEDTLS_PLATFORM_UTIL_H__ */
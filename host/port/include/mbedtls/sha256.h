@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : mbedtls/sha256.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             SHA-256 of mbedTLS 3.x on OpenSSL libcrypto (port/src/mbedtls.c)
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_MBEDTLS_SHA256_H__)
+
+#define __HOST_MBEDTLS_SHA256_H__
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+typedef struct {
+	void *md;			// EVP_MD_CTX
+} mbedtls_sha256_context;
+
+/*-------------------------- Function declares ---------------------------*/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx);
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx);
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224);
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen);
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output);
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char *output, int is224);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_MBEDTLS_SHA256_H__ */
@@ -0,0 +1,24 @@
+/****************************************************************************/
+//  File    : netinet/in.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             lwIP netinet/in.h : the address types with htons() and inet_ntoa()
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_NETINET_IN_H__)
+
+#define __HOST_NETINET_IN_H__
+
+// glibc keeps the inet helpers apart, lwIP has them with the address types
+#include_next <netinet/in.h>
+#include <arpa/inet.h>
+
+#endif  /* End_of __HOST_NETINET_IN_H__ */
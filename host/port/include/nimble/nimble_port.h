@@ -0,0 +1,36 @@
+/****************************************************************************/
+//  File    : nimble/nimble_port.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Host stack run loop : the phone socket server
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_NIMBLE_NIMBLE_PORT_H__)
+
+#define __HOST_NIMBLE_NIMBLE_PORT_H__
+
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t nimble_port_init(void);
+esp_err_t nimble_port_deinit(void);
+void nimble_port_run(void);
+int nimble_port_stop(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_NIMBLE_NIMBLE_PORT_H__ */
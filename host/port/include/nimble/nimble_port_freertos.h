@@ -0,0 +1,35 @@
+/****************************************************************************/
+//  File    : nimble/nimble_port_freertos.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Host task
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_NIMBLE_NIMBLE_PORT_FREERTOS_H__)
+
+#define __HOST_NIMBLE_NIMBLE_PORT_FREERTOS_H__
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+void nimble_port_freertos_init(TaskFunction_t host_task_fn);
+void nimble_port_freertos_deinit(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_NIMBLE_NIMBLE_PORT_FREERTOS_H__ */
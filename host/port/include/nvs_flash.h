@@ -0,0 +1,35 @@
+/****************************************************************************/
+//  File    : nvs_flash.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             NVS partition init
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_NVS_FLASH_H__)
+
+#define __HOST_NVS_FLASH_H__
+
+#include "esp_err.h"
+#include "nvs.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t nvs_flash_init(void);
+esp_err_t nvs_flash_erase(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_NVS_FLASH_H__ */
@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : sdkconfig.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             The options of /sdkconfig that main/ reads, same values
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_SDKCONFIG_H__)
+
+#define __HOST_SDKCONFIG_H__
+
+#define CONFIG_IDF_TARGET_ESP32S3				1
+#define CONFIG_IDF_FIRMWARE_CHIP_ID				0x0009
+#define CONFIG_ESPTOOLPY_FLASHSIZE				"8MB"
+#define CONFIG_LOG_DEFAULT_LEVEL				3
+#define CONFIG_COMPILER_OPTIMIZATION_DEBUG		1
+#define CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ			160
+#define CONFIG_PM_ENABLE						1
+#define CONFIG_SPI_FLASH_YIELD_DURING_ERASE		1
+#define CONFIG_BT_NIMBLE_ATT_PREFERRED_MTU		256
+#define CONFIG_ESP_TLS_SERVER					1
+#define CONFIG_ESP_TLS_SERVER_SESSION_TICKETS	1
+// not in /sdkconfig : bench ble and soak ble run in the host tests
+#define CONFIG_OTA_BLE_SIM						1
+
+#define CONFIG_FREERTOS_HZ						100
+#define CONFIG_FREERTOS_NUMBER_OF_CORES			2
+#define CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS	2
+#define CONFIG_FREERTOS_USE_TRACE_FACILITY		1
+#define CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS	1
+
+#define CONFIG_HEAP_USE_HOOKS					1
+// per task live bytes come from the block headers of the device heap, glibc has none
+#define CONFIG_HEAP_TASK_TRACKING				0
+
+#endif  /* End_of __HOST_SDKCONFIG_H__ */
@@ -0,0 +1,33 @@
+/****************************************************************************/
+//  File    : services/gap/ble_svc_gap.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             GAP service : device name
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_SERVICES_GAP_BLE_SVC_GAP_H__)
+
+#define __HOST_SERVICES_GAP_BLE_SVC_GAP_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+const char *ble_svc_gap_device_name(void);
+int ble_svc_gap_device_name_set(const char *name);
+void ble_svc_gap_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_SERVICES_GAP_BLE_SVC_GAP_H__ */
@@ -0,0 +1,31 @@
+/****************************************************************************/
+//  File    : services/gatt/ble_svc_gatt.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             GATT service
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_SERVICES_GATT_BLE_SVC_GATT_H__)
+
+#define __HOST_SERVICES_GATT_BLE_SVC_GATT_H__
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+void ble_svc_gatt_init(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HOST_SERVICES_GATT_BLE_SVC_GATT_H__ */
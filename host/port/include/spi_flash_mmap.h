@@ -0,0 +1,23 @@
+/****************************************************************************/
+//  File    : spi_flash_mmap.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Flash geometry
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_SPI_FLASH_MMAP_H__)
+
+#define __HOST_SPI_FLASH_MMAP_H__
+
+#define SPI_FLASH_SEC_SIZE		4096
+#define SPI_FLASH_MMU_PAGE_SIZE	0x10000
+
+#endif  /* End_of __HOST_SPI_FLASH_MMAP_H__ */
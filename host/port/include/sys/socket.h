@@ -0,0 +1,28 @@
+/****************************************************************************/
+//  File    : sys/socket.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             lwIP sys/socket.h : the socket calls with the address types and close()
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_SYS_SOCKET_H__)
+
+#define __HOST_SYS_SOCKET_H__
+
+// On the device this header pulls in lwip/sockets.h, which brings the address
+// types, the inet helpers and the POSIX io names the firmware uses with it
+#include_next <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#endif  /* End_of __HOST_SYS_SOCKET_H__ */
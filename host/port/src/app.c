@@ -0,0 +1,48 @@
+/**
+ * @file app.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : what main.c, wifi.c and ota_http.c give the other modules
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+
+#include "esp_system.h"
+#include "esp_app_desc.h"
+
+#include "debug.h"
+#include "ota_http.h"
+#include "wifi.h"
+
+/*---------------------------- User define -------------------------------*/
+
+/*---------------------------- Variables ---------------------------------*/
+static char strVersion[64];
+
+/*-------------------------- Function declares ---------------------------*/
+
+char *get_version_string(void)
+{
+	const esp_app_desc_t *app_desc;
+
+	if(strVersion[0] == 0)
+	{
+		app_desc = esp_app_get_description();
+		snprintf(strVersion, 64, "%s %s %s", app_desc->version, app_desc->date, app_desc->time);
+	}
+	return strVersion;
+}
+
+// The link to the "phone" and the TCP clients is the loopback interface
+char *get_my_ip(void)
+{
+	return "127.0.0.1";
+}
+
+// esp_http_server has no host stand-in
+esp_err_t ota_http_start(void)
+{
+	LOGW("HTTP OTA : not in the host build");
+	return ESP_ERR_NOT_SUPPORTED;
+}
@@ -0,0 +1,174 @@
+/**
+ * @file esp_heap_caps.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : heap_caps over the C library heap, allocation hooks, free heap of a device sized heap
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <malloc.h>
+
+#include "esp_system.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+
+/*---------------------------- User define -------------------------------*/
+// Internal RAM left to the app on the device : the free and minimum free figures are counted against it
+#define HOST_HEAP_SIZE		(320 * 1024)
+
+// The firmware objects are linked with -Wl,--wrap=malloc,... : their malloc() goes through here
+void *__real_malloc(size_t size);
+void *__real_calloc(size_t n, size_t size);
+void *__real_realloc(void *ptr, size_t size);
+void __real_free(void *ptr);
+
+/*---------------------------- Variables ---------------------------------*/
+static size_t heap_used;
+static size_t heap_peak;
+static esp_alloc_failed_hook_t heap_failed_hook;
+
+/*-------------------------- Function declares ---------------------------*/
+
+#if (CONFIG_HEAP_USE_HOOKS)
+// heap_tag.c has the real hooks
+__attribute__((weak)) void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+}
+
+__attribute__((weak)) void esp_heap_trace_free_hook(void *ptr)
+{
+}
+#endif
+
+static void heap_account(void *ptr, int add)
+{
+	size_t size = malloc_usable_size(ptr), used;
+
+	if(add)
+	{
+		used = __atomic_add_fetch(&heap_used, size, __ATOMIC_RELAXED);
+		if(used > heap_peak) heap_peak = used;
+	}
+	else
+	{
+		__atomic_sub_fetch(&heap_used, size, __ATOMIC_RELAXED);
+	}
+}
+
+static void *heap_done(void *ptr, size_t size, uint32_t caps, const char *function)
+{
+	if(ptr == NULL)
+	{
+		if(size > 0 && heap_failed_hook) heap_failed_hook(size, caps, function);
+		return NULL;
+	}
+
+	heap_account(ptr, 1);
+#if (CONFIG_HEAP_USE_HOOKS)
+	esp_heap_trace_alloc_hook(ptr, size, caps);
+#endif
+	return ptr;
+}
+
+void *heap_caps_malloc(size_t size, uint32_t caps)
+{
+	return heap_done(__real_malloc(size), size, caps, __func__);
+}
+
+void *heap_caps_calloc(size_t n, size_t size, uint32_t caps)
+{
+	return heap_done(__real_calloc(n, size), n * size, caps, __func__);
+}
+
+void *heap_caps_realloc(void *ptr, size_t size, uint32_t caps)
+{
+	void *p;
+
+	if(ptr == NULL) return heap_caps_malloc(size, caps);
+	if(size == 0)
+	{
+		heap_caps_free(ptr);
+		return NULL;
+	}
+
+	heap_account(ptr, 0);
+	p = __real_realloc(ptr, size);
+	if(p == NULL)
+	{
+		// the old block is still there
+		heap_account(ptr, 1);
+		if(heap_failed_hook) heap_failed_hook(size, caps, __func__);
+		return NULL;
+	}
+#if (CONFIG_HEAP_USE_HOOKS)
+	esp_heap_trace_free_hook(ptr);
+#endif
+	return heap_done(p, size, caps, __func__);
+}
+
+void heap_caps_free(void *ptr)
+{
+	if(ptr == NULL) return;
+
+#if (CONFIG_HEAP_USE_HOOKS)
+	esp_heap_trace_free_hook(ptr);
+#endif
+	heap_account(ptr, 0);
+	__real_free(ptr);
+}
+
+size_t heap_caps_get_free_size(uint32_t caps)
+{
+	size_t used = __atomic_load_n(&heap_used, __ATOMIC_RELAXED);
+
+	return used < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - used : 0;
+}
+
+size_t heap_caps_get_minimum_free_size(uint32_t caps)
+{
+	return heap_peak < HOST_HEAP_SIZE ? HOST_HEAP_SIZE - heap_peak : 0;
+}
+
+// No fragmentation figure on the host
+size_t heap_caps_get_largest_free_block(uint32_t caps)
+{
+	return heap_caps_get_free_size(caps);
+}
+
+esp_err_t heap_caps_register_failed_alloc_callback(esp_alloc_failed_hook_t callback)
+{
+	heap_failed_hook = callback;
+	return ESP_OK;
+}
+
+uint32_t esp_get_free_heap_size(void)
+{
+	return heap_caps_get_free_size(MALLOC_CAP_DEFAULT);
+}
+
+uint32_t esp_get_minimum_free_heap_size(void)
+{
+	return heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT);
+}
+
+/*---------------------------- libc --------------------------------------*/
+void *__wrap_malloc(size_t size)
+{
+	return heap_caps_malloc(size, MALLOC_CAP_DEFAULT);
+}
+
+void *__wrap_calloc(size_t n, size_t size)
+{
+	return heap_caps_calloc(n, size, MALLOC_CAP_DEFAULT);
+}
+
+void *__wrap_realloc(void *ptr, size_t size)
+{
+	return heap_caps_realloc(ptr, size, MALLOC_CAP_DEFAULT);
+}
+
+void __wrap_free(void *ptr)
+{
+	heap_caps_free(ptr);
+}
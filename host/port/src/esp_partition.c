@@ -0,0 +1,534 @@
+/**
+ * @file esp_partition.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : partitions and esp_ota_ops over a flash image file, otadata and image checks as in ESP-IDF
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+#include "esp_image_format.h"
+#include "esp_rom_crc.h"
+#include "mbedtls/sha256.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "FLASH"
+
+#define FLASH_SIZE			(8 * 1024 * 1024)	// CONFIG_ESPTOOLPY_FLASHSIZE
+#define FLASH_PAGE_SIZE		256
+
+#define OTA_HANDLE_MAX		2
+#define OTA_APP_COUNT		2
+
+// otadata : two sectors, the valid entry with the higher sequence number selects ota_[(seq - 1) % count]
+typedef struct {
+	uint32_t ota_seq;
+	uint8_t seq_label[20];
+	uint32_t ota_state;
+	uint32_t crc;			// crc32_le(UINT32_MAX, &ota_seq, 4)
+} esp_ota_select_entry_t;
+
+#define ESP_OTA_IMG_UNDEFINED	0xFFFFFFFFU
+
+struct esp_partition_iterator_opaque_ {
+	esp_partition_type_t type;
+	esp_partition_subtype_t subtype;
+	const char *label;
+	int index;
+};
+
+typedef struct {
+	esp_ota_handle_t handle;
+	const esp_partition_t *part;
+	uint32_t wrote_size;
+	uint32_t erased_size;
+	int sequential;			// OTA_WITH_SEQUENTIAL_WRITES : sectors erased as the writes reach them
+} ota_ops_entry_t;
+
+/*---------------------------- Variables ---------------------------------*/
+// partitions.csv of the project
+static const esp_partition_t flash_partitions[] = {
+	{ NULL, ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, 0x9000, 0x4000, SPI_FLASH_SEC_SIZE, "nvs" },
+	{ NULL, ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, 0xd000, 0x2000, SPI_FLASH_SEC_SIZE, "otadata" },
+	{ NULL, ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_PHY, 0xf000, 0x1000, SPI_FLASH_SEC_SIZE, "phy_init" },
+	{ NULL, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, 0x10000, 0x140000, SPI_FLASH_SEC_SIZE, "factory" },
+	{ NULL, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_0, 0x150000, 0x140000, SPI_FLASH_SEC_SIZE, "ota_0" },
+	{ NULL, ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_OTA_1, 0x290000, 0x140000, SPI_FLASH_SEC_SIZE, "ota_1" },
+};
+#define FLASH_PARTITION_COUNT	(sizeof(flash_partitions) / sizeof(flash_partitions[0]))
+
+static uint8_t *flash_mem;
+static const esp_partition_t *flash_running;
+static ota_ops_entry_t ota_entries[OTA_HANDLE_MAX];
+static esp_ota_handle_t ota_handles;
+static pthread_mutex_t ota_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*-------------------------- Function declares ---------------------------*/
+
+/*---------------------------- Partitions --------------------------------*/
+static int partition_match(const esp_partition_t *p, esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	if(type != ESP_PARTITION_TYPE_ANY && p->type != type) return 0;
+	if(subtype != ESP_PARTITION_SUBTYPE_ANY && p->subtype != subtype) return 0;
+	return label == NULL || strcmp(p->label, label) == 0;
+}
+
+static esp_partition_iterator_t partition_seek(esp_partition_iterator_t it)
+{
+	for(; it->index < (int)FLASH_PARTITION_COUNT; it->index++)
+	{
+		if(partition_match(&flash_partitions[it->index], it->type, it->subtype, it->label)) return it;
+	}
+	free(it);
+	return NULL;
+}
+
+esp_partition_iterator_t esp_partition_find(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	esp_partition_iterator_t it = calloc(1, sizeof(struct esp_partition_iterator_opaque_));
+
+	if(it == NULL) return NULL;
+
+	it->type = type;
+	it->subtype = subtype;
+	it->label = label;
+	return partition_seek(it);
+}
+
+const esp_partition_t *esp_partition_find_first(esp_partition_type_t type, esp_partition_subtype_t subtype, const char *label)
+{
+	size_t i;
+
+	for(i = 0; i < FLASH_PARTITION_COUNT; i++)
+	{
+		if(partition_match(&flash_partitions[i], type, subtype, label)) return &flash_partitions[i];
+	}
+	return NULL;
+}
+
+const esp_partition_t *esp_partition_get(esp_partition_iterator_t iterator)
+{
+	return &flash_partitions[iterator->index];
+}
+
+esp_partition_iterator_t esp_partition_next(esp_partition_iterator_t iterator)
+{
+	iterator->index++;
+	return partition_seek(iterator);
+}
+
+void esp_partition_iterator_release(esp_partition_iterator_t iterator)
+{
+	free(iterator);
+}
+
+static esp_err_t partition_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	if(partition == NULL || flash_mem == NULL) return ESP_ERR_INVALID_ARG;
+	if(offset > partition->size || size > partition->size - offset) return ESP_ERR_INVALID_SIZE;
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_read(const esp_partition_t *partition, size_t src_offset, void *dst, size_t size)
+{
+	esp_err_t err = partition_range(partition, src_offset, size);
+
+	if(err != ESP_OK) return err;
+
+	memcpy(dst, &flash_mem[partition->address + src_offset], size);
+	return ESP_OK;
+}
+
+// NOR flash : programming only clears bits, an unerased byte keeps the zeros it had
+esp_err_t esp_partition_write(const esp_partition_t *partition, size_t dst_offset, const void *src, size_t size)
+{
+	esp_err_t err = partition_range(partition, dst_offset, size);
+	uint8_t *dst;
+	const uint8_t *s = src;
+	size_t i;
+
+	if(err != ESP_OK) return err;
+
+	dst = &flash_mem[partition->address + dst_offset];
+	for(i = 0; i < size; i++) dst[i] &= s[i];
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_erase_range(const esp_partition_t *partition, size_t offset, size_t size)
+{
+	esp_err_t err = partition_range(partition, offset, size);
+
+	if(err != ESP_OK) return err;
+	if(offset % partition->erase_size || size % partition->erase_size) return ESP_ERR_INVALID_ARG;
+
+	memset(&flash_mem[partition->address + offset], 0xFF, size);
+	return ESP_OK;
+}
+
+esp_err_t esp_partition_mmap(const esp_partition_t *partition, size_t offset, size_t size,
+		esp_partition_mmap_memory_t memory, const void **out_ptr, esp_partition_mmap_handle_t *out_handle)
+{
+	esp_err_t err = partition_range(partition, offset, size);
+
+	if(err != ESP_OK) return err;
+
+	*out_ptr = &flash_mem[partition->address + offset];
+	*out_handle = 0;
+	return ESP_OK;
+}
+
+void esp_partition_munmap(esp_partition_mmap_handle_t handle)
+{
+}
+
+/*---------------------------- Image -------------------------------------*/
+/*******************************************
+What the bootloader and esp_ota_end() check : header, segments inside the
+partition, the XOR checksum (0xEF seed) in the last byte of the 16 byte
+padded block after the segments, then the SHA-256 of all of it when appended.
+*******************************************/
+esp_err_t esp_image_verify(esp_image_load_mode_t mode, const esp_partition_pos_t *part, esp_image_metadata_t *data)
+{
+	const uint8_t *img;
+	uint8_t checksum = 0xEF, sha[ESP_IMAGE_HASH_LEN];
+	uint32_t pos, i, j;
+
+	memset(data, 0, sizeof(esp_image_metadata_t));
+	data->start_addr = part->offset;
+	if(flash_mem == NULL || part->offset + part->size > FLASH_SIZE || part->size < sizeof(esp_image_header_t))
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	img = &flash_mem[part->offset];
+
+	memcpy(&data->image, img, sizeof(esp_image_header_t));
+	if(data->image.magic != ESP_IMAGE_HEADER_MAGIC || data->image.segment_count > ESP_IMAGE_MAX_SEGMENTS)
+	{
+		if(mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "image at 0x%x has invalid magic byte", (unsigned int)part->offset);
+		return ESP_ERR_IMAGE_INVALID;
+	}
+	if(data->image.chip_id != CONFIG_IDF_FIRMWARE_CHIP_ID)
+	{
+		if(mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "image at 0x%x has chip id %d", (unsigned int)part->offset, data->image.chip_id);
+		return ESP_ERR_IMAGE_INVALID;
+	}
+
+	pos = sizeof(esp_image_header_t);
+	for(i = 0; i < data->image.segment_count; i++)
+	{
+		if(pos + sizeof(esp_image_segment_header_t) > part->size) return ESP_ERR_IMAGE_INVALID;
+		memcpy(&data->segments[i], &img[pos], sizeof(esp_image_segment_header_t));
+		pos += sizeof(esp_image_segment_header_t);
+
+		if(data->segments[i].data_len > part->size - pos)
+		{
+			if(mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "segment %d length 0x%x past the partition", (int)i, (unsigned int)data->segments[i].data_len);
+			return ESP_ERR_IMAGE_INVALID;
+		}
+		data->segment_data[i] = part->offset + pos;
+		for(j = 0; j < data->segments[i].data_len; j++) checksum ^= img[pos + j];
+		pos += data->segments[i].data_len;
+	}
+
+	pos = (pos | 15) + 1;
+	if(pos > part->size || img[pos - 1] != checksum)
+	{
+		if(mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Checksum failed. Calculated 0x%x read 0x%x", checksum,
+				pos <= part->size ? img[pos - 1] : 0);
+		return ESP_ERR_IMAGE_INVALID;
+	}
+
+	if(data->image.hash_appended)
+	{
+		if(pos + ESP_IMAGE_HASH_LEN > part->size) return ESP_ERR_IMAGE_INVALID;
+
+		mbedtls_sha256(img, pos, sha, 0);
+		if(memcmp(sha, &img[pos], ESP_IMAGE_HASH_LEN) != 0)
+		{
+			if(mode != ESP_IMAGE_VERIFY_SILENT) ESP_LOGE(TAG, "Image hash failed - image is corrupt");
+			return ESP_ERR_IMAGE_INVALID;
+		}
+		memcpy(data->image_digest, sha, ESP_IMAGE_HASH_LEN);
+		pos += ESP_IMAGE_HASH_LEN;
+	}
+
+	data->image_len = pos;
+	return ESP_OK;
+}
+
+static esp_err_t image_check(const esp_partition_t *partition)
+{
+	esp_partition_pos_t pos = { partition->address, partition->size };
+	esp_image_metadata_t data;
+
+	return esp_image_verify(ESP_IMAGE_VERIFY, &pos, &data) == ESP_OK ? ESP_OK : ESP_ERR_OTA_VALIDATE_FAILED;
+}
+
+/*---------------------------- otadata -----------------------------------*/
+static const esp_partition_t *otadata_partition(void)
+{
+	return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, NULL);
+}
+
+static int otadata_valid(const esp_ota_select_entry_t *e)
+{
+	return e->ota_seq != UINT32_MAX && e->crc == esp_rom_crc32_le(UINT32_MAX, (const uint8_t *)&e->ota_seq, 4);
+}
+
+// Index of the active otadata sector, -1 when none is valid (factory boot)
+static int otadata_active(esp_ota_select_entry_t entry[2])
+{
+	const esp_partition_t *p = otadata_partition();
+
+	esp_partition_read(p, 0, &entry[0], sizeof(esp_ota_select_entry_t));
+	esp_partition_read(p, SPI_FLASH_SEC_SIZE, &entry[1], sizeof(esp_ota_select_entry_t));
+
+	if(otadata_valid(&entry[0]) && otadata_valid(&entry[1])) return entry[0].ota_seq >= entry[1].ota_seq ? 0 : 1;
+	if(otadata_valid(&entry[0])) return 0;
+	if(otadata_valid(&entry[1])) return 1;
+	return -1;
+}
+
+static esp_err_t otadata_select(int slot)
+{
+	const esp_partition_t *p = otadata_partition();
+	esp_ota_select_entry_t entry[2], e;
+	int active = otadata_active(entry), sector;
+	uint32_t seq = (active >= 0) ? entry[active].ota_seq : 0;
+	esp_err_t err;
+
+	// next sequence number that selects this slot
+	do {
+		seq++;
+	} while((seq - 1) % OTA_APP_COUNT != (uint32_t)slot);
+
+	memset(&e, 0xFF, sizeof(e));
+	e.ota_seq = seq;
+	e.ota_state = ESP_OTA_IMG_UNDEFINED;
+	e.crc = esp_rom_crc32_le(UINT32_MAX, (const uint8_t *)&e.ota_seq, 4);
+
+	sector = (active == 0) ? 1 : 0;
+	err = esp_partition_erase_range(p, sector * SPI_FLASH_SEC_SIZE, SPI_FLASH_SEC_SIZE);
+	if(err == ESP_OK) err = esp_partition_write(p, sector * SPI_FLASH_SEC_SIZE, &e, sizeof(e));
+	return err;
+}
+
+/*---------------------------- esp_ota_ops -------------------------------*/
+static ota_ops_entry_t *ota_entry(esp_ota_handle_t handle)
+{
+	int i;
+
+	for(i = 0; i < OTA_HANDLE_MAX; i++)
+	{
+		if(ota_entries[i].handle != 0 && ota_entries[i].handle == handle) return &ota_entries[i];
+	}
+	return NULL;
+}
+
+esp_err_t esp_ota_begin(const esp_partition_t *partition, size_t image_size, esp_ota_handle_t *out_handle)
+{
+	ota_ops_entry_t *e = NULL;
+	esp_err_t err;
+	size_t erase;
+	int i;
+
+	if(partition == NULL || out_handle == NULL) return ESP_ERR_INVALID_ARG;
+	if(partition->type != ESP_PARTITION_TYPE_APP || partition->subtype < ESP_PARTITION_SUBTYPE_APP_OTA_MIN)
+	{
+		return ESP_ERR_INVALID_ARG;
+	}
+	if(partition == flash_running) return ESP_ERR_OTA_PARTITION_CONFLICT;
+	if(image_size != OTA_SIZE_UNKNOWN && image_size != OTA_WITH_SEQUENTIAL_WRITES && image_size > partition->size)
+	{
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	pthread_mutex_lock(&ota_lock);
+	for(i = 0; i < OTA_HANDLE_MAX && e == NULL; i++)
+	{
+		if(ota_entries[i].handle == 0) e = &ota_entries[i];
+	}
+	if(e != NULL)
+	{
+		memset(e, 0, sizeof(ota_ops_entry_t));
+		e->handle = ++ota_handles;
+	}
+	pthread_mutex_unlock(&ota_lock);
+	if(e == NULL) return ESP_ERR_NO_MEM;
+
+	e->part = partition;
+	e->sequential = (image_size == OTA_WITH_SEQUENTIAL_WRITES);
+	if(!e->sequential)
+	{
+		erase = (image_size == OTA_SIZE_UNKNOWN) ? partition->size
+				: (image_size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+		err = esp_partition_erase_range(partition, 0, erase);
+		if(err != ESP_OK)
+		{
+			e->handle = 0;
+			return err;
+		}
+		e->erased_size = erase;
+	}
+
+	*out_handle = e->handle;
+	return ESP_OK;
+}
+
+esp_err_t esp_ota_write(esp_ota_handle_t handle, const void *data, size_t size)
+{
+	ota_ops_entry_t *e = ota_entry(handle);
+	uint32_t end;
+	esp_err_t err;
+
+	if(data == NULL || size == 0) return ESP_ERR_INVALID_ARG;
+	if(e == NULL) return ESP_ERR_INVALID_ARG;
+
+	if(e->wrote_size == 0 && ((const uint8_t *)data)[0] != ESP_IMAGE_HEADER_MAGIC)
+	{
+		ESP_LOGE(TAG, "OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", ((const uint8_t *)data)[0]);
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	if(e->sequential)
+	{
+		end = (e->wrote_size + size + SPI_FLASH_SEC_SIZE - 1) / SPI_FLASH_SEC_SIZE * SPI_FLASH_SEC_SIZE;
+		if(end > e->part->size) return ESP_ERR_INVALID_SIZE;
+		if(end > e->erased_size)
+		{
+			err = esp_partition_erase_range(e->part, e->erased_size, end - e->erased_size);
+			if(err != ESP_OK) return err;
+			e->erased_size = end;
+		}
+	}
+
+	err = esp_partition_write(e->part, e->wrote_size, data, size);
+	if(err != ESP_OK) return err;
+
+	e->wrote_size += size;
+	return ESP_OK;
+}
+
+esp_err_t esp_ota_end(esp_ota_handle_t handle)
+{
+	ota_ops_entry_t *e = ota_entry(handle);
+	esp_err_t err;
+
+	if(e == NULL) return ESP_ERR_NOT_FOUND;
+
+	err = (e->wrote_size == 0) ? ESP_ERR_INVALID_ARG : image_check(e->part);
+	e->handle = 0;
+	return err;
+}
+
+esp_err_t esp_ota_abort(esp_ota_handle_t handle)
+{
+	ota_ops_entry_t *e = ota_entry(handle);
+
+	if(e == NULL) return ESP_ERR_NOT_FOUND;
+
+	e->handle = 0;
+	return ESP_OK;
+}
+
+esp_err_t esp_ota_set_boot_partition(const esp_partition_t *partition)
+{
+	const esp_partition_t *p = otadata_partition();
+	esp_err_t err;
+
+	if(partition == NULL || partition->type != ESP_PARTITION_TYPE_APP) return ESP_ERR_INVALID_ARG;
+
+	err = image_check(partition);
+	if(err != ESP_OK) return err;
+
+	if(partition->subtype == ESP_PARTITION_SUBTYPE_APP_FACTORY) return esp_partition_erase_range(p, 0, p->size);
+	return otadata_select(partition->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN);
+}
+
+const esp_partition_t *esp_ota_get_boot_partition(void)
+{
+	esp_ota_select_entry_t entry[2];
+	int active = otadata_active(entry);
+
+	if(active < 0) return esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+	return esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+			ESP_PARTITION_SUBTYPE_APP_OTA_MIN + (entry[active].ota_seq - 1) % OTA_APP_COUNT, NULL);
+}
+
+const esp_partition_t *esp_ota_get_running_partition(void)
+{
+	return flash_running;
+}
+
+// The OTA slot after start_from (the running one by default), never the running one
+const esp_partition_t *esp_ota_get_next_update_partition(const esp_partition_t *start_from)
+{
+	const esp_partition_t *p;
+	int i, first;
+
+	if(start_from == NULL) start_from = flash_running;
+	if(start_from == NULL) return NULL;
+
+	first = (start_from->subtype >= ESP_PARTITION_SUBTYPE_APP_OTA_MIN) ? start_from->subtype - ESP_PARTITION_SUBTYPE_APP_OTA_MIN + 1 : 0;
+	for(i = 0; i < OTA_APP_COUNT; i++)
+	{
+		p = esp_partition_find_first(ESP_PARTITION_TYPE_APP,
+				ESP_PARTITION_SUBTYPE_APP_OTA_MIN + (first + i) % OTA_APP_COUNT, NULL);
+		if(p != NULL && p != flash_running) return p;
+	}
+	return NULL;
+}
+
+/*---------------------------- Boot --------------------------------------*/
+/*******************************************
+Flash image file, made 0xFF filled when missing. Then what the bootloader
+does : the otadata slot if its image checks out, the factory app otherwise.
+The factory app is this program and is not checked.
+*******************************************/
+esp_err_t esp_partition_host_init(const char *flash_path)
+{
+	const esp_partition_t *boot;
+	uint8_t block[SPI_FLASH_SEC_SIZE];
+	struct stat st;
+	int fd, i;
+
+	fd = open(flash_path, O_RDWR | O_CREAT, 0644);
+	if(fd < 0 || fstat(fd, &st) != 0) return ESP_FAIL;
+
+	if(st.st_size != FLASH_SIZE)
+	{
+		memset(block, 0xFF, sizeof(block));
+		if(ftruncate(fd, 0) != 0) return ESP_FAIL;
+		for(i = 0; i < FLASH_SIZE / SPI_FLASH_SEC_SIZE; i++)
+		{
+			if(write(fd, block, sizeof(block)) != sizeof(block)) return ESP_FAIL;
+		}
+	}
+
+	flash_mem = mmap(NULL, FLASH_SIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	close(fd);
+	if(flash_mem == MAP_FAILED)
+	{
+		flash_mem = NULL;
+		return ESP_FAIL;
+	}
+
+	flash_running = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_APP_FACTORY, NULL);
+	boot = esp_ota_get_boot_partition();
+	if(boot != flash_running)
+	{
+		if(image_check(boot) == ESP_OK) flash_running = boot;
+		else ESP_LOGE(TAG, "%s image invalid, booting factory", boot->label);
+	}
+	return ESP_OK;
+}
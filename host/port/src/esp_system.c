@@ -0,0 +1,336 @@
+/**
+ * @file esp_system.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : log, console UART on stdin/stdout, timers, restart, chip and app description
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <stdarg.h>
+#include <time.h>
+#include <unistd.h>
+#include <dirent.h>
+#include <stdlib.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/random.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_rom_sys.h"
+#include "esp_rom_crc.h"
+#include "esp_cpu.h"
+#include "esp_chip_info.h"
+#include "esp_app_desc.h"
+#include "esp_efuse.h"
+#include "esp_pm.h"
+#include "esp_wifi.h"
+#include "esp_coexist.h"
+#include "driver/uart.h"
+
+/*---------------------------- User define -------------------------------*/
+#define HOST_CHIP_REVISION		2		// v0.2
+#define HOST_CPU_TICKS_PER_US	1000	// the cycle counter runs in ns
+
+typedef struct {
+	esp_err_t code;
+	const char *name;
+} esp_err_name_t;
+
+#define ERR_NAME(code)	{ code, #code }
+
+/*---------------------------- Variables ---------------------------------*/
+static const esp_err_name_t esp_err_names[] = {
+	ERR_NAME(ESP_OK),
+	ERR_NAME(ESP_FAIL),
+	ERR_NAME(ESP_ERR_NO_MEM),
+	ERR_NAME(ESP_ERR_INVALID_ARG),
+	ERR_NAME(ESP_ERR_INVALID_STATE),
+	ERR_NAME(ESP_ERR_INVALID_SIZE),
+	ERR_NAME(ESP_ERR_NOT_FOUND),
+	ERR_NAME(ESP_ERR_NOT_SUPPORTED),
+	ERR_NAME(ESP_ERR_TIMEOUT),
+	ERR_NAME(ESP_ERR_INVALID_RESPONSE),
+	ERR_NAME(ESP_ERR_INVALID_CRC),
+	ERR_NAME(ESP_ERR_INVALID_VERSION),
+	ERR_NAME(ESP_ERR_NOT_ALLOWED),
+	ERR_NAME(ESP_ERR_NVS_NOT_INITIALIZED),
+	ERR_NAME(ESP_ERR_NVS_NOT_FOUND),
+	ERR_NAME(ESP_ERR_NVS_INVALID_HANDLE),
+	ERR_NAME(ESP_ERR_NVS_NOT_ENOUGH_SPACE),
+	ERR_NAME(ESP_ERR_NVS_INVALID_LENGTH),
+	ERR_NAME(ESP_ERR_NVS_NO_FREE_PAGES),
+	ERR_NAME(ESP_ERR_NVS_NEW_VERSION_FOUND),
+	ERR_NAME(ESP_ERR_OTA_PARTITION_CONFLICT),
+	ERR_NAME(ESP_ERR_OTA_SELECT_INFO_INVALID),
+	ERR_NAME(ESP_ERR_OTA_VALIDATE_FAILED),
+	ERR_NAME(ESP_ERR_OTA_SMALL_SEC_VER),
+	ERR_NAME(ESP_ERR_IMAGE_FLASH_FAIL),
+	ERR_NAME(ESP_ERR_IMAGE_INVALID),
+};
+
+// Same fields as the descriptor the build puts in the image, the running app is the host program
+static const esp_app_desc_t host_app_desc = {
+	.magic_word = ESP_APP_DESC_MAGIC_WORD,
+	.secure_version = 0,
+	.version = "V1.0",
+	.project_name = "esp32ota",
+	.time = __TIME__,
+	.date = __DATE__,
+	.idf_ver = "v5.2-host",
+	.mmu_page_size = 16,
+};
+
+static pthread_mutex_t uart_lock = PTHREAD_MUTEX_INITIALIZER;
+static struct timespec timer_boot;
+
+/*-------------------------- Function declares ---------------------------*/
+
+const char *esp_err_to_name(esp_err_t code)
+{
+	size_t i;
+
+	for(i = 0; i < sizeof(esp_err_names) / sizeof(esp_err_names[0]); i++)
+	{
+		if(esp_err_names[i].code == code) return esp_err_names[i].name;
+	}
+	return "UNKNOWN ERROR";
+}
+
+/*---------------------------- Log ---------------------------------------*/
+uint32_t esp_log_timestamp(void)
+{
+	return (uint32_t)(esp_timer_get_time() / 1000);
+}
+
+void esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	va_list args;
+
+	(void)level;
+	(void)tag;
+	va_start(args, format);
+	pthread_mutex_lock(&uart_lock);
+	vfprintf(stdout, format, args);
+	fflush(stdout);
+	pthread_mutex_unlock(&uart_lock);
+	va_end(args);
+}
+
+/*---------------------------- UART --------------------------------------*/
+// Console UART : stdin and stdout of the program
+esp_err_t uart_driver_install(uart_port_t uart_num, int rx_buffer_size, int tx_buffer_size, int queue_size,
+		void *uart_queue, int intr_alloc_flags)
+{
+	return ESP_OK;
+}
+
+esp_err_t uart_driver_delete(uart_port_t uart_num)
+{
+	return ESP_OK;
+}
+
+int uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+	pthread_mutex_lock(&uart_lock);
+	fwrite(src, 1, size, stdout);
+	fflush(stdout);
+	pthread_mutex_unlock(&uart_lock);
+	return size;
+}
+
+// End of stdin (a harness without a console) is a UART nobody types on : wait forever
+int uart_read_bytes(uart_port_t uart_num, void *buf, uint32_t length, TickType_t ticks_to_wait)
+{
+	ssize_t n = read(STDIN_FILENO, buf, length);
+
+	if(n > 0) return n;
+
+	for(;;) vTaskDelay(portMAX_DELAY);
+}
+
+/*---------------------------- Time --------------------------------------*/
+// esp_timer counts from boot, here from the start (or restart) of the process
+__attribute__((constructor)) static void timer_init(void)
+{
+	clock_gettime(CLOCK_MONOTONIC, &timer_boot);
+}
+
+int64_t esp_timer_get_time(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)(ts.tv_sec - timer_boot.tv_sec) * 1000000 + (ts.tv_nsec - timer_boot.tv_nsec) / 1000;
+}
+
+void esp_rom_delay_us(uint32_t us)
+{
+	int64_t end = esp_timer_get_time() + us;
+
+	// busy wait like the ROM function
+	while(esp_timer_get_time() < end);
+}
+
+uint32_t esp_rom_get_cpu_ticks_per_us(void)
+{
+	return HOST_CPU_TICKS_PER_US;
+}
+
+esp_cpu_cycle_count_t esp_cpu_get_cycle_count(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (esp_cpu_cycle_count_t)((uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+int esp_cpu_get_core_id(void)
+{
+	return xPortGetCoreID();
+}
+
+/*---------------------------- Misc --------------------------------------*/
+uint32_t esp_rom_crc32_le(uint32_t crc, uint8_t const *buf, uint32_t len)
+{
+	uint32_t i;
+	int k;
+
+	crc = ~crc;
+	for(i = 0; i < len; i++)
+	{
+		crc ^= buf[i];
+		for(k = 0; k < 8; k++) crc = (crc >> 1) ^ (0xEDB88320 & -(crc & 1));
+	}
+	return ~crc;
+}
+
+void esp_fill_random(void *buf, size_t len)
+{
+	uint8_t *p = buf;
+	ssize_t n;
+
+	while(len > 0)
+	{
+		n = getrandom(p, len, 0);
+		if(n <= 0) abort();
+		p += n;
+		len -= n;
+	}
+}
+
+uint32_t esp_random(void)
+{
+	uint32_t r;
+
+	esp_fill_random(&r, sizeof(r));
+	return r;
+}
+
+void esp_chip_info(esp_chip_info_t *out_info)
+{
+	memset(out_info, 0, sizeof(esp_chip_info_t));
+	out_info->model = CHIP_ESP32S3;
+	out_info->features = CHIP_FEATURE_WIFI_BGN | CHIP_FEATURE_BLE;
+	out_info->revision = HOST_CHIP_REVISION;
+	out_info->cores = configNUMBER_OF_CORES;
+}
+
+const esp_app_desc_t *esp_app_get_description(void)
+{
+	return &host_app_desc;
+}
+
+uint32_t esp_efuse_read_secure_version(void)
+{
+	return 0;
+}
+
+bool esp_efuse_check_secure_version(uint32_t secure_version)
+{
+	return secure_version >= esp_efuse_read_secure_version();
+}
+
+// Power management, Wi-Fi power save and coexistence have nothing to act on
+esp_err_t esp_pm_configure(const void *config)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_create(esp_pm_lock_type_t lock_type, int arg, const char *name, esp_pm_lock_handle_t *out_handle)
+{
+	*out_handle = NULL;
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_acquire(esp_pm_lock_handle_t handle)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_pm_lock_release(esp_pm_lock_handle_t handle)
+{
+	return ESP_OK;
+}
+
+esp_err_t esp_wifi_set_ps(wifi_ps_type_t type)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_wifi_get_ps(wifi_ps_type_t *type)
+{
+	return ESP_ERR_NOT_SUPPORTED;
+}
+
+esp_err_t esp_coex_preference_set(esp_coex_prefer_t prefer)
+{
+	return ESP_OK;
+}
+
+/*---------------------------- Restart -----------------------------------*/
+static char **restart_argv;
+static char restart_exe[PATH_MAX];
+
+/*******************************************
+Command line of the next boot, set by main(). The binary is looked up now :
+once the main task has ended /proc/self/exe no longer resolves.
+*******************************************/
+void esp_restart_host_args(char **argv)
+{
+	ssize_t len = readlink("/proc/self/exe", restart_exe, sizeof(restart_exe) - 1);
+
+	restart_exe[len > 0 ? len : 0] = 0;
+	restart_argv = argv;
+}
+
+// The program starts over with the same arguments : sockets are closed, the flash file is kept
+void esp_restart(void)
+{
+	struct dirent *e;
+	DIR *dir;
+	int fd;
+
+	fflush(stdout);
+	fflush(stderr);
+
+	// the file table of this thread : /proc/self is the main task, ended already
+	dir = opendir("/proc/thread-self/fd");
+	if(dir != NULL)
+	{
+		while((e = readdir(dir)) != NULL)
+		{
+			fd = atoi(e->d_name);
+			if(fd > STDERR_FILENO && fd != dirfd(dir)) close(fd);
+		}
+		closedir(dir);
+	}
+
+	if(restart_argv != NULL && restart_exe[0] != 0) execv(restart_exe, restart_argv);
+	_exit(1);
+}
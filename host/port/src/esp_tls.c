@@ -0,0 +1,138 @@
+/**
+ * @file esp_tls.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : esp-tls server sessions on OpenSSL, TLS 1.2 only and session tickets like the device
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <openssl/ssl.h>
+#include <openssl/err.h>
+#include <openssl/pem.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_tls.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "esp-tls"
+
+struct esp_tls {
+	SSL *ssl;
+};
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+esp_tls_t *esp_tls_init(void)
+{
+	return calloc(1, sizeof(esp_tls_t));
+}
+
+// Tickets are on unless asked for : OpenSSL keeps and rotates the ticket key itself
+esp_err_t esp_tls_cfg_server_session_tickets_init(esp_tls_cfg_server_t *cfg)
+{
+	cfg->ticket_ctx = cfg;
+	return ESP_OK;
+}
+
+static SSL_CTX *tls_server_ctx(esp_tls_cfg_server_t *cfg)
+{
+	SSL_CTX *ctx;
+	BIO *bio;
+	X509 *cert;
+	EVP_PKEY *key;
+
+	if(cfg->ssl_ctx != NULL) return cfg->ssl_ctx;
+
+	ctx = SSL_CTX_new(TLS_server_method());
+	if(ctx == NULL) return NULL;
+	SSL_CTX_set_min_proto_version(ctx, TLS1_2_VERSION);
+	SSL_CTX_set_max_proto_version(ctx, TLS1_2_VERSION);
+	if(cfg->ticket_ctx == NULL) SSL_CTX_set_options(ctx, SSL_OP_NO_TICKET);
+
+	bio = BIO_new_mem_buf(cfg->servercert_buf, cfg->servercert_bytes);
+	cert = bio ? PEM_read_bio_X509(bio, NULL, NULL, NULL) : NULL;
+	BIO_free(bio);
+	bio = BIO_new_mem_buf(cfg->serverkey_buf, cfg->serverkey_bytes);
+	key = bio ? PEM_read_bio_PrivateKey(bio, NULL, NULL, NULL) : NULL;
+	BIO_free(bio);
+
+	if(cert == NULL || key == NULL || SSL_CTX_use_certificate(ctx, cert) != 1 || SSL_CTX_use_PrivateKey(ctx, key) != 1)
+	{
+		ESP_LOGE(TAG, "server certificate or key unusable");
+		X509_free(cert);
+		EVP_PKEY_free(key);
+		SSL_CTX_free(ctx);
+		return NULL;
+	}
+	X509_free(cert);
+	EVP_PKEY_free(key);
+
+	cfg->ssl_ctx = ctx;
+	return ctx;
+}
+
+// Blocking handshake on the socket, 0 on success
+int esp_tls_server_session_create(esp_tls_cfg_server_t *cfg, int sockfd, esp_tls_t *tls)
+{
+	SSL_CTX *ctx = tls_server_ctx(cfg);
+	int ret;
+
+	if(ctx == NULL) return -1;
+
+	tls->ssl = SSL_new(ctx);
+	if(tls->ssl == NULL || SSL_set_fd(tls->ssl, sockfd) != 1) return -1;
+
+	ret = SSL_accept(tls->ssl);
+	if(ret != 1)
+	{
+		ESP_LOGE(TAG, "SSL_accept returned %d, error %d", ret, SSL_get_error(tls->ssl, ret));
+		ERR_clear_error();
+		return -1;
+	}
+	return 0;
+}
+
+// The socket belongs to the caller
+void esp_tls_server_session_delete(esp_tls_t *tls)
+{
+	if(tls == NULL) return;
+
+	if(tls->ssl != NULL)
+	{
+		SSL_shutdown(tls->ssl);
+		SSL_free(tls->ssl);
+	}
+	free(tls);
+}
+
+static ssize_t tls_result(esp_tls_t *tls, int ret)
+{
+	int err;
+
+	if(ret > 0) return ret;
+
+	err = SSL_get_error(tls->ssl, ret);
+	ERR_clear_error();
+	switch(err)
+	{
+		case SSL_ERROR_WANT_READ:	return ESP_TLS_ERR_SSL_WANT_READ;
+		case SSL_ERROR_WANT_WRITE:	return ESP_TLS_ERR_SSL_WANT_WRITE;
+		case SSL_ERROR_ZERO_RETURN:	return 0;		// close notify
+	}
+	return -1;
+}
+
+ssize_t esp_tls_conn_read(esp_tls_t *tls, void *data, size_t datalen)
+{
+	return tls_result(tls, SSL_read(tls->ssl, data, datalen));
+}
+
+ssize_t esp_tls_conn_write(esp_tls_t *tls, const void *data, size_t datalen)
+{
+	return tls_result(tls, SSL_write(tls->ssl, data, datalen));
+}
@@ -0,0 +1,668 @@
+/**
+ * @file freertos.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : FreeRTOS tasks, queues, semaphores and notifications on POSIX threads
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <errno.h>
+#include <sched.h>
+#include <pthread.h>
+#include <sys/mman.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TASK_POOL_SIZE		32		// records come from here : the heap hooks look tasks up inside malloc
+#define TASK_STACK_PAINT	0xA5
+
+// glibc and the sanitizers need more stack than newlib, the device sizes are scaled up
+#if !defined (HOST_STACK_SCALE)
+#define HOST_STACK_SCALE	4
+#endif
+#define TASK_STACK_MIN		(64 * 1024)
+
+struct tskTaskControlBlock {
+	int used;
+	int exited;						// thread returned from vTaskDelete(NULL), join before reuse
+	int joinable;
+	pthread_t thread;
+	clockid_t cpu_clock;
+	char name[configMAX_TASK_NAME_LEN];
+	TaskFunction_t fn;
+	void *arg;
+	UBaseType_t number;
+	UBaseType_t priority;
+	BaseType_t core;
+	uint8_t *stack;
+	size_t stack_size;
+	void *tls[CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS];
+	volatile int blocked;
+	int suspended;					// honoured at the task's next kernel call
+	uint32_t notify;
+	pthread_cond_t cond;			// notify and resume, under task_lock
+};
+
+struct QueueDefinition {
+	pthread_mutex_t lock;
+	pthread_cond_t not_empty;
+	pthread_cond_t not_full;
+	UBaseType_t length;
+	UBaseType_t item_size;
+	UBaseType_t count;
+	UBaseType_t head;
+	uint8_t *items;					// NULL for semaphores, only count moves
+};
+
+/*---------------------------- Variables ---------------------------------*/
+static struct tskTaskControlBlock task_pool[TASK_POOL_SIZE];
+static pthread_mutex_t task_lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_mutex_t task_critical = PTHREAD_RECURSIVE_MUTEX_INITIALIZER_NP;
+static __thread TaskHandle_t task_current;
+static UBaseType_t task_numbers;
+static BaseType_t task_scheduler = taskSCHEDULER_NOT_STARTED;
+static struct timespec task_boot;
+static struct tskTaskControlBlock task_idle[portNUM_PROCESSORS];		// stand-ins for the IDLE tasks of top
+
+/*-------------------------- Function declares ---------------------------*/
+
+static int64_t task_now_us(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (int64_t)(ts.tv_sec - task_boot.tv_sec) * 1000000 + (ts.tv_nsec - task_boot.tv_nsec) / 1000;
+}
+
+// Absolute CLOCK_MONOTONIC deadline, NULL for portMAX_DELAY
+static struct timespec *task_deadline(TickType_t ticks, struct timespec *ts)
+{
+	uint64_t ns;
+
+	if(ticks == portMAX_DELAY) return NULL;
+
+	clock_gettime(CLOCK_MONOTONIC, ts);
+	ns = (uint64_t)ts->tv_nsec + (uint64_t)ticks * portTICK_PERIOD_MS * 1000000ULL;
+	ts->tv_sec += ns / 1000000000ULL;
+	ts->tv_nsec = ns % 1000000000ULL;
+	return ts;
+}
+
+static void task_cond_init(pthread_cond_t *cond)
+{
+	pthread_condattr_t attr;
+
+	pthread_condattr_init(&attr);
+	pthread_condattr_setclock(&attr, CLOCK_MONOTONIC);
+	pthread_cond_init(cond, &attr);
+	pthread_condattr_destroy(&attr);
+}
+
+// Caller holds mutex. 0 : signalled, ETIMEDOUT : deadline passed.
+static int task_cond_wait(pthread_cond_t *cond, pthread_mutex_t *mutex, const struct timespec *deadline)
+{
+	if(deadline == NULL) return pthread_cond_wait(cond, mutex);
+	return pthread_cond_timedwait(cond, mutex, deadline);
+}
+
+// Slot of a thread that was not made by xTaskCreate (main, library threads), no stack of ours
+static TaskHandle_t task_adopt(const char *name)
+{
+	TaskHandle_t t = NULL;
+	int i;
+
+	pthread_mutex_lock(&task_lock);
+	for(i = 0; i < TASK_POOL_SIZE; i++)
+	{
+		if(task_pool[i].used) continue;
+
+		t = &task_pool[i];
+		memset(t, 0, sizeof(*t));
+		t->used = 1;
+		t->thread = pthread_self();
+		pthread_getcpuclockid(t->thread, &t->cpu_clock);
+		strncpy(t->name, name, configMAX_TASK_NAME_LEN - 1);
+		t->number = ++task_numbers;
+		t->priority = 1;
+		t->core = tskNO_AFFINITY;
+		task_cond_init(&t->cond);
+		break;
+	}
+	pthread_mutex_unlock(&task_lock);
+	return t;
+}
+
+// app_main runs in the "main" task with the scheduler started
+__attribute__((constructor)) static void task_boot_init(void)
+{
+	int i;
+
+	clock_gettime(CLOCK_MONOTONIC, &task_boot);
+	for(i = 0; i < portNUM_PROCESSORS; i++)
+	{
+		snprintf(task_idle[i].name, configMAX_TASK_NAME_LEN, "IDLE%d", i);
+		task_idle[i].core = i;
+	}
+	task_current = task_adopt("main");
+	task_scheduler = taskSCHEDULER_RUNNING;
+}
+
+// A suspended task stops here, at its next kernel call : a thread can not be stopped from outside
+static void task_checkpoint(void)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+
+	if(t == NULL || !t->suspended) return;
+
+	pthread_mutex_lock(&task_lock);
+	t->blocked = 1;
+	while(t->suspended) pthread_cond_wait(&t->cond, &task_lock);
+	t->blocked = 0;
+	pthread_mutex_unlock(&task_lock);
+}
+
+/*---------------------------- Critical ----------------------------------*/
+void vPortEnterCritical(portMUX_TYPE *mux)
+{
+	(void)mux;
+	pthread_mutex_lock(&task_critical);
+}
+
+void vPortExitCritical(portMUX_TYPE *mux)
+{
+	(void)mux;
+	pthread_mutex_unlock(&task_critical);
+}
+
+BaseType_t xPortInIsrContext(void)
+{
+	return pdFALSE;
+}
+
+BaseType_t xPortGetCoreID(void)
+{
+	TaskHandle_t t = task_current;
+
+	if(t != NULL && t->core != tskNO_AFFINITY) return t->core;
+	return sched_getcpu() % configNUMBER_OF_CORES;
+}
+
+void vPortYield(void)
+{
+	task_checkpoint();
+	sched_yield();
+}
+
+/*---------------------------- Tasks -------------------------------------*/
+static void *task_entry(void *arg)
+{
+	TaskHandle_t t = arg;
+
+	task_current = t;
+	pthread_getcpuclockid(pthread_self(), &t->cpu_clock);
+	t->fn(t->arg);
+
+	// a FreeRTOS task must not return
+	vTaskDelete(NULL);
+	return NULL;
+}
+
+BaseType_t xTaskCreatePinnedToCore(TaskFunction_t fn, const char *name, const uint32_t stack, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle, const BaseType_t core)
+{
+	pthread_attr_t attr;
+	TaskHandle_t t = NULL;
+	pthread_t old;
+	size_t size;
+	int i, join = 0;
+
+	pthread_mutex_lock(&task_lock);
+	for(i = 0; i < TASK_POOL_SIZE; i++)
+	{
+		if(!task_pool[i].used || task_pool[i].exited)
+		{
+			t = &task_pool[i];
+			break;
+		}
+	}
+	if(t != NULL)
+	{
+		join = t->exited && t->joinable;
+		old = t->thread;
+		t->used = 1;
+		t->exited = 0;
+	}
+	pthread_mutex_unlock(&task_lock);
+	if(t == NULL) return pdFAIL;
+
+	if(join) pthread_join(old, NULL);
+	if(t->stack != NULL) munmap(t->stack, t->stack_size);
+
+	memset(t, 0, sizeof(*t));
+	t->used = 1;
+	strncpy(t->name, name, configMAX_TASK_NAME_LEN - 1);
+	t->fn = fn;
+	t->arg = arg;
+	t->priority = priority;
+	t->core = core;
+	task_cond_init(&t->cond);
+
+	// own stack painted like the device one : the high water mark is measured, not guessed
+	size = (size_t)stack * HOST_STACK_SCALE;
+	if(size < TASK_STACK_MIN) size = TASK_STACK_MIN;
+	t->stack = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_STACK, -1, 0);
+	if(t->stack == MAP_FAILED)
+	{
+		t->stack = NULL;
+		t->used = 0;
+		return pdFAIL;
+	}
+	t->stack_size = size;
+	memset(t->stack, TASK_STACK_PAINT, size);
+
+	pthread_mutex_lock(&task_lock);
+	t->number = ++task_numbers;
+	pthread_mutex_unlock(&task_lock);
+
+	pthread_attr_init(&attr);
+	pthread_attr_setstack(&attr, t->stack, size);
+	if(pthread_create(&t->thread, &attr, task_entry, t) != 0)
+	{
+		pthread_attr_destroy(&attr);
+		munmap(t->stack, size);
+		t->stack = NULL;
+		t->used = 0;
+		return pdFAIL;
+	}
+	pthread_attr_destroy(&attr);
+	t->joinable = 1;
+
+	if(handle) *handle = t;
+	return pdPASS;
+}
+
+BaseType_t xTaskCreate(TaskFunction_t fn, const char *name, const configSTACK_DEPTH_TYPE stack, void *arg,
+		UBaseType_t priority, TaskHandle_t *handle)
+{
+	return xTaskCreatePinnedToCore(fn, name, stack, arg, priority, handle, tskNO_AFFINITY);
+}
+
+// Only the running task can delete itself : a thread can not be ended from outside
+void vTaskDelete(TaskHandle_t task)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+
+	if(task != NULL && task != t) abort();
+
+	pthread_mutex_lock(&task_lock);
+	t->exited = 1;
+	pthread_mutex_unlock(&task_lock);
+	pthread_exit(NULL);
+}
+
+void vTaskDelay(const TickType_t ticks)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+	struct timespec ts;
+
+	task_checkpoint();
+	if(ticks == 0)
+	{
+		sched_yield();
+		return;
+	}
+
+	task_deadline(ticks, &ts);
+	t->blocked = 1;
+	while(clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR);
+	t->blocked = 0;
+}
+
+void vTaskSuspend(TaskHandle_t task)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+
+	pthread_mutex_lock(&task_lock);
+	task->suspended = 1;
+	pthread_mutex_unlock(&task_lock);
+	task_checkpoint();
+}
+
+void vTaskResume(TaskHandle_t task)
+{
+	pthread_mutex_lock(&task_lock);
+	task->suspended = 0;
+	pthread_cond_broadcast(&task->cond);
+	pthread_mutex_unlock(&task_lock);
+}
+
+// Recorded for uxTaskPriorityGet() and the task lists, Linux threads keep their policy
+void vTaskPrioritySet(TaskHandle_t task, UBaseType_t priority)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	task->priority = priority;
+}
+
+UBaseType_t uxTaskPriorityGet(TaskHandle_t task)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	return task->priority;
+}
+
+TaskHandle_t xTaskGetCurrentTaskHandle(void)
+{
+	if(task_current == NULL) task_current = task_adopt("pthread");
+	return task_current;
+}
+
+TaskHandle_t xTaskGetHandle(const char *name)
+{
+	TaskHandle_t t = NULL;
+	int i;
+
+	pthread_mutex_lock(&task_lock);
+	for(i = 0; i < TASK_POOL_SIZE; i++)
+	{
+		if(task_pool[i].used && !task_pool[i].exited && strcmp(task_pool[i].name, name) == 0)
+		{
+			t = &task_pool[i];
+			break;
+		}
+	}
+	pthread_mutex_unlock(&task_lock);
+	return t;
+}
+
+char *pcTaskGetName(TaskHandle_t task)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	return task->name;
+}
+
+// Bytes at the bottom of the stack never written, 0 for adopted threads
+UBaseType_t uxTaskGetStackHighWaterMark(TaskHandle_t task)
+{
+	size_t i;
+
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	if(task->stack == NULL) return 0;
+
+	for(i = 0; i < task->stack_size && task->stack[i] == TASK_STACK_PAINT; i++);
+	return i;
+}
+
+TickType_t xTaskGetTickCount(void)
+{
+	return (TickType_t)(task_now_us() / 1000 / portTICK_PERIOD_MS);
+}
+
+UBaseType_t uxTaskGetNumberOfTasks(void)
+{
+	UBaseType_t n = 0;
+	int i;
+
+	for(i = 0; i < TASK_POOL_SIZE; i++)
+	{
+		if(task_pool[i].used && !task_pool[i].exited) n++;
+	}
+	return n;
+}
+
+BaseType_t xTaskGetSchedulerState(void)
+{
+	return task_scheduler;
+}
+
+/*******************************************
+Run time counters are thread CPU time in us, the total is wall time since boot.
+The IDLE tasks share what the process did not use of portNUM_PROCESSORS cores
+over that time, so the load figures of top stay meaningful.
+*******************************************/
+UBaseType_t uxTaskGetSystemState(TaskStatus_t *status, const UBaseType_t count, uint32_t *total_runtime)
+{
+	TaskHandle_t self = xTaskGetCurrentTaskHandle();
+	struct timespec ts;
+	UBaseType_t n = 0;
+	int64_t now = task_now_us(), idle;
+	int i;
+
+	pthread_mutex_lock(&task_lock);
+	for(i = 0; i < TASK_POOL_SIZE && n < count; i++)
+	{
+		TaskHandle_t t = &task_pool[i];
+		TaskStatus_t *s = &status[n];
+
+		if(!t->used || t->exited) continue;
+
+		memset(s, 0, sizeof(*s));
+		s->xHandle = t;
+		s->pcTaskName = t->name;
+		s->xTaskNumber = t->number;
+		s->eCurrentState = (t == self) ? eRunning : t->suspended ? eSuspended : t->blocked ? eBlocked : eReady;
+		s->uxCurrentPriority = s->uxBasePriority = t->priority;
+		if(clock_gettime(t->cpu_clock, &ts) == 0) s->ulRunTimeCounter = (uint32_t)(ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+		s->pxStackBase = t->stack;
+		s->xCoreID = t->core;
+		n++;
+	}
+	pthread_mutex_unlock(&task_lock);
+
+	clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &ts);
+	idle = now * portNUM_PROCESSORS - ((int64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000);
+	if(idle < 0) idle = 0;
+	for(i = 0; i < portNUM_PROCESSORS && n < count; i++, n++)
+	{
+		memset(&status[n], 0, sizeof(TaskStatus_t));
+		status[n].xHandle = &task_idle[i];
+		status[n].pcTaskName = task_idle[i].name;
+		status[n].eCurrentState = eReady;
+		status[n].ulRunTimeCounter = (uint32_t)(idle / portNUM_PROCESSORS);
+		status[n].xCoreID = i;
+	}
+
+	// water marks scan the stacks, outside the lock
+	for(i = 0; i < n; i++)
+	{
+		status[i].usStackHighWaterMark = uxTaskGetStackHighWaterMark(status[i].xHandle);
+	}
+	if(total_runtime) *total_runtime = (uint32_t)now;
+	return n;
+}
+
+void *pvTaskGetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	if(index < 0 || index >= CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS) return NULL;
+	return task->tls[index];
+}
+
+void vTaskSetThreadLocalStoragePointer(TaskHandle_t task, BaseType_t index, void *value)
+{
+	if(task == NULL) task = xTaskGetCurrentTaskHandle();
+	if(index < 0 || index >= CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS) return;
+	task->tls[index] = value;
+}
+
+uint32_t ulTaskNotifyTake(BaseType_t clear, TickType_t ticks)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+	struct timespec ts, *deadline;
+	uint32_t value;
+
+	task_checkpoint();
+	deadline = task_deadline(ticks, &ts);
+
+	pthread_mutex_lock(&task_lock);
+	t->blocked = 1;
+	while(t->notify == 0 && ticks != 0)
+	{
+		if(task_cond_wait(&t->cond, &task_lock, deadline) == ETIMEDOUT) break;
+	}
+	t->blocked = 0;
+	value = t->notify;
+	if(value > 0) t->notify = clear ? 0 : value - 1;
+	pthread_mutex_unlock(&task_lock);
+	return value;
+}
+
+BaseType_t xTaskNotifyGive(TaskHandle_t task)
+{
+	pthread_mutex_lock(&task_lock);
+	task->notify++;
+	pthread_cond_broadcast(&task->cond);
+	pthread_mutex_unlock(&task_lock);
+	return pdPASS;
+}
+
+/*---------------------------- Queues ------------------------------------*/
+static QueueHandle_t queue_new(UBaseType_t length, UBaseType_t item_size, UBaseType_t count)
+{
+	QueueHandle_t q = calloc(1, sizeof(struct QueueDefinition));
+
+	if(q == NULL) return NULL;
+
+	if(item_size > 0)
+	{
+		q->items = malloc((size_t)length * item_size);
+		if(q->items == NULL)
+		{
+			free(q);
+			return NULL;
+		}
+	}
+	pthread_mutex_init(&q->lock, NULL);
+	task_cond_init(&q->not_empty);
+	task_cond_init(&q->not_full);
+	q->length = length;
+	q->item_size = item_size;
+	q->count = count;
+	return q;
+}
+
+QueueHandle_t xQueueCreate(UBaseType_t length, UBaseType_t item_size)
+{
+	if(length == 0) return NULL;
+	return queue_new(length, item_size, 0);
+}
+
+void vQueueDelete(QueueHandle_t queue)
+{
+	if(queue == NULL) return;
+
+	pthread_mutex_destroy(&queue->lock);
+	pthread_cond_destroy(&queue->not_empty);
+	pthread_cond_destroy(&queue->not_full);
+	free(queue->items);
+	free(queue);
+}
+
+BaseType_t xQueueSend(QueueHandle_t queue, const void *item, TickType_t ticks)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+	struct timespec ts, *deadline;
+	BaseType_t ret = errQUEUE_FULL;
+
+	task_checkpoint();
+	deadline = task_deadline(ticks, &ts);
+
+	pthread_mutex_lock(&queue->lock);
+	t->blocked = 1;
+	while(queue->count == queue->length && ticks != 0)
+	{
+		if(task_cond_wait(&queue->not_full, &queue->lock, deadline) == ETIMEDOUT) break;
+	}
+	t->blocked = 0;
+	if(queue->count < queue->length)
+	{
+		if(queue->items != NULL)
+		{
+			memcpy(&queue->items[((queue->head + queue->count) % queue->length) * queue->item_size], item, queue->item_size);
+		}
+		queue->count++;
+		pthread_cond_signal(&queue->not_empty);
+		ret = pdPASS;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+BaseType_t xQueueReceive(QueueHandle_t queue, void *item, TickType_t ticks)
+{
+	TaskHandle_t t = xTaskGetCurrentTaskHandle();
+	struct timespec ts, *deadline;
+	BaseType_t ret = pdFALSE;
+
+	task_checkpoint();
+	deadline = task_deadline(ticks, &ts);
+
+	pthread_mutex_lock(&queue->lock);
+	t->blocked = 1;
+	while(queue->count == 0 && ticks != 0)
+	{
+		if(task_cond_wait(&queue->not_empty, &queue->lock, deadline) == ETIMEDOUT) break;
+	}
+	t->blocked = 0;
+	if(queue->count > 0)
+	{
+		if(queue->items != NULL)
+		{
+			memcpy(item, &queue->items[queue->head * queue->item_size], queue->item_size);
+		}
+		queue->head = (queue->head + 1) % queue->length;
+		queue->count--;
+		pthread_cond_signal(&queue->not_full);
+		ret = pdTRUE;
+	}
+	pthread_mutex_unlock(&queue->lock);
+	return ret;
+}
+
+UBaseType_t uxQueueMessagesWaiting(const QueueHandle_t queue)
+{
+	UBaseType_t n;
+
+	pthread_mutex_lock(&queue->lock);
+	n = queue->count;
+	pthread_mutex_unlock(&queue->lock);
+	return n;
+}
+
+BaseType_t xQueueReset(QueueHandle_t queue)
+{
+	pthread_mutex_lock(&queue->lock);
+	queue->count = 0;
+	queue->head = 0;
+	pthread_cond_broadcast(&queue->not_full);
+	pthread_mutex_unlock(&queue->lock);
+	return pdPASS;
+}
+
+/*---------------------------- Semaphores --------------------------------*/
+// Binary : empty queue of one zero size item. Mutex : the same, given once at creation.
+SemaphoreHandle_t xSemaphoreCreateBinary(void)
+{
+	return queue_new(1, 0, 0);
+}
+
+SemaphoreHandle_t xSemaphoreCreateMutex(void)
+{
+	return queue_new(1, 0, 1);
+}
+
+BaseType_t xSemaphoreTake(SemaphoreHandle_t sem, TickType_t ticks)
+{
+	return xQueueReceive(sem, NULL, ticks);
+}
+
+BaseType_t xSemaphoreGive(SemaphoreHandle_t sem)
+{
+	return xQueueSend(sem, NULL, 0);
+}
@@ -0,0 +1,280 @@
+/**
+ * @file mbedtls.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : the mbedTLS AES-CTR, GCM and SHA-256 calls of the firmware on OpenSSL EVP
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <openssl/evp.h>
+#include <openssl/crypto.h>
+
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/sha256.h"
+#include "mbedtls/platform_util.h"
+
+/*---------------------------- User define -------------------------------*/
+#define CTR_BATCH_BLOCKS	64		// counter blocks encrypted per EVP call
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+void mbedtls_platform_zeroize(void *buf, size_t len)
+{
+	if(len > 0) OPENSSL_cleanse(buf, len);
+}
+
+/*---------------------------- AES-CTR -----------------------------------*/
+static const EVP_CIPHER *aes_ecb(unsigned int keybits)
+{
+	switch(keybits)
+	{
+		case 128:	return EVP_aes_128_ecb();
+		case 192:	return EVP_aes_192_ecb();
+		case 256:	return EVP_aes_256_ecb();
+	}
+	return NULL;
+}
+
+void mbedtls_aes_init(mbedtls_aes_context *ctx)
+{
+	memset(ctx, 0, sizeof(mbedtls_aes_context));
+}
+
+void mbedtls_aes_free(mbedtls_aes_context *ctx)
+{
+	if(ctx == NULL) return;
+
+	EVP_CIPHER_CTX_free(ctx->ecb);
+	memset(ctx, 0, sizeof(mbedtls_aes_context));
+}
+
+int mbedtls_aes_setkey_enc(mbedtls_aes_context *ctx, const unsigned char *key, unsigned int keybits)
+{
+	const EVP_CIPHER *cipher = aes_ecb(keybits);
+
+	if(cipher == NULL) return MBEDTLS_ERR_AES_INVALID_KEY_LENGTH;
+
+	if(ctx->ecb == NULL) ctx->ecb = EVP_CIPHER_CTX_new();
+	if(ctx->ecb == NULL || EVP_EncryptInit_ex(ctx->ecb, cipher, NULL, key, NULL) != 1) return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+	EVP_CIPHER_CTX_set_padding(ctx->ecb, 0);
+	ctx->keybits = keybits;
+	return 0;
+}
+
+static void ctr_increment(unsigned char counter[16])
+{
+	int i;
+
+	for(i = 16; i > 0; i--)
+	{
+		if(++counter[i - 1] != 0) break;
+	}
+}
+
+/*******************************************
+Same results and the same nc_off / stream_block state as mbedTLS : a partly
+used key stream block is used up first, whole blocks are made in batches.
+*******************************************/
+int mbedtls_aes_crypt_ctr(mbedtls_aes_context *ctx, size_t length, size_t *nc_off, unsigned char nonce_counter[16],
+		unsigned char stream_block[16], const unsigned char *input, unsigned char *output)
+{
+	unsigned char counters[CTR_BATCH_BLOCKS * 16], stream[CTR_BATCH_BLOCKS * 16];
+	size_t n = *nc_off, blocks, i, b;
+	int outl;
+
+	if(n > 15 || ctx->ecb == NULL) return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+	while(n != 0 && length > 0)
+	{
+		*output++ = *input++ ^ stream_block[n];
+		n = (n + 1) & 0x0F;
+		length--;
+	}
+
+	while(length >= 16)
+	{
+		blocks = length / 16;
+		if(blocks > CTR_BATCH_BLOCKS) blocks = CTR_BATCH_BLOCKS;
+
+		for(b = 0; b < blocks; b++)
+		{
+			memcpy(&counters[b * 16], nonce_counter, 16);
+			ctr_increment(nonce_counter);
+		}
+		if(EVP_EncryptUpdate(ctx->ecb, stream, &outl, counters, blocks * 16) != 1) return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+
+		for(i = 0; i < blocks * 16; i++) output[i] = input[i] ^ stream[i];
+		memcpy(stream_block, &stream[(blocks - 1) * 16], 16);
+		input += blocks * 16;
+		output += blocks * 16;
+		length -= blocks * 16;
+	}
+
+	if(length > 0)
+	{
+		if(EVP_EncryptUpdate(ctx->ecb, stream_block, &outl, nonce_counter, 16) != 1) return MBEDTLS_ERR_AES_BAD_INPUT_DATA;
+		ctr_increment(nonce_counter);
+		for(i = 0; i < length; i++) output[i] = input[i] ^ stream_block[i];
+		n = length;
+	}
+
+	*nc_off = n;
+	mbedtls_platform_zeroize(stream, sizeof(stream));
+	return 0;
+}
+
+/*---------------------------- GCM ---------------------------------------*/
+static const EVP_CIPHER *aes_gcm(unsigned int keybits)
+{
+	switch(keybits)
+	{
+		case 128:	return EVP_aes_128_gcm();
+		case 192:	return EVP_aes_192_gcm();
+		case 256:	return EVP_aes_256_gcm();
+	}
+	return NULL;
+}
+
+void mbedtls_gcm_init(mbedtls_gcm_context *ctx)
+{
+	memset(ctx, 0, sizeof(mbedtls_gcm_context));
+}
+
+void mbedtls_gcm_free(mbedtls_gcm_context *ctx)
+{
+	if(ctx == NULL) return;
+
+	EVP_CIPHER_CTX_free(ctx->cipher);
+	EVP_CIPHER_CTX_free(ctx->tag);
+	mbedtls_platform_zeroize(ctx, sizeof(mbedtls_gcm_context));
+}
+
+// Both contexts are made here, starts() only rekeys them
+int mbedtls_gcm_setkey(mbedtls_gcm_context *ctx, mbedtls_cipher_id_t cipher, const unsigned char *key, unsigned int keybits)
+{
+	if(cipher != MBEDTLS_CIPHER_ID_AES || aes_gcm(keybits) == NULL) return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	if(ctx->cipher == NULL) ctx->cipher = EVP_CIPHER_CTX_new();
+	if(ctx->tag == NULL) ctx->tag = EVP_CIPHER_CTX_new();
+	if(ctx->cipher == NULL || ctx->tag == NULL) return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	memcpy(ctx->key, key, keybits / 8);
+	ctx->keybits = keybits;
+	return 0;
+}
+
+static int gcm_init(EVP_CIPHER_CTX *c, const EVP_CIPHER *cipher, int enc, const unsigned char *key,
+		const unsigned char *iv, size_t iv_len)
+{
+	if(EVP_CipherInit_ex(c, cipher, NULL, NULL, NULL, enc) != 1) return 0;
+	if(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_GCM_SET_IVLEN, iv_len, NULL) != 1) return 0;
+	return EVP_CipherInit_ex(c, NULL, NULL, key, iv, enc) == 1;
+}
+
+int mbedtls_gcm_starts(mbedtls_gcm_context *ctx, int mode, const unsigned char *iv, size_t iv_len)
+{
+	const EVP_CIPHER *cipher = aes_gcm(ctx->keybits);
+
+	if(cipher == NULL || iv_len == 0) return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	ctx->mode = mode;
+	if(!gcm_init(ctx->cipher, cipher, mode == MBEDTLS_GCM_ENCRYPT, ctx->key, iv, iv_len)) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	if(mode == MBEDTLS_GCM_DECRYPT && !gcm_init(ctx->tag, cipher, 1, ctx->key, iv, iv_len)) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	return 0;
+}
+
+int mbedtls_gcm_update_ad(mbedtls_gcm_context *ctx, const unsigned char *add, size_t add_len)
+{
+	int outl;
+
+	if(add_len == 0) return 0;
+	if(EVP_CipherUpdate(ctx->cipher, NULL, &outl, add, add_len) != 1) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	if(ctx->mode == MBEDTLS_GCM_DECRYPT && EVP_CipherUpdate(ctx->tag, NULL, &outl, add, add_len) != 1)
+	{
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+	}
+	return 0;
+}
+
+int mbedtls_gcm_update(mbedtls_gcm_context *ctx, const unsigned char *input, size_t input_length,
+		unsigned char *output, size_t output_size, size_t *output_length)
+{
+	unsigned char scratch[1024];
+	size_t off, n;
+	int outl;
+
+	*output_length = 0;
+	if(output_size < input_length) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	if(input_length == 0) return 0;
+
+	if(EVP_CipherUpdate(ctx->cipher, output, &outl, input, input_length) != 1 || (size_t)outl != input_length)
+	{
+		return MBEDTLS_ERR_GCM_BAD_INPUT;
+	}
+
+	// the plaintext encrypted again gives the ciphertext the tag is over
+	for(off = 0; ctx->mode == MBEDTLS_GCM_DECRYPT && off < input_length; off += n)
+	{
+		n = input_length - off < sizeof(scratch) ? input_length - off : sizeof(scratch);
+		if(EVP_CipherUpdate(ctx->tag, scratch, &outl, &output[off], n) != 1) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	}
+
+	*output_length = input_length;
+	return 0;
+}
+
+int mbedtls_gcm_finish(mbedtls_gcm_context *ctx, unsigned char *output, size_t output_size, size_t *output_length,
+		unsigned char *tag, size_t tag_len)
+{
+	EVP_CIPHER_CTX *c = (ctx->mode == MBEDTLS_GCM_DECRYPT) ? ctx->tag : ctx->cipher;
+	unsigned char rest[16];
+	int outl;
+
+	*output_length = 0;
+	if(tag_len < 4 || tag_len > 16) return MBEDTLS_ERR_GCM_BAD_INPUT;
+
+	if(EVP_EncryptFinal_ex(c, rest, &outl) != 1) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	if(EVP_CIPHER_CTX_ctrl(c, EVP_CTRL_GCM_GET_TAG, tag_len, tag) != 1) return MBEDTLS_ERR_GCM_BAD_INPUT;
+	return 0;
+}
+
+/*---------------------------- SHA-256 -----------------------------------*/
+void mbedtls_sha256_init(mbedtls_sha256_context *ctx)
+{
+	memset(ctx, 0, sizeof(mbedtls_sha256_context));
+}
+
+void mbedtls_sha256_free(mbedtls_sha256_context *ctx)
+{
+	if(ctx == NULL) return;
+
+	EVP_MD_CTX_free(ctx->md);
+	ctx->md = NULL;
+}
+
+int mbedtls_sha256_starts(mbedtls_sha256_context *ctx, int is224)
+{
+	if(ctx->md == NULL) ctx->md = EVP_MD_CTX_new();
+	if(ctx->md == NULL) return -1;
+	return EVP_DigestInit_ex(ctx->md, is224 ? EVP_sha224() : EVP_sha256(), NULL) == 1 ? 0 : -1;
+}
+
+int mbedtls_sha256_update(mbedtls_sha256_context *ctx, const unsigned char *input, size_t ilen)
+{
+	return EVP_DigestUpdate(ctx->md, input, ilen) == 1 ? 0 : -1;
+}
+
+int mbedtls_sha256_finish(mbedtls_sha256_context *ctx, unsigned char *output)
+{
+	return EVP_DigestFinal_ex(ctx->md, output, NULL) == 1 ? 0 : -1;
+}
+
+int mbedtls_sha256(const unsigned char *input, size_t ilen, unsigned char *output, int is224)
+{
+	return EVP_Digest(input, ilen, output, NULL, is224 ? EVP_sha224() : EVP_sha256(), NULL) == 1 ? 0 : -1;
+}
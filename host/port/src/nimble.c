@@ -0,0 +1,598 @@
+/**
+ * @file nimble.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : NimBLE host calls of bt_ble.c, the phone is a TCP client on 127.0.0.1
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <poll.h>
+#include <pthread.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "nimble/nimble_port.h"
+#include "nimble/nimble_port_freertos.h"
+#include "host/ble_hs.h"
+#include "host/util/util.h"
+#include "services/gap/ble_svc_gap.h"
+#include "services/gatt/ble_svc_gatt.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "NimBLE"
+
+#define BLE_ADV_DATA_MAX		31
+#define BLE_POLL_MS				100
+#define BLE_CONN_ITVL			12		// 15 ms, what bt_ble.c asks for
+#define BLE_ATT_CID				4
+
+typedef struct {
+	int sock;						// -1 : free
+	uint16_t handle;
+	int closing;					// terminated locally, the DISCONNECT is raised by the host task
+	int update;						// parameter update asked, CONN_UPDATE pending
+	pthread_mutex_t tx_lock;
+} ble_conn_t;
+
+/*---------------------------- Variables ---------------------------------*/
+struct ble_hs_cfg ble_hs_cfg;
+
+static const struct ble_gatt_svc_def *ble_svcs;
+static ble_gatt_access_fn *ble_rx_cb;		// the writable characteristic
+static uint16_t ble_tx_handle;
+
+static ble_gap_event_fn *ble_gap_cb;
+static void *ble_gap_cb_arg;
+static volatile int ble_adv_on;
+static volatile int ble_synced;
+static volatile int ble_stop;
+
+static ble_conn_t ble_conns[BLE_HOST_CONN_MAX];
+static uint16_t ble_handles;
+static pthread_mutex_t ble_conn_lock = PTHREAD_MUTEX_INITIALIZER;
+
+// msys pool : notifications and received writes, nothing from the heap
+static struct os_mbuf ble_mbufs[BLE_HOST_MBUF_COUNT];
+static uint8_t ble_mbuf_data[BLE_HOST_MBUF_COUNT][BLE_HOST_MBUF_SIZE];
+static uint8_t ble_mbuf_used[BLE_HOST_MBUF_COUNT];
+static pthread_mutex_t ble_mbuf_lock = PTHREAD_MUTEX_INITIALIZER;
+
+static char ble_device_name[32] = "nimble";
+static TaskHandle_t ble_host_task;
+
+/*-------------------------- Function declares ---------------------------*/
+
+/*---------------------------- mbuf --------------------------------------*/
+static struct os_mbuf *mbuf_get(void)
+{
+	struct os_mbuf *om = NULL;
+	int i;
+
+	pthread_mutex_lock(&ble_mbuf_lock);
+	for(i = 0; i < BLE_HOST_MBUF_COUNT; i++)
+	{
+		if(ble_mbuf_used[i]) continue;
+
+		ble_mbuf_used[i] = 1;
+		om = &ble_mbufs[i];
+		memset(om, 0, sizeof(struct os_mbuf));
+		om->om_data = ble_mbuf_data[i];
+		break;
+	}
+	pthread_mutex_unlock(&ble_mbuf_lock);
+	return om;
+}
+
+int os_mbuf_free_chain(struct os_mbuf *om)
+{
+	struct os_mbuf *next;
+
+	pthread_mutex_lock(&ble_mbuf_lock);
+	for(; om != NULL; om = next)
+	{
+		next = SLIST_NEXT(om, om_next);
+		ble_mbuf_used[om - ble_mbufs] = 0;
+	}
+	pthread_mutex_unlock(&ble_mbuf_lock);
+	return 0;
+}
+
+// NULL when the pool is out of blocks, the caller retries like on the device
+struct os_mbuf *ble_hs_mbuf_from_flat(const void *buf, uint16_t len)
+{
+	struct os_mbuf *head = NULL, *tail = NULL, *om;
+	const uint8_t *p = buf;
+	int n;
+
+	do
+	{
+		om = mbuf_get();
+		if(om == NULL)
+		{
+			os_mbuf_free_chain(head);
+			return NULL;
+		}
+		n = len < BLE_HOST_MBUF_SIZE ? len : BLE_HOST_MBUF_SIZE;
+		memcpy(om->om_data, p, n);
+		om->om_len = n;
+		p += n;
+		len -= n;
+
+		if(tail) SLIST_NEXT(tail, om_next) = om;
+		else head = om;
+		tail = om;
+	} while(len > 0);
+
+	return head;
+}
+
+/*---------------------------- Connections -------------------------------*/
+static ble_conn_t *conn_find(uint16_t handle)
+{
+	int i;
+
+	for(i = 0; i < BLE_HOST_CONN_MAX; i++)
+	{
+		if(ble_conns[i].sock >= 0 && ble_conns[i].handle == handle) return &ble_conns[i];
+	}
+	return NULL;
+}
+
+static void gap_event(struct ble_gap_event *event)
+{
+	if(ble_gap_cb) ble_gap_cb(event, ble_gap_cb_arg);
+}
+
+static int sock_read_all(int sock, void *buf, int len)
+{
+	uint8_t *p = buf;
+	int n;
+
+	while(len > 0)
+	{
+		n = recv(sock, p, len, 0);
+		if(n < 0 && errno == EINTR) continue;
+		if(n <= 0) return -1;
+		p += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static void conn_accept(int listen_sock)
+{
+	struct ble_gap_event event;
+	ble_conn_t *c = NULL;
+	int sock, i, one = 1;
+
+	sock = accept(listen_sock, NULL, NULL);
+	if(sock < 0) return;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	for(i = 0; i < BLE_HOST_CONN_MAX && c == NULL; i++)
+	{
+		if(ble_conns[i].sock < 0) c = &ble_conns[i];
+	}
+	if(c != NULL)
+	{
+		c->sock = sock;
+		c->handle = ++ble_handles;
+		c->closing = 0;
+		c->update = 0;
+	}
+	pthread_mutex_unlock(&ble_conn_lock);
+
+	if(c == NULL)
+	{
+		close(sock);
+		return;
+	}
+	setsockopt(sock, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	// a connection ends advertising, bt_ble.c starts it again
+	ble_adv_on = 0;
+	memset(&event, 0, sizeof(event));
+	event.type = BLE_GAP_EVENT_CONNECT;
+	event.connect.status = 0;
+	event.connect.conn_handle = c->handle;
+	gap_event(&event);
+}
+
+static void conn_close(ble_conn_t *c, int reason)
+{
+	struct ble_gap_event event;
+
+	memset(&event, 0, sizeof(event));
+	event.type = BLE_GAP_EVENT_DISCONNECT;
+	event.disconnect.reason = reason;
+	event.disconnect.conn.conn_handle = c->handle;
+	event.disconnect.conn.conn_itvl = BLE_CONN_ITVL;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	pthread_mutex_lock(&c->tx_lock);
+	close(c->sock);
+	c->sock = -1;
+	pthread_mutex_unlock(&c->tx_lock);
+	pthread_mutex_unlock(&ble_conn_lock);
+
+	gap_event(&event);
+}
+
+// One frame : a GATT write cut into an mbuf chain, or an MTU exchange
+static int conn_receive(ble_conn_t *c)
+{
+	struct ble_gatt_access_ctxt ctxt;
+	struct ble_gap_event event;
+	uint8_t data[BLE_ATT_ATTR_MAX_LEN];
+	uint16_t len, mtu;
+
+	if(sock_read_all(c->sock, &len, 2) != 0) return -1;
+
+	if(len == BLE_HOST_FRAME_MTU)
+	{
+		if(sock_read_all(c->sock, &mtu, 2) != 0) return -1;
+
+		memset(&event, 0, sizeof(event));
+		event.type = BLE_GAP_EVENT_MTU;
+		event.mtu.conn_handle = c->handle;
+		event.mtu.channel_id = BLE_ATT_CID;
+		event.mtu.value = mtu;
+		gap_event(&event);
+		return 0;
+	}
+
+	if(len > BLE_ATT_ATTR_MAX_LEN)
+	{
+		ESP_LOGE(TAG, "write of %d bytes, ATT allows %d", len, BLE_ATT_ATTR_MAX_LEN);
+		return -1;
+	}
+	if(sock_read_all(c->sock, data, len) != 0) return -1;
+
+	memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.op = BLE_GATT_ACCESS_OP_WRITE_CHR;
+	ctxt.om = ble_hs_mbuf_from_flat(data, len);
+	if(ctxt.om == NULL) return -1;
+
+	if(ble_rx_cb) ble_rx_cb(c->handle, 0, &ctxt, NULL);
+	os_mbuf_free_chain(ctxt.om);
+	return 0;
+}
+
+/*---------------------------- Port --------------------------------------*/
+esp_err_t nimble_port_init(void)
+{
+	int i;
+
+	for(i = 0; i < BLE_HOST_CONN_MAX; i++)
+	{
+		ble_conns[i].sock = -1;
+		pthread_mutex_init(&ble_conns[i].tx_lock, NULL);
+	}
+	ble_stop = 0;
+	return ESP_OK;
+}
+
+esp_err_t nimble_port_deinit(void)
+{
+	return ESP_OK;
+}
+
+/*******************************************
+The host task : listen for the phone, then the controller is "synced".
+Connection events, writes and MTU exchanges are delivered from here,
+like the NimBLE host task does.
+*******************************************/
+void nimble_port_run(void)
+{
+	struct pollfd fds[1 + BLE_HOST_CONN_MAX];
+	struct ble_gap_event event;
+	struct sockaddr_in addr;
+	ble_conn_t *conn[1 + BLE_HOST_CONN_MAX];
+	int listen_sock, one = 1, n, i;
+
+	listen_sock = socket(AF_INET, SOCK_STREAM, 0);
+	setsockopt(listen_sock, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	addr.sin_port = htons(BLE_HOST_PHONE_PORT);
+	if(listen_sock < 0 || bind(listen_sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(listen_sock, 1) != 0)
+	{
+		ESP_LOGE(TAG, "phone socket on port %d : errno %d", BLE_HOST_PHONE_PORT, errno);
+		if(listen_sock >= 0) close(listen_sock);
+		return;
+	}
+	ESP_LOGI(TAG, "phone link : 127.0.0.1:%d", BLE_HOST_PHONE_PORT);
+
+	ble_synced = 1;
+	if(ble_hs_cfg.sync_cb) ble_hs_cfg.sync_cb();
+
+	while(!ble_stop)
+	{
+		n = 0;
+		if(ble_adv_on)
+		{
+			fds[n].fd = listen_sock;
+			fds[n].events = POLLIN;
+			conn[n++] = NULL;
+		}
+		for(i = 0; i < BLE_HOST_CONN_MAX; i++)
+		{
+			ble_conn_t *c = &ble_conns[i];
+
+			if(c->sock < 0) continue;
+
+			if(c->closing)
+			{
+				conn_close(c, BLE_HS_HCI_ERR(BLE_ERR_CONN_TERM_LOCAL));
+				continue;
+			}
+			if(c->update)
+			{
+				c->update = 0;
+				memset(&event, 0, sizeof(event));
+				event.type = BLE_GAP_EVENT_CONN_UPDATE;
+				event.conn_update.conn_handle = c->handle;
+				gap_event(&event);
+			}
+			fds[n].fd = c->sock;
+			fds[n].events = POLLIN;
+			conn[n++] = c;
+		}
+
+		if(poll(fds, n, BLE_POLL_MS) <= 0) continue;
+
+		for(i = 0; i < n; i++)
+		{
+			if(fds[i].revents == 0) continue;
+
+			if(conn[i] == NULL) conn_accept(listen_sock);
+			else if(conn[i]->sock >= 0 && conn_receive(conn[i]) != 0)
+			{
+				conn_close(conn[i], conn[i]->closing ? BLE_HS_HCI_ERR(BLE_ERR_CONN_TERM_LOCAL)
+						: BLE_HS_HCI_ERR(BLE_ERR_REM_USER_CONN_TERM));
+			}
+		}
+	}
+
+	for(i = 0; i < BLE_HOST_CONN_MAX; i++)
+	{
+		if(ble_conns[i].sock >= 0) conn_close(&ble_conns[i], BLE_HS_HCI_ERR(BLE_ERR_CONN_TERM_LOCAL));
+	}
+	close(listen_sock);
+	ble_synced = 0;
+}
+
+int nimble_port_stop(void)
+{
+	ble_stop = 1;
+	return 0;
+}
+
+void nimble_port_freertos_init(TaskFunction_t host_task_fn)
+{
+	xTaskCreatePinnedToCore(host_task_fn, "nimble_host", 4096, NULL, 21, &ble_host_task, 0);
+}
+
+void nimble_port_freertos_deinit(void)
+{
+	ble_host_task = NULL;
+	vTaskDelete(NULL);
+}
+
+/*---------------------------- GATT --------------------------------------*/
+int ble_hs_synced(void)
+{
+	return ble_synced;
+}
+
+int ble_hs_id_infer_auto(int privacy, uint8_t *out_addr_type)
+{
+	*out_addr_type = 0;		// public
+	return 0;
+}
+
+int ble_gatts_count_cfg(const struct ble_gatt_svc_def *defs)
+{
+	return 0;
+}
+
+// Handles : the TX characteristic value gets one, the writable characteristic is the phone's target
+int ble_gatts_add_svcs(const struct ble_gatt_svc_def *svcs)
+{
+	const struct ble_gatt_chr_def *chr;
+	uint16_t handle = 1;
+
+	ble_svcs = svcs;
+	for(; svcs->type != BLE_GATT_SVC_TYPE_END; svcs++)
+	{
+		handle++;
+		for(chr = svcs->characteristics; chr != NULL && chr->uuid != NULL; chr++)
+		{
+			handle += 2;
+			if(chr->val_handle) *chr->val_handle = handle;
+			if(chr->flags & BLE_GATT_CHR_F_NOTIFY) ble_tx_handle = handle;
+			if((chr->flags & (BLE_GATT_CHR_F_WRITE | BLE_GATT_CHR_F_WRITE_NO_RSP)) && ble_rx_cb == NULL) ble_rx_cb = chr->access_cb;
+		}
+	}
+	return 0;
+}
+
+// One frame per notification, written before the call returns
+int ble_gattc_notify_custom(uint16_t conn_handle, uint16_t att_handle, struct os_mbuf *om)
+{
+	uint8_t frame[2 + BLE_ATT_ATTR_MAX_LEN];
+	struct os_mbuf *m;
+	ble_conn_t *c;
+	uint16_t len = 0;
+	int ret = 0;
+
+	if(om == NULL) return BLE_HS_ENOMEM;
+
+	for(m = om; m != NULL; m = SLIST_NEXT(m, om_next))
+	{
+		if(len + m->om_len > BLE_ATT_ATTR_MAX_LEN)
+		{
+			os_mbuf_free_chain(om);
+			return BLE_HS_EMSGSIZE;
+		}
+		memcpy(&frame[2 + len], m->om_data, m->om_len);
+		len += m->om_len;
+	}
+	os_mbuf_free_chain(om);
+	memcpy(frame, &len, 2);
+
+	pthread_mutex_lock(&ble_conn_lock);
+	c = conn_find(conn_handle);
+	if(c == NULL || att_handle != ble_tx_handle)
+	{
+		pthread_mutex_unlock(&ble_conn_lock);
+		return c == NULL ? BLE_HS_ENOTCONN : BLE_HS_EINVAL;
+	}
+	pthread_mutex_lock(&c->tx_lock);
+	pthread_mutex_unlock(&ble_conn_lock);
+
+	if(send(c->sock, frame, 2 + len, MSG_NOSIGNAL) != 2 + len) ret = BLE_HS_ENOTCONN;
+	pthread_mutex_unlock(&c->tx_lock);
+	return ret;
+}
+
+/*---------------------------- GAP ---------------------------------------*/
+static int adv_fields_len(const struct ble_hs_adv_fields *f)
+{
+	int len = 0;
+
+	if(f->flags) len += 3;
+	if(f->num_uuids128) len += 2 + 16 * f->num_uuids128;
+	if(f->name_len) len += 2 + f->name_len;
+	if(f->tx_pwr_lvl_is_present) len += 3;
+	return len;
+}
+
+int ble_gap_adv_set_fields(const struct ble_hs_adv_fields *adv_fields)
+{
+	return adv_fields_len(adv_fields) > BLE_ADV_DATA_MAX ? BLE_HS_EMSGSIZE : 0;
+}
+
+int ble_gap_adv_rsp_set_fields(const struct ble_hs_adv_fields *rsp_fields)
+{
+	return adv_fields_len(rsp_fields) > BLE_ADV_DATA_MAX ? BLE_HS_EMSGSIZE : 0;
+}
+
+// Advertising is accepting the next phone connection
+int ble_gap_adv_start(uint8_t own_addr_type, const void *direct_addr, int32_t duration_ms,
+		const struct ble_gap_adv_params *adv_params, ble_gap_event_fn *cb, void *cb_arg)
+{
+	if(ble_adv_on) return BLE_HS_EALREADY;
+
+	ble_gap_cb = cb;
+	ble_gap_cb_arg = cb_arg;
+	ble_adv_on = 1;
+	return 0;
+}
+
+int ble_gap_adv_stop(void)
+{
+	if(!ble_adv_on) return BLE_HS_EALREADY;
+
+	ble_adv_on = 0;
+	return 0;
+}
+
+int ble_gap_adv_active(void)
+{
+	return ble_adv_on;
+}
+
+int ble_gap_conn_find(uint16_t handle, struct ble_gap_conn_desc *out_desc)
+{
+	ble_conn_t *c;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	c = conn_find(handle);
+	pthread_mutex_unlock(&ble_conn_lock);
+	if(c == NULL) return BLE_HS_ENOTCONN;
+
+	memset(out_desc, 0, sizeof(struct ble_gap_conn_desc));
+	out_desc->conn_handle = handle;
+	out_desc->conn_itvl = BLE_CONN_ITVL;
+	out_desc->conn_latency = 0;
+	out_desc->supervision_timeout = 100;
+	return 0;
+}
+
+// Accepted as asked, the CONN_UPDATE event follows from the host task
+int ble_gap_update_params(uint16_t conn_handle, const struct ble_gap_upd_params *params)
+{
+	ble_conn_t *c;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	c = conn_find(conn_handle);
+	if(c != NULL) c->update = 1;
+	pthread_mutex_unlock(&ble_conn_lock);
+	return c ? 0 : BLE_HS_ENOTCONN;
+}
+
+// The phone sees its socket closed, the DISCONNECT event follows from the host task
+int ble_gap_terminate(uint16_t conn_handle, uint8_t hci_reason)
+{
+	ble_conn_t *c;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	c = conn_find(conn_handle);
+	if(c != NULL)
+	{
+		c->closing = 1;
+		shutdown(c->sock, SHUT_RDWR);
+	}
+	pthread_mutex_unlock(&ble_conn_lock);
+	return c ? 0 : BLE_HS_ENOTCONN;
+}
+
+int ble_gap_set_prefered_default_le_phy(uint8_t tx_phys_mask, uint8_t rx_phys_mask)
+{
+	return 0;
+}
+
+int ble_gap_read_le_phy(uint16_t conn_handle, uint8_t *tx_phy, uint8_t *rx_phy)
+{
+	ble_conn_t *c;
+
+	pthread_mutex_lock(&ble_conn_lock);
+	c = conn_find(conn_handle);
+	pthread_mutex_unlock(&ble_conn_lock);
+	if(c == NULL) return BLE_HS_ENOTCONN;
+
+	*tx_phy = *rx_phy = 2;		// 2M
+	return 0;
+}
+
+/*---------------------------- Services ----------------------------------*/
+const char *ble_svc_gap_device_name(void)
+{
+	return ble_device_name;
+}
+
+int ble_svc_gap_device_name_set(const char *name)
+{
+	if(strlen(name) >= sizeof(ble_device_name)) return BLE_HS_EINVAL;
+
+	strcpy(ble_device_name, name);
+	return 0;
+}
+
+void ble_svc_gap_init(void)
+{
+}
+
+void ble_svc_gatt_init(void)
+{
+}
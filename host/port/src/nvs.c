@@ -0,0 +1,309 @@
+/**
+ * @file nvs.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : NVS key/value store kept in the nvs partition of the flash file, survives esp_restart()
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <pthread.h>
+
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+/*---------------------------- User define -------------------------------*/
+#define NVS_MAGIC			0x53564E48		// "HNVS"
+#define NVS_AREA_SIZE		0x4000			// nvs partition
+#define NVS_HANDLE_MAX		16
+
+#define NVS_TYPE_NAMESPACE	0x00
+#define NVS_TYPE_U8			0x01
+#define NVS_TYPE_BLOB		0x42
+
+// Records follow the magic word : header, then the value padded to 4 bytes. The NVS page format is not kept.
+typedef struct {
+	char ns[NVS_KEY_NAME_MAX_SIZE];
+	char key[NVS_KEY_NAME_MAX_SIZE];
+	uint8_t type;
+	uint8_t reserved;
+	uint16_t len;
+} nvs_record_t;
+
+typedef struct {
+	int used;
+	nvs_open_mode_t mode;
+	char ns[NVS_KEY_NAME_MAX_SIZE];
+} nvs_open_t;
+
+#define NVS_PAD(len)	(((len) + 3) & ~3)
+
+/*---------------------------- Variables ---------------------------------*/
+static uint8_t nvs_area[NVS_AREA_SIZE];
+static int nvs_area_len;		// bytes of records after the magic word
+static int nvs_ready;
+static nvs_open_t nvs_handles[NVS_HANDLE_MAX];
+static pthread_mutex_t nvs_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/*-------------------------- Function declares ---------------------------*/
+
+static const esp_partition_t *nvs_partition(void)
+{
+	return esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_NVS, NULL);
+}
+
+// The whole area is written back on every change, like a committed NVS entry
+static esp_err_t nvs_store(void)
+{
+	const esp_partition_t *p = nvs_partition();
+	uint32_t magic = NVS_MAGIC;
+	esp_err_t err;
+
+	memcpy(nvs_area, &magic, 4);
+	err = esp_partition_erase_range(p, 0, p->size);
+	if(err == ESP_OK) err = esp_partition_write(p, 0, nvs_area, 4 + nvs_area_len);
+	return err;
+}
+
+static nvs_record_t *nvs_find(const char *ns, const char *key, uint8_t type)
+{
+	nvs_record_t *r;
+	int pos;
+
+	for(pos = 4; pos < 4 + nvs_area_len; pos += sizeof(nvs_record_t) + NVS_PAD(r->len))
+	{
+		r = (nvs_record_t *)&nvs_area[pos];
+		if(r->type == type && strcmp(r->ns, ns) == 0 && strcmp(r->key, key) == 0) return r;
+	}
+	return NULL;
+}
+
+static void nvs_remove(nvs_record_t *r)
+{
+	int pos = (uint8_t *)r - nvs_area, size = sizeof(nvs_record_t) + NVS_PAD(r->len);
+
+	memmove(r, (uint8_t *)r + size, 4 + nvs_area_len - pos - size);
+	nvs_area_len -= size;
+}
+
+static esp_err_t nvs_add(const char *ns, const char *key, uint8_t type, const void *value, size_t len)
+{
+	nvs_record_t *r;
+
+	if(4 + nvs_area_len + sizeof(nvs_record_t) + NVS_PAD(len) > NVS_AREA_SIZE) return ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+
+	r = (nvs_record_t *)&nvs_area[4 + nvs_area_len];
+	memset(r, 0, sizeof(nvs_record_t) + NVS_PAD(len));
+	strncpy(r->ns, ns, NVS_KEY_NAME_MAX_SIZE - 1);
+	strncpy(r->key, key, NVS_KEY_NAME_MAX_SIZE - 1);
+	r->type = type;
+	r->len = len;
+	if(len > 0) memcpy(r + 1, value, len);
+	nvs_area_len += sizeof(nvs_record_t) + NVS_PAD(len);
+	return ESP_OK;
+}
+
+/*---------------------------- nvs_flash ---------------------------------*/
+esp_err_t nvs_flash_init(void)
+{
+	const esp_partition_t *p = nvs_partition();
+	nvs_record_t *r;
+	uint32_t magic;
+	int pos;
+
+	pthread_mutex_lock(&nvs_lock);
+	esp_partition_read(p, 0, nvs_area, NVS_AREA_SIZE);
+	memcpy(&magic, nvs_area, 4);
+
+	nvs_area_len = 0;
+	if(magic == NVS_MAGIC)
+	{
+		// records up to the erased tail
+		for(pos = 4; pos + (int)sizeof(nvs_record_t) <= NVS_AREA_SIZE; pos += sizeof(nvs_record_t) + NVS_PAD(r->len))
+		{
+			r = (nvs_record_t *)&nvs_area[pos];
+			if((uint8_t)r->ns[0] == 0xFF || pos + sizeof(nvs_record_t) + NVS_PAD(r->len) > NVS_AREA_SIZE) break;
+		}
+		nvs_area_len = pos - 4;
+	}
+	nvs_ready = 1;
+	pthread_mutex_unlock(&nvs_lock);
+	return ESP_OK;
+}
+
+esp_err_t nvs_flash_erase(void)
+{
+	const esp_partition_t *p = nvs_partition();
+
+	pthread_mutex_lock(&nvs_lock);
+	nvs_area_len = 0;
+	nvs_ready = 0;
+	pthread_mutex_unlock(&nvs_lock);
+	return esp_partition_erase_range(p, 0, p->size);
+}
+
+/*---------------------------- nvs ---------------------------------------*/
+esp_err_t nvs_open(const char *namespace_name, nvs_open_mode_t open_mode, nvs_handle_t *out_handle)
+{
+	esp_err_t err = ESP_OK;
+	int i;
+
+	if(strlen(namespace_name) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+
+	pthread_mutex_lock(&nvs_lock);
+	if(!nvs_ready) err = ESP_ERR_NVS_NOT_INITIALIZED;
+	else if(nvs_find(namespace_name, "", NVS_TYPE_NAMESPACE) == NULL)
+	{
+		// a read only open does not make the namespace
+		if(open_mode == NVS_READONLY) err = ESP_ERR_NVS_NOT_FOUND;
+		else if((err = nvs_add(namespace_name, "", NVS_TYPE_NAMESPACE, NULL, 0)) == ESP_OK) err = nvs_store();
+	}
+
+	for(i = 0; err == ESP_OK && i < NVS_HANDLE_MAX; i++)
+	{
+		if(nvs_handles[i].used) continue;
+
+		nvs_handles[i].used = 1;
+		nvs_handles[i].mode = open_mode;
+		strcpy(nvs_handles[i].ns, namespace_name);
+		*out_handle = i + 1;
+		break;
+	}
+	if(err == ESP_OK && i == NVS_HANDLE_MAX) err = ESP_ERR_NVS_NOT_ENOUGH_SPACE;
+	pthread_mutex_unlock(&nvs_lock);
+	return err;
+}
+
+void nvs_close(nvs_handle_t handle)
+{
+	if(handle == 0 || handle > NVS_HANDLE_MAX) return;
+
+	pthread_mutex_lock(&nvs_lock);
+	nvs_handles[handle - 1].used = 0;
+	pthread_mutex_unlock(&nvs_lock);
+}
+
+static nvs_open_t *nvs_handle(nvs_handle_t handle)
+{
+	if(handle == 0 || handle > NVS_HANDLE_MAX || !nvs_handles[handle - 1].used) return NULL;
+	return &nvs_handles[handle - 1];
+}
+
+// Every change is stored when it is made
+esp_err_t nvs_commit(nvs_handle_t handle)
+{
+	return nvs_handle(handle) ? ESP_OK : ESP_ERR_NVS_INVALID_HANDLE;
+}
+
+static esp_err_t nvs_get(nvs_handle_t handle, const char *key, uint8_t type, void *out_value, size_t *length)
+{
+	nvs_open_t *h;
+	nvs_record_t *r;
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&nvs_lock);
+	h = nvs_handle(handle);
+	r = h ? nvs_find(h->ns, key, type) : NULL;
+	if(h == NULL) err = ESP_ERR_NVS_INVALID_HANDLE;
+	else if(r == NULL) err = ESP_ERR_NVS_NOT_FOUND;
+	else if(out_value == NULL) *length = r->len;
+	else if(*length < r->len) err = ESP_ERR_NVS_INVALID_LENGTH;
+	else
+	{
+		memcpy(out_value, r + 1, r->len);
+		*length = r->len;
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	return err;
+}
+
+static esp_err_t nvs_set(nvs_handle_t handle, const char *key, uint8_t type, const void *value, size_t length)
+{
+	nvs_open_t *h;
+	nvs_record_t *r;
+	esp_err_t err;
+
+	if(key == NULL || key[0] == 0 || strlen(key) >= NVS_KEY_NAME_MAX_SIZE) return ESP_ERR_INVALID_ARG;
+
+	pthread_mutex_lock(&nvs_lock);
+	h = nvs_handle(handle);
+	if(h == NULL || h->mode != NVS_READWRITE)
+	{
+		pthread_mutex_unlock(&nvs_lock);
+		return ESP_ERR_NVS_INVALID_HANDLE;
+	}
+
+	r = nvs_find(h->ns, key, type);
+	if(r != NULL) nvs_remove(r);
+	err = nvs_add(h->ns, key, type, value, length);
+	if(err == ESP_OK) err = nvs_store();
+	pthread_mutex_unlock(&nvs_lock);
+	return err;
+}
+
+esp_err_t nvs_get_u8(nvs_handle_t handle, const char *key, uint8_t *out_value)
+{
+	size_t len = 1;
+
+	return nvs_get(handle, key, NVS_TYPE_U8, out_value, &len);
+}
+
+esp_err_t nvs_set_u8(nvs_handle_t handle, const char *key, uint8_t value)
+{
+	return nvs_set(handle, key, NVS_TYPE_U8, &value, 1);
+}
+
+esp_err_t nvs_get_blob(nvs_handle_t handle, const char *key, void *out_value, size_t *length)
+{
+	return nvs_get(handle, key, NVS_TYPE_BLOB, out_value, length);
+}
+
+esp_err_t nvs_set_blob(nvs_handle_t handle, const char *key, const void *value, size_t length)
+{
+	return nvs_set(handle, key, NVS_TYPE_BLOB, value, length);
+}
+
+esp_err_t nvs_erase_key(nvs_handle_t handle, const char *key)
+{
+	nvs_open_t *h;
+	nvs_record_t *r = NULL;
+	esp_err_t err = ESP_ERR_NVS_NOT_FOUND;
+
+	pthread_mutex_lock(&nvs_lock);
+	h = nvs_handle(handle);
+	if(h == NULL || h->mode != NVS_READWRITE) err = ESP_ERR_NVS_INVALID_HANDLE;
+	else if((r = nvs_find(h->ns, key, NVS_TYPE_U8)) != NULL || (r = nvs_find(h->ns, key, NVS_TYPE_BLOB)) != NULL)
+	{
+		nvs_remove(r);
+		err = nvs_store();
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	return err;
+}
+
+// The keys of the namespace, the namespace itself stays
+esp_err_t nvs_erase_all(nvs_handle_t handle)
+{
+	nvs_open_t *h;
+	nvs_record_t *r;
+	int pos;
+	esp_err_t err = ESP_OK;
+
+	pthread_mutex_lock(&nvs_lock);
+	h = nvs_handle(handle);
+	if(h == NULL || h->mode != NVS_READWRITE) err = ESP_ERR_NVS_INVALID_HANDLE;
+	else
+	{
+		for(pos = 4; pos < 4 + nvs_area_len;)
+		{
+			r = (nvs_record_t *)&nvs_area[pos];
+			if(r->type != NVS_TYPE_NAMESPACE && strcmp(r->ns, h->ns) == 0) nvs_remove(r);
+			else pos += sizeof(nvs_record_t) + NVS_PAD(r->len);
+		}
+		err = nvs_store();
+	}
+	pthread_mutex_unlock(&nvs_lock);
+	return err;
+}
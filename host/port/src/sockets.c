@@ -0,0 +1,26 @@
+/**
+ * @file sockets.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host build : socket behaviour of lwIP the firmware relies on
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <sys/socket.h>
+
+/*---------------------------- User define -------------------------------*/
+// The firmware objects are linked with -Wl,--wrap=bind
+int __real_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen);
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+// lwIP lets a port be bound again while old connections are in TIME_WAIT, after esp_restart() too
+int __wrap_bind(int sockfd, const struct sockaddr *addr, socklen_t addrlen)
+{
+	int one = 1;
+
+	setsockopt(sockfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+	return __real_bind(sockfd, addr, addrlen);
+}
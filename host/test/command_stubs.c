@@ -0,0 +1,157 @@
+/**
+ * @file command_stubs.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host tests : the control message path of TaskBle without a BLE link or an OTA task
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdarg.h>
+#include <unistd.h>
+#include <sys/time.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_partition.h"
+#include "driver/uart.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "json.h"
+#include "cbor.h"
+#include "heap_tag.h"
+
+#include "command_stubs.h"
+
+/*---------------------------- User define -------------------------------*/
+#define STUB_LOG_MAX		1024
+
+/*---------------------------- Variables ---------------------------------*/
+command_stub_stats_t command_stub_stats;
+
+static int stub_verbose;
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t __wrap__nordic_uart_send(uint8_t *message, int len);
+void __wrap_esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...);
+int __wrap_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size);
+void __wrap_give_ota_semaphore(void);
+void __wrap_ota_stage_restart(void);
+int __wrap_settimeofday(const struct timeval *tv, const void *tz);
+
+esp_err_t __wrap__nordic_uart_send(uint8_t *message, int len)
+{
+	command_stub_stats.replies++;
+	command_stub_stats.reply_bytes += len;
+	if(stub_verbose) printf("reply %d bytes\n", len);
+	return ESP_OK;
+}
+
+// Formatted all the same : a bad format or argument of a log line is found like on the device
+void __wrap_esp_log_write(esp_log_level_t level, const char *tag, const char *format, ...)
+{
+	char line[STUB_LOG_MAX];
+	va_list args;
+
+	va_start(args, format);
+	vsnprintf(line, sizeof(line), format, args);
+	va_end(args);
+
+	command_stub_stats.log_lines++;
+	if(stub_verbose) fputs(line, stdout);
+}
+
+int __wrap_uart_write_bytes(uart_port_t uart_num, const void *src, size_t size)
+{
+	if(stub_verbose) fwrite(src, 1, size, stdout);
+	return size;
+}
+
+void __wrap_give_ota_semaphore(void)
+{
+	command_stub_stats.ota_starts++;
+	clear_ota_state();		// what the OTA task does when the session is over
+}
+
+void __wrap_ota_stage_restart(void)
+{
+	command_stub_stats.restarts++;
+}
+
+int __wrap_settimeofday(const struct timeval *tv, const void *tz)
+{
+	command_stub_stats.clock_sets++;
+	return 0;
+}
+
+/*******************************************
+Flash in a temporary file : the status reply reads the running partition and
+"ota switch" looks for the other slot. The file is gone once mapped.
+*******************************************/
+int command_stub_init(void)
+{
+	char path[512];
+	const char *dir = getenv("TMPDIR");
+	int fd;
+
+	stub_verbose = getenv("COMMAND_STUB_LOG") != NULL;
+
+	snprintf(path, sizeof(path), "%s/command_stub_XXXXXX", dir ? dir : "/tmp");
+	fd = mkstemp(path);
+	if(fd < 0) return -1;
+	close(fd);
+
+	if(esp_partition_host_init(path) != ESP_OK)
+	{
+		remove(path);
+		return -1;
+	}
+	remove(path);
+
+	heap_tag_init();
+	return 0;
+}
+
+/*******************************************
+One GATT write, dispatched like TaskBle() of bt_ble.c. The data is copied to a
+buffer of exactly len bytes, so a read past the fragment is caught by ASan.
+Text commands are counted and dropped : the console can reboot or erase.
+*******************************************/
+command_frame_t command_frame(const uint8_t *data, int len)
+{
+	uint8_t *msg;
+
+	if(len <= 0) return COMMAND_FRAME_EMPTY;
+
+	msg = malloc(len);
+	if(msg == NULL) return COMMAND_FRAME_EMPTY;
+	memcpy(msg, data, len);
+
+	if(!json_stream_busy() && (cbor_stream_busy() || CBOR_IS_MAP_START(msg[0])))
+	{
+		CommandProcessCbor(msg, len);
+		free(msg);
+		return COMMAND_FRAME_CBOR;
+	}
+
+	if(json_stream_busy() || msg[0] == '{')
+	{
+		CommandProcessJson((const char *)msg, len);
+		free(msg);
+		return COMMAND_FRAME_JSON;
+	}
+
+	command_stub_stats.text_frames++;
+	free(msg);
+	return COMMAND_FRAME_TEXT;
+}
+
+// BLE_GAP_EVENT_DISCONNECT : an unfinished message is dropped
+void command_disconnect(void)
+{
+	json_stream_reset();
+	cbor_stream_reset();
+}
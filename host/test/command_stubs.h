@@ -0,0 +1,56 @@
+/****************************************************************************/
+//  File    : command_stubs.h
+//---------------------------------------------------------------------------
+//  Scope   :  Host build
+//  Description:
+//             Control message path without a BLE link : TaskBle framing, replies and log counted
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HOST_COMMAND_STUBS_H__)
+
+#define __HOST_COMMAND_STUBS_H__
+
+#include <stdint.h>
+
+/*---------------------------- User define -------------------------------*/
+// Link with -Wl,--wrap= for each of these (host/CMakeLists.txt COMMAND_STUB_WRAP)
+//   _nordic_uart_send    status replies : counted, not sent
+//   esp_log_write        formatted and dropped, printed with COMMAND_STUB_LOG=1 in the environment
+//   uart_write_bytes     PrintConsole output, same
+//   give_ota_semaphore   counted : no OTA task waits for it
+//   ota_stage_restart    counted : no restart
+//   settimeofday         counted : the "datetime" key leaves the clock of the machine alone
+
+typedef enum {
+	COMMAND_FRAME_CBOR = 0,
+	COMMAND_FRAME_JSON,
+	COMMAND_FRAME_TEXT,		// console command, not run here (reboot, ota ...)
+	COMMAND_FRAME_EMPTY,
+} command_frame_t;
+
+typedef struct {
+	int replies;
+	int reply_bytes;
+	int ota_starts;
+	int restarts;
+	int clock_sets;
+	int text_frames;
+	int log_lines;
+} command_stub_stats_t;
+
+/*---------------------------- Variables ---------------------------------*/
+extern command_stub_stats_t command_stub_stats;
+
+/*-------------------------- Function declares ---------------------------*/
+int command_stub_init(void);
+command_frame_t command_frame(const uint8_t *data, int len);
+void command_disconnect(void);
+
+#endif  /* End_of __HOST_COMMAND_STUBS_H__ */
@@ -0,0 +1,156 @@
+/**
+ * @file fuzz_json.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host fuzz target : json_parsing() and the TaskBle framing into CommandProcessJson/Cbor
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "esp_system.h"
+
+#include "ota.h"
+#include "json.h"
+
+#include "command_stubs.h"
+
+/*---------------------------- User define -------------------------------*/
+#define FUZZ_PATH_MAX		1024
+
+/*---------------------------- Variables ---------------------------------*/
+// Whole writes, the default BLE MTU payload, and a message cut at every byte
+static const int fuzz_fragments[] = { QUEUE_DATA_SIZE, 20, 1 };
+
+/*-------------------------- Function declares ---------------------------*/
+int LLVMFuzzerInitialize(int *argc, char ***argv);
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+int LLVMFuzzerInitialize(int *argc, char ***argv)
+{
+	if(command_stub_init() != 0)
+	{
+		fprintf(stderr, "fuzz_json : flash file can not be made\n");
+		exit(1);
+	}
+	return 0;
+}
+
+/*******************************************
+The input is what the phone writes : one or more messages, JSON or CBOR,
+possibly cut short. Every received byte goes through the same code as on the
+device, the applied keys included (json_set_dry_run() stays off).
+*******************************************/
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	char *copy;
+	int i, off, n, len = (int)size;
+
+	if(len <= 0) return 0;
+
+	// the console and Wi-Fi path : one call, the whole message
+	copy = malloc(len);
+	if(copy == NULL) return 0;
+	memcpy(copy, data, len);
+	json_parsing(copy, len);
+	free(copy);
+
+	for(i = 0; i < (int)(sizeof(fuzz_fragments) / sizeof(fuzz_fragments[0])); i++)
+	{
+		for(off = 0; off < len; off += n)
+		{
+			n = (len - off < fuzz_fragments[i]) ? len - off : fuzz_fragments[i];
+			command_frame(&data[off], n);
+		}
+		command_disconnect();
+	}
+
+	clear_ota_state();
+	return 0;
+}
+
+#if !defined(HOST_LIBFUZZER)
+/*---------------------------- Replay ------------------------------------*/
+// Without libFuzzer (gcc) : every file given, or every file of a directory given, once
+static int fuzz_replay_file(const char *path)
+{
+	FILE *fp = fopen(path, "rb");
+	uint8_t *buf;
+	long len;
+
+	if(fp == NULL) return -1;
+	fseek(fp, 0, SEEK_END);
+	len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+
+	buf = malloc(len > 0 ? len : 1);
+	if(buf == NULL || fread(buf, 1, len, fp) != (size_t)len)
+	{
+		free(buf);
+		fclose(fp);
+		return -1;
+	}
+	fclose(fp);
+
+	LLVMFuzzerTestOneInput(buf, len);
+	free(buf);
+	return 0;
+}
+
+static int fuzz_replay(const char *path, int *count)
+{
+	char file[FUZZ_PATH_MAX];
+	struct dirent *ent;
+	struct stat st;
+	DIR *dir;
+	int err = 0;
+
+	if(stat(path, &st) != 0) return -1;
+	if(!S_ISDIR(st.st_mode))
+	{
+		(*count)++;
+		return fuzz_replay_file(path);
+	}
+
+	dir = opendir(path);
+	if(dir == NULL) return -1;
+	while((ent = readdir(dir)) != NULL)
+	{
+		if(ent->d_name[0] == '.') continue;
+		snprintf(file, sizeof(file), "%s/%s", path, ent->d_name);
+		if(fuzz_replay(file, count) != 0) err = -1;
+	}
+	closedir(dir);
+	return err;
+}
+
+int main(int argc, char **argv)
+{
+	int i, count = 0, err = 0;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage : %s <input file or directory>...\n", argv[0]);
+		return 2;
+	}
+
+	LLVMFuzzerInitialize(&argc, &argv);
+	for(i = 1; i < argc; i++)
+	{
+		if(fuzz_replay(argv[i], &count) != 0)
+		{
+			fprintf(stderr, "fuzz_json : %s can not be read\n", argv[i]);
+			err = 1;
+		}
+	}
+
+	printf("{\"fuzz\":\"replay\",\"inputs\":%d,\"replies\":%d,\"ota_starts\":%d,\"clock_sets\":%d,\"text_frames\":%d}\n",
+			count, command_stub_stats.replies, command_stub_stats.ota_starts, command_stub_stats.clock_sets,
+			command_stub_stats.text_frames);
+	return err;
+}
+#endif	// #if !defined(HOST_LIBFUZZER)
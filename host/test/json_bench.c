@@ -0,0 +1,191 @@
+/**
+ * @file json_bench.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host benchmark of the control message path : messages/sec, ns/byte, ns/token over a corpus
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <dirent.h>
+#include <sys/stat.h>
+
+#include "esp_timer.h"
+
+#include "ota.h"
+#include "json.h"
+#include "cbor.h"
+#include "bench.h"
+
+#include "command_stubs.h"
+
+/*---------------------------- User define -------------------------------*/
+#define BENCH_DEFAULT_ITERATIONS	10000
+#define BENCH_CORPUS_MAX			64
+#define BENCH_PATH_MAX				1024
+
+typedef struct {
+	uint8_t *data;
+	int len;
+} bench_msg_t;
+
+typedef enum {
+	BENCH_JSON = 0,		// parser only, keys not applied : bench json of the console
+	BENCH_CBOR,
+	BENCH_COMMAND,		// TaskBle framing, keys applied, status reply built
+} bench_mode_t;
+
+/*---------------------------- Variables ---------------------------------*/
+static const char *bench_names[] = { "json", "cbor", "command" };
+
+// Default BLE MTU payload, ATT MTU 247 - 3, a whole queue entry
+static const int bench_fragments[] = { 20, 244, QUEUE_DATA_SIZE };
+
+static bench_msg_t bench_corpus[2][BENCH_CORPUS_MAX];
+static int bench_count[2];
+
+/*-------------------------- Function declares ---------------------------*/
+
+static int bench_is_cbor(const bench_msg_t *msg)
+{
+	return CBOR_IS_MAP_START(msg->data[0]);
+}
+
+static int bench_load(const char *path)
+{
+	char file[BENCH_PATH_MAX];
+	struct dirent *ent;
+	struct stat st;
+	bench_msg_t msg;
+	DIR *dir;
+	FILE *fp;
+	int cbor;
+
+	dir = opendir(path);
+	if(dir == NULL) return -1;
+
+	while((ent = readdir(dir)) != NULL)
+	{
+		if(ent->d_name[0] == '.') continue;
+		snprintf(file, sizeof(file), "%s/%s", path, ent->d_name);
+		// subdirectories hold the fuzz regression inputs, not control messages
+		if(stat(file, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+		fp = fopen(file, "rb");
+		if(fp == NULL) continue;
+
+		fseek(fp, 0, SEEK_END);
+		msg.len = ftell(fp);
+		fseek(fp, 0, SEEK_SET);
+		msg.data = malloc(msg.len > 0 ? msg.len : 1);
+		if(msg.len <= 0 || msg.data == NULL || fread(msg.data, 1, msg.len, fp) != (size_t)msg.len)
+		{
+			free(msg.data);
+			fclose(fp);
+			continue;
+		}
+		fclose(fp);
+
+		cbor = bench_is_cbor(&msg);
+		if(bench_count[cbor] == BENCH_CORPUS_MAX)
+		{
+			free(msg.data);
+			continue;
+		}
+		bench_corpus[cbor][bench_count[cbor]++] = msg;
+	}
+	closedir(dir);
+
+	return (bench_count[0] + bench_count[1]) > 0 ? 0 : -1;
+}
+
+static void bench_dispatch(const bench_msg_t *msg, int frag)
+{
+	int i, n;
+
+	for(i = 0; i < msg->len; i += n)
+	{
+		n = (msg->len - i < frag) ? msg->len - i : frag;
+		command_frame(&msg->data[i], n);
+	}
+}
+
+static void bench_run(bench_mode_t mode, int iterations, int frag)
+{
+	int64_t messages = 0, bytes = 0, tokens = 0, errors = 0, start, elapsed;
+	int i, j, k, from, to;
+	int replies = command_stub_stats.replies, ota_starts = command_stub_stats.ota_starts;
+
+	// the command path takes both formats, the parsers their own
+	from = (mode == BENCH_CBOR) ? 1 : 0;
+	to = (mode == BENCH_JSON) ? 0 : 1;
+
+	json_set_dry_run(mode != BENCH_COMMAND);
+	start = esp_timer_get_time();
+
+	for(i = 0; i < iterations; i++)
+	{
+		for(k = from; k <= to; k++)
+		{
+			for(j = 0; j < bench_count[k]; j++)
+			{
+				if(mode == BENCH_COMMAND) bench_dispatch(&bench_corpus[k][j], frag);
+				else if(bench_feed(k, bench_corpus[k][j].data, bench_corpus[k][j].len, frag) < 0) errors++;
+
+				if(mode == BENCH_JSON) tokens += json_stream_token_count();
+				bytes += bench_corpus[k][j].len;
+				messages++;
+			}
+		}
+	}
+
+	elapsed = esp_timer_get_time() - start;
+	json_set_dry_run(0);
+	if(elapsed <= 0) elapsed = 1;
+
+	// a message the command path didn't answer is an error there
+	if(mode == BENCH_COMMAND)
+	{
+		errors = messages - (command_stub_stats.replies - replies) - (command_stub_stats.ota_starts - ota_starts);
+	}
+
+	// the line of the console bench, so host and device results compare
+	printf("{\"bench\":\"%s\",\"fragment\":%d,\"messages\":%lld,\"bytes\":%lld,\"tokens\":%lld,\"errors\":%lld,"
+			"\"us\":%lld,\"msg_per_sec\":%lld,\"ns_per_byte\":%lld,\"ns_per_token\":%lld}\n",
+			bench_names[mode], frag, (long long)messages, (long long)bytes, (long long)tokens, (long long)errors,
+			(long long)elapsed, (long long)(messages * 1000000 / elapsed), (long long)(elapsed * 1000 / (bytes ? bytes : 1)),
+			(long long)(tokens ? elapsed * 1000 / tokens : 0));
+}
+
+int main(int argc, char **argv)
+{
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+	int i, m;
+
+	if(argc < 2)
+	{
+		fprintf(stderr, "Usage : %s <corpus directory> [iterations]\n", argv[0]);
+		return 2;
+	}
+	if(argc > 2) iterations = atoi(argv[2]);
+	if(iterations <= 0 || bench_load(argv[1]) != 0)
+	{
+		fprintf(stderr, "json_bench : no message in %s, or invalid iterations\n", argv[1]);
+		return 2;
+	}
+	if(command_stub_init() != 0)
+	{
+		fprintf(stderr, "json_bench : flash file can not be made\n");
+		return 1;
+	}
+
+	for(m = BENCH_JSON; m <= BENCH_COMMAND; m++)
+	{
+		for(i = 0; i < (int)(sizeof(bench_fragments) / sizeof(bench_fragments[0])); i++)
+		{
+			bench_run(m, iterations, bench_fragments[i]);
+		}
+	}
+	return 0;
+}
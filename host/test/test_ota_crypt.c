@@ -0,0 +1,243 @@
+/**
+ * @file test_ota_crypt.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Host test : images of tools/ota_encrypt.py through ota_crypt_update/finish, CTR and GCM
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_partition.h"
+#include "nvs.h"
+#include "nvs_flash.h"
+
+#include "ota_crypt.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TEST_IMAGE_SIZE		100003		// no multiple of 16 : the last block is a partial one
+#define TEST_KEY_HEX		"603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4"
+
+#define CHECK(cond, ...) do { \
+		if(!(cond)) { \
+			printf("FAIL %s %d : ", __FILE__, __LINE__); \
+			printf(__VA_ARGS__); \
+			printf("\n"); \
+			test_failed++; \
+		} \
+	} while(0)
+
+typedef struct {
+	uint8_t *data;
+	int len;
+} test_file_t;
+
+/*---------------------------- Variables ---------------------------------*/
+// Packet sizes of the transports are anything : none of these is a multiple of the AES block
+static const int test_chunks[] = { 1, 7, 13, 100, 517, 1460 };
+
+static const char *test_python, *test_encrypt, *test_dir;
+static uint8_t test_plain[TEST_IMAGE_SIZE];
+static int test_failed;
+
+/*-------------------------- Function declares ---------------------------*/
+
+static int test_read(const char *path, test_file_t *f)
+{
+	FILE *fp = fopen(path, "rb");
+
+	if(fp == NULL) return -1;
+	fseek(fp, 0, SEEK_END);
+	f->len = ftell(fp);
+	fseek(fp, 0, SEEK_SET);
+	f->data = malloc(f->len);
+	if(f->data == NULL || fread(f->data, 1, f->len, fp) != (size_t)f->len) f->len = -1;
+	fclose(fp);
+	return f->len < 0 ? -1 : 0;
+}
+
+// tools/ota_encrypt.py on the plain image, the encryptor the release flow uses
+static int test_encrypt_file(const char *mode, test_file_t *f)
+{
+	char plain[512], enc[512], cmd[2048];
+
+	snprintf(plain, sizeof(plain), "%s/crypt_plain.bin", test_dir);
+	snprintf(enc, sizeof(enc), "%s/crypt_%s.bin", test_dir, mode);
+	snprintf(cmd, sizeof(cmd), "\"%s\" \"%s\" --key-hex %s --mode %s \"%s\" -o \"%s\" > /dev/null",
+			test_python, test_encrypt, TEST_KEY_HEX, mode, plain, enc);
+	if(system(cmd) != 0) return -1;
+	return test_read(enc, f);
+}
+
+/*******************************************
+The file in packets of chunk bytes, decrypted in place like the receive
+loops do. Returns what ota_crypt_finish() says, the plaintext in *out.
+file_size -1 : a TCP push without a size, the end is the closed socket.
+*******************************************/
+static esp_err_t test_run(const test_file_t *f, int file_size, int chunk, uint8_t *out, int *out_len)
+{
+	ota_crypt_t c;
+	uint8_t *buf = malloc(chunk), *p;
+	int off, n, len;
+	esp_err_t err = ESP_OK;
+
+	*out_len = 0;
+	if(buf == NULL) return ESP_ERR_NO_MEM;
+
+	err = ota_crypt_begin(&c, file_size);
+	for(off = 0; err == ESP_OK && off < f->len; off += n)
+	{
+		n = (f->len - off < chunk) ? f->len - off : chunk;
+		memcpy(buf, &f->data[off], n);
+		err = ota_crypt_update(&c, buf, n, &p, &len);
+		if(err != ESP_OK) break;
+
+		if(p < buf || p + len > buf + n || *out_len + len > TEST_IMAGE_SIZE)
+		{
+			err = ESP_FAIL;		// output outside the packet, or more than the image
+			break;
+		}
+		memcpy(&out[*out_len], p, len);
+		*out_len += len;
+	}
+	if(err == ESP_OK) err = ota_crypt_finish(&c);
+
+	ota_crypt_free(&c);
+	free(buf);
+	return err;
+}
+
+static void test_mode(const char *mode, int sized)
+{
+	static uint8_t out[TEST_IMAGE_SIZE];
+	test_file_t f;
+	esp_err_t err;
+	int i, len;
+
+	if(test_encrypt_file(mode, &f) != 0)
+	{
+		CHECK(0, "%s : ota_encrypt.py failed", mode);
+		return;
+	}
+
+	for(i = 0; i < (int)(sizeof(test_chunks) / sizeof(test_chunks[0])); i++)
+	{
+		memset(out, 0, sizeof(out));
+		err = test_run(&f, sized ? f.len : -1, test_chunks[i], out, &len);
+		CHECK(err == ESP_OK, "%s%s chunk %d : %s", mode, sized ? "" : " unsized", test_chunks[i], esp_err_to_name(err));
+		CHECK(len == TEST_IMAGE_SIZE && memcmp(out, test_plain, TEST_IMAGE_SIZE) == 0,
+				"%s%s chunk %d : plaintext differs (%d bytes)", mode, sized ? "" : " unsized", test_chunks[i], len);
+	}
+	free(f.data);
+}
+
+// A changed tag or ciphertext byte is refused at finish, before the image could be activated
+static void test_gcm_tampered(void)
+{
+	static uint8_t out[TEST_IMAGE_SIZE];
+	test_file_t f;
+	esp_err_t err;
+	int i, len;
+
+	if(test_encrypt_file("gcm", &f) != 0)
+	{
+		CHECK(0, "gcm : ota_encrypt.py failed");
+		return;
+	}
+
+	for(i = 0; i < (int)(sizeof(test_chunks) / sizeof(test_chunks[0])); i++)
+	{
+		f.data[f.len - 1] ^= 0x01;
+		err = test_run(&f, f.len, test_chunks[i], out, &len);
+		CHECK(err == ESP_ERR_INVALID_CRC, "gcm tag tampered, chunk %d : %s", test_chunks[i], esp_err_to_name(err));
+		f.data[f.len - 1] ^= 0x01;
+
+		f.data[OTA_CRYPT_HEAD_SIZE + 5000] ^= 0x80;
+		err = test_run(&f, f.len, test_chunks[i], out, &len);
+		CHECK(err == ESP_ERR_INVALID_CRC, "gcm ciphertext tampered, chunk %d : %s", test_chunks[i], esp_err_to_name(err));
+		f.data[OTA_CRYPT_HEAD_SIZE + 5000] ^= 0x80;
+	}
+
+	// the size says 5 bytes more than were sent : the tag is incomplete
+	err = test_run(&(test_file_t){ f.data, f.len - 5 }, f.len, 517, out, &len);
+	CHECK(err == ESP_ERR_INVALID_SIZE, "gcm truncated : %s", esp_err_to_name(err));
+
+	// GCM needs the size to tell the tag from the ciphertext
+	err = test_run(&f, -1, 517, out, &len);
+	CHECK(err != ESP_OK, "gcm without a size accepted");
+
+	err = test_run(&f, f.len, 517, out, &len);
+	CHECK(err == ESP_OK, "gcm after the tampered runs : %s", esp_err_to_name(err));
+	free(f.data);
+}
+
+static void test_plain_image(void)
+{
+	static uint8_t out[TEST_IMAGE_SIZE];
+	test_file_t f = { test_plain, TEST_IMAGE_SIZE };
+	esp_err_t err;
+	int len;
+
+	err = test_run(&f, f.len, 13, out, &len);
+	CHECK(err == ESP_OK && len == TEST_IMAGE_SIZE && memcmp(out, test_plain, TEST_IMAGE_SIZE) == 0,
+			"plain image not passed through : %s, %d bytes", esp_err_to_name(err), len);
+}
+
+static void test_setup(void)
+{
+	static const char hex[] = TEST_KEY_HEX;
+	uint8_t key[OTA_CRYPT_KEY_SIZE];
+	char path[512];
+	nvs_handle_t nvs;
+	FILE *fp;
+	int i;
+
+	// plain image : starts with 0xE9 like a .bin, the rest a fixed pseudo random pattern
+	srand(26);
+	test_plain[0] = 0xE9;
+	for(i = 1; i < TEST_IMAGE_SIZE; i++) test_plain[i] = rand() >> 7;
+
+	snprintf(path, sizeof(path), "%s/crypt_plain.bin", test_dir);
+	fp = fopen(path, "wb");
+	if(fp != NULL)
+	{
+		fwrite(test_plain, 1, TEST_IMAGE_SIZE, fp);
+		fclose(fp);
+	}
+
+	// the key where 'crypt key <64 hex>' puts it
+	snprintf(path, sizeof(path), "%s/crypt_flash.bin", test_dir);
+	remove(path);
+	ESP_ERROR_CHECK(esp_partition_host_init(path));
+	ESP_ERROR_CHECK(nvs_flash_init());
+
+	for(i = 0; i < OTA_CRYPT_KEY_SIZE; i++) sscanf(&hex[i * 2], "%2hhx", &key[i]);
+	ESP_ERROR_CHECK(nvs_open("ota_crypt", NVS_READWRITE, &nvs));
+	ESP_ERROR_CHECK(nvs_set_blob(nvs, "key", key, sizeof(key)));
+	nvs_close(nvs);
+}
+
+int main(int argc, char **argv)
+{
+	if(argc != 4)
+	{
+		fprintf(stderr, "Usage : %s <python> <tools/ota_encrypt.py> <work dir>\n", argv[0]);
+		return 2;
+	}
+	test_python = argv[1];
+	test_encrypt = argv[2];
+	test_dir = argv[3];
+
+	test_setup();
+	test_plain_image();
+	test_mode("ctr", 1);
+	test_mode("ctr", 0);
+	test_mode("gcm", 1);
+	test_gcm_tampered();
+
+	printf("test_ota_crypt : %s\n", test_failed ? "FAILED" : "OK");
+	return test_failed ? 1 : 0;
+}
@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : bench.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Console benchmarks and robustness runs
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__BENCH_H__)
+
+#define __BENCH_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_BENCH		"bench"
+#define CMD_FUZZ		"fuzz"
+#define CMD_SOAK		"soak"
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void bench_command(char **token, int token_count);
+void fuzz_command(char **token, int token_count);
+void soak_command(char **token, int token_count);
+int bench_wait(int (*cond)(void), int expect, int timeout_ms);
+int bench_feed(int cbor, const uint8_t *data, int len, int frag);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __BENCH_H__ */
@@ -0,0 +1,65 @@
+/****************************************************************************/
+//  File    : cbor.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Compact binary (CBOR, RFC 8949) control messages
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__CBOR_H__)
+
+#define __CBOR_H__
+
+#include <stdint.h>
+#include "json.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define MAX_CBOR_MESSAGE	512
+
+#define CBOR_MAJOR_UINT		0
+#define CBOR_MAJOR_NINT		1
+#define CBOR_MAJOR_BYTES	2
+#define CBOR_MAJOR_TEXT		3
+#define CBOR_MAJOR_ARRAY	4
+#define CBOR_MAJOR_MAP		5
+
+// Definite length map header : first byte of every CBOR control message
+#define CBOR_IS_MAP_START(b)	(((b) & 0xE0) == 0xA0 && ((b) & 0x1F) <= 26)
+
+typedef struct {
+	json_sink_t sink;	// same sink as the JSON writer (BLE notify stream, memory...)
+	void *ctx;
+	int total;			// bytes written so far
+	int err;
+} cbor_writer_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void cbor_writer_init(cbor_writer_t *w, json_sink_t sink, void *ctx);
+void cbor_map(cbor_writer_t *w, int count);
+void cbor_array(cbor_writer_t *w, int count);
+void cbor_text(cbor_writer_t *w, const char *str);
+void cbor_bytes(cbor_writer_t *w, const uint8_t *data, int len);
+void cbor_int(cbor_writer_t *w, int num);
+
+int cbor_stream_busy(void);
+void cbor_stream_reset(void);
+int cbor_stream_feed(const uint8_t *data, int len);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __CBOR_H__ */
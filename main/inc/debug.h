@@ -86,6 +86,8 @@ void InitDebug(void);
 void PrintTcp(const char *format, ...);
 void PrintConsole(const char *format, ...);
 void CommandProcess(char *cmd_str);
+void CommandProcessJson(const char *data, int len);
+void CommandProcessCbor(const uint8_t *data, int len);
 void CloseTelnetConnection(void);
 char *get_version_string(void);
 char *get_my_ip(void);
@@ -0,0 +1,80 @@
+/****************************************************************************/
+//  File    : heap_tag.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Heap accounting per subsystem
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__HEAP_TAG_H__)
+
+#define __HEAP_TAG_H__
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_HEAP			"heap"
+
+#define HEAP_TAG_MAX_TASKS	24	// task -> tag cache
+#define HEAP_TAG_MAX_WATCH	2	// zero allocation watches running at the same time
+
+// Allocations are tagged by the allocating task, or by heap_tag_push() around a call
+#define HEAP_TAG_TABLE(X) \
+	X(HEAP_TAG_OTHER,	"other") \
+	X(HEAP_TAG_BLE,		"ble") \
+	X(HEAP_TAG_OTA,		"ota") \
+	X(HEAP_TAG_CONSOLE,	"console") \
+	X(HEAP_TAG_JSON,	"json") \
+	X(HEAP_TAG_WIFI,	"wifi")
+
+#define HEAP_TAG_ENUM(id, name)	id,
+enum {
+	HEAP_TAG_TABLE(HEAP_TAG_ENUM)
+	HEAP_TAG_COUNT
+};
+#undef HEAP_TAG_ENUM
+
+typedef struct {
+	uint32_t allocs;
+	uint32_t frees;		// by a task of the tag, not necessarily its own blocks
+	uint32_t failed;
+	uint32_t bytes;		// total requested
+	uint32_t max_size;	// largest single allocation
+} heap_tag_stats_t;
+
+// Counts the heap allocations of one task between heap_watch_begin() and heap_watch_end()
+typedef struct {
+	TaskHandle_t task;
+	volatile uint32_t allocs;
+	volatile uint32_t bytes;
+} heap_watch_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void heap_tag_init(void);
+int heap_tag_push(int tag);
+void heap_tag_pop(int prev);
+void heap_tag_stats_get(int tag, heap_tag_stats_t *stats);
+void heap_watch_begin(heap_watch_t *w);
+uint32_t heap_watch_end(heap_watch_t *w);
+void heap_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __HEAP_TAG_H__ */
@@ -0,0 +1,83 @@
+/****************************************************************************/
+//  File    : json.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Streaming JSON writer
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__JSON_H__)
+
+#define __JSON_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define JSON_WRITER_MAX_DEPTH	8
+
+// Output sink : receives the document piece by piece, returns 0 on success
+typedef int (*json_sink_t)(void *ctx, const void *data, int len);
+
+typedef struct {
+	json_sink_t sink;
+	void *ctx;
+	int pretty;			// "\n\t" indentation, same layout as the original responses
+	int depth;
+	uint32_t has_item;	// bit per depth : an item was already written at this level
+	uint32_t is_array;	// bit per depth : the container at this level is an array
+	int total;			// bytes written so far
+	int err;
+} json_writer_t;
+
+// Value types of the control key schema
+enum {
+	JSON_TYPE_INT,
+	JSON_TYPE_STRING,
+	JSON_TYPE_ARRAY,	// array of strings, handler is called once per element
+};
+
+typedef struct {
+	int type;
+	const char *str;	// string value or array element, not null terminated
+	int len;
+	int num;			// JSON_TYPE_INT only
+	int index;			// JSON_TYPE_ARRAY : element index / element count
+	int count;
+} json_value_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void json_writer_init(json_writer_t *w, json_sink_t sink, void *ctx, int pretty);
+void json_begin_object(json_writer_t *w);
+void json_end_object(json_writer_t *w);
+void json_begin_array(json_writer_t *w);
+void json_end_array(json_writer_t *w);
+void json_key(json_writer_t *w, const char *key);
+void json_value_str(json_writer_t *w, const char *str);
+void json_value_int(json_writer_t *w, int num);
+int json_writer_end(json_writer_t *w);
+
+void json_command_begin(void);
+int json_command_lookup(const char *key, int len, int *type);
+void json_command_value(int id, const json_value_t *value);
+int json_command_end(void);
+int json_stream_token_count(void);
+void json_set_dry_run(int on);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __JSON_H__ */
@@ -0,0 +1,77 @@
+/****************************************************************************/
+//  File    : msg_queue.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             FreeRTOS message queue with depth and wait time statistics
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__MSG_QUEUE_H__)
+
+#define __MSG_QUEUE_H__
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/queue.h"
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_QUEUE			"queue"
+
+#define MSG_QUEUE_MAX		4
+#define MSG_QUEUE_WAIT_BINS	16	// log2 of the wait time : < 16 us, < 32 us, ... < 256 ms, >= 256 ms
+#define MSG_QUEUE_DEPTH_BINS	17	// items already queued when sending : 0 .. 15, >= 16
+
+// Counters are not locked : with two senders on one queue they can be off by a few
+typedef struct {
+	uint32_t sent;
+	uint32_t received;
+	uint32_t timeouts;		// send timed out, the item was dropped
+	int max_depth;			// peak items in the queue, including the one just sent
+	uint64_t copy_bytes;	// items are copied by value, once on send and once on receive
+	int64_t send_wait_us;	// total time blocked in send
+	int64_t send_max_us;
+	int64_t recv_max_us;
+	uint32_t send_hist[MSG_QUEUE_WAIT_BINS];
+	uint32_t recv_hist[MSG_QUEUE_WAIT_BINS];	// includes the time the consumer was idle
+	uint32_t depth_hist[MSG_QUEUE_DEPTH_BINS];
+} msg_queue_stats_t;
+
+typedef struct {
+	const char *name;
+	QueueHandle_t handle;
+	int length;
+	int item_size;
+	msg_queue_stats_t stats;
+} msg_queue_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t msg_queue_create(msg_queue_t *q, const char *name, int length, int item_size);
+BaseType_t msg_queue_send(msg_queue_t *q, const void *item, TickType_t wait);
+BaseType_t msg_queue_receive(msg_queue_t *q, void *item, TickType_t wait);
+msg_queue_t *msg_queue_find(const char *name);
+msg_queue_t *msg_queue_get(int index);
+int msg_queue_count(void);
+uint32_t msg_queue_summary_gen(void);
+void msg_queue_stats_get(msg_queue_t *q, msg_queue_stats_t *stats);
+void msg_queue_stats_reset(msg_queue_t *q);
+void msg_queue_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __MSG_QUEUE_H__ */
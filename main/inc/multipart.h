@@ -0,0 +1,69 @@
+/****************************************************************************/
+//  File    : multipart.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Streaming multipart/form-data scanner
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__MULTIPART_H__)
+
+#define __MULTIPART_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define MULTIPART_BOUNDARY_MAX	70		// RFC 2046
+#define MULTIPART_DELIM_MAX		(4 + MULTIPART_BOUNDARY_MAX)	// CRLF "--" boundary
+
+#define MULTIPART_PREAMBLE		0
+#define MULTIPART_DELIM_TAIL	1		// "--" : last part, CRLF : part headers follow
+#define MULTIPART_HEADERS		2
+#define MULTIPART_DATA			3
+#define MULTIPART_DONE			4
+
+// Body bytes of the file part, in place in the caller's buffer (may be modified, e.g. decrypted)
+typedef esp_err_t (*multipart_sink_t)(void *ctx, uint8_t *data, int len);
+
+typedef struct {
+	char delim[MULTIPART_DELIM_MAX];
+	int delim_len;
+	int state;
+	int match;			// delimiter bytes matched, the ones of earlier buffers are held back
+	int held;
+	int head_match;		// CRLF CRLF at the end of the part headers
+	int name_match;		// "filename=" in the part headers
+	int tail_len;
+	char tail[2];
+	int file;			// current part is the file
+	int files;			// file parts seen
+	int data_len;		// bytes given to the sink
+	uint8_t scratch[MULTIPART_DELIM_MAX];	// held bytes that turned out to be data
+	multipart_sink_t sink;
+	void *ctx;
+} multipart_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t multipart_begin(multipart_t *m, const char *content_type, multipart_sink_t sink, void *ctx);
+esp_err_t multipart_feed(multipart_t *m, uint8_t *data, int len);
+int multipart_done(const multipart_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __MULTIPART_H__ */
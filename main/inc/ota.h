@@ -5,22 +5,50 @@
 /*---------------------------- User define -------------------------------*/
 #define ENABLE_BLE_OTA	1
 #define ENABLE_WIFI_OTA	1
+#define ENABLE_HTTP_OTA	1	// browser / curl upload, ota_http.c
 
 #define WIFI_HTTP_OTA	1
 #define WIFI_TCP_OTA	2
 
 #define WIFI_OTA_TYPE	WIFI_TCP_OTA
 
+#define OTA_SERVER_PORT	12222
+
 #define MAX_FIRMWARE_SIZE	0x130000
 
 #define NUMBER_OF_BLE_MSG_QUEUE	5
 #define QUEUE_DATA_SIZE	512
 
+#define JSON_STREAM_INCOMPLETE	3	// json_stream_feed() : root object not closed yet
+
 typedef struct {
 	int len;
 	uint8_t data[QUEUE_DATA_SIZE];
 } BLE_MSG_st;
 
+// Control message encoding, follows the last request received on the connection
+#define MSG_FORMAT_JSON	0
+#define MSG_FORMAT_CBOR	1
+
+#define BLE_TX_CHUNK_MAX	256	// CONFIG_BT_NIMBLE_ATT_PREFERRED_MTU
+
+// Streaming notify : data is cut into MTU sized notifications as it is written
+typedef struct {
+	uint8_t chunk[BLE_TX_CHUNK_MAX];
+	int len;
+	int mtu;
+	int total;
+	esp_err_t err;
+} ble_tx_stream_t;
+
+// Advertising mode, ble_adv_set_mode()
+#define BLE_ADV_NORMAL	0
+#define BLE_ADV_SLOW	1	// 1 ~ 1.25 s interval
+#define BLE_ADV_OFF		2
+
+// BLE link simulation (bench ble, soak ble), CONFIG_OTA_BLE_SIM builds : mbufs per simulated GATT write
+#define BLE_SIM_MAX_MBUFS	4
+
 /*---------------------------- Variables ---------------------------------*/
 
 /*-------------------------- Function declares ---------------------------*/
@@ -29,17 +57,35 @@ void bt_ble_init(void);
 void print_le_status(void);
 int is_ble_connected(void);
 uint8_t *ble_get_mac_address(void);
+void ble_adv_set_mode(int mode);
+int ble_adv_get_mode(void);
 
 esp_err_t _nordic_uart_send( uint8_t *message, int len);
+int ble_get_msg_format(void);
+void ble_tx_begin(ble_tx_stream_t *tx);
+int ble_tx_write(void *ctx, const void *data, int len);
+esp_err_t ble_tx_end(ble_tx_stream_t *tx);
+esp_err_t ble_sim_write(const uint8_t *data, int len, int mbuf_size);
+void ble_sim_disconnect(void);
 int get_ota_file_size(void);
 int is_ota_ready(void);
+int is_ota_staged(void);
+void set_ota_rejected(void);
 void clear_ota_state(void);
 
 void give_ota_semaphore(void);
 void send_ota_data(uint8_t *data, int len);
-int json_parsing(char *json_string);
+int is_ota_receiving(void);
+int is_ota_draining(void);
+int json_parsing(char *json_string, int len);
+int json_stream_busy(void);
+void json_stream_begin(void);
+void json_stream_reset(void);
+int json_stream_feed(const char *data, int len);
 void test_mode_off(void);
 void send_json_info(void);
+void send_cbor_info(void);
+void send_status_info(void);
 void send_json_working_state(void);
 void send_json_light_onoff(void);
 void send_json_test_mode_off(void);
@@ -0,0 +1,82 @@
+/****************************************************************************/
+//  File    : ota_crypt.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Streaming decryption of pre-encrypted OTA images
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_CRYPT_H__)
+
+#define __OTA_CRYPT_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_CRYPT			"crypt"
+
+// Encrypted image (tools/ota_encrypt.py) :
+// "OTAE", mode, 3 reserved, 16 byte IV (CTR : initial counter block, GCM : 12 byte IV + 4 zero),
+// AES-256 ciphertext of the .bin file, GCM : 16 byte tag. The 24 byte head is the GCM AAD.
+// The first byte decides : 'O' encrypted, anything else (0xE9) plain image.
+#define OTA_CRYPT_MAGIC		"OTAE"
+#define OTA_CRYPT_HEAD_SIZE	24
+#define OTA_CRYPT_TAG_SIZE	16
+#define OTA_CRYPT_KEY_SIZE	32
+
+#define OTA_CRYPT_HEAD		-1		// 'O' seen, head not complete yet
+#define OTA_CRYPT_PLAIN		0
+#define OTA_CRYPT_CTR		1
+#define OTA_CRYPT_GCM		2
+
+// eFuse key block (0 ~ 5) burnt with an HMAC_UP key : image key = HMAC-SHA256(block, "ota image key").
+// -1 : image key in NVS, set with 'crypt key <64 hex>'
+#define OTA_CRYPT_HMAC_KEY	-1
+
+typedef struct {
+	int mode;
+	int in;				// bytes of the transferred file so far
+	int payload;		// ciphertext bytes, -1 : until the transport closes (CTR)
+	int decrypted;
+	uint8_t head[OTA_CRYPT_HEAD_SIZE];
+	int head_len;
+	uint8_t tag[OTA_CRYPT_TAG_SIZE];
+	int tag_len;
+	uint8_t key[OTA_CRYPT_KEY_SIZE];
+	int key_set;
+	mbedtls_aes_context aes;
+	mbedtls_gcm_context gcm;
+	uint8_t counter[16];
+	uint8_t stream[16];
+	size_t stream_off;
+} ota_crypt_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t ota_crypt_begin(ota_crypt_t *c, int file_size);
+esp_err_t ota_crypt_update(ota_crypt_t *c, uint8_t *data, int len, uint8_t **out, int *out_len);
+esp_err_t ota_crypt_finish(ota_crypt_t *c);
+void ota_crypt_free(ota_crypt_t *c);
+int ota_crypt_required(void);
+void ota_crypt_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_CRYPT_H__ */
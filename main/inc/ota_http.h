@@ -0,0 +1,44 @@
+/****************************************************************************/
+//  File    : ota_http.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             HTTP upload of OTA images (browser form or curl) and status page
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_HTTP_H__)
+
+#define __OTA_HTTP_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define OTA_HTTP_PORT			80
+#define OTA_HTTP_URI_UPDATE		"/update"	// POST : raw image body or multipart/form-data
+
+#define OTA_HTTP_RECV_SIZE		1024	// same receive size as the TCP transport
+#define OTA_HTTP_RECV_TIMEOUT	10		// s, per httpd_req_recv()
+#define OTA_HTTP_RECV_RETRY		3		// timeouts in a row before the upload is dropped
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t ota_http_start(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_HTTP_H__ */
@@ -0,0 +1,75 @@
+/****************************************************************************/
+//  File    : ota_manifest.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Chunk manifest of an OTA image : one SHA-256 per chunk, Merkle root
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_MANIFEST_H__)
+
+#define __OTA_MANIFEST_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "ota_stage.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define OTA_MANIFEST_MAGIC		"OTAM"
+#define OTA_CHUNK_SIZE			4096	// one flash sector : a chunk is erased and programmed on its own
+
+// TCP handshake : "otm" + manifest head + chunk_count leaf hashes instead of "ota".
+// Reply "ACK" + bitmap of the chunks still needed (bit set : send it), then per chunk
+// [index LE 32][len LE 32][data] from the client in any order, "A"/"N" + index (LE 32) from the device.
+// "N" : hash mismatch, send the chunk again. "END" / "ERR" once every chunk is in, then the restart.
+// Plain images only, the manifest mode is refused with 'crypt require on'.
+#define OTA_MANIFEST_CMD		"otm"
+
+// Merkle tree over the leaves : node = SHA-256(left | right), an odd last node goes up unchanged.
+// The root is sent by the client with the chunks, nothing authenticates it : it detects
+// corruption in transit and resumes from intact chunks, it is no protection against tampering.
+typedef struct {
+	char magic[4];
+	uint32_t image_len;
+	uint32_t chunk_size;
+	uint32_t chunk_count;
+	uint8_t root[OTA_HASH_SIZE];
+} ota_manifest_head_t;		// 48 bytes, little endian on the wire
+
+typedef struct {
+	ota_manifest_head_t head;
+	uint8_t *leaf;		// chunk_count x SHA-256 of the chunk
+	uint8_t *done;		// bitmap of the chunks written and verified
+	int done_count;
+} ota_manifest_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t ota_manifest_init(ota_manifest_t *m, const ota_manifest_head_t *head);
+esp_err_t ota_manifest_verify(const ota_manifest_t *m);
+void ota_manifest_free(ota_manifest_t *m);
+int ota_manifest_chunk_len(const ota_manifest_t *m, int index);
+int ota_manifest_check(const ota_manifest_t *m, int index, const void *data, int len);
+int ota_manifest_check_hash(const ota_manifest_t *m, int index, const uint8_t *sha256);
+int ota_manifest_is_done(const ota_manifest_t *m, int index);
+void ota_manifest_set_done(ota_manifest_t *m, int index);
+int ota_manifest_complete(const ota_manifest_t *m);
+int ota_manifest_bitmap_len(const ota_manifest_t *m);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_MANIFEST_H__ */
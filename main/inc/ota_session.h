@@ -0,0 +1,156 @@
+/****************************************************************************/
+//  File    : ota_session.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             OTA session shared by the TCP and BLE transports
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_SESSION_H__)
+
+#define __OTA_SESSION_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "heap_tag.h"
+#include "ota_manifest.h"
+#include "ota_crypt.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_OTA		"ota"
+
+#define OTA_SECTOR_SIZE		4096
+
+// Working memory of a session (transport receive buffer, sector buffer of the skip mode, decryption,
+// backend state), allocated once at begin and freed at the end so the transfer loop itself never touches the heap
+#define OTA_BACKEND_CTX_MAX		64
+#define OTA_SESSION_ARENA_SIZE	(2048 + OTA_SECTOR_SIZE + sizeof(ota_crypt_t) + OTA_BACKEND_CTX_MAX)
+
+// Sliced writer : every flash operation is one sector erase or a program of at most the slice size,
+// the radio tasks run between two of them. The slice adapts to keep each stall under the target.
+#define OTA_SLICE_DEFAULT		1024
+#define OTA_SLICE_MIN			256		// one flash page
+#define OTA_SLICE_MAX			4096
+#define OTA_STALL_TARGET_US		7500	// half of the 15 ms BLE connection interval
+
+// Where the received image goes : the OTA flash partition, nowhere (profiling the receive path),
+// or nowhere with simulated flash erase/program time (sim).
+// ctx is the per session state of the backend, ctx_size bytes of the session arena.
+typedef struct {
+	const char *name;
+	int ctx_size;
+	esp_err_t (*begin)(void *ctx, int image_size, int *sliced);	// sliced in : wanted, out : accepted
+	esp_err_t (*write)(void *ctx, const void *data, int len);
+	esp_err_t (*erase)(void *ctx, int offset, int len);			// sliced writer, NULL : write() only
+	esp_err_t (*program)(void *ctx, int offset, const void *data, int len);
+	int (*same)(void *ctx, int offset, const void *data, int len);	// 1 : already in flash, taken as programmed
+	esp_err_t (*hash)(void *ctx, int offset, int len, uint8_t *sha256);	// manifest resume, NULL : none
+	esp_err_t (*end)(void *ctx);
+	esp_err_t (*activate)(void *ctx);	// select the new image for the next boot
+	void (*abort)(void *ctx);
+	int restart;						// reboot into the new image after activate
+	int image;							// receives ESP app images : header checked as the first bytes arrive
+	int slot;							// writes the update slot : one session at a time
+} ota_backend_t;
+
+typedef struct {
+	int slices;			// flash operations
+	int erases;
+	int yields;			// tick given away after a slice over the target
+	int max_stall_us;	// worst single operation
+	int max_erase_us;
+	int max_program_us;
+	int64_t stall_us;	// time spent in flash operations
+	int slice;			// program slice size at the end
+	int skipped;		// sectors already identical in flash, neither erased nor programmed
+	int compared;		// sectors compared
+	int resumed;		// manifest chunks already in the slot at begin
+	int bad_chunks;		// manifest chunks with a wrong hash, requested again
+} ota_slice_stats_t;
+
+typedef struct {
+	const ota_backend_t *backend;
+	void *ctx;
+	int size;			// expected image size, 0 : until the transport closes
+	int received;
+	int64_t start_us;
+	int64_t begin_us;	// time spent in backend begin (esp_ota_begin erases the partition)
+	esp_err_t err;
+	uint8_t *arena;
+	int arena_used;
+	heap_watch_t watch;	// heap allocations of the transfer loop, expected 0
+	int sliced;
+	int erased;			// sliced writer : bytes erased so far
+	uint8_t *sector;	// skip mode : incoming sector, compared with the flash when complete
+	int sector_len;
+	uint8_t *head;		// image header and app description, checked once complete
+	int head_len;
+	int rejected;		// image refused on its header or size, before it was written
+	int skip;			// identical sectors are not written
+	ota_manifest_t *manifest;	// chunks in any order, each verified before it is written
+	uint8_t *chunk;		// manifest mode : chunk buffer of the transport
+	ota_crypt_t *crypt;	// encrypted image : decrypted in place in the transport buffer
+	int defer_restart;	// the transport answers its client first, then ota_stage_restart()
+	ota_slice_stats_t slice;
+} ota_session_t;
+
+// Synthetic image of the sim backend
+#define OTA_SIM_MAGIC		"ESIM"
+#define OTA_SIM_IMAGE_MIN	12		// magic, size, CRC
+
+typedef struct {
+	int begun;
+	int activated;
+	int rejected;		// image verification failed at the end
+	int aborted;
+	uint32_t crc;		// CRC32 of the last activated image
+	int size;
+} ota_sim_stats_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+// ESP_ERR_INVALID_STATE : another session is writing the update slot
+esp_err_t ota_session_begin(ota_session_t *s, int image_size);
+esp_err_t ota_session_start(ota_session_t *s, const ota_backend_t *backend, int image_size);
+void *ota_session_alloc(ota_session_t *s, int size);
+esp_err_t ota_session_write(ota_session_t *s, void *data, int len);
+esp_err_t ota_session_set_manifest(ota_session_t *s, ota_manifest_t *m);
+esp_err_t ota_session_write_chunk(ota_session_t *s, int index, const void *data, int len);
+int ota_session_complete(const ota_session_t *s);
+// On failure the session is cleaned up already, ota_session_abort() is a no-op after finish
+esp_err_t ota_session_finish(ota_session_t *s);
+void ota_session_abort(ota_session_t *s);
+int ota_session_busy(void);
+int ota_session_ended(void);
+void ota_session_hold_restart(int hold);
+int ota_session_restarts(const ota_session_t *s);
+
+const ota_backend_t *ota_get_backend(void);
+const ota_backend_t *ota_find_backend(const char *name);
+int ota_set_backend(const char *name);
+void ota_sim_set_latency(int erase_us, int page_us);
+void ota_sim_get_latency(int *erase_us, int *page_us);
+void ota_sim_image_read(int size, int offset, uint8_t *buf, int len);
+uint32_t ota_sim_image_crc(int size);
+void ota_sim_stats_get(ota_sim_stats_t *stats);
+void ota_sim_stats_reset(void);
+void ota_slice_stats_get(ota_slice_stats_t *stats);
+void ota_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_SESSION_H__ */
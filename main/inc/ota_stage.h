@@ -0,0 +1,60 @@
+/****************************************************************************/
+//  File    : ota_stage.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Fingerprints of the images already in the app partitions
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_STAGE_H__)
+
+#define __OTA_STAGE_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_partition.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_STAGE			"stage"
+
+#define OTA_HASH_SIZE		32		// SHA-256 of the .bin file, as sent by the client
+
+// TCP handshake : "ots" + image size (LE 32) + SHA-256 instead of "ota".
+// Reply "STG" when the image is already in a slot and selected for boot, "ACK" for a normal transfer.
+#define OTA_STAGE_CMD		"ots"
+#define OTA_STAGE_CMD_LEN	(3 + 4 + OTA_HASH_SIZE)
+
+// Persisted per partition label in NVS, valid until the partition is written again
+typedef struct {
+	uint32_t image_len;		// verified image length, 0 : no valid image
+	uint8_t sha256[OTA_HASH_SIZE];
+} ota_fingerprint_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t ota_stage_fingerprint(const esp_partition_t *part, ota_fingerprint_t *fp);
+void ota_stage_invalidate(const esp_partition_t *part);
+const esp_partition_t *ota_stage_find(const uint8_t *sha256, int size);
+const esp_partition_t *ota_stage_other(void);
+esp_err_t ota_stage_boot(const esp_partition_t *part);
+void ota_stage_restart(void);
+int ota_stage_hex(const char *hex, int len, uint8_t *sha256);
+void ota_stage_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_STAGE_H__ */
@@ -0,0 +1,65 @@
+/****************************************************************************/
+//  File    : ota_tls.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             TLS transport of the TCP OTA, session ticket resumption
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_TLS_H__)
+
+#define __OTA_TLS_H__
+
+#include <stdint.h>
+#include "esp_err.h"
+#include "esp_tls.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_TLS				"tls"
+
+// TLS listener next to the plain OTA_SERVER_PORT, opened only when a certificate is provisioned.
+// NVS namespace "ota_tls" : "cert" and "key" (PEM)
+#define OTA_TLS_PORT		12223
+#define OTA_TLS_RECV_TIMEOUT	10		// s, handshake and every read : a silent client frees the task
+
+// Plain socket or TLS session on it : the TCP OTA code reads and writes through this
+typedef struct {
+	int sock;
+	esp_tls_t *tls;		// NULL : plain TCP
+} ota_link_t;
+
+typedef struct {
+	int count;
+	int last_ms;
+	int min_ms;
+	int max_ms;
+	int failed;
+} ota_tls_stats_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+esp_err_t ota_tls_server_init(void);
+int ota_tls_listen(int port);
+esp_err_t ota_link_accept_tls(ota_link_t *link, int sock);
+int ota_link_recv(ota_link_t *link, void *buf, int len, int all);
+int ota_link_send(ota_link_t *link, const void *buf, int len);
+void ota_link_close(ota_link_t *link);
+void ota_tls_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_TLS_H__ */
@@ -0,0 +1,50 @@
+/****************************************************************************/
+//  File    : ota_turbo.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             System reconfiguration while an OTA session is running
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__OTA_TURBO_H__)
+
+#define __OTA_TURBO_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_TURBO			"turbo"
+
+// Transport of the session, decides the coexistence preference and the advertising mode
+#define OTA_TURBO_TCP		0
+#define OTA_TURBO_BLE		1
+
+#define OTA_TURBO_CPU_MAX_MHZ	240
+#define OTA_TURBO_CPU_MIN_MHZ	160		// CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ, outside of OTA
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void ota_turbo_init(void);
+void ota_turbo_begin(int transport);
+void ota_turbo_end(void);
+int ota_turbo_enabled(void);
+int ota_turbo_active(void);
+void ota_turbo_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __OTA_TURBO_H__ */
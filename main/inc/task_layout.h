@@ -0,0 +1,84 @@
+/****************************************************************************/
+//  File    : task_layout.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Core, priority and stack of the application tasks
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__TASK_LAYOUT_H__)
+
+#define __TASK_LAYOUT_H__
+
+#include <stdint.h>
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define CMD_TASK			"task"
+
+#define TASK_CORE_ANY		tskNO_AFFINITY
+#define TASK_CORE_RADIO		0	// NimBLE host, BT controller, Wi-Fi, lwIP (sdkconfig)
+#define TASK_CORE_WRITER	1	// OTA flash writers, away from the radio stacks
+
+#define TASK_LEGACY_PRIORITY	5	// every task when the plan is off
+
+// id, name, stack, core, priority, priority while an OTA session is running, suspended by OTA turbo
+// The core is fixed at creation, only the priority follows the OTA profile.
+#define TASK_LAYOUT_TABLE(X) \
+	X(TASK_BLE_RX,			"BLE-Rx",		8192,	TASK_CORE_RADIO,	5,	5,	0) \
+	X(TASK_BLE_OTA,			"BLEOTA",		4096,	TASK_CORE_WRITER,	5,	7,	0) \
+	X(TASK_TCP_OTA,			"TCPOTA",		4096,	TASK_CORE_WRITER,	5,	7,	0) \
+	X(TASK_BROADCAST,		"Broadcast",	4096,	TASK_CORE_ANY,		5,	2,	1) \
+	X(TASK_UART_CONSOLE,	"UART console",	4096,	TASK_CORE_ANY,		5,	3,	0) \
+	X(TASK_TCP_CONSOLE,		"TCP console",	4096,	TASK_CORE_ANY,		5,	3,	0) \
+	X(TASK_TOP,				"top",			4096,	TASK_CORE_ANY,		5,	3,	0) \
+	X(TASK_BENCH_OTA,		"BenchOta",		4096,	TASK_CORE_ANY,		5,	5,	0) \
+	X(TASK_HTTP_OTA,		"httpd",		6144,	TASK_CORE_WRITER,	5,	7,	0)
+
+#define TASK_LAYOUT_ENUM(id, name, stack, core, prio, ota_prio, ota_pause)	id,
+enum {
+	TASK_LAYOUT_TABLE(TASK_LAYOUT_ENUM)
+	TASK_LAYOUT_COUNT
+};
+#undef TASK_LAYOUT_ENUM
+
+typedef struct {
+	const char *name;
+	uint32_t stack;
+	BaseType_t core;
+	UBaseType_t priority;
+	UBaseType_t ota_priority;
+	uint8_t ota_pause;
+} task_layout_t;
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void task_layout_init(void);
+int task_layout_plan(void);
+BaseType_t task_create(int id, TaskFunction_t fn, void *arg, TaskHandle_t *handle);
+void task_exit(int id);
+const task_layout_t *task_layout_get(int id);
+void task_layout_adopt(int id, TaskHandle_t handle);
+void task_layout_ota_begin(void);
+void task_layout_ota_end(void);
+void task_layout_pause(int pause);
+void task_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __TASK_LAYOUT_H__ */
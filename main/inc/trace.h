@@ -0,0 +1,85 @@
+/****************************************************************************/
+//  File    : trace.h
+//---------------------------------------------------------------------------
+//  Scope   :
+//  Description:
+//             Binary event trace of the OTA and BLE hot paths
+//
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#if !defined (__TRACE_H__)
+
+#define __TRACE_H__
+
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define ENABLE_TRACE		1
+#define TRACE_RING_SIZE		1024	// events, power of 2 (12 bytes each)
+
+#define CMD_TRACE			"trace"
+
+// id, lane, name, phase (B : span begin, E : span end, i : instant)
+// Spans of one lane are emitted by one task at a time, so they nest on the host
+#define TRACE_EVENT_TABLE(X) \
+	X(TRACE_TCP_RECV_B,		"tcp_ota",	"recv",				'B') \
+	X(TRACE_TCP_RECV_E,		"tcp_ota",	"recv",				'E') \
+	X(TRACE_BLE_OTA_WAIT_B,	"ble_ota",	"queue_receive",	'B') \
+	X(TRACE_BLE_OTA_WAIT_E,	"ble_ota",	"queue_receive",	'E') \
+	X(TRACE_OTA_BEGIN_B,	"flash",	"ota_begin",		'B') \
+	X(TRACE_OTA_BEGIN_E,	"flash",	"ota_begin",		'E') \
+	X(TRACE_OTA_WRITE_B,	"flash",	"ota_write",		'B') \
+	X(TRACE_OTA_WRITE_E,	"flash",	"ota_write",		'E') \
+	X(TRACE_OTA_FINISH_B,	"flash",	"ota_finish",		'B') \
+	X(TRACE_OTA_FINISH_E,	"flash",	"ota_finish",		'E') \
+	X(TRACE_BLE_RX,			"ble_rx",	"gatt_write",		'i') \
+	X(TRACE_OTA_QUEUE_B,	"ble_rx",	"queue_send",		'B') \
+	X(TRACE_OTA_QUEUE_E,	"ble_rx",	"queue_send",		'E') \
+	X(TRACE_BLE_NOTIFY_B,	"ble_tx",	"notify",			'B') \
+	X(TRACE_BLE_NOTIFY_E,	"ble_tx",	"notify",			'E') \
+	X(TRACE_BLE_NOTIFY_RETRY, "ble_tx",	"notify_enomem",	'i') \
+	X(TRACE_HTTP_RECV_B,	"http_ota",	"recv",				'B') \
+	X(TRACE_HTTP_RECV_E,	"http_ota",	"recv",				'E')
+
+#define TRACE_ENUM(id, lane, name, phase)	id,
+enum {
+	TRACE_EVENT_TABLE(TRACE_ENUM)
+	TRACE_EVENT_COUNT
+};
+
+typedef struct {
+	uint32_t cycles;	// CPU cycle counter of the core, wraps every 2^32 cycles
+	uint8_t id;
+	uint8_t core;
+	uint16_t reserved;
+	uint32_t arg;
+} trace_event_t;
+
+#if (ENABLE_TRACE)
+extern volatile int trace_on;
+#define TRACE(id, arg)	do { if(trace_on) trace_record((id), (uint32_t)(arg)); } while(0)
+#else
+#define TRACE(id, arg)	do { } while(0)
+#endif
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+void trace_record(uint8_t id, uint32_t arg);
+void trace_command(char **token, int token_count);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif  /* End_of __TRACE_H__ */
@@ -8,5 +8,6 @@
 char *get_my_ip(void);
 void wifi_init_sta(void);
 void wifi_init_softap(void);
+void eth_init_openeth(void);
 
 #endif  // #if !defined (__WIFI_H__)
\ No newline at end of file
@@ -0,0 +1,582 @@
+/**
+ * @file bench.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Console benchmarks and robustness runs of the control message path
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "freertos/semphr.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_rom_sys.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "json.h"
+#include "cbor.h"
+#include "ota_session.h"
+#include "msg_queue.h"
+#include "task_layout.h"
+#include "ota_turbo.h"
+#include "bench.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "BENCH"
+
+#define BENCH_DEFAULT_ITERATIONS	1000
+#define BENCH_DEFAULT_FRAGMENT		20		// default BLE MTU payload
+#define FUZZ_DEFAULT_ITERATIONS		10000
+#define FUZZ_MAX_MESSAGE			256
+#define BENCH_OTA_DEFAULT_KB		64
+#define BENCH_OTA_DEFAULT_CHUNK		244		// ATT MTU 247 - 3
+
+#define BENCH_BLE_DEFAULT_MTU		247
+#define BENCH_BLE_MAX_MTU			515		// 512 byte attribute + 3 byte ATT header
+#define BENCH_BLE_DEFAULT_INTERVAL	15		// ms, itvl 12 x 1.25 ms requested on connect
+#define BENCH_BLE_DEFAULT_PACKETS	4		// writes per connection event
+#define BENCH_BLE_MBUF_SIZE			256		// msys block payload, longer writes become chains
+#define BENCH_BLE_TIMEOUT			30000	// ms
+
+typedef struct {
+	const uint8_t *data;
+	int len;
+} bench_msg_t;
+
+#define BENCH_MSG(s)	{ (const uint8_t *)(s), sizeof(s) - 1 }
+
+typedef struct {
+	int size;
+	int chunk;
+	int jitter_us;		// random delay 0..jitter_us before each chunk
+	QueueHandle_t queue;
+	SemaphoreHandle_t done;
+} bench_ota_t;
+
+/*---------------------------- Variables ---------------------------------*/
+// Control messages as sent by the gateway and the phone app
+static const bench_msg_t json_corpus[] = {
+	BENCH_MSG("{\"ota\":\"start\",\"ota size\":1048576}\x04"),
+	BENCH_MSG("{\n\t\"ota size\":\"524288\",\n\t\"ota\":\"start\"\n}\x04"),
+	BENCH_MSG("{\"datetime\":\"2024-06-19 10:20:30\"}\x04"),
+	BENCH_MSG("{\"groups\":[\"living\",\"kitchen\",\"room1\",\"room2\"]}\x04"),
+	BENCH_MSG("{\"status\":1,\"groups\":[],\"extra\":{\"a\":[1,2,{\"b\":\"}\"}]}}\x04"),
+	BENCH_MSG("{}\x04"),
+};
+
+static const bench_msg_t cbor_corpus[] = {
+	// {"ota":"start","ota size":1048576}
+	BENCH_MSG("\xA2\x63ota\x65start\x68ota size\x1A\x00\x10\x00\x00"),
+	// {"datetime":"2024-06-19 10:20:30"}
+	BENCH_MSG("\xA1\x68" "datetime" "\x73" "2024-06-19 10:20:30"),
+	// {"groups":["living","kitchen"]}
+	BENCH_MSG("\xA1\x66groups\x82\x66living\x67kitchen"),
+	// {}
+	BENCH_MSG("\xA0"),
+};
+
+#define CORPUS_COUNT(c)	((int)(sizeof(c) / sizeof((c)[0])))
+
+static bench_ota_t bench_ota;
+
+// Sweep : every chunk size with no flash latency, then with the default sim latency
+static const int bench_ota_chunks[] = { 20, 64, 128, 244, QUEUE_DATA_SIZE };
+static const int bench_ota_latency[][2] = { { 0, 0 }, { -1, -1 } };
+
+/*-------------------------- Function declares ---------------------------*/
+
+// One message in fragments of frag bytes through the JSON or CBOR stream parser, also run by host/test/json_bench.c
+int bench_feed(int cbor, const uint8_t *data, int len, int frag)
+{
+	int i, n, r = -1;
+
+	if(!cbor) json_stream_begin();
+
+	for(i = 0; i < len; i += n)
+	{
+		n = (len - i < frag) ? len - i : frag;
+		r = cbor ? cbor_stream_feed(&data[i], n) : json_stream_feed((const char *)&data[i], n);
+		if(r != JSON_STREAM_INCOMPLETE) break;
+	}
+
+	return r;
+}
+
+/*******************************************
+bench json|cbor and fuzz switch the parser to dry run and reset its stream :
+both are shared with the live command path, so a BLE or console message
+arriving meanwhile would be lost or mixed with the corpus. Refused while a
+link, an OTA session or an unfinished message is there.
+*******************************************/
+static int bench_parser_idle(void)
+{
+	if(is_ble_connected() || is_ota_ready() || is_ota_draining() || ota_session_busy()
+		|| json_stream_busy() || cbor_stream_busy())
+	{
+		LOGI("BLE link, OTA session or command in progress : parser bench refused");
+		return 0;
+	}
+	return 1;
+}
+
+static void bench_parser(int cbor, int iterations, int frag)
+{
+	const bench_msg_t *corpus = cbor ? cbor_corpus : json_corpus;
+	int count = cbor ? CORPUS_COUNT(cbor_corpus) : CORPUS_COUNT(json_corpus);
+	int i, j, messages = 0, bytes = 0, tokens = 0, errors = 0;
+	int64_t start, elapsed;
+
+	json_set_dry_run(1);
+	start = esp_timer_get_time();
+
+	for(i = 0; i < iterations; i++)
+	{
+		for(j = 0; j < count; j++)
+		{
+			if(bench_feed(cbor, corpus[j].data, corpus[j].len, frag) < 0) errors++;
+			if(!cbor) tokens += json_stream_token_count();
+			bytes += corpus[j].len;
+			messages++;
+		}
+	}
+
+	elapsed = esp_timer_get_time() - start;
+	json_set_dry_run(0);
+	if(elapsed <= 0) elapsed = 1;
+
+	// one line of JSON so results can be collected and compared between releases
+	PrintConsole("{\"bench\":\"%s\",\"fragment\":%d,\"messages\":%d,\"bytes\":%d,\"tokens\":%d,\"errors\":%d,"
+			"\"us\":%lld,\"msg_per_sec\":%lld,\"ns_per_byte\":%lld,\"ns_per_token\":%lld}\r\n",
+			cbor ? "cbor" : "json", frag, messages, bytes, tokens, errors, elapsed,
+			(int64_t)messages * 1000000 / elapsed, elapsed * 1000 / (bytes ? bytes : 1),
+			tokens ? elapsed * 1000 / tokens : 0LL);
+}
+
+/*---------------------------- OTA ---------------------------------------*/
+static void bench_delay_us(int us)
+{
+	if(us >= portTICK_PERIOD_MS * 1000) vTaskDelay(us / 1000 / portTICK_PERIOD_MS);
+	else if(us > 0) esp_rom_delay_us(us);
+}
+
+// Plays the BLE receive task : synthetic image cut into chunks, through a queue of the same depth
+static void TaskBenchOtaSource(void *arg)
+{
+	BLE_MSG_st msg;
+	int sent = 0;
+
+	while(sent < bench_ota.size)
+	{
+		msg.len = (bench_ota.size - sent < bench_ota.chunk) ? bench_ota.size - sent : bench_ota.chunk;
+		ota_sim_image_read(bench_ota.size, sent, msg.data, msg.len);
+
+		if(bench_ota.jitter_us > 0) bench_delay_us(esp_random() % (bench_ota.jitter_us + 1));
+
+		xQueueSend(bench_ota.queue, &msg, portMAX_DELAY);
+		sent += msg.len;
+	}
+
+	msg.len = 0;
+	xQueueSend(bench_ota.queue, &msg, portMAX_DELAY);
+
+	xSemaphoreGive(bench_ota.done);
+	task_exit(TASK_BENCH_OTA);
+}
+
+static void bench_ota_run(int size, int chunk, int jitter_us)
+{
+	BLE_MSG_st msg;
+	ota_session_t session;
+	TaskHandle_t handle;
+	int erase_us, page_us, depth, peak = 0, heap_used;
+	int64_t start, ttfb = -1, elapsed;
+	uint32_t heap_before = esp_get_free_heap_size();
+
+	bench_ota.size = size;
+	bench_ota.chunk = chunk;
+	bench_ota.jitter_us = jitter_us;
+	bench_ota.queue = xQueueCreate(NUMBER_OF_BLE_MSG_QUEUE, sizeof(BLE_MSG_st));
+	bench_ota.done = xSemaphoreCreateBinary();
+	if(bench_ota.queue == NULL || bench_ota.done == NULL)
+	{
+		LOGE("Bench OTA queue creation ERROR");
+		if(bench_ota.queue) vQueueDelete(bench_ota.queue);
+		if(bench_ota.done) vSemaphoreDelete(bench_ota.done);
+		return;
+	}
+
+	start = esp_timer_get_time();
+	if(ota_session_start(&session, ota_find_backend("sim"), size) != ESP_OK)
+	{
+		LOGE("Bench OTA session ERROR : %s", esp_err_to_name(session.err));
+		vQueueDelete(bench_ota.queue);
+		vSemaphoreDelete(bench_ota.done);
+		return;
+	}
+
+	if(task_create(TASK_BENCH_OTA, &TaskBenchOtaSource, NULL, &handle) != pdPASS)
+	{
+		LOGE("ERROR : CAN'T creat bench OTA task");
+		ota_session_abort(&session);
+		vQueueDelete(bench_ota.queue);
+		vSemaphoreDelete(bench_ota.done);
+		return;
+	}
+	heap_used = heap_before - esp_get_free_heap_size();
+
+	while(1)
+	{
+		xQueueReceive(bench_ota.queue, &msg, portMAX_DELAY);
+
+		depth = uxQueueMessagesWaiting(bench_ota.queue) + 1;
+		if(depth > peak) peak = depth;
+
+		if(msg.len == 0) break;
+
+		if(ttfb < 0) ttfb = esp_timer_get_time() - start;
+		ota_session_write(&session, msg.data, msg.len);	// keeps draining on error so the source can finish
+	}
+
+	xSemaphoreTake(bench_ota.done, portMAX_DELAY);
+	ota_session_finish(&session);
+	elapsed = esp_timer_get_time() - start;
+	if(elapsed <= 0) elapsed = 1;
+
+	vQueueDelete(bench_ota.queue);
+	vSemaphoreDelete(bench_ota.done);
+
+	ota_sim_get_latency(&erase_us, &page_us);
+	PrintConsole("{\"bench\":\"ota\",\"size\":%d,\"chunk\":%d,\"jitter_us\":%d,\"erase_us\":%d,\"page_us\":%d,"
+			"\"queue\":%d,\"err\":%d,\"us\":%lld,\"kb_per_sec\":%lld,\"begin_us\":%lld,\"ttfb_us\":%lld,\"peak_queue\":%d,"
+			"\"heap_used\":%d,\"heap_min_free\":%d,\"task_plan\":%d,\"sliced\":%d,\"max_stall_us\":%d,\"yields\":%d,\"skipped\":%d}\r\n",
+			size, chunk, jitter_us, erase_us, page_us, NUMBER_OF_BLE_MSG_QUEUE, session.err, elapsed,
+			(int64_t)session.received * 1000000 / 1024 / elapsed, session.begin_us, ttfb, peak,
+			heap_used, (int)esp_get_minimum_free_heap_size(), task_layout_plan(), session.sliced, session.slice.max_stall_us,
+			session.slice.yields, session.slice.skipped);
+}
+
+// bench ota [size KB] [chunk] [jitter us] [erase us/sector] [program us/page]
+// bench ota sweep [size KB] [jitter us]
+static void bench_ota_command(char **token, int token_count)
+{
+	int sweep = (token_count > 2 && strcmp(token[2], "sweep") == 0);
+	int arg = sweep ? 3 : 2;
+	int size = BENCH_OTA_DEFAULT_KB;
+	int chunk = BENCH_OTA_DEFAULT_CHUNK;
+	int jitter = 0, erase_us = -1, page_us = -1;
+	int i, j;
+
+	if(token_count > arg) size = atoi(token[arg++]);
+	if(!sweep && token_count > arg) chunk = atoi(token[arg++]);
+	if(token_count > arg) jitter = atoi(token[arg++]);
+	if(!sweep && token_count > arg) erase_us = atoi(token[arg++]);
+	if(!sweep && token_count > arg) page_us = atoi(token[arg++]);
+
+	if(size <= 0 || size * 1024 > MAX_FIRMWARE_SIZE || chunk <= 0 || chunk > QUEUE_DATA_SIZE || jitter < 0)
+	{
+		LOGI("Invalid bench ota parameter");
+		return;
+	}
+
+	if(!sweep)
+	{
+		ota_sim_set_latency(erase_us, page_us);
+		bench_ota_run(size * 1024, chunk, jitter);
+		return;
+	}
+
+	for(i = 0; i < sizeof(bench_ota_latency) / sizeof(bench_ota_latency[0]); i++)
+	{
+		ota_sim_set_latency(bench_ota_latency[i][0], bench_ota_latency[i][1]);
+		for(j = 0; j < sizeof(bench_ota_chunks) / sizeof(bench_ota_chunks[0]); j++)
+		{
+			bench_ota_run(size * 1024, bench_ota_chunks[j], jitter);
+		}
+	}
+	ota_sim_set_latency(-1, -1);
+}
+
+/*---------------------------- BLE link ----------------------------------*/
+int bench_wait(int (*cond)(void), int expect, int timeout_ms)
+{
+	while(cond() != expect)
+	{
+		if(timeout_ms <= 0) return -1;
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+		timeout_ms -= 10;
+	}
+	return 0;
+}
+
+#if (CONFIG_OTA_BLE_SIM)
+// Phone side of a BLE OTA : control message, then the image in GATT writes of (MTU - 3) bytes,
+// 'packets' writes per connection event, through the real _uart_receive -> TaskBleOta path
+static void bench_ble_run(int size, int mtu, int interval, int packets, int disconnect)
+{
+	static uint8_t buf[BENCH_BLE_MAX_MTU];
+	msg_queue_t *queue = msg_queue_find("ota");
+	msg_queue_stats_t stats;
+	ota_sim_stats_t before, after;
+	char cmd[64];
+	int i, n, sent = 0, refused = 0, payload = mtu - 3;
+	int64_t start, elapsed;
+
+	if(queue == NULL)
+	{
+		LOGE("Bench BLE : no OTA queue, ENABLE_BLE_OTA ?");
+		return;
+	}
+
+	msg_queue_stats_reset(queue);
+	ota_sim_stats_get(&before);
+	start = esp_timer_get_time();
+
+	n = snprintf(cmd, sizeof(cmd), "{\"ota\":\"start\",\"ota size\":%d}\x04", size);
+	for(i = 0; i < n; i += payload)
+	{
+		ble_sim_write((const uint8_t *)&cmd[i], (n - i < payload) ? n - i : payload, BENCH_BLE_MBUF_SIZE);
+	}
+
+	// the phone waits for the status notification sent once esp_ota_begin is done
+	if(bench_wait(is_ota_receiving, 1, BENCH_BLE_TIMEOUT) != 0)
+	{
+		LOGE("Bench BLE : OTA session didn't start");
+		clear_ota_state();
+		return;
+	}
+
+	while(sent < size)
+	{
+		for(i = 0; i < packets && sent < size; i++)
+		{
+			if(disconnect > 0 && sent >= disconnect) break;
+
+			n = (size - sent < payload) ? size - sent : payload;
+			ota_sim_image_read(size, sent, buf, n);
+			refused = (ble_sim_write(buf, n, BENCH_BLE_MBUF_SIZE) != ESP_OK);
+			if(refused) break;
+			sent += n;
+		}
+
+		// a refused write ends the run like a lost link
+		if((disconnect > 0 && sent >= disconnect) || refused)
+		{
+			ble_sim_disconnect();
+			break;
+		}
+
+		vTaskDelay(interval / portTICK_PERIOD_MS);
+	}
+
+	bench_wait(is_ota_receiving, 0, BENCH_BLE_TIMEOUT);
+	elapsed = esp_timer_get_time() - start;
+	if(elapsed <= 0) elapsed = 1;
+
+	msg_queue_stats_get(queue, &stats);
+	ota_sim_stats_get(&after);
+	// activated : sim backend only, the image verified and selected
+	PrintConsole("{\"bench\":\"ble\",\"backend\":\"%s\",\"size\":%d,\"mtu\":%d,\"interval_ms\":%d,\"packets\":%d,"
+			"\"disconnect\":%d,\"sent\":%d,\"activated\":%d,\"us\":%lld,\"kb_per_sec\":%lld,\"queue\":%d,\"queued\":%d,"
+			"\"dropped\":%d,\"peak_queue\":%d,\"blocked_us\":%lld,\"max_blocked_us\":%lld,\"task_plan\":%d,\"turbo\":%d}\r\n",
+			ota_get_backend()->name, size, mtu, interval, packets, disconnect, sent, after.activated - before.activated,
+			elapsed, (int64_t)sent * 1000000 / 1024 / elapsed, NUMBER_OF_BLE_MSG_QUEUE, stats.sent,
+			stats.timeouts, stats.max_depth, stats.send_wait_us, stats.send_max_us, task_layout_plan(),
+			ota_turbo_enabled());
+}
+
+// bench ble [size KB] [mtu] [interval ms] [packets/event] [disconnect after KB]
+static void bench_ble_command(char **token, int token_count)
+{
+	int size = BENCH_OTA_DEFAULT_KB;
+	int mtu = BENCH_BLE_DEFAULT_MTU;
+	int interval = BENCH_BLE_DEFAULT_INTERVAL;
+	int packets = BENCH_BLE_DEFAULT_PACKETS;
+	int disconnect = 0;
+
+	if(token_count > 2) size = atoi(token[2]);
+	if(token_count > 3) mtu = atoi(token[3]);
+	if(token_count > 4) interval = atoi(token[4]);
+	if(token_count > 5) packets = atoi(token[5]);
+	if(token_count > 6) disconnect = atoi(token[6]);
+
+	if(size <= 0 || size * 1024 > MAX_FIRMWARE_SIZE || mtu < 23 || mtu > BENCH_BLE_MAX_MTU
+		|| interval < 0 || packets <= 0 || disconnect < 0)
+	{
+		LOGI("Invalid bench ble parameter");
+		return;
+	}
+
+	// the image is synthetic, never let it reach the OTA partition
+	if(strcmp(ota_get_backend()->name, "flash") == 0)
+	{
+		LOGI("Select the null or sim OTA backend first : ota backend sim");
+		return;
+	}
+
+	if(is_ble_connected() || is_ota_ready())
+	{
+		LOGI("BLE link or OTA busy");
+		return;
+	}
+
+	bench_ble_run(size * 1024, mtu, interval, packets, disconnect * 1024);
+}
+#endif	// #if (CONFIG_OTA_BLE_SIM)
+
+void bench_command(char **token, int token_count)
+{
+	int iterations = BENCH_DEFAULT_ITERATIONS;
+	int frag = BENCH_DEFAULT_FRAGMENT;
+
+	if(token_count < 2)
+	{
+		LOGI("Usage : bench json|cbor [iterations] [fragment size]");
+		LOGI("        bench ota [size KB] [chunk] [jitter us] [erase us/sector] [program us/page]");
+		LOGI("        bench ota sweep [size KB] [jitter us]");
+#if (CONFIG_OTA_BLE_SIM)
+		LOGI("        bench ble [size KB] [mtu] [interval ms] [packets/event] [disconnect after KB]");
+#endif
+		return;
+	}
+
+#if (CONFIG_OTA_BLE_SIM)
+	if(strcmp(token[1], "ble") == 0)
+	{
+		bench_ble_command(token, token_count);
+		return;
+	}
+#endif
+
+	if(strcmp(token[1], "ota") == 0)
+	{
+		bench_ota_command(token, token_count);
+		return;
+	}
+
+	if(token_count > 2) iterations = atoi(token[2]);
+	if(token_count > 3) frag = atoi(token[3]);
+	if(iterations <= 0 || frag <= 0)
+	{
+		LOGI("Invalid bench parameter");
+		return;
+	}
+	if(!bench_parser_idle()) return;
+
+	if(strcmp(token[1], "json") == 0)
+	{
+		bench_parser(0, iterations, frag);
+	}
+	else if(strcmp(token[1], "cbor") == 0)
+	{
+		bench_parser(1, iterations, frag);
+	}
+	else
+	{
+		LOGW("Unknown bench : %s", token[1]);
+	}
+}
+
+/*---------------------------- Fuzz --------------------------------------*/
+// Random byte flips, truncation, stray EOT and random fragmentation of the corpus
+static int fuzz_mutate(const bench_msg_t *msg, uint8_t *buf)
+{
+	int len = msg->len;
+	int i, n = esp_random() % 4;
+
+	memcpy(buf, msg->data, len);
+
+	for(i = 0; i < n; i++)
+	{
+		switch(esp_random() % 4)
+		{
+			case 0:	buf[esp_random() % len] = esp_random();	break;
+			case 1:	buf[esp_random() % len] = 0x04;			break;
+			case 2:	len = 1 + esp_random() % len;				break;
+			case 3:	buf[esp_random() % len] ^= 1 << (esp_random() % 8);	break;
+		}
+	}
+
+	return len;
+}
+
+static void fuzz_parser(int cbor, int iterations)
+{
+	const bench_msg_t *corpus = cbor ? cbor_corpus : json_corpus;
+	int count = cbor ? CORPUS_COUNT(cbor_corpus) : CORPUS_COUNT(json_corpus);
+	uint8_t buf[FUZZ_MAX_MESSAGE];
+	int result[4] = {0};	// error, complete, OTA, incomplete
+	int i, j, len, frag, r;
+	int64_t start = esp_timer_get_time();
+
+	json_set_dry_run(1);
+
+	for(i = 0; i < iterations; i++)
+	{
+		len = fuzz_mutate(&corpus[esp_random() % count], buf);
+		frag = 1 + esp_random() % 32;
+
+		// several messages back to back also exercise resuming after an unfinished one
+		for(j = 0; j < 1 + (int)(esp_random() % 2); j++)
+		{
+			r = bench_feed(cbor, buf, len, frag);
+			if(r == JSON_STREAM_INCOMPLETE) result[3]++;
+			else if(r < 0) result[0]++;
+			else if(r == 2) result[2]++;
+			else result[1]++;
+		}
+
+		// drop an unfinished message the same way a disconnect does
+		json_stream_reset();
+		cbor_stream_reset();
+
+		if((i & 0xFF) == 0) vTaskDelay(1);	// keep the idle task / watchdog fed
+	}
+
+	json_set_dry_run(0);
+
+	PrintConsole("{\"fuzz\":\"%s\",\"iterations\":%d,\"error\":%d,\"ok\":%d,\"ota\":%d,\"incomplete\":%d,"
+			"\"us\":%lld,\"stack_free\":%d}\r\n",
+			cbor ? "cbor" : "json", iterations, result[0], result[1], result[2], result[3],
+			esp_timer_get_time() - start, (int)uxTaskGetStackHighWaterMark(NULL));
+}
+
+void fuzz_command(char **token, int token_count)
+{
+	int iterations = FUZZ_DEFAULT_ITERATIONS;
+
+	if(token_count < 2)
+	{
+		LOGI("Usage : fuzz json|cbor [iterations]");
+		return;
+	}
+
+	if(token_count > 2) iterations = atoi(token[2]);
+	if(iterations <= 0)
+	{
+		LOGI("Invalid fuzz parameter");
+		return;
+	}
+	if(!bench_parser_idle()) return;
+
+	if(strcmp(token[1], "json") == 0)
+	{
+		fuzz_parser(0, iterations);
+	}
+	else if(strcmp(token[1], "cbor") == 0)
+	{
+		fuzz_parser(1, iterations);
+	}
+	else
+	{
+		LOGW("Unknown fuzz target : %s", token[1]);
+	}
+}
@@ -27,6 +27,11 @@
 
 #include "debug.h"
 #include "ota.h"
+#include "json.h"
+#include "cbor.h"
+#include "msg_queue.h"
+#include "task_layout.h"
+#include "trace.h"
 
 /*---------------------------- User define -------------------------------*/
 #define BLE_ADV_NAME "ESP32_BLE"
@@ -59,7 +64,7 @@ typedef void (*uart_receive_callback_t)(struct ble_gatt_access_ctxt *ctxt);
 /*---------------------------- Variables ---------------------------------*/
 static const char *TAG = "BLE";
 
-static QueueHandle_t msg_queue_ble;
+static msg_queue_t msg_queue_ble;
 
 // [xlink] 240619 : Nordic UART Service UUID
 static const ble_uuid128_t SERVICE_UUID = UUID128_CONST(0x6E400001, 0xB5A3, 0xF393, 0xE0A9, 0xE50E24DCCA9E);
@@ -67,6 +72,7 @@ static const ble_uuid128_t CHAR_UUID_RX = UUID128_CONST(0x6E400002, 0xB5A3, 0xF3
 static const ble_uuid128_t CHAR_UUID_TX = UUID128_CONST(0x6E400003, 0xB5A3, 0xF393, 0xE0A9, 0xE50E24DCCA9E);
 
 static uint8_t ble_addr_type;
+static volatile int ble_adv_mode = BLE_ADV_NORMAL;
 
 static uint16_t ble_conn_hdl = BLE_HS_CONN_HANDLE_NONE;
 static uint16_t notify_char_attr_hdl;
@@ -96,48 +102,59 @@ static const struct ble_gatt_svc_def gat_svcs[] = {
 /*-------------------------- Function declares ---------------------------*/
 static int ble_gap_event_cb(struct ble_gap_event *event, void *arg);
 
-static int _uart_receive(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
-	static BLE_MSG_st msg;
-	uint8_t *ptr;
-	uint16_t total_len;
+// Drop unfinished messages and stop a running OTA
+static void ble_rx_disconnected(void)
+{
+	json_stream_reset();
+	cbor_stream_reset();
+	if(is_ota_ready() || is_ota_draining()) send_ota_data(NULL, -1);
+}
 
-	ptr = ctxt->om->om_data;
-	total_len = ctxt->om->om_len;
-	
-	if(ctxt->om->om_len > QUEUE_DATA_SIZE)
+static void _uart_receive_flush(BLE_MSG_st *msg)
+{
+	if(is_ota_ready() || is_ota_draining())
 	{
-		if(is_ota_ready())
+		send_ota_data(msg->data, msg->len);
+	}
+	else
+	{
+		if(msg_queue_send( &msg_queue_ble, msg, 1000 ) == 0)	// 1000 ticks(ms) 동안 전송 시도
 		{
-			send_ota_data(ptr, total_len);
-			ptr += QUEUE_DATA_SIZE;
-			total_len -= QUEUE_DATA_SIZE;
+			LOGE("BLE Rx message send ERROR");
 		}
-		else
+	}
+}
+
+// Writes longer than one mbuf arrive as a chain, and are queued in QUEUE_DATA_SIZE pieces
+static int _uart_receive(uint16_t conn_handle, uint16_t attr_handle, struct ble_gatt_access_ctxt *ctxt, void *arg) {
+	static BLE_MSG_st msg;
+	struct os_mbuf *om;
+	int off, n, queued = 0;
+
+	msg.len = 0;
+
+	for(om = ctxt->om; om != NULL; om = SLIST_NEXT(om, om_next))
+	{
+		TRACE(TRACE_BLE_RX, om->om_len);
+		for(off = 0; off < om->om_len; off += n)
 		{
-			memcpy(msg.data, ptr, QUEUE_DATA_SIZE);
-			msg.len = QUEUE_DATA_SIZE;
-			ptr += QUEUE_DATA_SIZE;
-			total_len -= QUEUE_DATA_SIZE;
-			if(xQueueSend( msg_queue_ble, &msg, 1000 ) == 0)	// 1000 ticks(ms) 동안 전송 시도
+			n = MIN(om->om_len - off, QUEUE_DATA_SIZE - msg.len);
+			memcpy(&msg.data[msg.len], &om->om_data[off], n);
+			msg.len += n;
+
+			if(msg.len == QUEUE_DATA_SIZE)
 			{
-				LOGE("BLE Rx message send ERROR");
+				_uart_receive_flush(&msg);
+				msg.len = 0;
+				queued = 1;
 			}
 		}
 	}
 
-	if(is_ota_ready())
+	// an empty write is passed on too : it ends the OTA image
+	if(msg.len > 0 || !queued)
 	{
-		send_ota_data(ptr, total_len);
-	}
-	else
-	{
-		memcpy(msg.data, ptr, total_len);
-		msg.len = total_len;
-
-		if(xQueueSend( msg_queue_ble, &msg, 1000 ) == 0)	// 1000 ticks(ms) 동안 전송 시도
-		{
-			LOGE("BLE Rx message send ERROR");
-		}
+		_uart_receive_flush(&msg);
 	}
 	
 	return 0;
@@ -156,6 +173,9 @@ static void ble_app_advertise(void) {
   const char *name = ble_svc_gap_device_name();
   int err;
 
+  // [xlink] OTA turbo : no advertising restart on connect/disconnect while an update runs
+  if (ble_adv_mode == BLE_ADV_OFF) return;
+
 #if 1	//[[ Kwon TaeYoung 2023/03/29_BEGIN -- Short advertising name 사용하지 않음
   struct ble_hs_adv_fields  fields;
   
@@ -216,8 +236,13 @@ static void ble_app_advertise(void) {
   struct ble_gap_adv_params adv_params;
   memset(&adv_params, 0, sizeof(adv_params));
 
-  adv_params.itvl_min = 300;
-  adv_params.itvl_max = 400;
+  if (ble_adv_mode == BLE_ADV_SLOW) {
+    adv_params.itvl_min = 1600;	// 1 s
+    adv_params.itvl_max = 2000;
+  } else {
+    adv_params.itvl_min = 300;
+    adv_params.itvl_max = 400;
+  }
   
   adv_params.conn_mode = BLE_GAP_CONN_MODE_UND;
   adv_params.disc_mode = BLE_GAP_DISC_MODE_GEN;
@@ -250,6 +275,13 @@ int is_ble_connected(void)
 	return ble_connected;
 }
 
+// Responses use the encoding of the last request on this connection
+static int ble_msg_format = MSG_FORMAT_JSON;
+int ble_get_msg_format(void)
+{
+	return ble_msg_format;
+}
+
 static uint8_t bt_mac_addr[6];
 
 uint8_t *ble_get_mac_address(void)
@@ -286,6 +318,7 @@ static int ble_gap_event_cb(struct ble_gap_event *event, void *arg)
 				param.supervision_timeout = 100;
 				ble_gap_update_params(ble_conn_hdl, &param);
 				ble_connected = 1;
+				ble_msg_format = MSG_FORMAT_JSON;
 
 				// [xlink] 241016 : 연결된 후에도 Adv 시작하여 새로운 접속 처리하기 위해
 				ble_app_advertise();
@@ -309,11 +342,11 @@ static int ble_gap_event_cb(struct ble_gap_event *event, void *arg)
 			}
 
 			ble_connected = 0;
+			ble_rx_disconnected();
 
     		if (_nordic_uart_callback)
     		  	_nordic_uart_callback(NORDIC_UART_DISCONNECTED);
     		ble_app_advertise();
-			if(is_ota_ready()) send_ota_data(NULL, -1);
 
 			ble_gap_set_prefered_default_le_phy(BLE_HCI_LE_PHY_2M_PREF_MASK, BLE_HCI_LE_PHY_2M_PREF_MASK);
     	break;
@@ -357,6 +390,29 @@ static int ble_gap_event_cb(struct ble_gap_event *event, void *arg)
   	return 0;
 }
 
+// BLE_ADV_NORMAL, BLE_ADV_SLOW (longer interval) or BLE_ADV_OFF, restarts advertising with the new interval
+void ble_adv_set_mode(int mode)
+{
+	int err;
+
+	if(mode == ble_adv_mode) return;
+	ble_adv_mode = mode;
+
+	if(!ble_hs_synced()) return;
+
+	err = ble_gap_adv_stop();
+	if(err != 0 && err != BLE_HS_EALREADY)
+	{
+		LOGE("Advertising stop failed: err %d", err);
+	}
+	ble_app_advertise();
+}
+
+int ble_adv_get_mode(void)
+{
+	return ble_adv_mode;
+}
+
 static void ble_app_on_sync_cb(void) {
   int ret = ble_hs_id_infer_auto(0, &ble_addr_type);
   if (ret != 0) {
@@ -372,6 +428,34 @@ static void ble_host_task(void *param) {
 //  _nordic_uart_buf_deinit();
 }
 
+// Send one notification, retry while NimBLE is out of mbufs
+static esp_err_t _nordic_uart_notify(const uint8_t *data, int len)
+{
+	struct os_mbuf *om;
+	int err;
+	int err_count = 0;
+
+	TRACE(TRACE_BLE_NOTIFY_B, len);
+	do
+	{
+		om = ble_hs_mbuf_from_flat(data, len);
+		err = ble_gattc_notify_custom(ble_conn_hdl, notify_char_attr_hdl, om);
+		if(err == BLE_HS_ENOMEM)
+		{
+			TRACE(TRACE_BLE_NOTIFY_RETRY, err_count);
+			vTaskDelay(100 / portTICK_PERIOD_MS);
+		}
+	} while(err == BLE_HS_ENOMEM && err_count++ < 10);
+	TRACE(TRACE_BLE_NOTIFY_E, err);
+
+	if(err)
+	{
+		LOGE("BLE send ERROR : %d", err);
+		return ESP_FAIL;
+	}
+	return ESP_OK;
+}
+
 // Split the message in BLE_SEND_MTU and send it.
 esp_err_t _nordic_uart_send( uint8_t *message, int len) {
 	if(!ble_connected) return ESP_FAIL;
@@ -380,25 +464,59 @@ esp_err_t _nordic_uart_send( uint8_t *message, int len) {
     return ESP_OK;
   // Split the message in BLE_SEND_MTU and send it.
   for (int i = 0; i < len; i += BLE_SEND_MTU) {
-    int err;
-    struct os_mbuf *om;
-    int err_count = 0;
-  do_notify:
-    om = ble_hs_mbuf_from_flat(&message[i], MIN(BLE_SEND_MTU, len - i));
-    err = ble_gattc_notify_custom(ble_conn_hdl, notify_char_attr_hdl, om);
-    if (err == BLE_HS_ENOMEM && err_count++ < 10) {
-      vTaskDelay(100 / portTICK_PERIOD_MS);
-      goto do_notify;
-    }
-    if (err)
+    if (_nordic_uart_notify(&message[i], MIN(BLE_SEND_MTU, len - i)) != ESP_OK)
     {
-		LOGE("BLE send ERROR : %d", err);
       return ESP_FAIL;
     }
   }
   return ESP_OK;
 }
 
+void ble_tx_begin(ble_tx_stream_t *tx)
+{
+	tx->len = 0;
+	tx->total = 0;
+	tx->mtu = MIN(BLE_SEND_MTU, BLE_TX_CHUNK_MAX);
+	tx->err = ble_connected ? ESP_OK : ESP_FAIL;
+}
+
+// json_sink_t : fill the current chunk, every full chunk goes out as one notification
+int ble_tx_write(void *ctx, const void *data, int len)
+{
+	ble_tx_stream_t *tx = (ble_tx_stream_t *)ctx;
+	const uint8_t *ptr = (const uint8_t *)data;
+	int n;
+
+	while(len > 0 && tx->err == ESP_OK)
+	{
+		n = MIN(len, tx->mtu - tx->len);
+		memcpy(&tx->chunk[tx->len], ptr, n);
+		tx->len += n;
+		tx->total += n;
+		ptr += n;
+		len -= n;
+
+		if(tx->len == tx->mtu)
+		{
+			tx->err = _nordic_uart_notify(tx->chunk, tx->len);
+			tx->len = 0;
+		}
+	}
+
+	return (tx->err == ESP_OK) ? 0 : -1;
+}
+
+esp_err_t ble_tx_end(ble_tx_stream_t *tx)
+{
+	if(tx->err == ESP_OK && tx->len > 0)
+	{
+		tx->err = _nordic_uart_notify(tx->chunk, tx->len);
+		tx->len = 0;
+	}
+
+	return tx->err;
+}
+
 esp_err_t _nordic_uart_start(const char *device_name, void (*callback)(enum nordic_uart_callback_type callback_type)) {
   // already initialized will return ESP_FAIL
 //  if (_nordic_uart_linebuf_initialized()) {
@@ -470,15 +588,74 @@ static void TaskBle(void *arg)
 	
 	while(1)
 	{
-		if( xQueueReceive(msg_queue_ble, &msg, portMAX_DELAY))
+		if( msg_queue_receive(&msg_queue_ble, &msg, portMAX_DELAY))
 		{
 			LOGI("BLE task received message : %d", msg.len);
-			msg.data[msg.len] = 0;
+			if(msg.len <= 0) continue;
+
+			// JSON continuation first, a UTF-8 fragment may start with a byte in the CBOR map range
+			if(!json_stream_busy() && (cbor_stream_busy() || CBOR_IS_MAP_START(msg.data[0])))
+			{
+				ble_msg_format = MSG_FORMAT_CBOR;
+				CommandProcessCbor(msg.data, msg.len);
+				continue;
+			}
+
+			if(json_stream_busy() || msg.data[0] == '{')
+			{
+				if(!json_stream_busy()) ble_msg_format = MSG_FORMAT_JSON;
+				CommandProcessJson((const char *)msg.data, msg.len);
+				continue;
+			}
+
+			// text commands are short, terminated in place
+			msg.data[MIN(msg.len, QUEUE_DATA_SIZE - 1)] = 0;
 			CommandProcess((char *)msg.data);
 		}
 	}
 }
 
+/*---------------------------- Link simulation ---------------------------*/
+#if (CONFIG_OTA_BLE_SIM)
+// Same path as a GATT write from the phone : data is cut into a chain of mbuf_size mbufs.
+// One write, never split : longer than BLE_SIM_MAX_MBUFS mbufs is refused.
+esp_err_t ble_sim_write(const uint8_t *data, int len, int mbuf_size)
+{
+	struct os_mbuf om[BLE_SIM_MAX_MBUFS];
+	struct ble_gatt_access_ctxt ctxt;
+	int i, n;
+
+	if(len < 0 || mbuf_size <= 0 || len > BLE_SIM_MAX_MBUFS * mbuf_size)
+	{
+		LOGE("BLE sim write of %d bytes : more than %d mbufs of %d", len, BLE_SIM_MAX_MBUFS, mbuf_size);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	memset(om, 0, sizeof(om));
+	for(i = 0; i < BLE_SIM_MAX_MBUFS; i++)
+	{
+		n = MIN(len, mbuf_size);
+		om[i].om_data = (uint8_t *)data;
+		om[i].om_len = n;
+		data += n;
+		len -= n;
+		if(len <= 0) break;
+		SLIST_NEXT(&om[i], om_next) = &om[i + 1];
+	}
+
+	memset(&ctxt, 0, sizeof(ctxt));
+	ctxt.op = BLE_GATT_ACCESS_OP_WRITE_CHR;
+	ctxt.om = om;
+	_uart_receive(ble_conn_hdl, 0, &ctxt, NULL);
+	return ESP_OK;
+}
+
+void ble_sim_disconnect(void)
+{
+	ble_rx_disconnected();
+}
+#endif	// #if (CONFIG_OTA_BLE_SIM)
+
 void bt_ble_init(void)
 {
 	char adv_name[32] = {0};
@@ -492,19 +669,13 @@ void bt_ble_init(void)
 	TaskHandle_t handle;
 	int ret;
 
-	msg_queue_ble = xQueueCreate(NUMBER_OF_BLE_MSG_QUEUE, sizeof(BLE_MSG_st));
-	if(msg_queue_ble == 0)
+	if(msg_queue_create(&msg_queue_ble, "ble", NUMBER_OF_BLE_MSG_QUEUE, sizeof(BLE_MSG_st)) != ESP_OK)
 	{
 		LOGE("BLE Rx message queue creation ERROR");
 		return;
 	}
 	
-	ret = xTaskCreatePinnedToCore(&TaskBle, "BLE-Rx",
-            8192, 
-            NULL,
-            5,
-            &handle,
-            tskNO_AFFINITY);
+	ret = task_create(TASK_BLE_RX, &TaskBle, NULL, &handle);
 	
     if (ret != pdPASS) {
 		LOGE("ERROR : CAN'T creat task");
@@ -0,0 +1,344 @@
+/****************************************************************************/
+//  File    : cbor.c
+//---------------------------------------------------------------------------
+//  Description:
+//             Compact binary (CBOR) encoding of the control messages.
+//             Requests are a map of the same keys as the JSON messages,
+//             and are decoded through the same key schema (json_command_xxx).
+//
+//  History :
+//---------------------------------------------------------------------------
+//   Date      | Author          | Version |  Modification
+//-------------+--------+---------+------------------------------------------
+// 1 Sep 2022 |  Kwon Taeyoung   |   1.0   |  Creation
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "debug.h"
+#include "ota.h"
+#include "json.h"
+#include "cbor.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG	"CBOR"
+
+#define CBOR_ERR_INVALID	-1
+#define CBOR_ERR_PART		-2	// message continues in the next fragment
+#define CBOR_MAX_DEPTH		4
+
+/*---------------------------- Variables ---------------------------------*/
+static uint8_t cbor_buf[MAX_CBOR_MESSAGE];
+static int cbor_len;
+
+/*-------------------------- Function declares ---------------------------*/
+
+/*---------------------------- Writer ------------------------------------*/
+static void cbor_out(cbor_writer_t *w, const void *data, int len)
+{
+	if(w->err || len <= 0) return;
+
+	if(w->sink(w->ctx, data, len) != 0)
+	{
+		w->err = -1;
+	}
+	w->total += len;
+}
+
+static void cbor_head(cbor_writer_t *w, int major, uint32_t val)
+{
+	uint8_t buf[5];
+	int n;
+
+	if(val < 24)
+	{
+		buf[0] = (major << 5) | val;
+		n = 1;
+	}
+	else if(val <= 0xFF)
+	{
+		buf[0] = (major << 5) | 24;
+		buf[1] = val;
+		n = 2;
+	}
+	else if(val <= 0xFFFF)
+	{
+		buf[0] = (major << 5) | 25;
+		buf[1] = val >> 8;
+		buf[2] = val;
+		n = 3;
+	}
+	else
+	{
+		buf[0] = (major << 5) | 26;
+		buf[1] = val >> 24;
+		buf[2] = val >> 16;
+		buf[3] = val >> 8;
+		buf[4] = val;
+		n = 5;
+	}
+
+	cbor_out(w, buf, n);
+}
+
+void cbor_writer_init(cbor_writer_t *w, json_sink_t sink, void *ctx)
+{
+	w->sink = sink;
+	w->ctx = ctx;
+	w->total = 0;
+	w->err = 0;
+}
+
+void cbor_map(cbor_writer_t *w, int count)
+{
+	cbor_head(w, CBOR_MAJOR_MAP, count);
+}
+
+void cbor_array(cbor_writer_t *w, int count)
+{
+	cbor_head(w, CBOR_MAJOR_ARRAY, count);
+}
+
+void cbor_text(cbor_writer_t *w, const char *str)
+{
+	int len = strlen(str);
+
+	cbor_head(w, CBOR_MAJOR_TEXT, len);
+	cbor_out(w, str, len);
+}
+
+void cbor_bytes(cbor_writer_t *w, const uint8_t *data, int len)
+{
+	cbor_head(w, CBOR_MAJOR_BYTES, len);
+	cbor_out(w, data, len);
+}
+
+void cbor_int(cbor_writer_t *w, int num)
+{
+	if(num >= 0) cbor_head(w, CBOR_MAJOR_UINT, num);
+	else cbor_head(w, CBOR_MAJOR_NINT, -1 - num);
+}
+
+/*---------------------------- Reader ------------------------------------*/
+// Item header : major type and argument (value, length or count)
+static int cbor_read_head(const uint8_t **p, const uint8_t *end, int *major, uint32_t *val)
+{
+	uint8_t ai;
+	int n;
+
+	if(*p >= end) return CBOR_ERR_PART;
+
+	*major = **p >> 5;
+	ai = **p & 0x1F;
+	(*p)++;
+
+	if(ai < 24)
+	{
+		*val = ai;
+		return 0;
+	}
+
+	// 64 bit arguments and indefinite lengths are not used by the control protocol
+	if(ai > 26) return CBOR_ERR_INVALID;
+
+	n = 1 << (ai - 24);
+	if(end - *p < n) return CBOR_ERR_PART;
+
+	*val = 0;
+	while(n--)
+	{
+		*val = (*val << 8) | *(*p)++;
+	}
+	return 0;
+}
+
+static int cbor_skip(const uint8_t **p, const uint8_t *end, int depth)
+{
+	int major, r;
+	uint32_t val, i;
+
+	if(depth > CBOR_MAX_DEPTH) return CBOR_ERR_INVALID;
+
+	r = cbor_read_head(p, end, &major, &val);
+	if(r != 0) return r;
+
+	switch(major)
+	{
+		case CBOR_MAJOR_BYTES:
+		case CBOR_MAJOR_TEXT:
+			if((uint32_t)(end - *p) < val) return CBOR_ERR_PART;
+			*p += val;
+		break;
+
+		case CBOR_MAJOR_MAP:
+			if(val > MAX_CBOR_MESSAGE) return CBOR_ERR_INVALID;
+			val *= 2;
+			// fall through
+		case CBOR_MAJOR_ARRAY:
+			for(i = 0; i < val; i++)
+			{
+				r = cbor_skip(p, end, depth + 1);
+				if(r != 0) return r;
+			}
+		break;
+
+		case 6:	// tag : skip the tagged item
+			return cbor_skip(p, end, depth + 1);
+
+		default:	// integers and simple values have no payload
+		break;
+	}
+
+	return 0;
+}
+
+static void cbor_value(int id, int type, const uint8_t **p, const uint8_t *end)
+{
+	const uint8_t *start = *p;
+	json_value_t value;
+	int major;
+	uint32_t val, i;
+
+	memset(&value, 0, sizeof(value));
+	value.type = type;
+
+	cbor_read_head(p, end, &major, &val);
+
+	if(type == JSON_TYPE_INT && (major == CBOR_MAJOR_UINT || major == CBOR_MAJOR_NINT) && val <= 0x7FFFFFFF)
+	{
+		value.num = (major == CBOR_MAJOR_UINT) ? (int)val : -1 - (int)val;
+		json_command_value(id, &value);
+		return;
+	}
+
+	if(type == JSON_TYPE_STRING && major == CBOR_MAJOR_TEXT)
+	{
+		value.str = (const char *)*p;
+		value.len = val;
+		*p += val;
+		json_command_value(id, &value);
+		return;
+	}
+
+	if(type == JSON_TYPE_ARRAY && major == CBOR_MAJOR_ARRAY)
+	{
+		value.count = val;
+		for(i = 0; i < (uint32_t)value.count; i++)
+		{
+			start = *p;
+			cbor_read_head(p, end, &major, &val);
+			if(major != CBOR_MAJOR_TEXT)
+			{
+				*p = start;
+				cbor_skip(p, end, 1);
+				continue;
+			}
+			value.str = (const char *)*p;
+			value.len = val;
+			*p += val;
+			json_command_value(id, &value);
+			value.index++;
+		}
+		return;
+	}
+
+	LOGI("CBOR value type mismatch : major %d", major);
+	*p = start;
+	cbor_skip(p, end, 0);
+}
+
+// Message was validated by cbor_skip(), so reads below can't run past the end
+static int cbor_apply(const uint8_t *data, int len)
+{
+	const uint8_t *p = data;
+	const uint8_t *end = data + len;
+	int major, id, type;
+	uint32_t count, key_len, i;
+
+	json_command_begin();
+
+	cbor_read_head(&p, end, &major, &count);
+	if(major != CBOR_MAJOR_MAP)
+	{
+		LOGI("CBOR map expected");
+		return -1;
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		cbor_read_head(&p, end, &major, &key_len);
+		if(major != CBOR_MAJOR_TEXT)
+		{
+			LOGI("CBOR key must be text : %d", major);
+			return -1;
+		}
+
+		id = json_command_lookup((const char *)p, key_len, &type);
+		p += key_len;
+
+		if(id == 0)
+		{
+			cbor_skip(&p, end, 1);
+			continue;
+		}
+
+		cbor_value(id, type, &p, end);
+	}
+
+	return json_command_end();
+}
+
+int cbor_stream_busy(void)
+{
+	return cbor_len > 0;
+}
+
+void cbor_stream_reset(void)
+{
+	cbor_len = 0;
+}
+
+/*******************************************
+Feed one received fragment, the message ends when the root map is complete
+Return : same as json_stream_feed()
+-1 : Parsing error
+1  : Set parameters
+2  : OTA
+JSON_STREAM_INCOMPLETE : more fragments expected
+*******************************************/
+int cbor_stream_feed(const uint8_t *data, int len)
+{
+	const uint8_t *p;
+	int r;
+
+	if(cbor_len + len > MAX_CBOR_MESSAGE)
+	{
+		LOGE("CBOR message too long : %d", cbor_len + len);
+		cbor_len = 0;
+		return -1;
+	}
+
+	memcpy(&cbor_buf[cbor_len], data, len);
+	cbor_len += len;
+
+	p = cbor_buf;
+	r = cbor_skip(&p, cbor_buf + cbor_len, 0);
+	if(r == CBOR_ERR_PART)
+	{
+		return JSON_STREAM_INCOMPLETE;
+	}
+
+	cbor_len = 0;
+
+	if(r != 0)
+	{
+		LOGI("Failed to parse CBOR : %d", r);
+		return -1;
+	}
+
+	return cbor_apply(cbor_buf, p - cbor_buf);
+}
@@ -33,20 +33,50 @@
 #include "esp_adc/adc_continuous.h"
 #include "driver/gpio.h"
 #include "spi_flash_mmap.h"
+#include "esp_heap_caps.h"
 #include <sys/socket.h>
 #include "debug.h"
 #include "ota.h"
+#include "cbor.h"
+#include "bench.h"
+#include "ota_session.h"
+#include "msg_queue.h"
+#include "heap_tag.h"
+#include "task_layout.h"
+#include "ota_turbo.h"
+#include "ota_stage.h"
+#include "ota_crypt.h"
+#include "ota_tls.h"
+#include "trace.h"
 
 #define TAG	"debug"
 
 #define CMD_REBOOT		"reboot"
 #define CMD_TIME		"time"
+#define CMD_TOP			"top"
+
+#define TOP_MAX_TASKS		32
+#define TOP_SAMPLE_MS		1000	// window of a single 'top'
+
+typedef struct {
+	TaskHandle_t handle;
+	uint32_t runtime;
+} top_sample_t;
 
 #if defined(ENABLE_WIFI)
 static int TcpConnected;
 static int TelnetClientSocket;
 #endif	// #if defined(ENABLE_WIFI)
 
+#if (configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS)
+static TaskStatus_t top_status[TOP_MAX_TASKS];
+static top_sample_t top_prev[TOP_MAX_TASKS];
+static int top_prev_count;
+static uint32_t top_prev_total;
+static volatile int top_period;		// streaming period in seconds, 0 : not streaming
+static TaskHandle_t top_task;
+#endif
+
 void PrintConsole(const char *format, ...)
 {
 	char outBuff[512];
@@ -157,90 +187,250 @@ static void set_new_time(char **token)
 	print_time();
 }
 
-#define MAX_JSON_STRING		2048
-
-void CommandProcess(char *cmd_str)
+// Result of a complete JSON or CBOR control message
+static void CommandResult(int result)
 {
-	static bool json_in_process;
-	static char json_string[MAX_JSON_STRING + 1];
-	const char *delimiters = " \r\n";
-	char *token[10];
-	int i, token_count, len, json_result;
-	
-	if(json_in_process)
+	if(result >= 0)
 	{
-		len = strlen(cmd_str);
-		
-		if(cmd_str[len - 1] == 0x04 || cmd_str[len - 1] == '}')	// CTRL-D (End Of Transmission)
+		if(result == 2)
 		{
-			if(cmd_str[len - 1] == 0x04)
-			{
-				cmd_str[len - 1] = 0;
-			}
-			strcat(json_string, cmd_str);
-			json_result = json_parsing(json_string);
-			json_in_process = false;
-
-			if(json_result >= 0)
-			{
-				if(json_result == 2)
-				{
-					LOGI("Send OTA start semaphore");
-					give_ota_semaphore();
-				}
-				else
-				{
-					send_json_info();
-				}
-			}
-			else
-			{
-				LOGE("JSON parsing ERROR");
-			}
+			LOGI("Send OTA start semaphore");
+			give_ota_semaphore();
 		}
 		else
 		{
-			strcat(json_string, cmd_str);
+			// set_led_state(LED_STATE_TRANSMIT_BLINK);
+			send_status_info();
+			// set_led_state(LED_STATE_DEFAULT_BLINK);
+			if(is_ota_staged()) ota_stage_restart();
 		}
+	}
+	else
+	{
+		LOGE("JSON parsing ERROR");
+	}
+}
+
+// JSON fragment of len bytes, no NUL needed : a full BLE fragment has no room for one
+void CommandProcessJson(const char *data, int len)
+{
+	int result;
+
+	if(!json_stream_busy())
+	{
+		json_stream_begin();
+	}
+
+	result = json_stream_feed(data, len);
+	if(result != JSON_STREAM_INCOMPLETE)
+	{
+		CommandResult(result);
+	}
+}
+
+void CommandProcessCbor(const uint8_t *data, int len)
+{
+	int result = cbor_stream_feed(data, len);
+
+	if(result != JSON_STREAM_INCOMPLETE)
+	{
+		CommandResult(result);
+	}
+}
+
+/*---------------------------- top ---------------------------------------*/
+#if (configUSE_TRACE_FACILITY && configGENERATE_RUN_TIME_STATS)
+static uint32_t top_prev_runtime(TaskHandle_t handle)
+{
+	int i;
+
+	for(i = 0; i < top_prev_count; i++)
+	{
+		if(top_prev[i].handle == handle) return top_prev[i].runtime;
+	}
+	return 0;	// task created since the last sample
+}
+
+static char top_state_char(eTaskState state)
+{
+	switch(state)
+	{
+		case eRunning:		return 'X';
+		case eReady:		return 'R';
+		case eBlocked:		return 'B';
+		case eSuspended:	return 'S';
+		default:			return 'D';
+	}
+}
+
+// Take a sample, print the usage since the previous one
+static void top_sample(int print)
+{
+	static const struct {
+		const char *name;
+		uint32_t caps;
+	} heaps[] = {
+		{ "default",	MALLOC_CAP_DEFAULT },
+		{ "internal",	MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT },
+		{ "dma",		MALLOC_CAP_DMA },
+		{ "32bit",		MALLOC_CAP_32BIT },		// includes IRAM usable by 32 bit accesses
+#if (CONFIG_SPIRAM)
+		{ "spiram",		MALLOC_CAP_SPIRAM },
+#endif
+	};
+	uint32_t delta[TOP_MAX_TASKS];
+	uint32_t total, elapsed, idle[portNUM_PROCESSORS] = { 0 };
+	int i, j, count, len, order[TOP_MAX_TASKS], tmp;
+	char line[80];
+
+	count = uxTaskGetSystemState(top_status, TOP_MAX_TASKS, &total);
+	if(count == 0)
+	{
+		LOGE("top : more than %d tasks", TOP_MAX_TASKS);
 		return;
 	}
-	
-	if(cmd_str[0] == '{')
+
+	elapsed = total - top_prev_total;	// run time counter is in us (esp_timer)
+	if(elapsed == 0) elapsed = 1;
+
+	for(i = 0; i < count; i++)
 	{
-		json_in_process = true;
-		memset(json_string, 0, sizeof(json_string));
-		strcpy(json_string, cmd_str);
-		len = strlen(cmd_str);
+		delta[i] = top_status[i].ulRunTimeCounter - top_prev_runtime(top_status[i].xHandle);
+		if(strncmp(top_status[i].pcTaskName, "IDLE", 4) == 0)
+		{
+			j = top_status[i].pcTaskName[4] - '0';
+			if(j >= 0 && j < portNUM_PROCESSORS) idle[j] = delta[i];
+		}
+		order[i] = i;
+	}
 
-		if(cmd_str[len - 1] == 0x04 || cmd_str[len - 1] == '}')	// CTRL-D (End Of Transmission)
+	for(i = 0; print && i < count; i++)
+	{
+		// busiest first
+		for(j = i; j > 0 && delta[order[j]] > delta[order[j - 1]]; j--)
 		{
-			if(cmd_str[len - 1] == 0x04)
-			{
-				json_string[len - 1] = 0;
-			}
-			// LOGI("Json string :\n%s", json_string);
-			json_result = json_parsing(json_string);
-			json_in_process = false;
+			tmp = order[j];
+			order[j] = order[j - 1];
+			order[j - 1] = tmp;
+		}
+	}
 
-			if(json_result >= 0)
-			{
-				if(json_result == 2)
-				{
-					LOGI("Send OTA start semaphore");
-					give_ota_semaphore();
-				}
-				else
-				{
-					// set_led_state(LED_STATE_TRANSMIT_BLINK);
-					send_json_info();
-					// set_led_state(LED_STATE_DEFAULT_BLINK);
-				}
-			}
-			else
-			{
-				LOGE("JSON parsing ERROR");
-			}
+	if(print)
+	{
+		len = sprintf(line, "top : %u ms, %d tasks", (unsigned int)(elapsed / 1000), count);
+		for(i = 0; i < portNUM_PROCESSORS; i++)
+		{
+			len += sprintf(&line[len], ", cpu%d %d%%", i, (int)(100 - (uint64_t)((idle[i] < elapsed) ? idle[i] : elapsed) * 100 / elapsed));
+		}
+		PrintConsole("%s\r\n", line);
+
+		// cpu% is of one core, two busy cores add up to 200%
+		PrintConsole("task             core st prio   cpu%%  stack free\r\n");
+		for(i = 0; i < count; i++)
+		{
+			TaskStatus_t *t = &top_status[order[i]];
+			char core[4] = "-";
+
+#if (configTASKLIST_INCLUDE_COREID)
+			if(t->xCoreID >= 0 && t->xCoreID < portNUM_PROCESSORS) sprintf(core, "%d", (int)t->xCoreID);
+#endif
+			PrintConsole("%-16s %4s  %c %4d %4d.%d %11u\r\n", t->pcTaskName, core, top_state_char(t->eCurrentState),
+					(int)t->uxCurrentPriority, (int)((uint64_t)delta[order[i]] * 100 / elapsed),
+					(int)((uint64_t)delta[order[i]] * 1000 / elapsed % 10), (unsigned int)t->usStackHighWaterMark);
+		}
+
+		PrintConsole("heap             free   min free    largest\r\n");
+		for(i = 0; i < sizeof(heaps) / sizeof(heaps[0]); i++)
+		{
+			PrintConsole("%-10s %10u %10u %10u\r\n", heaps[i].name,
+					(unsigned int)heap_caps_get_free_size(heaps[i].caps),
+					(unsigned int)heap_caps_get_minimum_free_size(heaps[i].caps),
+					(unsigned int)heap_caps_get_largest_free_block(heaps[i].caps));
+		}
+	}
+
+	for(i = 0; i < count; i++)
+	{
+		top_prev[i].handle = top_status[i].xHandle;
+		top_prev[i].runtime = top_status[i].ulRunTimeCounter;
+	}
+	top_prev_count = count;
+	top_prev_total = total;
+}
+
+// Prints to the active console, the telnet client when one is connected.
+// Sleeps until 'top <seconds>' wakes it, the period can change at any time.
+static void TaskTop(void *arg)
+{
+	while(1)
+	{
+		if(top_period == 0)
+		{
+			ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+			top_sample(0);
+			continue;
 		}
+
+		if(ulTaskNotifyTake(pdTRUE, top_period * 1000 / portTICK_PERIOD_MS) == 0)
+		{
+			top_sample(1);
+		}
+	}
+}
+
+// top [seconds|stop]
+static void top_command(char **token, int token_count)
+{
+	int period;
+
+	if(token_count >= 2)
+	{
+		period = (strcmp(token[1], "stop") == 0) ? 0 : atoi(token[1]);
+		if(period < 0 || (period == 0 && strcmp(token[1], "stop") != 0))
+		{
+			LOGI("Usage : top [seconds|stop]");
+			return;
+		}
+
+		if(top_task == NULL && task_create(TASK_TOP, &TaskTop, NULL, &top_task) != pdPASS)
+		{
+			LOGE("ERROR : CAN'T creat top task");
+			top_task = NULL;
+			return;
+		}
+
+		top_period = period;
+		xTaskNotifyGive(top_task);
+		return;
+	}
+
+	if(top_period > 0)
+	{
+		LOGI("top is streaming every %d s, 'top stop' first", top_period);
+		return;
+	}
+
+	// usage over TOP_SAMPLE_MS
+	top_sample(0);
+	vTaskDelay(TOP_SAMPLE_MS / portTICK_PERIOD_MS);
+	top_sample(1);
+}
+#else
+static void top_command(char **token, int token_count)
+{
+	LOGI("top needs CONFIG_FREERTOS_USE_TRACE_FACILITY and CONFIG_FREERTOS_GENERATE_RUN_TIME_STATS");
+}
+#endif
+
+void CommandProcess(char *cmd_str)
+{
+	const char *delimiters = " \r\n";
+	char *token[10];
+	int i, token_count;
+	
+	if(json_stream_busy() || cmd_str[0] == '{')
+	{
+		CommandProcessJson(cmd_str, strlen(cmd_str));
 		return;
 	}
 
@@ -278,6 +468,58 @@ void CommandProcess(char *cmd_str)
 			LOGI("Invalid time command format");
 		}
 	}
+	else if(strcmp(token[0], CMD_TOP) == 0)
+	{
+		top_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_BENCH) == 0)
+	{
+		bench_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_FUZZ) == 0)
+	{
+		fuzz_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_SOAK) == 0)
+	{
+		soak_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_TRACE) == 0)
+	{
+		trace_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_TASK) == 0)
+	{
+		task_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_TURBO) == 0)
+	{
+		ota_turbo_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_STAGE) == 0)
+	{
+		ota_stage_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_CRYPT) == 0)
+	{
+		ota_crypt_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_TLS) == 0)
+	{
+		ota_tls_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_HEAP) == 0)
+	{
+		heap_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_QUEUE) == 0)
+	{
+		msg_queue_command(token, token_count);
+	}
+	else if(strcmp(token[0], CMD_OTA) == 0)
+	{
+		ota_command(token, token_count);
+	}
 	else
 	{
 		LOGW("Unknown command : %s", token[0]);
@@ -513,12 +755,7 @@ static void InitUartConsole(void)
 	TaskHandle_t handle;
 	int ret;
 
-	ret = xTaskCreatePinnedToCore(&TaskConsole, "UART console",
-            4096, 
-            NULL,
-            5,
-            &handle,
-            tskNO_AFFINITY /*PRO_CPU_NUM*/);
+	ret = task_create(TASK_UART_CONSOLE, &TaskConsole, NULL, &handle);
     if (ret != pdPASS) {
 		ESP_LOGE(TAG, "ERROR : CAN'T creat task");
         return;
@@ -530,12 +767,7 @@ static void InitTcpConsole(void)
 {
 	TaskHandle_t handle;
 
-	int ret = xTaskCreatePinnedToCore(&TaskTcpConsole, "TCP console",
-            4096, 
-            NULL,
-            5,
-            &handle,
-            tskNO_AFFINITY /*PRO_CPU_NUM*/);
+	int ret = task_create(TASK_TCP_CONSOLE, &TaskTcpConsole, NULL, &handle);
     if (ret != pdPASS) {
 		ESP_LOGE(TAG, "ERROR : CAN'T creat task");
         return;
@@ -0,0 +1,285 @@
+/**
+ * @file heap_tag.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Heap accounting per subsystem, zero allocation watch of the OTA transfer loop
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_attr.h"
+#include "esp_heap_caps.h"
+#if (CONFIG_HEAP_TASK_TRACKING)
+#include "esp_heap_task_info.h"
+#endif
+
+#include "debug.h"
+#include "heap_tag.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "HEAP"
+
+// index 0 is used by pthread
+#define HEAP_TAG_TLS_INDEX		(CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS - 1)
+#if (HEAP_TAG_TLS_INDEX < 1)
+#error "heap_tag needs CONFIG_FREERTOS_THREAD_LOCAL_STORAGE_POINTERS >= 2"
+#endif
+
+#define HEAP_LIVE_MAX_TASKS		32
+
+// Task name prefix -> tag, resolved once per task on its first allocation
+typedef struct {
+	const char *prefix;
+	uint8_t tag;
+} heap_task_map_t;
+
+/*---------------------------- Variables ---------------------------------*/
+#define HEAP_TAG_NAME(id, name)	name,
+static const char *heap_tag_names[HEAP_TAG_COUNT] = {
+	HEAP_TAG_TABLE(HEAP_TAG_NAME)
+};
+#undef HEAP_TAG_NAME
+
+static const heap_task_map_t heap_task_map[] = {
+	{ "nimble",			HEAP_TAG_BLE },
+	{ "btController",	HEAP_TAG_BLE },
+	{ "BLE-Rx",			HEAP_TAG_BLE },
+	{ "BLEOTA",			HEAP_TAG_OTA },
+	{ "TCPOTA",			HEAP_TAG_OTA },
+	{ "httpd",			HEAP_TAG_OTA },
+	{ "Broadcast",		HEAP_TAG_OTA },
+	{ "UART console",	HEAP_TAG_CONSOLE },
+	{ "TCP console",	HEAP_TAG_CONSOLE },
+	{ "top",			HEAP_TAG_CONSOLE },
+	{ "wifi",			HEAP_TAG_WIFI },
+	{ "tiT",			HEAP_TAG_WIFI },	// lwIP
+	{ "sys_evt",		HEAP_TAG_WIFI },
+};
+
+static heap_tag_stats_t heap_tag_stats[HEAP_TAG_COUNT];
+static heap_watch_t *volatile heap_watches[HEAP_TAG_MAX_WATCH];
+static portMUX_TYPE heap_watch_lock = portMUX_INITIALIZER_UNLOCKED;
+
+#if (CONFIG_HEAP_TASK_TRACKING)
+static heap_task_totals_t heap_live_totals[HEAP_LIVE_MAX_TASKS];
+static TaskStatus_t heap_live_tasks[HEAP_LIVE_MAX_TASKS];
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+
+static IRAM_ATTR int heap_tag_prefix(const char *name, const char *prefix)
+{
+	while(*prefix)
+	{
+		if(*name++ != *prefix++) return 0;
+	}
+	return 1;
+}
+
+static IRAM_ATTR int heap_tag_resolve(TaskHandle_t task)
+{
+	const char *name = pcTaskGetName(task);
+	int i;
+
+	for(i = 0; i < sizeof(heap_task_map) / sizeof(heap_task_map[0]); i++)
+	{
+		if(heap_tag_prefix(name, heap_task_map[i].prefix)) return heap_task_map[i].tag;
+	}
+	return HEAP_TAG_OTHER;
+}
+
+// Tag of the running task, kept in a thread local pointer as tag + 1 so a new task starts unresolved
+static IRAM_ATTR int heap_tag_current(void)
+{
+	TaskHandle_t task;
+	int tag;
+
+	if(xPortInIsrContext() || xTaskGetSchedulerState() == taskSCHEDULER_NOT_STARTED) return HEAP_TAG_OTHER;
+
+	task = xTaskGetCurrentTaskHandle();
+	tag = (int)(intptr_t)pvTaskGetThreadLocalStoragePointer(task, HEAP_TAG_TLS_INDEX);
+	if(tag == 0)
+	{
+		tag = heap_tag_resolve(task) + 1;
+		vTaskSetThreadLocalStoragePointer(task, HEAP_TAG_TLS_INDEX, (void *)(intptr_t)tag);
+	}
+	return tag - 1;
+}
+
+#if (CONFIG_HEAP_USE_HOOKS)
+// Called by heap_caps after every allocation, must not allocate
+IRAM_ATTR void esp_heap_trace_alloc_hook(void *ptr, size_t size, uint32_t caps)
+{
+	heap_tag_stats_t *s = &heap_tag_stats[heap_tag_current()];
+	heap_watch_t *w;
+	TaskHandle_t task;
+	int i;
+
+	__atomic_fetch_add(&s->allocs, 1, __ATOMIC_RELAXED);
+	__atomic_fetch_add(&s->bytes, size, __ATOMIC_RELAXED);
+	if(size > s->max_size) s->max_size = size;
+
+	if(xPortInIsrContext()) return;
+
+	task = xTaskGetCurrentTaskHandle();
+	for(i = 0; i < HEAP_TAG_MAX_WATCH; i++)
+	{
+		w = heap_watches[i];
+		if(w != NULL && w->task == task)
+		{
+			w->allocs++;
+			w->bytes += size;
+		}
+	}
+}
+
+IRAM_ATTR void esp_heap_trace_free_hook(void *ptr)
+{
+	__atomic_fetch_add(&heap_tag_stats[heap_tag_current()].frees, 1, __ATOMIC_RELAXED);
+}
+#endif
+
+static void heap_tag_failed(size_t size, uint32_t caps, const char *function_name)
+{
+	__atomic_fetch_add(&heap_tag_stats[heap_tag_current()].failed, 1, __ATOMIC_RELAXED);
+}
+
+void heap_tag_init(void)
+{
+	heap_caps_register_failed_alloc_callback(heap_tag_failed);
+}
+
+// Charge the allocations of the running task to 'tag' until heap_tag_pop(), return the previous tag
+int heap_tag_push(int tag)
+{
+	int prev = heap_tag_current();
+
+	vTaskSetThreadLocalStoragePointer(NULL, HEAP_TAG_TLS_INDEX, (void *)(intptr_t)(tag + 1));
+	return prev;
+}
+
+void heap_tag_pop(int prev)
+{
+	vTaskSetThreadLocalStoragePointer(NULL, HEAP_TAG_TLS_INDEX, (void *)(intptr_t)(prev + 1));
+}
+
+void heap_tag_stats_get(int tag, heap_tag_stats_t *stats)
+{
+	*stats = heap_tag_stats[tag];
+}
+
+// Start counting the allocations of the running task. Without CONFIG_HEAP_USE_HOOKS nothing is counted.
+void heap_watch_begin(heap_watch_t *w)
+{
+	int i;
+
+	w->task = xTaskGetCurrentTaskHandle();
+	w->allocs = 0;
+	w->bytes = 0;
+
+	portENTER_CRITICAL(&heap_watch_lock);
+	for(i = 0; i < HEAP_TAG_MAX_WATCH; i++)
+	{
+		if(heap_watches[i] == NULL)
+		{
+			heap_watches[i] = w;
+			break;
+		}
+	}
+	portEXIT_CRITICAL(&heap_watch_lock);
+
+	if(i == HEAP_TAG_MAX_WATCH)
+	{
+		LOGW("No free heap watch slot, HEAP_TAG_MAX_WATCH %d", HEAP_TAG_MAX_WATCH);
+		w->task = NULL;
+	}
+}
+
+// Stop the watch, return the allocations seen. Safe to call twice.
+uint32_t heap_watch_end(heap_watch_t *w)
+{
+	int i;
+
+	portENTER_CRITICAL(&heap_watch_lock);
+	for(i = 0; i < HEAP_TAG_MAX_WATCH; i++)
+	{
+		if(heap_watches[i] == w) heap_watches[i] = NULL;
+	}
+	portEXIT_CRITICAL(&heap_watch_lock);
+
+	w->task = NULL;
+	return w->allocs;
+}
+
+/*---------------------------- Console -----------------------------------*/
+#if (CONFIG_HEAP_TASK_TRACKING)
+// Bytes currently held per tag. Blocks of deleted tasks are charged to "other".
+static void heap_live_bytes(uint32_t live[HEAP_TAG_COUNT])
+{
+	heap_task_info_params_t params;
+	size_t num_totals = 0;
+	int i, j, n, tag;
+
+	memset(&params, 0, sizeof(params));	// caps 0, mask 0 : every heap
+	params.totals = heap_live_totals;
+	params.num_totals = &num_totals;
+	params.max_totals = HEAP_LIVE_MAX_TASKS;
+	heap_caps_get_per_task_info(&params);
+
+	n = uxTaskGetSystemState(heap_live_tasks, HEAP_LIVE_MAX_TASKS, NULL);
+
+	for(i = 0; i < num_totals; i++)
+	{
+		tag = HEAP_TAG_OTHER;
+		for(j = 0; j < n; j++)
+		{
+			if(heap_live_tasks[j].xHandle == heap_live_totals[i].task)
+			{
+				tag = heap_tag_resolve(heap_live_totals[i].task);
+				break;
+			}
+		}
+		live[tag] += heap_live_totals[i].size[0];
+	}
+}
+#endif
+
+// heap [reset]
+void heap_command(char **token, int token_count)
+{
+	uint32_t live[HEAP_TAG_COUNT] = { 0 };
+	heap_tag_stats_t *s;
+	int i;
+
+	if(token_count >= 2 && strcmp(token[1], "reset") == 0)
+	{
+		memset(heap_tag_stats, 0, sizeof(heap_tag_stats));
+		return;
+	}
+
+#if !(CONFIG_HEAP_USE_HOOKS)
+	LOGI("Allocation counters need CONFIG_HEAP_USE_HOOKS");
+#endif
+#if (CONFIG_HEAP_TASK_TRACKING)
+	heap_live_bytes(live);
+#else
+	LOGI("Live bytes need CONFIG_HEAP_TASK_TRACKING");
+#endif
+
+	PrintConsole("tag         allocs    frees  failed   alloc KB   max size       live\r\n");
+	for(i = 0; i < HEAP_TAG_COUNT; i++)
+	{
+		s = &heap_tag_stats[i];
+		PrintConsole("%-8s %9u %8u %7u %10u %10u %10u\r\n", heap_tag_names[i], (unsigned int)s->allocs,
+				(unsigned int)s->frees, (unsigned int)s->failed, (unsigned int)(s->bytes / 1024),
+				(unsigned int)s->max_size, (unsigned int)live[i]);
+	}
+	PrintConsole("free %u, min free %u, largest block %u\r\n", (unsigned int)heap_caps_get_free_size(MALLOC_CAP_DEFAULT),
+			(unsigned int)heap_caps_get_minimum_free_size(MALLOC_CAP_DEFAULT),
+			(unsigned int)heap_caps_get_largest_free_block(MALLOC_CAP_DEFAULT));
+}
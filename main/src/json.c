@@ -2,7 +2,7 @@
 //  File    : json.c
 //---------------------------------------------------------------------------
 //  Description: 
-//             JSON Parser
+//             JSON Parser / Writer
 //  
 //  
 //  History : 
@@ -16,44 +16,102 @@
 #include <ctype.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 #include <sys/time.h>
 #include <sys/unistd.h>
 #include "mbedtls/base64.h"
 
 #include "esp_system.h"
 #include "esp_log.h"
+// Parent links give O(1) bracket closing when the parser resumes on a new fragment,
+// strict mode keeps a number split across two fragments from being cut short.
+#define JSMN_PARENT_LINKS
+#define JSMN_STRICT
 #include "jsmn.h"
 #include "debug.h"
 #include "ota.h"
+#include "json.h"
+#include "cbor.h"
+#include "msg_queue.h"
+#include "heap_tag.h"
+#include "ota_stage.h"
 
 /*---------------------------- User define -------------------------------*/
 #define TAG	"JSON"
 
-#define MAX_JSON_PACKET_SIZE	(3 * 1024)
-#define MAX_JSON_PARSING_TOKEN	32
+#define MAX_JSON_STRING			2048
+#define JSON_TOKEN_POOL_MIN		32
+#define JSON_TOKEN_POOL_MAX		256
 
 #define JSON_KEY_DATETIME			"datetime"
 #define JSON_KEY_FIRMWARE			"firmware"
 #define JSON_KEY_START				"start"
 #define JSON_KEY_OTA				"ota"
 #define JSON_KEY_OTA_SIZE			"ota size"
+#define JSON_KEY_OTA_SHA256			"ota sha256"
+#define JSON_KEY_QUEUE				"queue"
+#define JSON_KEY_MAX_DEPTH			"max depth"
+#define JSON_KEY_TIMEOUTS			"timeouts"
 
 #define JSON_VALUE_START			"start"
 #define JSON_VALUE_READY			"ready"
+#define JSON_VALUE_SWITCH			"switch"	// boot the other valid slot, no transfer
+#define JSON_VALUE_STAGED			"staged"	// requested image already in a slot, selected for boot
+#define JSON_VALUE_REJECTED			"rejected"	// image header refused, transfer aborted
 #define JSON_VALUE_NOT_READY		"not ready"
 #define JSON_VALUE_INVALID_SIZE		"invalid size"
 
 #define JSON_KEY_GROUPS			"groups"
 
+#define STATUS_DOC_SIZE			288
+#define STATUS_DATETIME_LEN		19	// "YYYY-MM-DD hh:mm:ss"
+
+#define STATUS_DIRTY_OTA		(1 << 0)
+#define STATUS_DIRTY_FIRMWARE	(1 << 1)
+#define STATUS_DIRTY_QUEUE		(1 << 2)
+#define STATUS_DIRTY_ALL		(STATUS_DIRTY_OTA | STATUS_DIRTY_FIRMWARE | STATUS_DIRTY_QUEUE)
+
+// Serialized status response, rebuilt only when a field changes.
+// The datetime value has a fixed width and is patched in place every second.
+typedef struct {
+	uint8_t buf[STATUS_DOC_SIZE];
+	int len;
+	int datetime_ofs;
+	time_t datetime;	// second currently written at datetime_ofs
+	uint32_t dirty;
+} status_doc_t;
+
+typedef struct {
+	uint8_t *buf;
+	int size;
+	int len;
+} mem_sink_t;
+
 /*---------------------------- Variables ---------------------------------*/
-static jsmntok_t json_token[MAX_JSON_PARSING_TOKEN]; /* We expect no more than MAX_JSON_PARSING_TOKEN tokens */
+static jsmntok_t *json_token;	/* grown on demand from JSON_TOKEN_POOL_MIN up to JSON_TOKEN_POOL_MAX tokens */
+static int json_token_num;
+static jsmn_parser json_parser;
+static char json_string[MAX_JSON_STRING + 1];
+static int json_len;
+static bool json_in_process;
+static bool json_dry_run;	// bench / fuzz : parse and look up keys but don't apply values
 static int ota_start;
 static int ota_size;
+static int ota_switch;
+static int ota_hash_set;
+static uint8_t ota_hash[OTA_HASH_SIZE];
+static int ota_staged;
+static int ota_rejected;
 static int file_transfer_flag;
 static int file_transfer_type;	// 1 : compress, 0 : plain
 static char transfer_filename[64];
-static uint8_t json_packet[MAX_JSON_PACKET_SIZE];
+static status_doc_t status_doc[2] = {	// MSG_FORMAT_JSON, MSG_FORMAT_CBOR
+	{ .dirty = STATUS_DIRTY_ALL },
+	{ .dirty = STATUS_DIRTY_ALL },
+};
+static uint32_t status_queue_gen;	// msg_queue_summary_gen() the documents were built with
 /*-------------------------- Function declares ---------------------------*/
+static void status_mark_dirty(uint32_t bits);
 
 //void base64_encode(uint8_t *in, char *out)
 //{
@@ -61,158 +119,881 @@ static uint8_t json_packet[MAX_JSON_PACKET_SIZE];
 //	mbedtls_base64_decode(unsigned char * dst, size_t dlen, size_t * olen, const unsigned char * src, size_t slen)
 //}
 
-void send_json_info(void)
+/*---------------------------- Writer ------------------------------------*/
+static void json_out(json_writer_t *w, const void *data, int len)
 {
-	struct tm *st_time;
-	time_t _time;
-	char buf[256];
-	
-	_time = time(0);
-	st_time = localtime(&_time);
+	if(w->err || len <= 0) return;
 
-	sprintf((char *)json_packet, "{\n\t\""JSON_KEY_DATETIME"\":\"%04d-%02d-%02d %02d:%02d:%02d\"", 
-		st_time->tm_year+1900, st_time->tm_mon+1, st_time->tm_mday, st_time->tm_hour, st_time->tm_min, st_time->tm_sec);
-	sprintf(buf, ",\n\t\""JSON_KEY_FIRMWARE"\":\"%s\"", get_version_string());
-	strcat((char *)json_packet, buf);
+	if(w->sink(w->ctx, data, len) != 0)
+	{
+		w->err = -1;
+	}
+	w->total += len;
+}
 
-	if(is_ota_ready())
+static void json_indent(json_writer_t *w, int depth)
+{
+	static const char tabs[JSON_WRITER_MAX_DEPTH + 1] = "\n\t\t\t\t\t\t\t\t";
+
+	if(w->pretty)
 	{
-		sprintf(buf, ",\n\t\""JSON_KEY_OTA"\":\""JSON_VALUE_READY"\"" );
+		json_out(w, tabs, 1 + (depth < JSON_WRITER_MAX_DEPTH ? depth : JSON_WRITER_MAX_DEPTH));
 	}
-	else
+}
+
+// Separator and indentation before a new key or array element
+static void json_item(json_writer_t *w)
+{
+	uint32_t bit = 1u << w->depth;
+
+	if(w->has_item & bit)
 	{
-		if(ota_size < 0 || ota_size > 0x0F0000)
-		{
-			sprintf(buf, ",\n\t\""JSON_KEY_OTA"\":\""JSON_VALUE_INVALID_SIZE"\"" );
-		}
-		else
+		json_out(w, ",", 1);
+	}
+	w->has_item |= bit;
+	json_indent(w, w->depth);
+}
+
+// Array elements need the same separator as object keys
+static void json_element(json_writer_t *w)
+{
+	if(w->is_array & (1u << w->depth))
+	{
+		json_item(w);
+	}
+}
+
+static void json_open(json_writer_t *w, char c)
+{
+	if(w->depth >= JSON_WRITER_MAX_DEPTH)
+	{
+		w->err = -1;
+		return;
+	}
+
+	json_out(w, &c, 1);
+	w->depth++;
+	w->has_item &= ~(1u << w->depth);
+	w->is_array &= ~(1u << w->depth);
+}
+
+static void json_close(json_writer_t *w, char c)
+{
+	if(w->depth <= 0)
+	{
+		w->err = -1;
+		return;
+	}
+
+	if(w->has_item & (1u << w->depth))
+	{
+		json_indent(w, w->depth - 1);
+	}
+	w->depth--;
+	json_out(w, &c, 1);
+}
+
+static void json_string_out(json_writer_t *w, const char *str)
+{
+	const char *run = str;
+	char esc[2] = {'\\', 0};
+
+	json_out(w, "\"", 1);
+	for(; *str; str++)
+	{
+		switch(*str)
 		{
-			sprintf(buf, ",\n\t\""JSON_KEY_OTA"\":\""JSON_VALUE_NOT_READY"\"" );
+			case '"':	esc[1] = '"';	break;
+			case '\\':	esc[1] = '\\';	break;
+			case '\n':	esc[1] = 'n';	break;
+			case '\r':	esc[1] = 'r';	break;
+			case '\t':	esc[1] = 't';	break;
+			default:	continue;
 		}
+		json_out(w, run, str - run);
+		json_out(w, esc, 2);
+		run = str + 1;
 	}
-	strcat((char *)json_packet, buf);
+	json_out(w, run, str - run);
+	json_out(w, "\"", 1);
+}
 
-	strcat((char *)json_packet, "\n}\x04");
+void json_writer_init(json_writer_t *w, json_sink_t sink, void *ctx, int pretty)
+{
+	memset(w, 0, sizeof(json_writer_t));
+	w->sink = sink;
+	w->ctx = ctx;
+	w->pretty = pretty;
+}
 
-	LOGI("Send message : \n%s", json_packet);
+void json_begin_object(json_writer_t *w)
+{
+	json_element(w);
+	json_open(w, '{');
+}
+
+void json_end_object(json_writer_t *w)
+{
+	json_close(w, '}');
+}
+
+void json_begin_array(json_writer_t *w)
+{
+	json_element(w);
+	json_open(w, '[');
+	w->is_array |= 1u << w->depth;
+}
+
+void json_end_array(json_writer_t *w)
+{
+	json_close(w, ']');
+}
+
+void json_key(json_writer_t *w, const char *key)
+{
+	json_item(w);
+	json_string_out(w, key);
+	json_out(w, ":", 1);
+}
+
+void json_value_str(json_writer_t *w, const char *str)
+{
+	json_element(w);
+	json_string_out(w, str);
+}
+
+void json_value_int(json_writer_t *w, int num)
+{
+	char buf[12];
+	int i = sizeof(buf);
+	unsigned int u = (num < 0) ? -(unsigned int)num : (unsigned int)num;
+
+	do
+	{
+		buf[--i] = '0' + (u % 10);
+		u /= 10;
+	} while(u);
+
+	if(num < 0) buf[--i] = '-';
+
+	json_element(w);
+	json_out(w, &buf[i], sizeof(buf) - i);
+}
 
-	_nordic_uart_send(json_packet, strlen((char *)json_packet));
+int json_writer_end(json_writer_t *w)
+{
+	if(w->depth != 0) w->err = -1;
+
+	return w->err;
+}
+
+/*---------------------------- Responses ---------------------------------*/
+static const char *json_ota_state_str(void)
+{
+	if(ota_staged) return JSON_VALUE_STAGED;
+
+	if(ota_rejected) return JSON_VALUE_REJECTED;
 
-	LOGI("JSON send finished");
+	if(is_ota_ready()) return JSON_VALUE_READY;
+
+	if(ota_size < 0 || ota_size > 0x0F0000) return JSON_VALUE_INVALID_SIZE;
+
+	return JSON_VALUE_NOT_READY;
+}
+
+/*---------------------------- Status document ---------------------------*/
+static void status_mark_dirty(uint32_t bits)
+{
+	status_doc[MSG_FORMAT_JSON].dirty |= bits;
+	status_doc[MSG_FORMAT_CBOR].dirty |= bits;
 }
 
-static int jsoneq(const char *json, jsmntok_t *tok, const char *s) 
+static int mem_sink_write(void *ctx, const void *data, int len)
 {
-	if (tok->type == JSMN_STRING && (int)strlen(s) == tok->end - tok->start &&
-	  strncmp(json + tok->start, s, tok->end - tok->start) == 0) 
+	mem_sink_t *mem = (mem_sink_t *)ctx;
+
+	if(mem->len + len > mem->size) return -1;
+
+	memcpy(&mem->buf[mem->len], data, len);
+	mem->len += len;
+	return 0;
+}
+
+static void status_datetime_str(time_t now, char *buf, int size)
+{
+	struct tm st_time;
+
+	// a year past 9999 makes it longer than STATUS_DATETIME_LEN : the callers check the length
+	if(localtime_r(&now, &st_time) == NULL || strftime(buf, size, "%Y-%m-%d %H:%M:%S", &st_time) == 0)
 	{
+		buf[0] = 0;
+	}
+}
+
+// Return : offset of the datetime value in the output, -1 on error
+static int status_write_json(json_writer_t *w, const char *datetime)
+{
+	msg_queue_t *q;
+	int ofs, i;
+
+	json_begin_object(w);
+	json_key(w, JSON_KEY_DATETIME);
+	ofs = w->total + 1;	// opening quote
+	json_value_str(w, datetime);
+	json_key(w, JSON_KEY_FIRMWARE);
+	json_value_str(w, get_version_string());
+	json_key(w, JSON_KEY_OTA);
+	json_value_str(w, json_ota_state_str());
+	json_key(w, JSON_KEY_QUEUE);
+	json_begin_object(w);
+	for(i = 0; i < msg_queue_count(); i++)
+	{
+		q = msg_queue_get(i);
+		json_key(w, q->name);
+		json_begin_object(w);
+		json_key(w, JSON_KEY_MAX_DEPTH);
+		json_value_int(w, q->stats.max_depth);
+		json_key(w, JSON_KEY_TIMEOUTS);
+		json_value_int(w, q->stats.timeouts);
+		json_end_object(w);
+	}
+	json_end_object(w);
+	json_end_object(w);
+
+	return (json_writer_end(w) == 0) ? ofs : -1;
+}
+
+// Same document as status_write_json(), CBOR is self delimiting so no EOT is added
+static int status_write_cbor(cbor_writer_t *w, const char *datetime)
+{
+	msg_queue_t *q;
+	int ofs, i;
+
+	cbor_map(w, 4);
+	cbor_text(w, JSON_KEY_DATETIME);
+	ofs = w->total + 1;	// text header, length < 24
+	cbor_text(w, datetime);
+	cbor_text(w, JSON_KEY_FIRMWARE);
+	cbor_text(w, get_version_string());
+	cbor_text(w, JSON_KEY_OTA);
+	cbor_text(w, json_ota_state_str());
+	cbor_text(w, JSON_KEY_QUEUE);
+	cbor_map(w, msg_queue_count());
+	for(i = 0; i < msg_queue_count(); i++)
+	{
+		q = msg_queue_get(i);
+		cbor_text(w, q->name);
+		cbor_map(w, 2);
+		cbor_text(w, JSON_KEY_MAX_DEPTH);
+		cbor_int(w, q->stats.max_depth);
+		cbor_text(w, JSON_KEY_TIMEOUTS);
+		cbor_int(w, q->stats.timeouts);
+	}
+
+	return (w->err == 0) ? ofs : -1;
+}
+
+// Bring the cached document up to date : full rebuild if a field is dirty, otherwise only a new second
+static int status_refresh(int format, time_t now)
+{
+	status_doc_t *doc = &status_doc[format];
+	char datetime[24];
+	mem_sink_t mem;
+	json_writer_t jw;
+	cbor_writer_t cw;
+	int ofs;
+
+	if(!doc->dirty && doc->datetime == now) return 0;
+
+	status_datetime_str(now, datetime, sizeof(datetime));
+
+	if(!doc->dirty && strlen(datetime) == STATUS_DATETIME_LEN)
+	{
+		memcpy(&doc->buf[doc->datetime_ofs], datetime, STATUS_DATETIME_LEN);
+		doc->datetime = now;
 		return 0;
 	}
-	
-	return -1;
+
+	mem.buf = doc->buf;
+	mem.size = sizeof(doc->buf);
+	mem.len = 0;
+
+	if(format == MSG_FORMAT_CBOR)
+	{
+		cbor_writer_init(&cw, mem_sink_write, &mem);
+		ofs = status_write_cbor(&cw, datetime);
+	}
+	else
+	{
+		json_writer_init(&jw, mem_sink_write, &mem, 1);
+		ofs = status_write_json(&jw, datetime);
+		if(mem_sink_write(&mem, "\x04", 1) != 0) ofs = -1;
+	}
+
+	if(ofs < 0 || strlen(datetime) != STATUS_DATETIME_LEN)
+	{
+		// doesn't fit or can't be patched : keep it dirty, the caller streams it instead
+		doc->dirty = STATUS_DIRTY_ALL;
+		return -1;
+	}
+
+	doc->len = mem.len;
+	doc->datetime_ofs = ofs;
+	doc->datetime = now;
+	doc->dirty = 0;
+	return 0;
 }
 
-/*******************************************
-Return : EVENT_REQUEST 에 대한 응답을 우선 처리함.
-         EVENT_REQUEST 가 있을 경우 다른 key 값이 있어도 처리만 하고 응답은 보내지 않음
--1 : Parsing error
-0  : Request event data
-1  : Set parameters or delete
-2  : OTA
-*******************************************/
-int json_parsing(char *json_string)
+// Fallback when the document doesn't fit in the cache : serialize straight into MTU sized notifications
+static esp_err_t status_stream(int format, time_t now)
+{
+	char datetime[24];
+	ble_tx_stream_t tx;
+	json_writer_t jw;
+	cbor_writer_t cw;
+	int ofs;
+
+	status_datetime_str(now, datetime, sizeof(datetime));
+
+	ble_tx_begin(&tx);
+	if(format == MSG_FORMAT_CBOR)
+	{
+		cbor_writer_init(&cw, ble_tx_write, &tx);
+		ofs = status_write_cbor(&cw, datetime);
+	}
+	else
+	{
+		json_writer_init(&jw, ble_tx_write, &tx, 1);
+		ofs = status_write_json(&jw, datetime);
+		ble_tx_write(&tx, "\x04", 1);
+	}
+
+	if(ofs < 0) return ESP_FAIL;
+
+	return ble_tx_end(&tx);
+}
+
+static void send_status_format(int format)
+{
+	time_t now = time(0);
+	esp_err_t err;
+
+	if(msg_queue_summary_gen() != status_queue_gen)
+	{
+		status_queue_gen = msg_queue_summary_gen();
+		status_mark_dirty(STATUS_DIRTY_QUEUE);
+	}
+
+	if(status_refresh(format, now) == 0)
+	{
+		err = _nordic_uart_send(status_doc[format].buf, status_doc[format].len);
+	}
+	else
+	{
+		err = status_stream(format, now);
+	}
+
+	if(err != ESP_OK)
+	{
+		LOGE("Status send ERROR : %d", format);
+		return;
+	}
+
+	LOGI("Status send finished");
+}
+
+void send_json_info(void)
+{
+	send_status_format(MSG_FORMAT_JSON);
+}
+
+void send_cbor_info(void)
+{
+	send_status_format(MSG_FORMAT_CBOR);
+}
+
+void send_status_info(void)
+{
+	send_status_format(ble_get_msg_format());
+}
+
+/*---------------------------- Key schema --------------------------------*/
+// Every control key is described once here : X(id, key, first char, last char, value type, handler)
+// The lookup switch is generated from this table, keyed by (length, first char, last char).
+// Two keys with the same hash produce a duplicate case label, so collisions fail at compile time.
+#define JSON_KEY_SCHEMA(X) \
+	X(JSON_ID_OTA,		JSON_KEY_OTA,		'o', 'a', JSON_TYPE_STRING,	json_on_ota) \
+	X(JSON_ID_OTA_SIZE,	JSON_KEY_OTA_SIZE,	'o', 'e', JSON_TYPE_INT,	json_on_ota_size) \
+	X(JSON_ID_OTA_SHA256,	JSON_KEY_OTA_SHA256,	'o', '6', JSON_TYPE_STRING,	json_on_ota_sha256) \
+	X(JSON_ID_GROUPS,	JSON_KEY_GROUPS,	'g', 's', JSON_TYPE_ARRAY,	json_on_groups) \
+	X(JSON_ID_DATETIME,	JSON_KEY_DATETIME,	'd', 'e', JSON_TYPE_STRING,	json_on_datetime)
+
+#define JSON_KEY_LEN(key)				((int)sizeof(key) - 1)
+#define JSON_KEY_HASH(len, first, last)	(((len) << 16) | ((uint8_t)(first) << 8) | (uint8_t)(last))
+
+typedef void (*json_key_handler_t)(const json_value_t *value);
+
+typedef struct {
+	const char *key;
+	int type;
+	json_key_handler_t handler;
+} json_key_def_t;
+
+#define JSON_KEY_ENUM(id, key, first, last, type, handler)	id,
+enum {
+	JSON_ID_UNKNOWN = 0,
+	JSON_KEY_SCHEMA(JSON_KEY_ENUM)
+	JSON_ID_MAX
+};
+#undef JSON_KEY_ENUM
+
+static void json_on_ota(const json_value_t *value);
+static void json_on_ota_size(const json_value_t *value);
+static void json_on_ota_sha256(const json_value_t *value);
+static void json_on_groups(const json_value_t *value);
+static void json_on_datetime(const json_value_t *value);
+
+#define JSON_KEY_DEF(id, key, first, last, type, handler)	[id] = { key, type, handler },
+static const json_key_def_t json_keys[JSON_ID_MAX] = {
+	JSON_KEY_SCHEMA(JSON_KEY_DEF)
+};
+#undef JSON_KEY_DEF
+
+static int json_key_lookup(const char *s, int len)
+{
+	if(len <= 0) return JSON_ID_UNKNOWN;
+
+	switch(JSON_KEY_HASH(len, s[0], s[len - 1]))
+	{
+#define JSON_KEY_CASE(id, key, first, last, type, handler) \
+		case JSON_KEY_HASH(JSON_KEY_LEN(key), first, last): \
+			return (memcmp(s, key, len) == 0) ? id : JSON_ID_UNKNOWN;
+		JSON_KEY_SCHEMA(JSON_KEY_CASE)
+#undef JSON_KEY_CASE
+		default:
+			break;
+	}
+
+	return JSON_ID_UNKNOWN;
+}
+
+/*---------------------------- Value extraction --------------------------*/
+// Parse a decimal integer directly from the token, quoted numbers are accepted too.
+static int json_token_int(const char *json, jsmntok_t *tok, int *out)
 {
-	int ret = 1;
-	int i, r;
-	jsmn_parser p;
-	char str_value[64];
-//	char str_groups[5][100];
+	const char *p = json + tok->start;
+	const char *end = json + tok->end;
+	int neg = 0, val = 0, d;
+
+	if(p < end && *p == '-')
+	{
+		neg = 1;
+		p++;
+	}
+	if(p >= end) return -1;
+
+	for(; p < end; p++)
+	{
+		if(*p < '0' || *p > '9') return -1;
+		d = *p - '0';
+		if(val > (INT_MAX - d) / 10) return -1;	// would wrap into a size the OTA start accepts
+		val = val * 10 + d;
+	}
+
+	*out = neg ? -val : val;
+	return 0;
+}
+
+static int json_value_eq(const json_value_t *value, const char *s)
+{
+	return (value->len == (int)strlen(s) && memcmp(value->str, s, value->len) == 0);
+}
+
+static int json_digits(const char *s, int n)
+{
+	int val = 0;
+
+	while(n--)
+	{
+		if(*s < '0' || *s > '9') return -1;
+		val = val * 10 + (*s++ - '0');
+	}
+	return val;
+}
+
+/*---------------------------- Key handlers ------------------------------*/
+static void json_on_ota(const json_value_t *value)
+{
+	if(json_value_eq(value, JSON_VALUE_START))
+	{
+		LOGI("Received OTA start command");
+		ota_start = 1;
+		status_mark_dirty(STATUS_DIRTY_OTA);
+	}
+	else if(json_value_eq(value, JSON_VALUE_SWITCH))
+	{
+		LOGI("Received OTA switch command");
+		ota_switch = 1;
+	}
+	else
+	{
+		LOGI("Received OTA key but not 'start' : %.*s", value->len, value->str);
+	}
+}
+
+static void json_on_ota_size(const json_value_t *value)
+{
+	ota_size = value->num;
+	status_mark_dirty(STATUS_DIRTY_OTA);
+	if(ota_size > 0)
+	{
+		LOGI("Received OTA size : %d", ota_size);
+	}
+	else
+	{
+		LOGI("Received OTA SIZE key but invalid size : %d (0x%08X)", ota_size, ota_size);
+	}
+}
+
+// SHA-256 of the image, 64 hex digits : no transfer if a slot already holds it
+static void json_on_ota_sha256(const json_value_t *value)
+{
+	if(ota_stage_hex(value->str, value->len, ota_hash) != 0)
+	{
+		LOGI("Received invalid OTA SHA-256 : %.*s", value->len, value->str);
+		return;
+	}
+	ota_hash_set = 1;
+}
+
+static void json_on_groups(const json_value_t *value)
+{
+	if(value->index == 0) LOGI("- Groups:");
+	LOGI("  * %.*s", value->len, value->str);
+}
+
+// "YYYY-MM-DD hh:mm:ss", same format as send_json_info()
+static void json_on_datetime(const json_value_t *value)
+{
+	const char *s = value->str;
+	struct tm _time;
+	struct timeval now;
+
+	if(value->len != 19 || s[4] != '-' || s[7] != '-' || s[10] != ' ' || s[13] != ':' || s[16] != ':')
+	{
+		LOGI("Received invalid datetime : %.*s", value->len, value->str);
+		return;
+	}
+
+	memset(&_time, 0, sizeof(_time));
+	_time.tm_year = json_digits(&s[0], 4) - 1900;
+	_time.tm_mon = json_digits(&s[5], 2) - 1;
+	_time.tm_mday = json_digits(&s[8], 2);
+	_time.tm_hour = json_digits(&s[11], 2);
+	_time.tm_min = json_digits(&s[14], 2);
+	_time.tm_sec = json_digits(&s[17], 2);
+
+	if(_time.tm_year < 0 || _time.tm_mon < 0 || _time.tm_mday < 0 ||
+	   _time.tm_hour < 0 || _time.tm_min < 0 || _time.tm_sec < 0)
+	{
+		LOGI("Received invalid datetime : %.*s", value->len, value->str);
+		return;
+	}
+
+	now.tv_sec = mktime(&_time);
+	now.tv_usec = 0;
+	settimeofday(&now, NULL);
+
+	LOGI("Set new time : %.*s", value->len, value->str);
+}
+
+/*---------------------------- Dispatch ----------------------------------*/
+// Index of the token following token i and all of its children
+static int json_skip(jsmntok_t *tok, int i, int count)
+{
+	int end = tok[i].end;
+
+	for(i++; i < count && tok[i].start < end; i++);
+
+	return i;
+}
+
+static void json_dispatch(const char *json, int id, jsmntok_t *tok, int i, int count)
+{
+	const json_key_def_t *def = &json_keys[id];
+	json_value_t value;
+	int j;
+
+	memset(&value, 0, sizeof(value));
+	value.type = def->type;
+
+	switch(def->type)
+	{
+		case JSON_TYPE_INT:
+			if(json_token_int(json, &tok[i], &value.num) != 0)
+			{
+				LOGI("Key '%s' expects a number : %.*s", def->key, tok[i].end - tok[i].start, json + tok[i].start);
+				return;
+			}
+			json_command_value(id, &value);
+		break;
+
+		case JSON_TYPE_STRING:
+			value.str = json + tok[i].start;
+			value.len = tok[i].end - tok[i].start;
+			json_command_value(id, &value);
+		break;
+
+		case JSON_TYPE_ARRAY:
+			if(tok[i].type != JSMN_ARRAY)
+			{
+				LOGI("Key '%s' expects an array", def->key);
+				return;
+			}
+			value.count = tok[i].size;
+			for(j = i + 1; j < count && value.index < value.count; j = json_skip(tok, j, count))
+			{
+				value.str = json + tok[j].start;
+				value.len = tok[j].end - tok[j].start;
+				json_command_value(id, &value);
+				value.index++;
+			}
+		break;
+	}
+}
+
+/*---------------------------- Command API -------------------------------*/
+// Shared by the JSON and CBOR decoders : begin, lookup + value per key, end
+void json_command_begin(void)
+{
+	if(json_dry_run) return;
 
 	ota_start = 0;
 	ota_size = 0;
+	ota_switch = 0;
+	ota_hash_set = 0;
+	ota_rejected = 0;
+	status_mark_dirty(STATUS_DIRTY_OTA);
 	file_transfer_flag = 0;
 	file_transfer_type = 0;	// default : plain
 	memset(transfer_filename, 0, sizeof(transfer_filename));
+}
 
-	jsmn_init(&p);
+// Return : key id, 0 if the key is unknown. *type : JSON_TYPE_xxx expected for the value
+int json_command_lookup(const char *key, int len, int *type)
+{
+	int id = json_key_lookup(key, len);
 
-	r = jsmn_parse(&p, json_string, strlen(json_string), json_token,
-                 sizeof(json_token) / sizeof(json_token[0]));
-	if (r < 0) 
+	if(id == JSON_ID_UNKNOWN)
 	{
-		LOGI("Failed to parse JSON: %d", r);
-		return -1;
+		LOGI("Unexpected key: %.*s", len, key);
+		return JSON_ID_UNKNOWN;
+	}
+
+	*type = json_keys[id].type;
+	return id;
+}
+
+void json_command_value(int id, const json_value_t *value)
+{
+	if(id <= JSON_ID_UNKNOWN || id >= JSON_ID_MAX) return;
+	if(json_dry_run) return;
+
+	json_keys[id].handler(value);
+}
+
+// Staged image or slot switch : boot partition changed, the status reply says "staged" before the restart
+static void json_stage(void)
+{
+	const esp_partition_t *part = NULL;
+
+	if(ota_hash_set && is_ota_ready()) part = ota_stage_find(ota_hash, ota_size);
+	else if(ota_switch) part = ota_stage_other();
+
+	if(part == NULL)
+	{
+		if(ota_switch) LOGW("No other valid image to boot");
+		return;
 	}
+	if(ota_stage_boot(part) != ESP_OK) return;
+
+	ota_start = 0;
+	ota_staged = 1;
+	status_mark_dirty(STATUS_DIRTY_OTA);
+}
+
+// Return : 1 set parameters, 2 OTA ready
+int json_command_end(void)
+{
+	if(!json_dry_run && (ota_hash_set || ota_switch)) json_stage();
+
+	if(is_ota_ready()) return 2;
+	
+	return 1;
+}
+
+static int json_apply(const char *json, int count)
+{
+	int i, id, type;
+
+	json_command_begin();
 
 	/* Assume the top-level element is an object */
-	if (r < 1 || json_token[0].type != JSMN_OBJECT) 
+	if (count < 1 || json_token[0].type != JSMN_OBJECT) 
 	{
 		LOGI("Object expected");
 		return -1;
 	}
 
-	/* Loop over all keys of the root object */
-	for (i = 1; i < r; i++) 
+	/* Loop over all keys of the root object, i : key, i + 1 : value */
+	for (i = 1; i + 1 < count; i = json_skip(json_token, i + 1, count)) 
 	{
-		if (jsoneq(json_string, &json_token[i], JSON_KEY_OTA) == 0) 
+		if (json_token[i].type != JSMN_STRING)
 		{
-			snprintf(str_value, sizeof(str_value), "%.*s", json_token[i + 1].end - json_token[i + 1].start,
-					json_string + json_token[i + 1].start);
-			if(strcmp(str_value, JSON_VALUE_START) == 0)
-			{
-				LOGI("Received OTA start command");
-				ota_start = 1;
-			}
-			else
-			{
-				LOGI("Received OTA key but not 'start' : %s", str_value);
-			}
+			LOGI("Unexpected key type : %d", json_token[i].type);
+			continue;
+		}
 
-			i++;
-		} 
-		else if (jsoneq(json_string, &json_token[i], JSON_KEY_OTA_SIZE) == 0) 
+		id = json_command_lookup(json + json_token[i].start, json_token[i].end - json_token[i].start, &type);
+		if (id != JSON_ID_UNKNOWN) 
 		{
-			snprintf(str_value, sizeof(str_value), "%.*s", json_token[i + 1].end - json_token[i + 1].start,
-					json_string + json_token[i + 1].start);
+			json_dispatch(json, id, json_token, i + 1, count);
+		}
+	}
 
-			ota_size = atoi(str_value);
-			if(ota_size > 0)
-			{
-				LOGI("Received OTA size : %d", ota_size);
-			}
-			else
-			{
-				LOGI("Received OTA SIZE key but invalid size : %d (0x%08X)", ota_size, ota_size);
-			}
+	return json_command_end();
+}
+
+static int json_grow_tokens(void)
+{
+	jsmntok_t *tok;
+	int num = json_token_num ? json_token_num * 2 : JSON_TOKEN_POOL_MIN;
+	int prev;
+
+	if(num > JSON_TOKEN_POOL_MAX) return -1;
+
+	prev = heap_tag_push(HEAP_TAG_JSON);
+	tok = realloc(json_token, num * sizeof(jsmntok_t));
+	heap_tag_pop(prev);
+	if(tok == NULL) return -1;
+
+	json_token = tok;
+	json_token_num = num;
+	return 0;
+}
+
+int json_stream_busy(void)
+{
+	return json_in_process;
+}
+
+// Tokens of the last parsed message
+int json_stream_token_count(void)
+{
+	return json_parser.toknext;
+}
+
+void json_set_dry_run(int on)
+{
+	json_dry_run = on;
+}
+
+// Drop an unfinished message (disconnect)
+void json_stream_reset(void)
+{
+	json_in_process = false;
+}
+
+void json_stream_begin(void)
+{
+	json_len = 0;
+	json_string[0] = 0;
+	jsmn_init(&json_parser);
+	json_in_process = true;
+}
 
-			i++;
-		} 
-		else if (jsoneq(json_string, &json_token[i], JSON_KEY_GROUPS) == 0) 
+/*******************************************
+Feed one received fragment. The parser keeps its state between fragments,
+only the new bytes are scanned. The message is complete when the root object
+is closed, not when a fragment happens to end with '}'.
+Return : EVENT_REQUEST 에 대한 응답을 우선 처리함.
+         EVENT_REQUEST 가 있을 경우 다른 key 값이 있어도 처리만 하고 응답은 보내지 않음
+-1 : Parsing error
+0  : Request event data
+1  : Set parameters or delete
+2  : OTA
+JSON_STREAM_INCOMPLETE : more fragments expected
+*******************************************/
+int json_stream_feed(const char *data, int len)
+{
+	const char *eot;
+	int r;
+
+	if(!json_in_process) return -1;
+
+	// CTRL-D (End Of Transmission) terminates the message
+	eot = memchr(data, 0x04, len);
+	if(eot) len = eot - data;
+
+	if(json_len + len > MAX_JSON_STRING)
+	{
+		LOGE("JSON string too long : %d", json_len + len);
+		json_in_process = false;
+		return -1;
+	}
+
+	memcpy(&json_string[json_len], data, len);
+	json_len += len;
+	json_string[json_len] = 0;
+
+	if(json_token == NULL && json_grow_tokens() != 0)
+	{
+		json_in_process = false;
+		return -1;
+	}
+
+	while(1)
+	{
+		r = jsmn_parse(&json_parser, json_string, json_len, json_token, json_token_num);
+
+		/* Root object closed : anything after it (CR/LF, EOT) is ignored */
+		if(json_parser.toknext > 0 && json_token[0].end != -1)
 		{
-			int j;
-			LOGI("- Groups:");
-			if (json_token[i + 1].type != JSMN_ARRAY) 
-			{
-				continue; /* We expect groups to be an array of strings */
-			}
+			json_in_process = false;
+			return json_apply(json_string, json_skip(json_token, 0, json_parser.toknext));
+		}
 
-			for (j = 0; j < json_token[i + 1].size; j++) 
-			{
-				jsmntok_t *g = &json_token[i + j + 2];
-				(void)g;
-				LOGI("  * %.*s", g->end - g->start, json_string + g->start);
-			}
-			i += json_token[i + 1].size + 1;
-		} 
-		else 
+		if(r == JSMN_ERROR_NOMEM && json_grow_tokens() == 0)
 		{
-			LOGI("Unexpected key: %.*s", json_token[i].end - json_token[i].start,
-			     json_string + json_token[i].start);
+			continue;
 		}
+		break;
+	}
+
+	if(r == JSMN_ERROR_PART && eot == NULL)
+	{
+		return JSON_STREAM_INCOMPLETE;
+	}
+
+	LOGI("Failed to parse JSON: %d", r);
+	json_in_process = false;
+	return -1;
+}
+
+// Parse a complete message in one call
+int json_parsing(char *str, int len)
+{
+	int ret;
+
+	json_stream_begin();
+	ret = json_stream_feed(str, len);
+	if(ret == JSON_STREAM_INCOMPLETE)
+	{
+		LOGI("Incomplete JSON message");
+		json_in_process = false;
+		ret = -1;
 	}
 
-	if(is_ota_ready()) ret = 2;
-	
 	return ret;
 }
 
@@ -228,9 +1009,22 @@ int get_ota_file_size(void)
 	return ota_size;
 }
 
+int is_ota_staged(void)
+{
+	return ota_staged;
+}
+
+// Image refused on its header, reported until the next command
+void set_ota_rejected(void)
+{
+	ota_rejected = 1;
+	status_mark_dirty(STATUS_DIRTY_OTA);
+}
+
 void clear_ota_state(void)
 {
 	ota_start = 0;
 	ota_size = 0;
+	status_mark_dirty(STATUS_DIRTY_OTA);
 }
 
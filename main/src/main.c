@@ -23,12 +23,16 @@
 #include "esp_system.h"
 #include "esp_log.h"
 #include "esp_app_desc.h"
+#include "esp_ota_ops.h"
 #include "nvs_flash.h"
 #include "driver/uart.h"
 
 #include "debug.h"
 #include "ota.h"
 #include "wifi.h"
+#include "heap_tag.h"
+#include "task_layout.h"
+#include "ota_turbo.h"
 
 static char strVersion[64];
 
@@ -41,12 +45,14 @@ char *get_version_string(void)
 void app_main(void)
 {
 	esp_err_t ret;
+	int prev_tag;
 
     const esp_app_desc_t *app_desc = esp_app_get_description();
 
 	// version(PROJECT_VER) is defined in CMakeLists.txt
 	snprintf(strVersion, 64, "%s %s %s", app_desc->version, app_desc->date, app_desc->time);
 
+    heap_tag_init();
     uart_driver_install(UART_NUM_0, 1024, 0, 0, NULL, 0);
 
 	ret = nvs_flash_init();
@@ -58,13 +64,27 @@ void app_main(void)
 		LOGI("nvs default partition reinit : %d, %s", ret, esp_err_to_name(ret));
     }
     ESP_ERROR_CHECK(ret);
+	task_layout_init();
+	ota_turbo_init();
+
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	LOGI("Running partition : %s (offset 0x%x)", running->label, running->address);
     
+#if CONFIG_ETH_USE_OPENETH
+	// QEMU build : neither Wi-Fi nor the BT controller are emulated
+	eth_init_openeth();
+#else
 #if defined(ENABLE_WIFI)
+	prev_tag = heap_tag_push(HEAP_TAG_WIFI);
 	wifi_init_softap();
 	// wifi_init_sta();
+	heap_tag_pop(prev_tag);
 #endif
 
+	prev_tag = heap_tag_push(HEAP_TAG_BLE);
     bt_ble_init();
+	heap_tag_pop(prev_tag);
+#endif
     usleep(10000);
     InitOta();
     InitDebug();
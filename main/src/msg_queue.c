@@ -0,0 +1,232 @@
+/**
+ * @file msg_queue.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief FreeRTOS message queue with depth and wait time statistics
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "freertos/queue.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+
+#include "debug.h"
+#include "msg_queue.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "QUEUE"
+
+#define MSG_QUEUE_WAIT_MIN_US	16	// upper bound of the first wait bin
+
+/*---------------------------- Variables ---------------------------------*/
+static msg_queue_t *msg_queues[MSG_QUEUE_MAX];
+static int msg_queue_num;
+static volatile uint32_t summary_gen;	// bumped when max_depth or timeouts change
+
+/*-------------------------- Function declares ---------------------------*/
+
+static int wait_bin(int64_t us)
+{
+	int bin;
+
+	if(us < MSG_QUEUE_WAIT_MIN_US) return 0;
+	if(us >= (int64_t)MSG_QUEUE_WAIT_MIN_US << (MSG_QUEUE_WAIT_BINS - 2)) return MSG_QUEUE_WAIT_BINS - 1;
+
+	bin = 31 - __builtin_clz((uint32_t)us);	// floor(log2(us)), >= 4
+	return bin - 3;
+}
+
+esp_err_t msg_queue_create(msg_queue_t *q, const char *name, int length, int item_size)
+{
+	memset(q, 0, sizeof(msg_queue_t));
+	q->name = name;
+	q->length = length;
+	q->item_size = item_size;
+	q->handle = xQueueCreate(length, item_size);
+	if(q->handle == 0)
+	{
+		return ESP_ERR_NO_MEM;
+	}
+
+	if(msg_queue_num < MSG_QUEUE_MAX)
+	{
+		msg_queues[msg_queue_num++] = q;
+	}
+	else
+	{
+		LOGW("Queue %s created but not listed, MSG_QUEUE_MAX %d", name, MSG_QUEUE_MAX);
+	}
+	return ESP_OK;
+}
+
+BaseType_t msg_queue_send(msg_queue_t *q, const void *item, TickType_t wait)
+{
+	msg_queue_stats_t *s = &q->stats;
+	int64_t start, waited;
+	int depth;
+	BaseType_t ret;
+
+	depth = uxQueueMessagesWaiting(q->handle);
+	s->depth_hist[(depth < MSG_QUEUE_DEPTH_BINS) ? depth : MSG_QUEUE_DEPTH_BINS - 1]++;
+
+	start = esp_timer_get_time();
+	ret = xQueueSend(q->handle, item, wait);
+	waited = esp_timer_get_time() - start;
+
+	s->send_wait_us += waited;
+	if(waited > s->send_max_us) s->send_max_us = waited;
+	s->send_hist[wait_bin(waited)]++;
+
+	if(ret == pdTRUE)
+	{
+		s->sent++;
+		s->copy_bytes += q->item_size;
+		if(depth + 1 > s->max_depth)
+		{
+			s->max_depth = depth + 1;
+			summary_gen++;
+		}
+	}
+	else
+	{
+		s->timeouts++;
+		summary_gen++;
+	}
+	return ret;
+}
+
+BaseType_t msg_queue_receive(msg_queue_t *q, void *item, TickType_t wait)
+{
+	msg_queue_stats_t *s = &q->stats;
+	int64_t start, waited;
+	BaseType_t ret;
+
+	start = esp_timer_get_time();
+	ret = xQueueReceive(q->handle, item, wait);
+	waited = esp_timer_get_time() - start;
+
+	if(ret == pdTRUE)
+	{
+		s->received++;
+		s->copy_bytes += q->item_size;
+		if(waited > s->recv_max_us) s->recv_max_us = waited;
+		s->recv_hist[wait_bin(waited)]++;
+	}
+	return ret;
+}
+
+msg_queue_t *msg_queue_find(const char *name)
+{
+	int i;
+
+	for(i = 0; i < msg_queue_num; i++)
+	{
+		if(strcmp(msg_queues[i]->name, name) == 0) return msg_queues[i];
+	}
+	return NULL;
+}
+
+msg_queue_t *msg_queue_get(int index)
+{
+	return (index >= 0 && index < msg_queue_num) ? msg_queues[index] : NULL;
+}
+
+int msg_queue_count(void)
+{
+	return msg_queue_num;
+}
+
+// Changes when a value of the status summary (max depth, timeouts) changes
+uint32_t msg_queue_summary_gen(void)
+{
+	return summary_gen;
+}
+
+void msg_queue_stats_get(msg_queue_t *q, msg_queue_stats_t *stats)
+{
+	*stats = q->stats;
+}
+
+void msg_queue_stats_reset(msg_queue_t *q)
+{
+	memset(&q->stats, 0, sizeof(q->stats));
+	summary_gen++;
+}
+
+/*---------------------------- Console -----------------------------------*/
+static void msg_queue_print(msg_queue_t *q)
+{
+	msg_queue_stats_t *s = &q->stats;
+
+	PrintConsole("%-6s %3d %5d %8u %8u %6u %4d/%-3d %8llu %9lld %9lld %9lld\r\n", q->name, q->length, q->item_size,
+			(unsigned int)s->sent, (unsigned int)s->received, (unsigned int)s->timeouts,
+			s->max_depth, q->length, s->copy_bytes / 1024, s->send_wait_us, s->send_max_us, s->recv_max_us);
+}
+
+static void msg_queue_print_hist(msg_queue_t *q)
+{
+	msg_queue_stats_t *s = &q->stats;
+	int i;
+
+	PrintConsole("%s : wait time          send      recv\r\n", q->name);
+	for(i = 0; i < MSG_QUEUE_WAIT_BINS; i++)
+	{
+		if(s->send_hist[i] == 0 && s->recv_hist[i] == 0) continue;
+
+		if(i == MSG_QUEUE_WAIT_BINS - 1)
+			PrintConsole("  >= %6d us    %9u %9u\r\n", MSG_QUEUE_WAIT_MIN_US << (i - 1),
+					(unsigned int)s->send_hist[i], (unsigned int)s->recv_hist[i]);
+		else
+			PrintConsole("  <  %6d us    %9u %9u\r\n", MSG_QUEUE_WAIT_MIN_US << i,
+					(unsigned int)s->send_hist[i], (unsigned int)s->recv_hist[i]);
+	}
+
+	PrintConsole("%s : depth at send\r\n", q->name);
+	for(i = 0; i < MSG_QUEUE_DEPTH_BINS; i++)
+	{
+		if(s->depth_hist[i] == 0) continue;
+
+		PrintConsole("  %s%2d            %9u\r\n", (i == MSG_QUEUE_DEPTH_BINS - 1) ? ">=" : "  ", i,
+				(unsigned int)s->depth_hist[i]);
+	}
+}
+
+// queue [name|reset]
+void msg_queue_command(char **token, int token_count)
+{
+	msg_queue_t *q;
+	int i;
+
+	if(token_count >= 2 && strcmp(token[1], "reset") == 0)
+	{
+		for(i = 0; i < msg_queue_num; i++)
+		{
+			msg_queue_stats_reset(msg_queues[i]);
+		}
+		return;
+	}
+
+	if(token_count >= 2)
+	{
+		q = msg_queue_find(token[1]);
+		if(q == NULL)
+		{
+			LOGW("Unknown queue : %s", token[1]);
+			return;
+		}
+		msg_queue_print_hist(q);
+		return;
+	}
+
+	PrintConsole("name   len  item     sent     recv  tmout  max/len  copy KB   wait us  max send  max recv\r\n");
+	for(i = 0; i < msg_queue_num; i++)
+	{
+		msg_queue_print(msg_queues[i]);
+	}
+	LOGI("Usage : queue [name|reset]");
+}
@@ -0,0 +1,212 @@
+/**
+ * @file multipart.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Streaming multipart/form-data scanner : the file part goes to a sink as it arrives, nothing buffered
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+
+#include "debug.h"
+#include "multipart.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "MPART"
+
+#define MULTIPART_FILENAME	"filename="
+#define MULTIPART_HEAD_END	"\r\n\r\n"
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+/*******************************************
+Content-Type : multipart/form-data; boundary=XYZ (or "XYZ").
+The delimiter is CRLF "--" boundary, the first one is matched as if the
+body started with a CRLF. A boundary has no CR, so a CR is the only byte
+that can start a delimiter : a broken match restarts at 0 or 1.
+*******************************************/
+esp_err_t multipart_begin(multipart_t *m, const char *content_type, multipart_sink_t sink, void *ctx)
+{
+	const char *b;
+	int len;
+
+	memset(m, 0, sizeof(multipart_t));
+	if(content_type == NULL || strncasecmp(content_type, "multipart/form-data", 19) != 0) return ESP_ERR_NOT_SUPPORTED;
+
+	b = strstr(content_type, "boundary=");
+	if(b == NULL) return ESP_ERR_INVALID_ARG;
+	b += 9;
+	if(*b == '"') b++;
+	for(len = 0; b[len] && b[len] != '"' && b[len] != ';' && b[len] != '\r'; len++);
+	if(len == 0 || len > MULTIPART_BOUNDARY_MAX)
+	{
+		LOGE("Multipart boundary length ERROR : %d", len);
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	memcpy(m->delim, "\r\n--", 4);
+	memcpy(&m->delim[4], b, len);
+	m->delim_len = 4 + len;
+	m->match = 2;
+	m->state = MULTIPART_PREAMBLE;
+	m->sink = sink;
+	m->ctx = ctx;
+	return ESP_OK;
+}
+
+static esp_err_t multipart_emit(multipart_t *m, uint8_t *data, int len)
+{
+	if(!m->file || len <= 0) return ESP_OK;
+
+	m->data_len += len;
+	return m->sink(m->ctx, data, len);
+}
+
+// Part body : runs between delimiters go to the sink straight from the buffer
+static esp_err_t multipart_data(multipart_t *m, uint8_t *data, int len, int *pos)
+{
+	uint8_t *r;
+	int i = *pos, start = *pos, end;
+	esp_err_t err;
+
+	while(i < len)
+	{
+		if(m->match == 0)
+		{
+			r = memchr(&data[i], '\r', len - i);
+			if(r == NULL) break;
+			i = r - data;
+		}
+
+		if(data[i] == m->delim[m->match])
+		{
+			i++;
+			if(++m->match < m->delim_len) continue;
+
+			// delimiter complete : its bytes of earlier buffers were held back, drop them
+			end = i - (m->delim_len - m->held);
+			err = multipart_emit(m, &data[start], end - start);
+			m->match = m->held = 0;
+			m->tail_len = 0;
+			m->state = MULTIPART_DELIM_TAIL;
+			*pos = i;
+			return err;
+		}
+
+		// not a delimiter after all : the held bytes were data, they come before this buffer
+		if(m->held > 0)
+		{
+			memcpy(m->scratch, m->delim, m->held);
+			err = multipart_emit(m, m->scratch, m->held);
+			m->held = 0;
+			if(err != ESP_OK) return err;
+		}
+		m->match = (data[i] == '\r');
+		i++;
+	}
+
+	// a partial delimiter at the end is held back until the next buffer decides
+	end = len - (m->match - m->held);
+	err = multipart_emit(m, &data[start], end - start);
+	m->held = m->match;
+	*pos = len;
+	return err;
+}
+
+esp_err_t multipart_feed(multipart_t *m, uint8_t *data, int len)
+{
+	esp_err_t err;
+	int i = 0;
+	uint8_t c;
+
+	while(i < len && m->state != MULTIPART_DONE)
+	{
+		switch(m->state)
+		{
+		case MULTIPART_PREAMBLE:
+			for(; i < len; i++)
+			{
+				c = data[i];
+				if(c != m->delim[m->match])
+				{
+					m->match = (c == '\r');
+					continue;
+				}
+				if(++m->match == m->delim_len)
+				{
+					i++;
+					m->match = 0;
+					m->tail_len = 0;
+					m->state = MULTIPART_DELIM_TAIL;
+					break;
+				}
+			}
+			break;
+
+		case MULTIPART_DELIM_TAIL:
+			m->tail[m->tail_len++] = data[i++];
+			if(m->tail_len < 2) break;
+
+			if(m->tail[0] == '-' && m->tail[1] == '-')
+			{
+				m->file = 0;
+				m->state = MULTIPART_DONE;
+			}
+			else if(m->tail[0] == '\r' && m->tail[1] == '\n')
+			{
+				m->file = 0;
+				m->head_match = 2;	// the CRLF just read : no headers at all ends at the next CRLF
+				m->name_match = 0;
+				m->state = MULTIPART_HEADERS;
+			}
+			else
+			{
+				LOGE("Multipart delimiter ERROR");
+				return ESP_ERR_INVALID_ARG;
+			}
+			break;
+
+		case MULTIPART_HEADERS:
+			for(; i < len; i++)
+			{
+				c = data[i];
+				m->name_match = (c == MULTIPART_FILENAME[m->name_match]) ? m->name_match + 1 : (c == 'f');
+				if(m->name_match == sizeof(MULTIPART_FILENAME) - 1)
+				{
+					m->file = 1;
+					m->name_match = 0;
+				}
+				m->head_match = (c == MULTIPART_HEAD_END[m->head_match]) ? m->head_match + 1 : (c == '\r');
+				if(m->head_match == sizeof(MULTIPART_HEAD_END) - 1)
+				{
+					i++;
+					// only the first file of the form is taken
+					if(m->file && m->files++ > 0) m->file = 0;
+					m->match = m->held = 0;
+					m->state = MULTIPART_DATA;
+					break;
+				}
+			}
+			break;
+
+		case MULTIPART_DATA:
+			err = multipart_data(m, data, len, &i);
+			if(err != ESP_OK) return err;
+			break;
+		}
+	}
+
+	return ESP_OK;
+}
+
+// Final delimiter seen and a file part was in the form
+int multipart_done(const multipart_t *m)
+{
+	return m->state == MULTIPART_DONE && m->files > 0;
+}
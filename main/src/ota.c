@@ -19,35 +19,43 @@
 #include "esp_wifi.h"
 #include "esp_event.h"
 #include "esp_log.h"
+#include "esp_timer.h"
 #include "esp_ota_ops.h"
 
 #include "nvs.h"
 #include "nvs_flash.h"
 #include "debug.h"
 #include "ota.h"
+#include "ota_session.h"
+#include "msg_queue.h"
+#include "task_layout.h"
+#include "ota_turbo.h"
+#include "ota_stage.h"
+#include "ota_manifest.h"
+#include "ota_tls.h"
+#include "ota_http.h"
+#include "trace.h"
 
 #define TAG "OTA"
 
 #define BUFFSIZE 1024
 
-static int binary_file_length = 0;
-/*an ota data write buffer ready to write to the flash*/
-static char ota_write_data[BUFFSIZE + 1] = { 0 };
-
 #if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_HTTP_OTA || WIFI_OTA_TYPE == WIFI_TCP_OTA))
 
 
 #define TEXT_BUFFSIZE 1024
 
 
+#endif	/* #if #if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_HTTP_OTA || WIFI_OTA_TYPE == WIFI_TCP_OTA)) */
+
+#if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_HTTP_OTA))
 /*an packet receive buffer*/
 static char text[BUFFSIZE + 1] = { 0 };
 /* an image total length*/
+static int binary_file_length = 0;
+/*an ota data write buffer ready to write to the flash*/
+static char ota_write_data[BUFFSIZE + 1] = { 0 };
 
-
-#endif	/* #if #if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_HTTP_OTA || WIFI_OTA_TYPE == WIFI_TCP_OTA)) */
-
-#if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_HTTP_OTA))
 /*socket id*/
 static int socket_id = -1;
 
@@ -179,18 +187,17 @@ void TaskClientOta(void *pvParameter)
 	        "Host: %s:%d\r\n"
 	        "User-Agent: esp-idf/1.0 esp32\r\n\r\n";
 
-	    char *http_request = NULL;
-	    int get_len = asprintf(&http_request, GET_FORMAT, 
+	    char http_request[256];
+	    int get_len = snprintf(http_request, sizeof(http_request), GET_FORMAT, 
 							st_Config.OtaFilename, inet_ntoa(st_Config.OtaServerIp), st_Config.OtaServerPort);
 
 		PrintConsole("Req : %s\r\n", http_request);
-	    if (get_len < 0) {
-	        PrintConsole("Failed to allocate memory for GET request buffer\r\n");
+	    if (get_len < 0 || get_len >= sizeof(http_request)) {
+	        PrintConsole("GET request too long for the request buffer\r\n");
 			close(socket_id);
 			return;
 	    }
 	    int res = send(socket_id, http_request, get_len, 0);
-	    free(http_request);
 
 	    if (res < 0) {
 	        PrintConsole("Send GET request to server failed\r\n");
@@ -287,15 +294,19 @@ void TaskClientOta(void *pvParameter)
 
 #if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_TCP_OTA))
 
-#define OTA_SERVER_PORT	12222
 #define OTA_BROADCAST_PORT	13333
 
-static int check_ota_command(int ota_socket)
+// Return : 0 error, 1 transfer, 2 image already staged and selected for boot (reply sent), 3 manifest follows
+static int check_ota_command(ota_link_t *link, int *image_size)
 {
 	int rcv_len;
-	uint8_t buf[4];
+	uint8_t buf[OTA_STAGE_CMD_LEN];
+	uint8_t stg[4] = {'S', 'T', 'G', 0};
+	const esp_partition_t *part;
+	uint32_t size;
 	
-	rcv_len = recv(ota_socket, buf, 3, 0);
+	*image_size = 0;
+	rcv_len = ota_link_recv(link, buf, 3, 0);
 	if(rcv_len <= 0)
 	{
 		LOGE("OTA command receive ERROR : %d", rcv_len);
@@ -308,20 +319,39 @@ static int check_ota_command(int ota_socket)
 		return 0;
 	}
 
-	if(memcmp(buf, "ota", 3) != 0)
+	if(memcmp(buf, "ota", 3) == 0) return 1;
+
+	if(memcmp(buf, OTA_MANIFEST_CMD, 3) == 0) return 3;
+
+	if(memcmp(buf, OTA_STAGE_CMD, 3) != 0)
 	{
 		LOGE("OTA command ERROR : %02X %02X %02X", buf[0], buf[1], buf[2]);
 		return 0;
 	}
-	
-	return 1;
+
+	// size and SHA-256 of the image the client is about to send
+	rcv_len = ota_link_recv(link, &buf[3], OTA_STAGE_CMD_LEN - 3, 1);
+	if(rcv_len != OTA_STAGE_CMD_LEN - 3)
+	{
+		LOGE("OTA stage command received length ERROR : %d", rcv_len);
+		return 0;
+	}
+
+	memcpy(&size, &buf[3], 4);
+	*image_size = (size > 0 && size < MAX_FIRMWARE_SIZE) ? size : 0;
+
+	part = ota_stage_find(&buf[7], size);
+	if(part == NULL || ota_stage_boot(part) != ESP_OK) return 1;
+
+	ota_link_send(link, stg, 4);
+	return 2;
 }
 
-static int send_ack_msg(int ota_socket)
+static int send_ack_msg(ota_link_t *link)
 {
 	uint8_t ack[4] = {'A', 'C', 'K', 0};
 
-	int res = send(ota_socket, ack, 4, 0);
+	int res = ota_link_send(link, ack, 4);
 
 	if(res < 0)
 	{
@@ -334,6 +364,113 @@ static int send_ack_msg(int ota_socket)
 	return 1;
 }
 
+/*******************************************
+Manifest transfer : the client sends the chunks the device still needs, in any order.
+A chunk with a wrong hash is answered "N" and sent again, the session goes on.
+After the last chunk the image is verified, "END" then the restart, "ERR" if it fails.
+Plain images only : an encrypted one has no chunk to flash offset mapping.
+The leaf hashes and the Merkle root come from the same unauthenticated client
+as the chunks : they catch corruption on the way, not a tampered image.
+*******************************************/
+static void ota_tcp_manifest(ota_link_t *link)
+{
+	ota_manifest_head_t head;
+	ota_manifest_t manifest;
+	ota_session_t session;
+	uint8_t reply[5];
+	uint8_t *need;
+	uint32_t frame[2];	// index, length
+	int i, len, ok, restart = 0;
+	esp_err_t err;
+
+	if(ota_link_recv(link, &head, sizeof(head), 1) != sizeof(head) || ota_manifest_init(&manifest, &head) != ESP_OK)
+	{
+		LOGE("OTA manifest receive ERROR");
+		return;
+	}
+
+	len = head.chunk_count * OTA_HASH_SIZE;
+	if(ota_link_recv(link, manifest.leaf, len, 1) != len || ota_manifest_verify(&manifest) != ESP_OK)
+	{
+		ota_manifest_free(&manifest);
+		return;
+	}
+
+	if(ota_session_begin(&session, head.image_len) != ESP_OK)
+	{
+		ota_manifest_free(&manifest);
+		return;
+	}
+	session.defer_restart = 1;
+
+	len = ota_manifest_bitmap_len(&manifest);
+	need = ota_session_alloc(&session, len);
+	if(need == NULL || ota_session_set_manifest(&session, &manifest) != ESP_OK)
+	{
+		ota_session_abort(&session);
+		ota_manifest_free(&manifest);
+		return;
+	}
+
+	memset(need, 0, len);
+	for(i = 0; i < head.chunk_count; i++)
+	{
+		if(!ota_manifest_is_done(&manifest, i)) need[i / 8] |= 1 << (i % 8);
+	}
+	if(!send_ack_msg(link) || ota_link_send(link, need, len) != len)
+	{
+		ota_session_abort(&session);
+		ota_manifest_free(&manifest);
+		return;
+	}
+
+	ota_turbo_begin(OTA_TURBO_TCP);
+
+	LOGI("Waiting for %d chunks", (int)head.chunk_count - manifest.done_count);
+
+	while(!ota_session_complete(&session))
+	{
+		TRACE(TRACE_TCP_RECV_B, 0);
+		// frame[] is only read once the whole header is in
+		len = ota_link_recv(link, frame, sizeof(frame), 1);
+		ok = (len == sizeof(frame) && frame[1] > 0 && frame[1] <= OTA_CHUNK_SIZE);
+		if(ok)
+		{
+			len = ota_link_recv(link, session.chunk, frame[1], 1);
+			ok = (len >= 0 && (uint32_t)len == frame[1]);
+		}
+		TRACE(TRACE_TCP_RECV_E, len);
+		if(!ok)
+		{
+			LOGE("Error: receive chunk error! : %d", len);
+			ota_session_abort(&session);
+			break;
+		}
+
+		err = ota_session_write_chunk(&session, frame[0], session.chunk, len);
+		if(err != ESP_OK && err != ESP_ERR_INVALID_CRC)
+		{
+			ota_session_abort(&session);
+			break;
+		}
+
+		reply[0] = (err == ESP_OK) ? 'A' : 'N';
+		memcpy(&reply[1], &frame[0], 4);
+		ota_link_send(link, reply, sizeof(reply));
+	}
+
+	if(ota_session_complete(&session))
+	{
+		err = ota_session_finish(&session);
+		ota_link_send(link, err == ESP_OK ? "END" : "ERR", 4);
+		restart = (err == ESP_OK && ota_session_restarts(&session));
+	}
+
+	ota_turbo_end();
+	ota_manifest_free(&manifest);
+	if(restart) ota_stage_restart();
+}
+
 extern char *get_my_ip(void);
 
 static void TaskRcvOtaBroadcast(void *arg)
@@ -393,12 +530,14 @@ static void TaskRcvOtaBroadcast(void *arg)
 
 static void TaskServerOta(void *arg)
 {
-	esp_err_t err;
-	int ServerSocket, OtaClientSocket;
+	int ServerSocket, TlsSocket = -1, ListenSocket, OtaClientSocket;
+	fd_set fds;
+	ota_link_t link;
 	struct sockaddr_in ServerAddr, ClientAddr;
 	int AddrSize;
-	const esp_partition_t *update_partition = NULL;
-	esp_ota_handle_t update_handle = 0 ;
+	int command, image_size;
+	ota_session_t session;
+	char *text;
 	
 	LOGI("Task OTA server started\r\n");
 		
@@ -451,13 +590,34 @@ static void TaskServerOta(void *arg)
 		break;
 	}
 
+	// TLS port next to the plain one, only with a provisioned certificate
+	if(ota_tls_server_init() == ESP_OK)
+	{
+		TlsSocket = ota_tls_listen(OTA_TLS_PORT);
+		if(TlsSocket >= 0) LOGI("OTA TLS port : %d", OTA_TLS_PORT);
+	}
+
 	while(1)
 	{
 		LOGI("Waiting for OTA client...");
 		
 		AddrSize = sizeof(struct sockaddr_in);
 
-		OtaClientSocket = accept(ServerSocket, (struct sockaddr*)&ClientAddr, (socklen_t *)&AddrSize);
+		ListenSocket = ServerSocket;
+		if(TlsSocket >= 0)
+		{
+			FD_ZERO(&fds);
+			FD_SET(ServerSocket, &fds);
+			FD_SET(TlsSocket, &fds);
+			if(select((ServerSocket > TlsSocket ? ServerSocket : TlsSocket) + 1, &fds, NULL, NULL, NULL) <= 0)
+			{
+				usleep(100000);
+				continue;
+			}
+			if(FD_ISSET(TlsSocket, &fds)) ListenSocket = TlsSocket;
+		}
+
+		OtaClientSocket = accept(ListenSocket, (struct sockaddr*)&ClientAddr, (socklen_t *)&AddrSize);
 		if(OtaClientSocket == -1)
 		{
 			LOGE("OTA server accept ERROR!!!");
@@ -466,101 +626,89 @@ static void TaskServerOta(void *arg)
 			continue;
 		}
 
-		LOGI("+++ OTA client connected : %s +++", inet_ntoa(ClientAddr.sin_addr));
-		if(!check_ota_command(OtaClientSocket))
+		LOGI("+++ OTA client connected : %s%s +++", inet_ntoa(ClientAddr.sin_addr), ListenSocket == TlsSocket ? " (TLS)" : "");
+
+		link.sock = OtaClientSocket;
+		link.tls = NULL;
+		if(ListenSocket == TlsSocket && ota_link_accept_tls(&link, OtaClientSocket) != ESP_OK)
 		{
-			LOGE("OTA command ERROR");
-			close(OtaClientSocket);
+			ota_link_close(&link);
 			usleep(100000);
 			continue;
 		}
 
-		LOGI("OTA command OK");
-
-		const esp_partition_t *configured = esp_ota_get_boot_partition();
-    	const esp_partition_t *running = esp_ota_get_running_partition();
-
-	    if (configured != running) {
-	        LOGI("Configured OTA boot partition at offset 0x%x, but running from offset 0x%x\r\n",
-	                 configured->address, running->address);
-	        LOGI("(This can happen if either the OTA boot data or preferred boot image become corrupted somehow.)\r\n");
-	    }
-		
-	    LOGI("Running partition type %d subtype %d (offset 0x%x)\r\n",
-             		running->type, running->subtype, running->address);
-
-		update_partition = esp_ota_get_next_update_partition(NULL);
-	    PrintConsole("Writing to partition subtype %d at offset 0x%x\r\n",
-	             update_partition->subtype, update_partition->address);
-	    if(update_partition == NULL)
-	    {
-			LOGE("Update partition ERROR");
-			close(OtaClientSocket);
+		command = check_ota_command(&link, &image_size);
+		if(command == 0)
+		{
+			LOGE("OTA command ERROR");
+			ota_link_close(&link);
 			usleep(100000);
 			continue;
-	    }
+		}
+		else if(command == 2)
+		{
+			ota_link_close(&link);
+			ota_stage_restart();
+		}
+		else if(command == 3)
+		{
+			ota_tcp_manifest(&link);
+			LOGI("\r\nClose OTA client socket\r\n");
+			ota_link_close(&link);
+			usleep(100000);
+			continue;
+		}
 
-	    err = esp_ota_begin(update_partition, OTA_SIZE_UNKNOWN, &update_handle);
-	    if (err != ESP_OK) {
-	        LOGE("esp_ota_begin failed, error=%d\r\n", err);
-			close(OtaClientSocket);
+		LOGI("OTA command OK");
+
+		if(ota_session_begin(&session, image_size) != ESP_OK)
+		{
+			ota_link_close(&link);
 			usleep(100000);
 			continue;
-	    }
-	    LOGI("esp_ota_begin succeeded");
+		}
 
-		if(!send_ack_msg(OtaClientSocket))
+		text = ota_session_alloc(&session, TEXT_BUFFSIZE);
+		if(text == NULL || !send_ack_msg(&link))
 		{
-			close(OtaClientSocket);
+			ota_session_abort(&session);
+			ota_link_close(&link);
 			usleep(100000);
 			continue;
 		}
 
+		ota_turbo_begin(OTA_TURBO_TCP);
+
 		LOGI("Waiting for OTA firmware");
 		
 	    /*deal with all receive packet*/
 	    while (1) {
-	        memset(text, 0, TEXT_BUFFSIZE);
-	        memset(ota_write_data, 0, BUFFSIZE);
 	        int buff_len;
 
-			buff_len = recv(OtaClientSocket, text, TEXT_BUFFSIZE, 0);
+			TRACE(TRACE_TCP_RECV_B, 0);
+			buff_len = ota_link_recv(&link, text, TEXT_BUFFSIZE, 0);
+			TRACE(TRACE_TCP_RECV_E, buff_len);
 			
 	        if (buff_len < 0) { /*receive error*/
 				LOGE("Error: receive data error!\r\n");
+				ota_session_abort(&session);
 				break;
 					
 	        } else if (buff_len > 0) {
-	            memcpy(ota_write_data, text, buff_len);
-	            err = esp_ota_write( update_handle, (const void *)ota_write_data, buff_len);
-	            if (err != ESP_OK) {
-	                LOGE("Error: esp_ota_write failed! err=0x%x\r\n", err);
+	            if (ota_session_write(&session, text, buff_len) != ESP_OK) {
+					ota_session_abort(&session);
 					break;
 		        }
-	            binary_file_length += buff_len;
-	            PrintConsole(".");
+	            if(!ota_turbo_active()) PrintConsole(".");
 	        } else {  /*packet over*/
-				LOGI("\r\nAll packets received");
-				LOGI("Total Write binary data length : %d\r\n", binary_file_length);
-
-				if (esp_ota_end(update_handle) != ESP_OK) {
-			        LOGE("esp_ota_end failed!\r\n");
-					break;
-			    }
-			    err = esp_ota_set_boot_partition(update_partition);
-			    if (err != ESP_OK) {
-			        LOGE("esp_ota_set_boot_partition failed! err=0x%x\r\n", err);
-					break;
-			    }
-			    LOGI("\r\nPrepare to restart system!\r\n\r\n");
-				usleep(100000);
-			    esp_restart();
-				sleep(10);
+				ota_session_finish(&session);
+				break;
 	        }
 	    }
 
+		ota_turbo_end();
 		LOGI("\r\nClose OTA client socket\r\n");
-		close(OtaClientSocket);
+		ota_link_close(&link);
 		usleep(100000);
 		continue;
 	}
@@ -569,7 +717,11 @@ static void TaskServerOta(void *arg)
 
 #if (ENABLE_BLE_OTA)
 static SemaphoreHandle_t semaphore_ota;
-static QueueHandle_t msg_queue_ota;
+static msg_queue_t msg_queue_ota;
+static volatile int ota_receiving;	// session started, image data is expected
+static volatile int ota_draining;	// image refused, the rest of it is dropped
+
+#define BLE_OTA_DRAIN_IDLE_MS	1000	// phone quiet this long after a refusal : back to commands
 
 void send_ota_data(uint8_t *data, int len)
 {
@@ -581,10 +733,27 @@ void send_ota_data(uint8_t *data, int len)
 	}
 	
 	msg.len = len;
-	if(xQueueSend( msg_queue_ota, &msg, 1000 ) == 0)	// 1000 ticks(ms) 동안 전송 시도
+
+	TRACE(TRACE_OTA_QUEUE_B, uxQueueMessagesWaiting(msg_queue_ota.handle) + 1);
+	if(msg_queue_send( &msg_queue_ota, &msg, 1000 ) == 0)	// 1000 ticks(ms) 동안 전송 시도
 	{
+		TRACE(TRACE_OTA_QUEUE_E, 0);
 		LOGE("OTA message send ERROR");
 	}
+	else
+	{
+		TRACE(TRACE_OTA_QUEUE_E, 1);
+	}
+}
+
+int is_ota_receiving(void)
+{
+	return ota_receiving;
+}
+
+int is_ota_draining(void)
+{
+	return ota_draining;
 }
 
 void give_ota_semaphore(void)
@@ -592,101 +761,101 @@ void give_ota_semaphore(void)
 	xSemaphoreGive(semaphore_ota);
 }
 
+/*******************************************
+Image refused before it was all sent : the phone may keep streaming the rest.
+Its packets still come to the OTA queue and are dropped until the image is over,
+the link drops or the phone is quiet for BLE_OTA_DRAIN_IDLE_MS, so image bytes
+never reach the command parser.
+*******************************************/
+static void ble_ota_drain(int left)
+{
+	BLE_MSG_st msg;
+	int dropped = 0;
+
+	ota_draining = 1;
+	clear_ota_state();
+	send_status_info();
+
+	while(left > 0 && msg_queue_receive(&msg_queue_ota, &msg, pdMS_TO_TICKS(BLE_OTA_DRAIN_IDLE_MS)))
+	{
+		if(msg.len <= 0) break;	// disconnected, or the empty write that ends the image
+		dropped += msg.len;
+		left -= msg.len;
+	}
+
+	// commands go to TaskBle from here, what is still queued is image data
+	ota_draining = 0;
+	while(msg_queue_receive(&msg_queue_ota, &msg, 0))
+	{
+		if(msg.len > 0) dropped += msg.len;
+	}
+	LOGW("OTA refused : %d bytes of the image dropped", dropped);
+}
+
 static void TaskBleOta(void *arg)
 {
 	BLE_MSG_st msg;
-	esp_err_t err;
-	const esp_partition_t *update_partition = NULL;
-	esp_ota_handle_t update_handle = 0 ;
+	ota_session_t session;
+	int received;
 	
 	while(1)
 	{
 		xSemaphoreTake(semaphore_ota, portMAX_DELAY);
 		
 		LOGI("Got semaphore_ota, Begin OTA procedure");
-		
-		const esp_partition_t *configured = esp_ota_get_boot_partition();
-    	const esp_partition_t *running = esp_ota_get_running_partition();
-
-	    if (configured != running) {
-	        LOGI("Configured OTA boot partition at offset 0x%08x, but running from offset 0x%08x\r\n",
-	                 configured->address, running->address);
-	        LOGI("(This can happen if either the OTA boot data or preferred boot image become corrupted somehow.)\r\n");
-	    }
-		
-	    LOGI("Running partition type %d subtype %d (offset 0x%08x)\r\n",
-             		running->type, running->subtype, running->address);
-
-		update_partition = esp_ota_get_next_update_partition(NULL);
-	    PrintConsole("Writing to partition subtype %d at offset 0x%x\r\n",
-	             update_partition->subtype, update_partition->address);
-	    if(update_partition == NULL)
-	    {
-			LOGE("Update partition ERROR");
-			usleep(100000);
-			continue;
-	    }
 
-	    err = esp_ota_begin(update_partition, get_ota_file_size(), &update_handle);
-	    if (err != ESP_OK) {
-	        LOGE("esp_ota_begin failed, error=%d\r\n", err);
+		if(ota_session_begin(&session, get_ota_file_size()) != ESP_OK)
+		{
+			if(session.rejected) set_ota_rejected();
+			ble_ota_drain(get_ota_file_size());
+			clear_ota_state();
 			usleep(100000);
 			continue;
-	    }
+		}
+		received = 0;
 
 		// set_led_state(LED_STATE_TRANSMIT_BLINK);
-	    LOGI("esp_ota_begin succeeded");
-		binary_file_length = 0;
-
-		send_json_info();
+		ota_turbo_begin(OTA_TURBO_BLE);
+		ota_receiving = 1;
+		send_status_info();
 
 	    /*deal with all receive packet*/
 	    while (1) {
 	        int buff_len;
 
-			xQueueReceive(msg_queue_ota, &msg, portMAX_DELAY);
+			TRACE(TRACE_BLE_OTA_WAIT_B, 0);
+			msg_queue_receive(&msg_queue_ota, &msg, portMAX_DELAY);
+			TRACE(TRACE_BLE_OTA_WAIT_E, msg.len);
 //			LOGI("Ota task received message : %d", msg.len);
 			
 			buff_len = msg.len;
 			
 	        if (buff_len < 0) { /*receive error*/
 				LOGE("Error: receive data error!, Disconnected?\r\n");
+				ota_session_abort(&session);
 				break;
 					
 	        } else if (buff_len > 0) {
-	            memcpy(ota_write_data, msg.data, buff_len);
-	            err = esp_ota_write( update_handle, (const void *)ota_write_data, buff_len);
-	            if (err != ESP_OK) {
-	                LOGE("Error: esp_ota_write failed! err=0x%x\r\n", err);
+	            if (ota_session_write(&session, msg.data, buff_len) != ESP_OK) {
+					ota_session_abort(&session);
+					// tell the phone now, it would send the whole image before the final status
+					if(session.rejected) set_ota_rejected();
+					ble_ota_drain(get_ota_file_size() - received - buff_len);
 					break;
 		        }
-	            binary_file_length += buff_len;
-	            // PrintConsole(".");
-				LOGI("Rx Len : %d / %d", binary_file_length, get_ota_file_size());
+				received += buff_len;
+				if(!ota_turbo_active()) LOGI("Rx Len : %d / %d", session.received, session.size);
 	        } 
 			
-			if(binary_file_length >= get_ota_file_size() || buff_len == 0){  /*packet over*/
-				LOGI("\r\nAll packets received");
-				LOGI("Total Write binary data length : %d\r\n", binary_file_length);
-
-				if (esp_ota_end(update_handle) != ESP_OK) {
-			        LOGE("esp_ota_end failed!\r\n");
-					break;
-			    }
-			    err = esp_ota_set_boot_partition(update_partition);
-			    if (err != ESP_OK) {
-			        LOGE("esp_ota_set_boot_partition failed! err=0x%x\r\n", err);
-					break;
-			    }
-
+			if(ota_session_complete(&session) || buff_len == 0){  /*packet over*/
 				// set_led_state(LED_STATE_ON);
-			    LOGI("\r\nPrepare to restart system!\r\n\r\n");
-				usleep(1000000);
-			    esp_restart();
-				sleep(10);
+				ota_session_finish(&session);
+				break;
 	        }
 		}
 
+		ota_receiving = 0;
+		ota_turbo_end();
 		clear_ota_state();
 		// set_led_state(LED_STATE_DEFAULT_BLINK);
 	}
@@ -701,18 +870,12 @@ void InitOta(void)
 
 #if (ENABLE_BLE_OTA)
 	semaphore_ota = xSemaphoreCreateBinary();
-	msg_queue_ota = xQueueCreate(NUMBER_OF_BLE_MSG_QUEUE, sizeof(BLE_MSG_st));
-	if(msg_queue_ota == 0)
+	if(msg_queue_create(&msg_queue_ota, "ota", NUMBER_OF_BLE_MSG_QUEUE, sizeof(BLE_MSG_st)) != ESP_OK)
 	{
 		LOGE("OTA message queue creation ERROR");
 		return;
 	}
-	ret = xTaskCreatePinnedToCore(&TaskBleOta, "BLEOTA",
-            4096, 
-            NULL,
-            5,
-            &handle,
-            tskNO_AFFINITY);
+	ret = task_create(TASK_BLE_OTA, &TaskBleOta, NULL, &handle);
 	
     if (ret != pdPASS) {
 		LOGE("ERROR : CAN'T creat OTA task");
@@ -721,29 +884,23 @@ void InitOta(void)
 #endif	// #if (ENABLE_BLE_OTA)
 
 #if (ENABLE_WIFI_OTA)
-	ret = xTaskCreatePinnedToCore(&TaskServerOta, "TCPOTA",
-			4096, 
-			NULL,
-			5,
-			&handle,
-			tskNO_AFFINITY);
+	ret = task_create(TASK_TCP_OTA, &TaskServerOta, NULL, &handle);
 	
 	if (ret != pdPASS) {
 		LOGE("ERROR : CAN'T creat OTA task");
 		return;
 	}
 
-	ret = xTaskCreatePinnedToCore(&TaskRcvOtaBroadcast, "Broadcast",
-			4096, 
-			NULL,
-			5,
-			&handle,
-			tskNO_AFFINITY);
+	ret = task_create(TASK_BROADCAST, &TaskRcvOtaBroadcast, NULL, &handle);
 	
 	if (ret != pdPASS) {
 		LOGE("ERROR : CAN'T creat OTA broadcast task");
 		return;
 	}
+
+#if (ENABLE_HTTP_OTA)
+	ota_http_start();
+#endif
 #endif	// #if (ENABLE_WIFI_OTA)
 }
 
@@ -0,0 +1,299 @@
+/**
+ * @file ota_crypt.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Streaming AES-256-CTR/GCM decryption of OTA images, in place in the receive buffer
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "mbedtls/aes.h"
+#include "mbedtls/gcm.h"
+#include "mbedtls/platform_util.h"
+#include "nvs.h"
+
+#include "debug.h"
+#include "ota_crypt.h"
+#include "ota_stage.h"
+#if (OTA_CRYPT_HMAC_KEY >= 0)
+#include "esp_hmac.h"
+#endif
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "CRYPT"
+
+#define CRYPT_NVS_NAMESPACE	"ota_crypt"
+#define CRYPT_NVS_KEY		"key"
+
+/*---------------------------- Variables ---------------------------------*/
+static int crypt_require;	// console 'crypt require on|off' : plain images refused
+
+/*-------------------------- Function declares ---------------------------*/
+
+static esp_err_t crypt_load_key(uint8_t *key)
+{
+#if (OTA_CRYPT_HMAC_KEY >= 0)
+	static const char label[] = "ota image key";
+
+	return esp_hmac_calculate(HMAC_KEY0 + OTA_CRYPT_HMAC_KEY, label, sizeof(label) - 1, key);
+#else
+	nvs_handle_t nvs;
+	size_t len = OTA_CRYPT_KEY_SIZE;
+	esp_err_t err;
+
+	err = nvs_open(CRYPT_NVS_NAMESPACE, NVS_READONLY, &nvs);
+	if(err != ESP_OK) return err;
+
+	err = nvs_get_blob(nvs, CRYPT_NVS_KEY, key, &len);
+	nvs_close(nvs);
+	if(err == ESP_OK && len != OTA_CRYPT_KEY_SIZE) err = ESP_ERR_INVALID_SIZE;
+	return err;
+#endif
+}
+
+/*******************************************
+Before the transfer : key read and both ciphers keyed here,
+mbedtls_gcm_setkey() allocates and the receive loop must not
+*******************************************/
+esp_err_t ota_crypt_begin(ota_crypt_t *c, int file_size)
+{
+	memset(c, 0, sizeof(ota_crypt_t));
+	c->payload = file_size;
+	mbedtls_aes_init(&c->aes);
+	mbedtls_gcm_init(&c->gcm);
+
+	if(crypt_load_key(c->key) != ESP_OK) return ESP_OK;
+
+	if(mbedtls_aes_setkey_enc(&c->aes, c->key, OTA_CRYPT_KEY_SIZE * 8) != 0
+		|| mbedtls_gcm_setkey(&c->gcm, MBEDTLS_CIPHER_ID_AES, c->key, OTA_CRYPT_KEY_SIZE * 8) != 0)
+	{
+		LOGE("Image key setup ERROR");
+		return ESP_FAIL;
+	}
+	c->key_set = 1;
+	return ESP_OK;
+}
+
+static esp_err_t crypt_head(ota_crypt_t *c)
+{
+	int tag = 0;
+
+	if(memcmp(c->head, OTA_CRYPT_MAGIC, 4) != 0 || (c->head[4] != OTA_CRYPT_CTR && c->head[4] != OTA_CRYPT_GCM))
+	{
+		LOGE("Encrypted image head ERROR");
+		return ESP_ERR_INVALID_ARG;
+	}
+	if(!c->key_set)
+	{
+		LOGE("Encrypted image, no key : crypt key <64 hex>");
+		return ESP_ERR_INVALID_STATE;
+	}
+
+	c->mode = c->head[4];
+	if(c->mode == OTA_CRYPT_CTR)
+	{
+		memcpy(c->counter, &c->head[8], 16);
+	}
+	else
+	{
+		tag = OTA_CRYPT_TAG_SIZE;
+		if(c->payload <= 0)
+		{
+			LOGE("GCM image needs its size up front");
+			return ESP_ERR_INVALID_SIZE;
+		}
+		if(mbedtls_gcm_starts(&c->gcm, MBEDTLS_GCM_DECRYPT, &c->head[8], 12) != 0
+			|| mbedtls_gcm_update_ad(&c->gcm, c->head, OTA_CRYPT_HEAD_SIZE) != 0)
+		{
+			return ESP_FAIL;
+		}
+	}
+
+	c->payload = (c->payload > 0) ? c->payload - OTA_CRYPT_HEAD_SIZE - tag : -1;
+	if(c->payload == 0 || c->payload < -1) return ESP_ERR_INVALID_SIZE;
+
+	LOGI("Encrypted image : AES-256-%s", c->mode == OTA_CRYPT_CTR ? "CTR" : "GCM");
+	return ESP_OK;
+}
+
+/*******************************************
+Received bytes of the file in, plaintext out : *out / *out_len is the part of
+the same buffer that holds image bytes, decrypted in place (no copy).
+The head and the GCM tag are kept here, *out_len is 0 for a packet of only those.
+*******************************************/
+esp_err_t ota_crypt_update(ota_crypt_t *c, uint8_t *data, int len, uint8_t **out, int *out_len)
+{
+	size_t olen;
+	int n, rest;
+
+	*out = data;
+	*out_len = len;
+	if(len <= 0) return ESP_OK;
+
+	if(c->in == 0 && data[0] == OTA_CRYPT_MAGIC[0])
+	{
+		c->mode = OTA_CRYPT_HEAD;
+	}
+	else if(c->in == 0 && crypt_require)
+	{
+		LOGE("Plain image refused : crypt require on");
+		return ESP_ERR_NOT_ALLOWED;
+	}
+	c->in += len;
+	if(c->mode == OTA_CRYPT_PLAIN) return ESP_OK;
+
+	// head, possibly split over packets
+	if(c->head_len < OTA_CRYPT_HEAD_SIZE)
+	{
+		n = OTA_CRYPT_HEAD_SIZE - c->head_len;
+		if(n > len) n = len;
+		memcpy(&c->head[c->head_len], data, n);
+		c->head_len += n;
+		data += n;
+		len -= n;
+		*out = data;
+		*out_len = 0;
+		if(c->head_len < OTA_CRYPT_HEAD_SIZE) return ESP_OK;
+
+		if(crypt_head(c) != ESP_OK) return ESP_ERR_INVALID_ARG;
+	}
+
+	// ciphertext, then the tag
+	n = len;
+	if(c->payload >= 0 && c->decrypted + n > c->payload) n = c->payload - c->decrypted;
+	rest = len - n;
+	if(rest > 0)
+	{
+		if(c->mode != OTA_CRYPT_GCM || c->tag_len + rest > OTA_CRYPT_TAG_SIZE)
+		{
+			LOGE("Encrypted image longer than its size");
+			return ESP_ERR_INVALID_SIZE;
+		}
+		memcpy(&c->tag[c->tag_len], &data[n], rest);
+		c->tag_len += rest;
+	}
+
+	if(n > 0)
+	{
+		if(c->mode == OTA_CRYPT_CTR)
+		{
+			if(mbedtls_aes_crypt_ctr(&c->aes, n, &c->stream_off, c->counter, c->stream, data, data) != 0) return ESP_FAIL;
+		}
+		else
+		{
+			if(mbedtls_gcm_update(&c->gcm, data, n, data, n, &olen) != 0 || olen != n) return ESP_FAIL;
+		}
+		c->decrypted += n;
+	}
+
+	*out = data;
+	*out_len = n;
+	return ESP_OK;
+}
+
+// End of the file : everything decrypted, GCM tag checked before the image is activated
+esp_err_t ota_crypt_finish(ota_crypt_t *c)
+{
+	uint8_t tag[OTA_CRYPT_TAG_SIZE];
+	size_t olen;
+	int i, diff = 0;
+
+	if(c->mode == OTA_CRYPT_PLAIN) return ESP_OK;
+
+	if(c->mode == OTA_CRYPT_HEAD || (c->payload >= 0 && c->decrypted != c->payload))
+	{
+		LOGE("Encrypted image truncated : %d bytes decrypted", c->decrypted);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	if(c->mode == OTA_CRYPT_GCM)
+	{
+		if(c->tag_len != OTA_CRYPT_TAG_SIZE || mbedtls_gcm_finish(&c->gcm, NULL, 0, &olen, tag, sizeof(tag)) != 0)
+		{
+			return ESP_ERR_INVALID_SIZE;
+		}
+		for(i = 0; i < OTA_CRYPT_TAG_SIZE; i++) diff |= tag[i] ^ c->tag[i];
+		if(diff)
+		{
+			LOGE("Encrypted image tag mismatch");
+			return ESP_ERR_INVALID_CRC;
+		}
+	}
+
+	LOGI("Image decrypted : %d bytes", c->decrypted);
+	return ESP_OK;
+}
+
+// Plain images refused : transports that cannot carry an encrypted image refuse the transfer
+int ota_crypt_required(void)
+{
+	return crypt_require;
+}
+
+void ota_crypt_free(ota_crypt_t *c)
+{
+	mbedtls_aes_free(&c->aes);
+	mbedtls_gcm_free(&c->gcm);
+	mbedtls_platform_zeroize(c->key, sizeof(c->key));
+}
+
+/*---------------------------- Console -----------------------------------*/
+static void crypt_set_key(const uint8_t *key)
+{
+	nvs_handle_t nvs;
+	esp_err_t err;
+
+	err = nvs_open(CRYPT_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+	if(err != ESP_OK)
+	{
+		LOGE("NVS open ERROR : %s", esp_err_to_name(err));
+		return;
+	}
+
+	if(key) err = nvs_set_blob(nvs, CRYPT_NVS_KEY, key, OTA_CRYPT_KEY_SIZE);
+	else err = nvs_erase_key(nvs, CRYPT_NVS_KEY);
+	if(err == ESP_OK) err = nvs_commit(nvs);
+	if(err != ESP_OK) LOGE("Image key save ERROR : %s", esp_err_to_name(err));
+	nvs_close(nvs);
+}
+
+// crypt [key <64 hex>|clear|require on|off]
+void ota_crypt_command(char **token, int token_count)
+{
+	uint8_t key[OTA_CRYPT_KEY_SIZE];
+
+	if(token_count == 3 && strcmp(token[1], "key") == 0)
+	{
+		if(ota_stage_hex(token[2], strlen(token[2]), key) != 0)
+		{
+			LOGW("Key : 64 hex digits");
+			return;
+		}
+		crypt_set_key(key);
+		mbedtls_platform_zeroize(key, sizeof(key));
+	}
+	else if(token_count == 2 && strcmp(token[1], "clear") == 0)
+	{
+		crypt_set_key(NULL);
+	}
+	else if(token_count == 3 && strcmp(token[1], "require") == 0)
+	{
+		crypt_require = (strcmp(token[2], "on") == 0);
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : crypt [key <64 hex>|clear|require on|off]");
+		return;
+	}
+
+#if (OTA_CRYPT_HMAC_KEY >= 0)
+	LOGI("Image key : HMAC of eFuse key block %d", OTA_CRYPT_HMAC_KEY);
+#else
+	LOGI("Image key : %s", crypt_load_key(key) == ESP_OK ? "set (NVS)" : "none");
+	mbedtls_platform_zeroize(key, sizeof(key));
+#endif
+	LOGI("Plain images : %s", crypt_require ? "refused" : "accepted");
+}
@@ -0,0 +1,219 @@
+/**
+ * @file ota_http.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief HTTP upload of OTA images : POST body streamed into the OTA session, status page
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <strings.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_http_server.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "ota_http.h"
+#include "ota_session.h"
+#include "ota_stage.h"
+#include "ota_turbo.h"
+#include "multipart.h"
+#include "task_layout.h"
+#include "trace.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "HTTP"
+
+#define HTTP_PAGE_HEAD \
+	"<!DOCTYPE html><html><head><meta name=\"viewport\" content=\"width=device-width\">" \
+	"<title>OTA</title></head><body><h3>OTA update</h3>"
+
+#define HTTP_PAGE_FORM \
+	"<form method=\"post\" action=\"" OTA_HTTP_URI_UPDATE "\" enctype=\"multipart/form-data\">" \
+	"<input type=\"file\" name=\"firmware\"> <input type=\"submit\" value=\"Update\"></form></body></html>"
+
+/*---------------------------- Variables ---------------------------------*/
+static httpd_handle_t http_server;
+static char http_last[96] = "none";	// result of the last upload, on the status page
+
+/*-------------------------- Function declares ---------------------------*/
+
+static esp_err_t http_sink(void *ctx, uint8_t *data, int len)
+{
+	return ota_session_write((ota_session_t *)ctx, data, len);
+}
+
+static esp_err_t http_page_handler(httpd_req_t *req)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	const esp_app_desc_t *app = esp_app_get_description();
+	char line[160];
+
+	httpd_resp_set_type(req, "text/html");
+	httpd_resp_sendstr_chunk(req, HTTP_PAGE_HEAD);
+	snprintf(line, sizeof(line), "<p>Running : %s, %s %s</p>", running->label, app->project_name, app->version);
+	httpd_resp_sendstr_chunk(req, line);
+	snprintf(line, sizeof(line), "<p>Last upload : %s</p>", http_last);
+	httpd_resp_sendstr_chunk(req, line);
+	httpd_resp_sendstr_chunk(req, HTTP_PAGE_FORM);
+	return httpd_resp_sendstr_chunk(req, NULL);
+}
+
+static esp_err_t http_fail(httpd_req_t *req, httpd_err_code_t code, const char *msg)
+{
+	snprintf(http_last, sizeof(http_last), "ERROR, %s", msg);
+	LOGE("HTTP upload ERROR : %s", msg);
+	httpd_resp_send_err(req, code, msg);
+	return ESP_FAIL;
+}
+
+// Another transport (BLE, TCP, manifest, bench) is writing the update slot : nothing is received
+static esp_err_t http_busy(httpd_req_t *req)
+{
+	LOGW("HTTP upload refused : OTA session running");
+	httpd_resp_set_status(req, "409 Conflict");
+	httpd_resp_set_type(req, "text/plain");
+	httpd_resp_sendstr(req, "OTA session running\n");
+	return ESP_FAIL;
+}
+
+/*******************************************
+POST /update : Content-Type multipart/form-data (browser form, curl -F) goes
+through the boundary scanner, anything else is the image itself (curl --data-binary).
+Each receive lands in the session buffer and is written from there, the scanner
+passes the file bytes on in place. The reply is sent before the restart.
+*******************************************/
+static esp_err_t http_update_handler(httpd_req_t *req)
+{
+	ota_session_t session;
+	multipart_t mp;
+	char ctype[128];
+	uint8_t *buf;
+	int multipart, left, n, timeouts = 0;
+	int64_t elapsed;
+	esp_err_t err = ESP_OK;
+
+	if(req->content_len == 0) return http_fail(req, HTTPD_411_LENGTH_REQUIRED, "Content-Length required");
+	if(ota_session_busy()) return http_busy(req);
+
+	if(httpd_req_get_hdr_value_str(req, "Content-Type", ctype, sizeof(ctype)) != ESP_OK) ctype[0] = 0;
+	multipart = (strncasecmp(ctype, "multipart/", 10) == 0);
+
+	LOGI("+++ HTTP upload : %d bytes%s +++", (int)req->content_len, multipart ? ", multipart" : "");
+
+	// a raw body is the image, its size is known up front (GCM images need it)
+	if(ota_session_begin(&session, multipart ? 0 : req->content_len) != ESP_OK)
+	{
+		if(session.err == ESP_ERR_INVALID_STATE) return http_busy(req);
+		return http_fail(req, session.rejected ? HTTPD_400_BAD_REQUEST : HTTPD_500_INTERNAL_SERVER_ERROR,
+				session.rejected ? "image rejected" : "OTA begin failed");
+	}
+	session.defer_restart = 1;
+
+	buf = ota_session_alloc(&session, OTA_HTTP_RECV_SIZE);
+	if(buf == NULL || (multipart && multipart_begin(&mp, ctype, http_sink, &session) != ESP_OK))
+	{
+		ota_session_abort(&session);
+		return http_fail(req, HTTPD_400_BAD_REQUEST, "bad multipart body");
+	}
+
+	ota_turbo_begin(OTA_TURBO_TCP);
+
+	left = req->content_len;
+	while(left > 0)
+	{
+		TRACE(TRACE_HTTP_RECV_B, 0);
+		n = httpd_req_recv(req, (char *)buf, left < OTA_HTTP_RECV_SIZE ? left : OTA_HTTP_RECV_SIZE);
+		TRACE(TRACE_HTTP_RECV_E, n);
+		if(n == HTTPD_SOCK_ERR_TIMEOUT && ++timeouts < OTA_HTTP_RECV_RETRY) continue;
+		if(n <= 0)
+		{
+			LOGE("Error: receive data error! : %d, %d bytes left", n, left);
+			err = ESP_FAIL;
+			break;
+		}
+		timeouts = 0;
+		left -= n;
+
+		err = multipart ? multipart_feed(&mp, buf, n) : ota_session_write(&session, buf, n);
+		if(err != ESP_OK) break;
+	}
+
+	if(err == ESP_OK && multipart && !multipart_done(&mp))
+	{
+		LOGE("Multipart body without a complete file part");
+		err = ESP_ERR_INVALID_SIZE;
+	}
+	// a failed finish cleans up the session itself
+	if(err == ESP_OK)
+	{
+		err = ota_session_finish(&session);
+	}
+	else
+	{
+		ota_session_abort(&session);
+	}
+	elapsed = esp_timer_get_time() - session.start_us;
+	ota_turbo_end();
+
+	if(err != ESP_OK)
+	{
+		return http_fail(req, session.rejected ? HTTPD_400_BAD_REQUEST : HTTPD_500_INTERNAL_SERVER_ERROR,
+				session.rejected ? "image rejected" : "update failed");
+	}
+
+	snprintf(http_last, sizeof(http_last), "OK, %d bytes, %lld ms, %lld KB/s", session.received, elapsed / 1000,
+			elapsed > 0 ? (int64_t)session.received * 1000000 / 1024 / elapsed : 0LL);
+	httpd_resp_set_type(req, "text/plain");
+	httpd_resp_sendstr(req, ota_session_restarts(&session) ? "Update OK, restarting\n" : "Update OK\n");
+
+	if(ota_session_restarts(&session)) ota_stage_restart();
+	return ESP_OK;
+}
+
+static const httpd_uri_t http_uri_page = {
+	.uri = "/",
+	.method = HTTP_GET,
+	.handler = http_page_handler,
+};
+
+static const httpd_uri_t http_uri_update = {
+	.uri = OTA_HTTP_URI_UPDATE,
+	.method = HTTP_POST,
+	.handler = http_update_handler,
+};
+
+// httpd runs its own task : stack and core of the TASK_HTTP_OTA entry, priority and OTA profile by task_layout
+esp_err_t ota_http_start(void)
+{
+	const task_layout_t *t = task_layout_get(TASK_HTTP_OTA);
+	httpd_config_t config = HTTPD_DEFAULT_CONFIG();
+	esp_err_t err;
+
+	config.server_port = OTA_HTTP_PORT;
+	config.stack_size = t->stack;
+	config.core_id = task_layout_plan() ? t->core : tskNO_AFFINITY;
+	config.recv_wait_timeout = OTA_HTTP_RECV_TIMEOUT;
+	config.max_open_sockets = 3;
+	config.lru_purge_enable = true;
+
+	err = httpd_start(&http_server, &config);
+	if(err != ESP_OK)
+	{
+		LOGE("HTTP server start ERROR : %s", esp_err_to_name(err));
+		return err;
+	}
+
+	httpd_register_uri_handler(http_server, &http_uri_page);
+	httpd_register_uri_handler(http_server, &http_uri_update);
+	task_layout_adopt(TASK_HTTP_OTA, xTaskGetHandle(t->name));
+
+	LOGI("HTTP OTA : port %d, POST %s", OTA_HTTP_PORT, OTA_HTTP_URI_UPDATE);
+	return ESP_OK;
+}
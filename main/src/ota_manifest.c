@@ -0,0 +1,174 @@
+/**
+ * @file ota_manifest.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief OTA chunk manifest : per chunk SHA-256, Merkle root, bitmap of the chunks written
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_heap_caps.h"
+#include "mbedtls/sha256.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "heap_tag.h"
+#include "ota_manifest.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "MANIFEST"
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+// Leaves and bitmap are allocated here, outside of the transfer loop
+esp_err_t ota_manifest_init(ota_manifest_t *m, const ota_manifest_head_t *head)
+{
+	int count;
+	int prev;
+
+	memset(m, 0, sizeof(ota_manifest_t));
+
+	if(memcmp(head->magic, OTA_MANIFEST_MAGIC, 4) != 0)
+	{
+		LOGE("Manifest magic ERROR");
+		return ESP_ERR_INVALID_ARG;
+	}
+
+	count = (head->image_len + OTA_CHUNK_SIZE - 1) / OTA_CHUNK_SIZE;
+	if(head->chunk_size != OTA_CHUNK_SIZE || head->image_len == 0 || head->image_len > MAX_FIRMWARE_SIZE
+		|| head->chunk_count != count)
+	{
+		LOGE("Manifest ERROR : %u bytes, %u x %u bytes chunks", (unsigned int)head->image_len,
+				(unsigned int)head->chunk_count, (unsigned int)head->chunk_size);
+		return ESP_ERR_INVALID_SIZE;
+	}
+
+	m->head = *head;
+
+	prev = heap_tag_push(HEAP_TAG_OTA);
+	m->leaf = heap_caps_malloc(count * OTA_HASH_SIZE, MALLOC_CAP_8BIT);
+	m->done = heap_caps_calloc(1, (count + 7) / 8, MALLOC_CAP_8BIT);
+	heap_tag_pop(prev);
+	if(m->leaf == NULL || m->done == NULL)
+	{
+		LOGE("Manifest allocation failed : %d chunks", count);
+		ota_manifest_free(m);
+		return ESP_ERR_NO_MEM;
+	}
+
+	return ESP_OK;
+}
+
+void ota_manifest_free(ota_manifest_t *m)
+{
+	if(m->leaf) heap_caps_free(m->leaf);
+	if(m->done) heap_caps_free(m->done);
+	m->leaf = NULL;
+	m->done = NULL;
+}
+
+static void manifest_node(const uint8_t *left, const uint8_t *right, uint8_t *out)
+{
+	mbedtls_sha256_context ctx;
+
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	mbedtls_sha256_update(&ctx, left, OTA_HASH_SIZE);
+	mbedtls_sha256_update(&ctx, right, OTA_HASH_SIZE);
+	mbedtls_sha256_finish(&ctx, out);
+	mbedtls_sha256_free(&ctx);
+}
+
+/*******************************************
+Leaves received : the Merkle root built from them has to be the one of the head.
+One level is reduced in place at a time, in a copy of the leaves.
+*******************************************/
+esp_err_t ota_manifest_verify(const ota_manifest_t *m)
+{
+	uint8_t *level;
+	int count = m->head.chunk_count;
+	int i, n;
+	esp_err_t err = ESP_OK;
+
+	level = heap_caps_malloc(count * OTA_HASH_SIZE, MALLOC_CAP_8BIT);
+	if(level == NULL) return ESP_ERR_NO_MEM;
+
+	memcpy(level, m->leaf, count * OTA_HASH_SIZE);
+	while(count > 1)
+	{
+		for(i = 0, n = 0; i < count; i += 2, n++)
+		{
+			if(i + 1 < count) manifest_node(&level[i * OTA_HASH_SIZE], &level[(i + 1) * OTA_HASH_SIZE], &level[n * OTA_HASH_SIZE]);
+			else memmove(&level[n * OTA_HASH_SIZE], &level[i * OTA_HASH_SIZE], OTA_HASH_SIZE);
+		}
+		count = n;
+	}
+
+	if(memcmp(level, m->head.root, OTA_HASH_SIZE) != 0)
+	{
+		LOGE("Manifest Merkle root mismatch");
+		err = ESP_ERR_INVALID_CRC;
+	}
+	else
+	{
+		LOGI("Manifest : %u bytes, %u chunks, root %02x%02x%02x%02x...", (unsigned int)m->head.image_len,
+				(unsigned int)m->head.chunk_count, m->head.root[0], m->head.root[1], m->head.root[2], m->head.root[3]);
+	}
+
+	heap_caps_free(level);
+	return err;
+}
+
+// Bytes of the chunk, the last one is shorter. 0 : no such chunk
+int ota_manifest_chunk_len(const ota_manifest_t *m, int index)
+{
+	int offset = index * OTA_CHUNK_SIZE;
+
+	if(index < 0 || index >= m->head.chunk_count) return 0;
+
+	return (m->head.image_len - offset < OTA_CHUNK_SIZE) ? m->head.image_len - offset : OTA_CHUNK_SIZE;
+}
+
+// 1 : SHA-256 of the data is the leaf of the chunk
+int ota_manifest_check(const ota_manifest_t *m, int index, const void *data, int len)
+{
+	uint8_t sha256[OTA_HASH_SIZE];
+
+	if(len == 0 || len != ota_manifest_chunk_len(m, index)) return 0;
+
+	mbedtls_sha256(data, len, sha256, 0);
+	return ota_manifest_check_hash(m, index, sha256);
+}
+
+int ota_manifest_check_hash(const ota_manifest_t *m, int index, const uint8_t *sha256)
+{
+	return memcmp(&m->leaf[index * OTA_HASH_SIZE], sha256, OTA_HASH_SIZE) == 0;
+}
+
+int ota_manifest_is_done(const ota_manifest_t *m, int index)
+{
+	return (m->done[index / 8] >> (index % 8)) & 1;
+}
+
+void ota_manifest_set_done(ota_manifest_t *m, int index)
+{
+	if(ota_manifest_is_done(m, index)) return;
+
+	m->done[index / 8] |= 1 << (index % 8);
+	m->done_count++;
+}
+
+int ota_manifest_complete(const ota_manifest_t *m)
+{
+	return m->done_count == m->head.chunk_count;
+}
+
+int ota_manifest_bitmap_len(const ota_manifest_t *m)
+{
+	return (m->head.chunk_count + 7) / 8;
+}
@@ -0,0 +1,1341 @@
+/**
+ * @file ota_session.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief OTA session and image backends shared by the TCP and BLE transports
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <assert.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "esp_app_desc.h"
+#include "esp_chip_info.h"
+#include "esp_efuse.h"
+#include "esp_heap_caps.h"
+#include "esp_rom_sys.h"
+#include "esp_rom_crc.h"
+#include "mbedtls/sha256.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "ota_session.h"
+#include "heap_tag.h"
+#include "ota_stage.h"
+#include "ota_manifest.h"
+#include "ota_crypt.h"
+#include "trace.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "OTA"
+
+#define FLASH_SECTOR_SIZE	OTA_SECTOR_SIZE
+#define FLASH_PAGE_SIZE		256
+
+// Image header, first segment header, esp_app_desc_t at the start of the first segment
+#define OTA_HEAD_SIZE		(sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t) + sizeof(esp_app_desc_t))
+
+// Typical ESP32 SPI flash timings : 4 KB sector erase ~45 ms, 256 byte page program ~0.7 ms
+#define SIM_ERASE_US_DEFAULT	45000
+#define SIM_PAGE_US_DEFAULT		700
+
+/*---------------------------- Variables ---------------------------------*/
+static int slice_enabled = 1;
+static int slice_size = OTA_SLICE_DEFAULT;
+static int slice_target_us = OTA_STALL_TARGET_US;
+static int skip_enabled = 1;
+static int refuse_same_version;		// console 'ota same refuse|allow'
+static ota_slice_stats_t slice_last;	// last sliced session
+
+static portMUX_TYPE slot_lock = portMUX_INITIALIZER_UNLOCKED;
+static const ota_session_t *slot_session;	// session writing the update slot
+static int session_ended;	// sessions released, started ones only
+static int restart_held;	// soak : an activated image stays selected, no restart
+
+static int sim_erase_us = SIM_ERASE_US_DEFAULT;
+static int sim_page_us = SIM_PAGE_US_DEFAULT;
+static ota_sim_stats_t sim_stats;
+static int sim_image_size;	// ota_sim_image_crc() cache
+static int sim_slot_size;	// size of the last activated image, the sim "flash" content
+static int sim_slot_valid;	// bytes of it not erased since
+static uint32_t sim_image_crc;
+
+/*-------------------------- Function declares ---------------------------*/
+
+/*---------------------------- Flash backend -----------------------------*/
+typedef struct {
+	const esp_partition_t *partition;
+	esp_ota_handle_t handle;
+	int sliced;		// erase/program through esp_partition, no esp_ota handle
+} flash_ctx_t;
+
+static esp_err_t flash_begin(void *ctx, int image_size, int *sliced)
+{
+	flash_ctx_t *f = ctx;
+	esp_err_t err;
+	const esp_partition_t *configured = esp_ota_get_boot_partition();
+	const esp_partition_t *running = esp_ota_get_running_partition();
+
+	if(configured != running)
+	{
+		LOGI("Configured OTA boot partition at offset 0x%08x, but running from offset 0x%08x",
+				configured->address, running->address);
+		LOGI("(This can happen if either the OTA boot data or preferred boot image become corrupted somehow.)");
+	}
+
+	LOGI("Running partition type %d subtype %d (offset 0x%08x)",
+			running->type, running->subtype, running->address);
+
+	f->partition = esp_ota_get_next_update_partition(NULL);
+	if(f->partition == NULL)
+	{
+		LOGE("Update partition ERROR");
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	LOGI("Writing to partition subtype %d at offset 0x%x", f->partition->subtype, f->partition->address);
+	ota_stage_invalidate(f->partition);
+
+	// Encrypted writes need the 16 byte block buffering of esp_ota_write()
+	f->sliced = *sliced && !f->partition->encrypted;
+	*sliced = f->sliced;
+	if(f->sliced)
+	{
+		if(image_size > (int)f->partition->size)
+		{
+			LOGE("Image %d bytes larger than the partition %u", image_size, (unsigned int)f->partition->size);
+			return ESP_ERR_INVALID_SIZE;
+		}
+		LOGI("Sliced OTA write, sectors are erased as the image arrives");
+		return ESP_OK;
+	}
+
+	err = esp_ota_begin(f->partition, image_size > 0 ? image_size : OTA_SIZE_UNKNOWN, &f->handle);
+	if(err != ESP_OK)
+	{
+		LOGE("esp_ota_begin failed, error=%d", err);
+		return err;
+	}
+
+	LOGI("esp_ota_begin succeeded");
+	return ESP_OK;
+}
+
+static esp_err_t flash_write(void *ctx, const void *data, int len)
+{
+	flash_ctx_t *f = ctx;
+
+	return esp_ota_write(f->handle, data, len);
+}
+
+static esp_err_t flash_erase(void *ctx, int offset, int len)
+{
+	flash_ctx_t *f = ctx;
+
+	return esp_partition_erase_range(f->partition, offset, len);
+}
+
+static esp_err_t flash_program(void *ctx, int offset, const void *data, int len)
+{
+	flash_ctx_t *f = ctx;
+
+	if(offset == 0 && ((const uint8_t *)data)[0] != ESP_IMAGE_HEADER_MAGIC)
+	{
+		LOGE("OTA image has invalid magic byte (expected 0xE9, saw 0x%02x)", ((const uint8_t *)data)[0]);
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+	return esp_partition_write(f->partition, offset, data, len);
+}
+
+// Read through the cache (mmap) : unlike esp_partition_read() it keeps the cache enabled
+static int flash_same(void *ctx, int offset, const void *data, int len)
+{
+	flash_ctx_t *f = ctx;
+	esp_partition_mmap_handle_t handle;
+	const void *p;
+	int same;
+
+	if(esp_partition_mmap(f->partition, offset, len, ESP_PARTITION_MMAP_DATA, &p, &handle) != ESP_OK) return 0;
+
+	same = (memcmp(p, data, len) == 0);
+	esp_partition_munmap(handle);
+	return same;
+}
+
+static esp_err_t flash_hash(void *ctx, int offset, int len, uint8_t *sha256)
+{
+	flash_ctx_t *f = ctx;
+	esp_partition_mmap_handle_t handle;
+	const void *p;
+	esp_err_t err;
+
+	err = esp_partition_mmap(f->partition, offset, len, ESP_PARTITION_MMAP_DATA, &p, &handle);
+	if(err != ESP_OK) return err;
+
+	mbedtls_sha256(p, len, sha256, 0);
+	esp_partition_munmap(handle);
+	return ESP_OK;
+}
+
+static esp_err_t flash_end(void *ctx)
+{
+	flash_ctx_t *f = ctx;
+	esp_partition_pos_t pos;
+	esp_image_metadata_t data;
+
+	if(!f->sliced) return esp_ota_end(f->handle);
+
+	// what esp_ota_end() checks
+	pos.offset = f->partition->address;
+	pos.size = f->partition->size;
+	if(esp_image_verify(ESP_IMAGE_VERIFY, &pos, &data) != ESP_OK)
+	{
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+	return ESP_OK;
+}
+
+static esp_err_t flash_activate(void *ctx)
+{
+	flash_ctx_t *f = ctx;
+
+	return esp_ota_set_boot_partition(f->partition);
+}
+
+static void flash_abort(void *ctx)
+{
+	flash_ctx_t *f = ctx;
+
+	if(!f->sliced) esp_ota_abort(f->handle);
+}
+
+static const ota_backend_t flash_backend = {
+	.name = "flash",
+	.ctx_size = sizeof(flash_ctx_t),
+	.begin = flash_begin,
+	.write = flash_write,
+	.erase = flash_erase,
+	.program = flash_program,
+	.same = flash_same,
+	.hash = flash_hash,
+	.end = flash_end,
+	.activate = flash_activate,
+	.abort = flash_abort,
+	.restart = 1,
+	.image = 1,
+	.slot = 1,
+};
+
+/*---------------------------- Null backend ------------------------------*/
+// Image is received and counted but never written : measures the transport alone
+static esp_err_t null_begin(void *ctx, int image_size, int *sliced)
+{
+	LOGI("OTA to null backend, image is discarded");
+	return ESP_OK;
+}
+
+static esp_err_t null_write(void *ctx, const void *data, int len)
+{
+	return ESP_OK;
+}
+
+static esp_err_t null_end(void *ctx)
+{
+	return ESP_OK;
+}
+
+static void null_abort(void *ctx)
+{
+}
+
+static const ota_backend_t null_backend = {
+	.name = "null",
+	.begin = null_begin,
+	.write = null_write,
+	.end = null_end,
+	.activate = null_end,
+	.abort = null_abort,
+	.restart = 0,
+};
+
+/*---------------------------- Sim backend -------------------------------*/
+typedef struct {
+	int erased;			// bytes erased so far
+	int written;
+	int size;			// declared image size
+	int random;			// out of order programs : checked against the synthetic image as they come
+	int random_bad;
+	uint8_t head[8];
+	uint8_t tail[4];	// last 4 bytes seen : CRC trailer if the image ends here
+	uint32_t crc;		// CRC of everything but the last 4 bytes
+	uint32_t crc_all;
+} sim_ctx_t;
+
+// No flash access, but the CPU is blocked for as long as the erase/program would take,
+// yielding a tick every 20 ms like CONFIG_SPI_FLASH_YIELD_DURING_ERASE
+static void sim_busy(int us)
+{
+	while(us > 0)
+	{
+		esp_rom_delay_us(us > 20000 ? 20000 : us);
+		us -= 20000;
+		if(us > 0) vTaskDelay(1);
+	}
+}
+
+static esp_err_t sim_begin(void *ctx, int image_size, int *sliced)
+{
+	sim_ctx_t *c = ctx;
+
+	c->size = image_size;
+	sim_stats.begun++;
+
+	// esp_ota_begin() erases the whole image up front when the size is known
+	if(!*sliced) sim_slot_valid = 0;
+	if(image_size > 0 && !*sliced)
+	{
+		c->erased = (image_size + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * FLASH_SECTOR_SIZE;
+		sim_busy(c->erased / FLASH_SECTOR_SIZE * sim_erase_us);
+	}
+
+	return ESP_OK;
+}
+
+// Image bytes in order : head, CRC trailer, programmed pages
+static int sim_track(sim_ctx_t *c, const void *data, int len)
+{
+	const uint8_t *p = data;
+	int pages = (c->written + len + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE - (c->written + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE;
+	int i, keep;
+
+	c->crc_all = esp_rom_crc32_le(c->crc_all, p, len);
+
+	for(i = 0; i < len && c->written + i < sizeof(c->head); i++)
+	{
+		c->head[c->written + i] = p[i];
+	}
+
+	// bytes pushed out of the 4 byte tail are not the trailer
+	keep = (c->written < 4) ? c->written : 4;
+	for(i = 0; i < len; i++)
+	{
+		if(keep == 4)
+		{
+			c->crc = esp_rom_crc32_le(c->crc, c->tail, 1);
+			memmove(c->tail, c->tail + 1, 3);
+			keep = 3;
+		}
+		c->tail[keep++] = p[i];
+	}
+
+	c->written += len;
+	return pages;
+}
+
+static esp_err_t sim_write(void *ctx, const void *data, int len)
+{
+	sim_ctx_t *c = ctx;
+	int pages = sim_track(c, data, len);
+
+	while(c->erased < c->written)
+	{
+		c->erased += FLASH_SECTOR_SIZE;
+		sim_busy(sim_erase_us);
+	}
+
+	sim_busy(pages * sim_page_us);
+	return ESP_OK;
+}
+
+static esp_err_t sim_erase(void *ctx, int offset, int len)
+{
+	sim_ctx_t *c = ctx;
+
+	c->erased = offset + len;
+	if(offset < sim_slot_valid) sim_slot_valid = offset;
+	sim_busy((len + FLASH_SECTOR_SIZE - 1) / FLASH_SECTOR_SIZE * sim_erase_us);
+	return ESP_OK;
+}
+
+// Programmed bytes are the synthetic image of the declared size : see ota_sim_image_read()
+static int sim_image_match(sim_ctx_t *c, int offset, const uint8_t *p, int len)
+{
+	uint8_t buf[256];
+	int off, n;
+
+	for(off = 0; off < len; off += n)
+	{
+		n = (len - off < sizeof(buf)) ? len - off : sizeof(buf);
+		ota_sim_image_read(c->size, offset + off, buf, n);
+		if(memcmp(buf, p + off, n) != 0) return 0;
+	}
+	return 1;
+}
+
+static uint32_t sim_image_prefix_crc(sim_ctx_t *c, int len)
+{
+	uint8_t buf[256];
+	uint32_t crc = 0;
+	int off, n;
+
+	for(off = 0; off < len; off += n)
+	{
+		n = (len - off < sizeof(buf)) ? len - off : sizeof(buf);
+		ota_sim_image_read(c->size, off, buf, n);
+		crc = esp_rom_crc32_le(crc, buf, n);
+	}
+	return crc;
+}
+
+/*******************************************
+The sliced writer programs in order, the manifest mode in any order.
+From the first out of order program on, the bytes programmed in order so far
+and every program after are compared with the synthetic image of the declared size.
+*******************************************/
+static esp_err_t sim_program(void *ctx, int offset, const void *data, int len)
+{
+	sim_ctx_t *c = ctx;
+
+	if(!c->random && offset == c->written && offset + len <= c->erased)
+	{
+		sim_busy(sim_track(c, data, len) * sim_page_us);
+		return ESP_OK;
+	}
+	if(c->size < OTA_SIM_IMAGE_MIN || offset + len > c->size) return ESP_ERR_INVALID_STATE;
+
+	if(!c->random)
+	{
+		c->random = 1;
+		if(c->crc_all != sim_image_prefix_crc(c, c->written)) c->random_bad++;
+	}
+
+	if(!sim_image_match(c, offset, data, len)) c->random_bad++;
+	c->written += len;
+	sim_busy((len + FLASH_PAGE_SIZE - 1) / FLASH_PAGE_SIZE * sim_page_us);
+	return ESP_OK;
+}
+
+// Stands in for the image verification of esp_ota_end() : see ota_sim_image_read()
+static esp_err_t sim_end(void *ctx)
+{
+	sim_ctx_t *c = ctx;
+	uint32_t size, crc;
+
+	if(c->random)
+	{
+		if(c->written != c->size || c->random_bad > 0)
+		{
+			LOGE("Sim image verification failed : %d of %d bytes, %d bad programs", c->written, c->size, c->random_bad);
+			sim_stats.rejected++;
+			return ESP_ERR_OTA_VALIDATE_FAILED;
+		}
+		c->crc_all = ota_sim_image_crc(c->size);
+		return ESP_OK;
+	}
+
+	memcpy(&size, &c->head[4], 4);
+	memcpy(&crc, c->tail, 4);
+
+	if(c->written < OTA_SIM_IMAGE_MIN || memcmp(c->head, OTA_SIM_MAGIC, 4) != 0
+		|| size != c->written || crc != c->crc)
+	{
+		LOGE("Sim image verification failed : %d bytes", c->written);
+		sim_stats.rejected++;
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	return ESP_OK;
+}
+
+// Images of the sim backend are a function of their size : the slot holds the last activated one
+static int sim_same(void *ctx, int offset, const void *data, int len)
+{
+	sim_ctx_t *c = ctx;
+	uint8_t buf[256];
+	const uint8_t *p = data;
+	int off, n;
+
+	if(c->random || offset != c->written || offset + len > sim_slot_valid) return 0;
+
+	for(off = 0; off < len; off += n)
+	{
+		n = (len - off < sizeof(buf)) ? len - off : sizeof(buf);
+		ota_sim_image_read(sim_slot_size, offset + off, buf, n);
+		if(memcmp(buf, p + off, n) != 0) return 0;
+	}
+
+	sim_track(c, data, len);
+	c->erased = offset + len;
+	return 1;
+}
+
+static esp_err_t sim_activate(void *ctx)
+{
+	sim_ctx_t *c = ctx;
+
+	sim_stats.activated++;
+	sim_slot_size = c->written;
+	sim_slot_valid = c->written;
+	sim_stats.crc = c->crc_all;
+	sim_stats.size = c->written;
+	return ESP_OK;
+}
+
+static void sim_abort(void *ctx)
+{
+	sim_stats.aborted++;
+}
+
+static const ota_backend_t sim_backend = {
+	.name = "sim",
+	.ctx_size = sizeof(sim_ctx_t),
+	.begin = sim_begin,
+	.write = sim_write,
+	.erase = sim_erase,
+	.program = sim_program,
+	.same = sim_same,
+	.end = sim_end,
+	.activate = sim_activate,
+	.abort = sim_abort,
+	.restart = 0,
+	.slot = 1,
+};
+
+static uint8_t sim_image_byte(int offset)
+{
+	return (uint8_t)(offset * 7 + (offset >> 8));
+}
+
+static void sim_image_body(int size, int offset, uint8_t *buf, int len)
+{
+	int i;
+
+	for(i = 0; i < len; i++, offset++)
+	{
+		if(offset < 4) buf[i] = OTA_SIM_MAGIC[offset];
+		else if(offset < 8) buf[i] = (uint8_t)(size >> ((offset - 4) * 8));
+		else buf[i] = sim_image_byte(offset);
+	}
+}
+
+static uint32_t sim_image_crc_body(int size)
+{
+	uint8_t buf[256];
+	uint32_t crc = 0;
+	int off, n;
+
+	if(size == sim_image_size) return sim_image_crc;
+
+	for(off = 0; off < size - 4; off += n)
+	{
+		n = (size - 4 - off < sizeof(buf)) ? size - 4 - off : sizeof(buf);
+		sim_image_body(size, off, buf, n);
+		crc = esp_rom_crc32_le(crc, buf, n);
+	}
+
+	sim_image_size = size;
+	sim_image_crc = crc;
+	return crc;
+}
+
+/*******************************************
+Synthetic image accepted by the sim backend :
+magic "ESIM", total size (LE), pattern, CRC32 of everything before it (LE)
+*******************************************/
+void ota_sim_image_read(int size, int offset, uint8_t *buf, int len)
+{
+	uint32_t crc = sim_image_crc_body(size);
+	int i, n;
+
+	n = (offset + len > size - 4) ? size - 4 - offset : len;
+	if(n > 0)
+	{
+		sim_image_body(size, offset, buf, n);
+	}
+	else
+	{
+		n = 0;
+	}
+
+	for(i = n; i < len; i++)
+	{
+		buf[i] = (uint8_t)(crc >> ((offset + i - (size - 4)) * 8));
+	}
+}
+
+// CRC32 of the whole synthetic image, trailer included
+uint32_t ota_sim_image_crc(int size)
+{
+	uint32_t crc = sim_image_crc_body(size);
+	uint8_t trailer[4];
+
+	memcpy(trailer, &crc, 4);
+	return esp_rom_crc32_le(crc, trailer, 4);
+}
+
+void ota_sim_stats_get(ota_sim_stats_t *stats)
+{
+	*stats = sim_stats;
+}
+
+void ota_sim_stats_reset(void)
+{
+	memset(&sim_stats, 0, sizeof(sim_stats));
+}
+
+void ota_slice_stats_get(ota_slice_stats_t *stats)
+{
+	*stats = slice_last;
+}
+
+void ota_sim_set_latency(int erase_us, int page_us)
+{
+	sim_erase_us = erase_us < 0 ? SIM_ERASE_US_DEFAULT : erase_us;
+	sim_page_us = page_us < 0 ? SIM_PAGE_US_DEFAULT : page_us;
+}
+
+void ota_sim_get_latency(int *erase_us, int *page_us)
+{
+	*erase_us = sim_erase_us;
+	*page_us = sim_page_us;
+}
+
+static const ota_backend_t *ota_backends[] = {
+	&flash_backend,
+	&null_backend,
+	&sim_backend,
+};
+
+static const ota_backend_t *ota_backend = &flash_backend;
+
+/*---------------------------- Session -----------------------------------*/
+const ota_backend_t *ota_get_backend(void)
+{
+	return ota_backend;
+}
+
+const ota_backend_t *ota_find_backend(const char *name)
+{
+	int i;
+
+	for(i = 0; i < sizeof(ota_backends) / sizeof(ota_backends[0]); i++)
+	{
+		if(strcmp(name, ota_backends[i]->name) == 0) return ota_backends[i];
+	}
+
+	return NULL;
+}
+
+int ota_set_backend(const char *name)
+{
+	const ota_backend_t *backend = ota_find_backend(name);
+
+	if(backend == NULL) return -1;
+
+	ota_backend = backend;
+	return 0;
+}
+
+esp_err_t ota_session_begin(ota_session_t *s, int image_size)
+{
+	return ota_session_start(s, ota_backend, image_size);
+}
+
+/*******************************************
+First bytes of the image : reject a wrong chip, a bad magic or an older
+secure version before the rest is transferred, instead of at esp_ota_end()
+*******************************************/
+static esp_err_t ota_head_check(ota_session_t *s)
+{
+	const esp_image_header_t *hdr = (const esp_image_header_t *)s->head;
+	const esp_app_desc_t *desc = (const esp_app_desc_t *)&s->head[sizeof(esp_image_header_t) + sizeof(esp_image_segment_header_t)];
+	const esp_app_desc_t *running = esp_app_get_description();
+	esp_chip_info_t chip;
+
+	if(hdr->magic != ESP_IMAGE_HEADER_MAGIC)
+	{
+		LOGE("Image rejected : magic 0x%02x", hdr->magic);
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	if(hdr->chip_id != CONFIG_IDF_FIRMWARE_CHIP_ID)
+	{
+		LOGE("Image rejected : chip id %d, expected %d", (int)hdr->chip_id, CONFIG_IDF_FIRMWARE_CHIP_ID);
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	esp_chip_info(&chip);
+	if(chip.revision < hdr->min_chip_rev_full || (hdr->max_chip_rev_full != 0 && chip.revision > hdr->max_chip_rev_full))
+	{
+		LOGE("Image rejected : chip revision v%d.%d not in v%d.%d ~ v%d.%d", chip.revision / 100, chip.revision % 100,
+				hdr->min_chip_rev_full / 100, hdr->min_chip_rev_full % 100, hdr->max_chip_rev_full / 100, hdr->max_chip_rev_full % 100);
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	if(desc->magic_word != ESP_APP_DESC_MAGIC_WORD)
+	{
+		LOGE("Image rejected : no app description");
+		return ESP_ERR_OTA_VALIDATE_FAILED;
+	}
+
+	LOGI("Image : %.32s %.32s, %.16s %.16s, IDF %.32s, secure version %u", desc->project_name, desc->version,
+			desc->date, desc->time, desc->idf_ver, (unsigned int)desc->secure_version);
+
+#if (CONFIG_BOOTLOADER_APP_ANTI_ROLLBACK)
+	if(!esp_efuse_check_secure_version(desc->secure_version))
+#else
+	if(desc->secure_version < running->secure_version)
+#endif
+	{
+		LOGE("Image rejected : secure version %u too old", (unsigned int)desc->secure_version);
+		return ESP_ERR_OTA_SMALL_SEC_VER;
+	}
+
+	if(refuse_same_version && strncmp(desc->version, running->version, sizeof(desc->version)) == 0)
+	{
+		LOGE("Image rejected : version %.32s already running", desc->version);
+		return ESP_ERR_INVALID_VERSION;
+	}
+
+	return ESP_OK;
+}
+
+static esp_err_t ota_head_write(ota_session_t *s, const uint8_t *data, int len)
+{
+	int n = OTA_HEAD_SIZE - s->head_len;
+	esp_err_t err;
+
+	if(n > len) n = len;
+	memcpy(&s->head[s->head_len], data, n);
+	s->head_len += n;
+
+	if(s->head_len < OTA_HEAD_SIZE) return ESP_OK;
+
+	// checked once : later writes go straight to the backend
+	err = ota_head_check(s);
+	s->head = NULL;
+	return err;
+}
+
+// End of the transfer loop : report any heap allocation made by the session task since the first write
+static void ota_session_watch_end(ota_session_t *s)
+{
+	uint32_t allocs;
+
+	if(s->watch.task == NULL) return;
+
+	allocs = heap_watch_end(&s->watch);
+	if(allocs > 0)
+	{
+		LOGE("OTA transfer loop : %u heap allocations, %u bytes", (unsigned int)allocs, (unsigned int)s->watch.bytes);
+#if (CONFIG_COMPILER_OPTIMIZATION_DEBUG)
+		assert(allocs == 0);
+#endif
+	}
+}
+
+// Update slot : one session writes it at a time, whichever transport it comes from
+static int ota_slot_claim(const ota_session_t *s)
+{
+	int claimed;
+
+	portENTER_CRITICAL(&slot_lock);
+	if(slot_session == NULL) slot_session = s;
+	claimed = (slot_session == s);
+	portEXIT_CRITICAL(&slot_lock);
+	return claimed;
+}
+
+static void ota_slot_release(const ota_session_t *s)
+{
+	portENTER_CRITICAL(&slot_lock);
+	if(slot_session == s) slot_session = NULL;
+	portEXIT_CRITICAL(&slot_lock);
+}
+
+int ota_session_busy(void)
+{
+	return slot_session != NULL;
+}
+
+int ota_session_ended(void)
+{
+	return session_ended;
+}
+
+void ota_session_hold_restart(int hold)
+{
+	restart_held = hold;
+}
+
+// After a successful finish : whether the transport restarts into the new image
+int ota_session_restarts(const ota_session_t *s)
+{
+	return s->backend->restart && !restart_held;
+}
+
+// Everything of the session goes with its arena : released once, by start, finish or abort
+static void ota_session_release(ota_session_t *s)
+{
+	ota_session_watch_end(s);
+	if(s->arena == NULL) return;
+
+	if(s->sliced && (s->slice.slices > 0 || s->slice.skipped > 0))
+	{
+		slice_last = s->slice;
+		LOGI("Sliced write : %d operations (%d erases), max stall %d us (erase %d, program %d), %d yields, slice %d",
+				s->slice.slices, s->slice.erases, s->slice.max_stall_us, s->slice.max_erase_us, s->slice.max_program_us,
+				s->slice.yields, s->slice.slice);
+		if(s->slice.compared > 0)
+		{
+			LOGI("Identical sectors skipped : %d / %d", s->slice.skipped, s->slice.compared);
+		}
+	}
+	if(s->manifest)
+	{
+		slice_last.resumed = s->slice.resumed;
+		slice_last.bad_chunks = s->slice.bad_chunks;
+		LOGI("Manifest chunks : %d / %d, %d resumed, %d sent again", s->manifest->done_count,
+				(int)s->manifest->head.chunk_count, s->slice.resumed, s->slice.bad_chunks);
+	}
+	if(s->crypt)
+	{
+		ota_crypt_free(s->crypt);
+		s->crypt = NULL;
+	}
+	heap_caps_free(s->arena);
+	s->arena = NULL;
+	s->ctx = NULL;
+	ota_slot_release(s);
+	session_ended++;
+}
+
+esp_err_t ota_session_start(ota_session_t *s, const ota_backend_t *backend, int image_size)
+{
+	int prev;
+
+	memset(s, 0, sizeof(ota_session_t));
+	s->backend = backend;
+	s->size = image_size;
+	s->start_us = esp_timer_get_time();
+
+	if(backend->image && image_size > MAX_FIRMWARE_SIZE)
+	{
+		LOGE("Image rejected : %d bytes, MAX_FIRMWARE_SIZE %d", image_size, MAX_FIRMWARE_SIZE);
+		s->rejected = 1;
+		s->err = ESP_ERR_INVALID_SIZE;
+		return s->err;
+	}
+	s->sliced = slice_enabled && backend->erase != NULL;
+	s->slice.slice = slice_size;
+
+	if(backend->slot && !ota_slot_claim(s))
+	{
+		LOGE("OTA rejected : another session is writing the update slot");
+		s->err = ESP_ERR_INVALID_STATE;
+		return s->err;
+	}
+
+	prev = heap_tag_push(HEAP_TAG_OTA);
+	s->arena = heap_caps_malloc(OTA_SESSION_ARENA_SIZE, MALLOC_CAP_INTERNAL | MALLOC_CAP_8BIT);
+	heap_tag_pop(prev);
+	if(s->arena == NULL)
+	{
+		LOGE("OTA session arena allocation failed");
+		ota_slot_release(s);
+		s->err = ESP_ERR_NO_MEM;
+		return s->err;
+	}
+
+	s->ctx = ota_session_alloc(s, backend->ctx_size);
+	s->crypt = ota_session_alloc(s, sizeof(ota_crypt_t));
+	if(s->ctx != NULL) memset(s->ctx, 0, backend->ctx_size);
+	if(s->ctx == NULL || s->crypt == NULL || ota_crypt_begin(s->crypt, image_size) != ESP_OK)
+	{
+		s->err = (s->ctx == NULL || s->crypt == NULL) ? ESP_ERR_NO_MEM : ESP_FAIL;
+		ota_session_release(s);
+		return s->err;
+	}
+
+	TRACE(TRACE_OTA_BEGIN_B, image_size);
+	s->err = s->backend->begin(s->ctx, image_size, &s->sliced);
+	TRACE(TRACE_OTA_BEGIN_E, s->err);
+	s->begin_us = esp_timer_get_time() - s->start_us;
+	if(s->err != ESP_OK)
+	{
+		ota_session_release(s);
+		return s->err;
+	}
+
+	s->skip = s->sliced && skip_enabled && s->backend->same != NULL;
+	if(s->skip)
+	{
+		s->sector = ota_session_alloc(s, FLASH_SECTOR_SIZE);
+	}
+	if(s->backend->image)
+	{
+		s->head = ota_session_alloc(s, OTA_HEAD_SIZE);
+	}
+
+	// without them the early header check and the skip mode would be off, silently
+	if((s->skip && s->sector == NULL) || (s->backend->image && s->head == NULL))
+	{
+		LOGE("OTA session arena exhausted");
+		s->backend->abort(s->ctx);
+		ota_session_release(s);
+		s->err = ESP_ERR_NO_MEM;
+	}
+	return s->err;
+}
+
+// Bump allocation from the session arena, valid until the session ends
+void *ota_session_alloc(ota_session_t *s, int size)
+{
+	void *p;
+
+	size = (size + 3) & ~3;
+	if(s->arena == NULL || s->arena_used + size > OTA_SESSION_ARENA_SIZE)
+	{
+		LOGE("OTA session arena exhausted : %d + %d bytes", s->arena_used, size);
+		return NULL;
+	}
+
+	p = &s->arena[s->arena_used];
+	s->arena_used += size;
+	return p;
+}
+
+// One flash operation done : account it, adapt the program slice, let the radio tasks run
+static void ota_slice_done(ota_session_t *s, int64_t us, int erase)
+{
+	ota_slice_stats_t *st = &s->slice;
+
+	st->slices++;
+	st->stall_us += us;
+	if(us > st->max_stall_us) st->max_stall_us = us;
+	if(erase)
+	{
+		st->erases++;
+		if(us > st->max_erase_us) st->max_erase_us = us;
+	}
+	else
+	{
+		if(us > st->max_program_us) st->max_program_us = us;
+		if(us > slice_target_us && st->slice > OTA_SLICE_MIN) st->slice /= 2;
+		else if(us < slice_target_us / 2 && st->slice < slice_size) st->slice *= 2;
+	}
+
+	// A sector erase is always over the target : the other tasks get a full tick after it
+	if(us > slice_target_us)
+	{
+		st->yields++;
+		vTaskDelay(1);
+	}
+	else
+	{
+		taskYIELD();
+	}
+}
+
+// Sector erase and program slices never cross a sector boundary
+static esp_err_t ota_slice_write(ota_session_t *s, int offset, const uint8_t *data, int len)
+{
+	int64_t t;
+	esp_err_t err;
+	int n;
+
+	while(len > 0)
+	{
+		if(offset >= s->erased)
+		{
+			t = esp_timer_get_time();
+			err = s->backend->erase(s->ctx, s->erased, FLASH_SECTOR_SIZE);
+			if(err != ESP_OK) return err;
+			s->erased += FLASH_SECTOR_SIZE;
+			ota_slice_done(s, esp_timer_get_time() - t, 1);
+			continue;
+		}
+
+		n = s->erased - offset;
+		if(n > s->slice.slice) n = s->slice.slice;
+		if(n > len) n = len;
+
+		t = esp_timer_get_time();
+		err = s->backend->program(s->ctx, offset, data, n);
+		if(err != ESP_OK) return err;
+		ota_slice_done(s, esp_timer_get_time() - t, 0);
+
+		offset += n;
+		data += n;
+		len -= n;
+	}
+
+	return ESP_OK;
+}
+
+// Skip mode : a complete (or the last, partial) sector is compared with the flash before anything is erased
+static esp_err_t ota_sector_flush(ota_session_t *s, int offset)
+{
+	int len = s->sector_len;
+
+	if(len == 0) return ESP_OK;
+
+	s->sector_len = 0;
+	s->slice.compared++;
+	if(s->backend->same(s->ctx, offset, s->sector, len))
+	{
+		s->slice.skipped++;
+		s->erased = offset + FLASH_SECTOR_SIZE;
+		return ESP_OK;
+	}
+
+	return ota_slice_write(s, offset, s->sector, len);
+}
+
+static esp_err_t ota_sector_write(ota_session_t *s, const uint8_t *data, int len)
+{
+	int offset = s->received;
+	esp_err_t err;
+	int n;
+
+	while(len > 0)
+	{
+		n = FLASH_SECTOR_SIZE - s->sector_len;
+		if(n > len) n = len;
+
+		memcpy(&s->sector[s->sector_len], data, n);
+		s->sector_len += n;
+		offset += n;
+		data += n;
+		len -= n;
+
+		if(s->sector_len == FLASH_SECTOR_SIZE)
+		{
+			err = ota_sector_flush(s, offset - FLASH_SECTOR_SIZE);
+			if(err != ESP_OK) return err;
+		}
+	}
+
+	return ESP_OK;
+}
+
+// The buffer is decrypted in place when the image is encrypted
+esp_err_t ota_session_write(ota_session_t *s, void *data, int len)
+{
+	uint8_t *p;
+
+	if(s->err != ESP_OK) return s->err;
+
+	// steady state from the first data on, until finish / abort
+	if(s->received == 0 && s->watch.task == NULL) heap_watch_begin(&s->watch);
+
+	s->err = ota_crypt_update(s->crypt, data, len, &p, &len);
+	if(s->err != ESP_OK)
+	{
+		s->rejected = 1;
+		return s->err;
+	}
+	if(len == 0) return ESP_OK;
+	data = p;
+
+	if(s->backend->image && s->received + len > MAX_FIRMWARE_SIZE)
+	{
+		LOGE("Image rejected : more than MAX_FIRMWARE_SIZE %d bytes", MAX_FIRMWARE_SIZE);
+		s->rejected = 1;
+		s->err = ESP_ERR_INVALID_SIZE;
+		return s->err;
+	}
+	if(s->head != NULL)
+	{
+		s->err = ota_head_write(s, data, len);
+		if(s->err != ESP_OK)
+		{
+			s->rejected = 1;
+			return s->err;
+		}
+	}
+
+	TRACE(TRACE_OTA_WRITE_B, len);
+	if(s->sector) s->err = ota_sector_write(s, data, len);
+	else if(s->sliced) s->err = ota_slice_write(s, s->received, data, len);
+	else s->err = s->backend->write(s->ctx, data, len);
+	TRACE(TRACE_OTA_WRITE_E, s->err);
+	if(s->err != ESP_OK)
+	{
+		LOGE("Error: OTA write failed! err=0x%x", s->err);
+		return s->err;
+	}
+
+	s->received += len;
+	return ESP_OK;
+}
+
+/*******************************************
+Manifest mode : chunks arrive in any order and each one is checked against its
+leaf hash before its sector is erased and programmed. Needs the sliced writer.
+Chunks are written as they are, plain images only : refused with 'crypt require on'.
+*******************************************/
+esp_err_t ota_session_set_manifest(ota_session_t *s, ota_manifest_t *m)
+{
+	uint8_t sha256[OTA_HASH_SIZE];
+	int i, len;
+
+	if(s->err != ESP_OK) return s->err;
+
+	if(!s->sliced || m->head.image_len != s->size)
+	{
+		LOGE("Manifest mode needs the sliced writer and the manifest image size");
+		s->err = ESP_ERR_NOT_SUPPORTED;
+		return s->err;
+	}
+	if(ota_crypt_required())
+	{
+		LOGE("Manifest mode refused : crypt require on, plain images only");
+		s->rejected = 1;
+		s->err = ESP_ERR_NOT_SUPPORTED;
+		return s->err;
+	}
+
+	// the sector buffer of the skip mode is not used with whole chunks
+	s->chunk = (s->sector != NULL) ? s->sector : ota_session_alloc(s, OTA_CHUNK_SIZE);
+	s->sector = NULL;
+	if(s->chunk == NULL)
+	{
+		s->err = ESP_ERR_NO_MEM;
+		return s->err;
+	}
+	s->manifest = m;
+
+	if(s->backend->hash == NULL) return ESP_OK;
+
+	// Resume : chunks of an interrupted transfer still in the slot.
+	// Chunk 0 is always sent again so the image header is checked.
+	for(i = 1; i < m->head.chunk_count; i++)
+	{
+		len = ota_manifest_chunk_len(m, i);
+		if(s->backend->hash(s->ctx, i * OTA_CHUNK_SIZE, len, sha256) == ESP_OK && ota_manifest_check_hash(m, i, sha256))
+		{
+			ota_manifest_set_done(m, i);
+			s->received += len;
+			s->slice.resumed++;
+		}
+	}
+	if(s->slice.resumed > 0)
+	{
+		LOGI("Resume : %d of %d chunks already in the slot", s->slice.resumed, (int)m->head.chunk_count);
+	}
+
+	return ESP_OK;
+}
+
+// ESP_ERR_INVALID_CRC : wrong hash, nothing written, the transport asks for the chunk again
+esp_err_t ota_session_write_chunk(ota_session_t *s, int index, const void *data, int len)
+{
+	int offset = index * OTA_CHUNK_SIZE;
+
+	if(s->err != ESP_OK) return s->err;
+
+	if(s->watch.task == NULL) heap_watch_begin(&s->watch);
+
+	if(!ota_manifest_check(s->manifest, index, data, len))
+	{
+		LOGW("Chunk %d : hash mismatch, %d bytes", index, len);
+		s->slice.bad_chunks++;
+		return ESP_ERR_INVALID_CRC;
+	}
+	if(ota_manifest_is_done(s->manifest, index)) return ESP_OK;
+
+	if(index == 0 && len >= 4 && memcmp(data, OTA_CRYPT_MAGIC, 4) == 0)
+	{
+		LOGE("Manifest mode : encrypted image not supported");
+		s->rejected = 1;
+		s->err = ESP_ERR_NOT_SUPPORTED;
+		return s->err;
+	}
+	if(index == 0 && s->head != NULL)
+	{
+		s->err = ota_head_write(s, data, len);
+		if(s->err != ESP_OK)
+		{
+			s->rejected = 1;
+			return s->err;
+		}
+	}
+
+	TRACE(TRACE_OTA_WRITE_B, len);
+	if(s->skip)
+	{
+		s->slice.compared++;
+	}
+	if(s->skip && s->backend->same(s->ctx, offset, data, len))
+	{
+		s->slice.skipped++;
+	}
+	else
+	{
+		// erase the sector of the chunk before its first program
+		s->erased = offset;
+		s->err = ota_slice_write(s, offset, data, len);
+	}
+	TRACE(TRACE_OTA_WRITE_E, s->err);
+	if(s->err != ESP_OK)
+	{
+		LOGE("Error: OTA write failed! err=0x%x", s->err);
+		return s->err;
+	}
+
+	ota_manifest_set_done(s->manifest, index);
+	s->received += len;
+	return ESP_OK;
+}
+
+// Known size : done when everything arrived, unknown size : the transport decides
+int ota_session_complete(const ota_session_t *s)
+{
+	if(s->manifest) return ota_manifest_complete(s->manifest);
+
+	// size of the transferred file : with an encrypted image, head and tag included
+	return s->size > 0 && s->crypt->in >= s->size;
+}
+
+esp_err_t ota_session_finish(ota_session_t *s)
+{
+	int64_t elapsed;
+
+	// last partial sector of the skip mode
+	if(s->err == ESP_OK && s->sector != NULL)
+	{
+		s->err = ota_sector_flush(s, s->received - s->sector_len);
+		if(s->err != ESP_OK) LOGE("Error: OTA write failed! err=0x%x", s->err);
+	}
+	if(s->err == ESP_OK && s->manifest == NULL)
+	{
+		s->err = ota_crypt_finish(s->crypt);
+	}
+	if(s->err == ESP_OK && s->manifest != NULL && !ota_manifest_complete(s->manifest))
+	{
+		LOGE("Manifest : %d of %d chunks written", s->manifest->done_count, (int)s->manifest->head.chunk_count);
+		s->err = ESP_ERR_INVALID_STATE;
+	}
+	elapsed = esp_timer_get_time() - s->start_us;
+
+	if(s->err != ESP_OK)
+	{
+		ota_session_abort(s);
+		return s->err;
+	}
+	ota_session_watch_end(s);
+
+	LOGI("All packets received");
+	LOGI("Total Write binary data length : %d, %lld ms (begin %lld ms), %lld KB/s", s->received, elapsed / 1000,
+			s->begin_us / 1000, elapsed > 0 ? (int64_t)s->received * 1000000 / 1024 / elapsed : 0LL);
+
+	TRACE(TRACE_OTA_FINISH_B, s->received);
+	s->err = s->backend->end(s->ctx);
+	if(s->err == ESP_OK) s->err = s->backend->activate(s->ctx);
+	TRACE(TRACE_OTA_FINISH_E, s->err);
+	ota_session_release(s);
+	if(s->err != ESP_OK)
+	{
+		LOGE("OTA end / set boot partition failed! err=0x%x", s->err);
+		return s->err;
+	}
+
+	if(ota_session_restarts(s) && !s->defer_restart)
+	{
+		LOGI("Prepare to restart system!");
+		usleep(1000000);
+		esp_restart();
+	}
+
+	return ESP_OK;
+}
+
+void ota_session_abort(ota_session_t *s)
+{
+	if(s->arena == NULL) return;	// released already
+
+	LOGW("OTA aborted : %d bytes received", s->received);
+	ota_session_watch_end(s);
+	s->backend->abort(s->ctx);
+	ota_session_release(s);
+}
+
+/*---------------------------- Console -----------------------------------*/
+void ota_command(char **token, int token_count)
+{
+	if(token_count == 3 && strcmp(token[1], "backend") == 0)
+	{
+		if(ota_set_backend(token[2]) != 0)
+		{
+			LOGW("Unknown OTA backend : %s", token[2]);
+			return;
+		}
+	}
+	else if(token_count == 4 && strcmp(token[1], "sim") == 0)
+	{
+		ota_sim_set_latency(atoi(token[2]), atoi(token[3]));
+	}
+	else if(token_count >= 3 && strcmp(token[1], "slice") == 0)
+	{
+		if(strcmp(token[2], "off") == 0)
+		{
+			slice_enabled = 0;
+		}
+		else
+		{
+			slice_enabled = 1;
+			slice_size = atoi(token[2]) & ~(OTA_SLICE_MIN - 1);
+			if(slice_size < OTA_SLICE_MIN) slice_size = OTA_SLICE_MIN;
+			if(slice_size > OTA_SLICE_MAX) slice_size = OTA_SLICE_MAX;
+			if(token_count >= 4 && atoi(token[3]) > 0) slice_target_us = atoi(token[3]);
+		}
+	}
+	else if(token_count == 3 && strcmp(token[1], "skip") == 0)
+	{
+		skip_enabled = (strcmp(token[2], "on") == 0);
+	}
+	else if(token_count == 3 && strcmp(token[1], "same") == 0)
+	{
+		refuse_same_version = (strcmp(token[2], "refuse") == 0);
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : ota [backend flash|null|sim] [sim <erase us/sector> <program us/page>] [slice <bytes> [target us]|off] [skip on|off] [same refuse|allow]");
+		return;
+	}
+
+	LOGI("OTA backend : %s, sim erase %d us/sector, program %d us/page", ota_backend->name, sim_erase_us, sim_page_us);
+	if(slice_enabled)
+	{
+		LOGI("Sliced write : slice %d bytes, stall target %d us, identical sector skip %s", slice_size, slice_target_us,
+				skip_enabled ? "on" : "off");
+	}
+	else
+	{
+		LOGI("Sliced write off : esp_ota_write()");
+	}
+	LOGI("Image with the running version : %s", refuse_same_version ? "refused" : "allowed");
+	if(slice_last.slices > 0 || slice_last.compared > 0)
+	{
+		PrintConsole("last : %d operations, %d erases, max stall %d us (erase %d, program %d), %lld ms in flash, %d yields\r\n",
+				slice_last.slices, slice_last.erases, slice_last.max_stall_us, slice_last.max_erase_us,
+				slice_last.max_program_us, slice_last.stall_us / 1000, slice_last.yields);
+		PrintConsole("last : %d of %d sectors skipped, identical in flash\r\n", slice_last.skipped, slice_last.compared);
+		if(slice_last.resumed > 0 || slice_last.bad_chunks > 0)
+		{
+			PrintConsole("last : %d manifest chunks resumed, %d sent again\r\n", slice_last.resumed, slice_last.bad_chunks);
+		}
+	}
+}
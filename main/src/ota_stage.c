@@ -0,0 +1,268 @@
+/**
+ * @file ota_stage.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Staged images : SHA-256 fingerprint cache of the app partitions, boot switch without transfer
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <unistd.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_ota_ops.h"
+#include "esp_partition.h"
+#include "esp_image_format.h"
+#include "mbedtls/sha256.h"
+#include "nvs.h"
+
+#include "debug.h"
+#include "ota_stage.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "STAGE"
+
+#define STAGE_NVS_NAMESPACE	"stage"
+#define STAGE_MAP_SIZE		0x10000		// one MMU page per mmap while hashing
+
+/*---------------------------- Variables ---------------------------------*/
+
+/*-------------------------- Function declares ---------------------------*/
+
+// SHA-256 of the first image_len bytes, read through the cache
+static esp_err_t stage_hash(const esp_partition_t *part, uint32_t image_len, uint8_t *sha256)
+{
+	mbedtls_sha256_context ctx;
+	esp_partition_mmap_handle_t handle;
+	const void *p;
+	uint32_t off, n;
+	esp_err_t err = ESP_OK;
+
+	mbedtls_sha256_init(&ctx);
+	mbedtls_sha256_starts(&ctx, 0);
+	for(off = 0; off < image_len; off += n)
+	{
+		n = (image_len - off < STAGE_MAP_SIZE) ? image_len - off : STAGE_MAP_SIZE;
+		err = esp_partition_mmap(part, off, n, ESP_PARTITION_MMAP_DATA, &p, &handle);
+		if(err != ESP_OK) break;
+
+		mbedtls_sha256_update(&ctx, p, n);
+		esp_partition_munmap(handle);
+	}
+	mbedtls_sha256_finish(&ctx, sha256);
+	mbedtls_sha256_free(&ctx);
+	return err;
+}
+
+static void stage_compute(const esp_partition_t *part, ota_fingerprint_t *fp)
+{
+	esp_partition_pos_t pos;
+	esp_image_metadata_t data;
+	int64_t start = esp_timer_get_time();
+
+	memset(fp, 0, sizeof(ota_fingerprint_t));
+	pos.offset = part->address;
+	pos.size = part->size;
+	if(esp_image_verify(ESP_IMAGE_VERIFY_SILENT, &pos, &data) == ESP_OK)
+	{
+		fp->image_len = data.image_len;
+		if(stage_hash(part, fp->image_len, fp->sha256) != ESP_OK) fp->image_len = 0;
+	}
+	LOGI("Fingerprint of %s : %u bytes, %lld ms", part->label, (unsigned int)fp->image_len,
+			(esp_timer_get_time() - start) / 1000);
+}
+
+// Cached in NVS, computed on the first request after the partition was written
+esp_err_t ota_stage_fingerprint(const esp_partition_t *part, ota_fingerprint_t *fp)
+{
+	nvs_handle_t nvs;
+	size_t len = sizeof(ota_fingerprint_t);
+	esp_err_t err;
+
+	if(nvs_open(STAGE_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) nvs = 0;
+
+	if(nvs && nvs_get_blob(nvs, part->label, fp, &len) == ESP_OK && len == sizeof(ota_fingerprint_t))
+	{
+		nvs_close(nvs);
+		return fp->image_len ? ESP_OK : ESP_ERR_NOT_FOUND;
+	}
+
+	stage_compute(part, fp);
+
+	// an empty slot is cached too, until it is written
+	if(nvs)
+	{
+		err = nvs_set_blob(nvs, part->label, fp, sizeof(ota_fingerprint_t));
+		if(err == ESP_OK) err = nvs_commit(nvs);
+		if(err != ESP_OK) LOGE("Fingerprint save ERROR : %s", esp_err_to_name(err));
+		nvs_close(nvs);
+	}
+
+	return fp->image_len ? ESP_OK : ESP_ERR_NOT_FOUND;
+}
+
+// Before the partition is erased or written
+void ota_stage_invalidate(const esp_partition_t *part)
+{
+	nvs_handle_t nvs;
+
+	if(nvs_open(STAGE_NVS_NAMESPACE, NVS_READWRITE, &nvs) != ESP_OK) return;
+
+	if(nvs_erase_key(nvs, part->label) == ESP_OK) nvs_commit(nvs);
+	nvs_close(nvs);
+}
+
+static int stage_match(const ota_fingerprint_t *fp, const uint8_t *sha256, int size)
+{
+	return fp->image_len == size && memcmp(fp->sha256, sha256, OTA_HASH_SIZE) == 0;
+}
+
+// App partition other than the running one holding exactly this image, NULL if none.
+// A cache hit is hashed again before it is trusted : the slot may have been flashed by other means.
+const esp_partition_t *ota_stage_find(const uint8_t *sha256, int size)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	const esp_partition_t *found = NULL;
+	const esp_partition_t *part;
+	esp_partition_iterator_t it;
+	ota_fingerprint_t fp;
+
+	it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+	for(; it != NULL && found == NULL; it = esp_partition_next(it))
+	{
+		part = esp_partition_get(it);
+		if(part->address == running->address) continue;
+
+		if(ota_stage_fingerprint(part, &fp) != ESP_OK || !stage_match(&fp, sha256, size)) continue;
+
+		stage_compute(part, &fp);
+		if(stage_match(&fp, sha256, size)) found = part;
+		else ota_stage_invalidate(part);
+	}
+	esp_partition_iterator_release(it);
+
+	return found;
+}
+
+// Next OTA slot if it holds a valid image
+const esp_partition_t *ota_stage_other(void)
+{
+	const esp_partition_t *part = esp_ota_get_next_update_partition(NULL);
+	ota_fingerprint_t fp;
+
+	if(part == NULL || ota_stage_fingerprint(part, &fp) != ESP_OK) return NULL;
+
+	return part;
+}
+
+esp_err_t ota_stage_boot(const esp_partition_t *part)
+{
+	esp_err_t err = esp_ota_set_boot_partition(part);
+
+	if(err != ESP_OK)
+	{
+		LOGE("Set boot partition %s ERROR : %s", part->label, esp_err_to_name(err));
+		return err;
+	}
+
+	LOGI("Boot partition : %s, staged image, no transfer", part->label);
+	return ESP_OK;
+}
+
+// After the reply went out
+void ota_stage_restart(void)
+{
+	LOGI("Prepare to restart system!");
+	usleep(1000000);
+	esp_restart();
+}
+
+// 64 hex digits -> 32 bytes
+int ota_stage_hex(const char *hex, int len, uint8_t *sha256)
+{
+	int i, c, v = 0;
+
+	if(len != OTA_HASH_SIZE * 2) return -1;
+
+	for(i = 0; i < len; i++)
+	{
+		c = hex[i];
+		if(c >= '0' && c <= '9') c -= '0';
+		else if(c >= 'a' && c <= 'f') c -= 'a' - 10;
+		else if(c >= 'A' && c <= 'F') c -= 'A' - 10;
+		else return -1;
+
+		v = ((v << 4) | c) & 0xFF;
+		if(i & 1) sha256[i / 2] = v;
+	}
+	return 0;
+}
+
+/*---------------------------- Console -----------------------------------*/
+static void stage_print(void)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	const esp_partition_t *boot = esp_ota_get_boot_partition();
+	const esp_partition_t *part;
+	esp_partition_iterator_t it;
+	ota_fingerprint_t fp;
+	char hex[OTA_HASH_SIZE * 2 + 1];
+	int i;
+
+	it = esp_partition_find(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, NULL);
+	for(; it != NULL; it = esp_partition_next(it))
+	{
+		part = esp_partition_get(it);
+		if(ota_stage_fingerprint(part, &fp) != ESP_OK)
+		{
+			PrintConsole("%-8s 0x%06x  no valid image\r\n", part->label, (unsigned int)part->address);
+			continue;
+		}
+
+		for(i = 0; i < OTA_HASH_SIZE; i++) sprintf(&hex[i * 2], "%02x", fp.sha256[i]);
+		PrintConsole("%-8s 0x%06x %8u %s%s%s\r\n", part->label, (unsigned int)part->address, (unsigned int)fp.image_len,
+				hex, part == running ? " running" : "", part == boot ? " boot" : "");
+	}
+	esp_partition_iterator_release(it);
+}
+
+// stage [boot [label]|clear]
+void ota_stage_command(char **token, int token_count)
+{
+	const esp_partition_t *part;
+	nvs_handle_t nvs;
+
+	if(token_count >= 2 && strcmp(token[1], "boot") == 0)
+	{
+		if(token_count >= 3) part = esp_partition_find_first(ESP_PARTITION_TYPE_APP, ESP_PARTITION_SUBTYPE_ANY, token[2]);
+		else part = ota_stage_other();
+
+		if(part == NULL)
+		{
+			LOGW("No other valid image to boot");
+			return;
+		}
+		if(ota_stage_boot(part) == ESP_OK) ota_stage_restart();
+		return;
+	}
+	else if(token_count == 2 && strcmp(token[1], "clear") == 0)
+	{
+		if(nvs_open(STAGE_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+		{
+			nvs_erase_all(nvs);
+			nvs_commit(nvs);
+			nvs_close(nvs);
+		}
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : stage [boot [label]|clear]");
+		return;
+	}
+
+	stage_print();
+}
@@ -0,0 +1,261 @@
+/**
+ * @file ota_tls.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief TLS transport of the TCP OTA : esp-tls server with session tickets
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+#include <sys/socket.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_heap_caps.h"
+#include "esp_tls.h"
+#include "nvs.h"
+
+#include "debug.h"
+#include "ota_tls.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "TLS"
+
+#if !(CONFIG_ESP_TLS_SERVER)
+#error "ota_tls needs CONFIG_ESP_TLS_SERVER"
+#endif
+
+#define TLS_NVS_NAMESPACE	"ota_tls"
+#define TLS_NVS_CERT		"cert"
+#define TLS_NVS_KEY			"key"
+
+#define TLS_PEM_MAX			8192
+
+/*---------------------------- Variables ---------------------------------*/
+static esp_tls_cfg_server_t tls_server_cfg;
+static char *tls_cert, *tls_key;
+static int tls_server_ready;
+
+static ota_tls_stats_t tls_server_stats;
+
+/*-------------------------- Function declares ---------------------------*/
+
+// PEM blob of the NVS namespace, NUL terminated as mbedTLS wants it (length includes the NUL)
+static char *tls_load_pem(nvs_handle_t nvs, const char *key, size_t *len)
+{
+	char *pem;
+
+	*len = 0;
+	if(nvs_get_blob(nvs, key, NULL, len) != ESP_OK || *len == 0 || *len > TLS_PEM_MAX) return NULL;
+
+	pem = malloc(*len + 1);
+	if(pem == NULL) return NULL;
+
+	if(nvs_get_blob(nvs, key, pem, len) != ESP_OK)
+	{
+		free(pem);
+		return NULL;
+	}
+	if(pem[*len - 1] != 0) pem[(*len)++] = 0;
+	return pem;
+}
+
+/*******************************************
+Server certificate and key are loaded once, the session ticket context
+(random key, rotated by mbedTLS) lives as long as the task.
+Without a certificate in NVS the TLS listener stays closed.
+*******************************************/
+esp_err_t ota_tls_server_init(void)
+{
+	nvs_handle_t nvs;
+	size_t cert_len, key_len;
+
+	if(tls_server_ready) return ESP_OK;
+
+	if(nvs_open(TLS_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return ESP_ERR_NOT_FOUND;
+	tls_cert = tls_load_pem(nvs, TLS_NVS_CERT, &cert_len);
+	tls_key = tls_load_pem(nvs, TLS_NVS_KEY, &key_len);
+	nvs_close(nvs);
+
+	if(tls_cert == NULL || tls_key == NULL)
+	{
+		free(tls_cert);
+		free(tls_key);
+		tls_cert = tls_key = NULL;
+		return ESP_ERR_NOT_FOUND;
+	}
+
+	memset(&tls_server_cfg, 0, sizeof(tls_server_cfg));
+	tls_server_cfg.servercert_buf = (const unsigned char *)tls_cert;
+	tls_server_cfg.servercert_bytes = cert_len;
+	tls_server_cfg.serverkey_buf = (const unsigned char *)tls_key;
+	tls_server_cfg.serverkey_bytes = key_len;
+
+#if (CONFIG_ESP_TLS_SERVER_SESSION_TICKETS)
+	if(esp_tls_cfg_server_session_tickets_init(&tls_server_cfg) != ESP_OK)
+	{
+		LOGW("Session tickets disabled : every client does a full handshake");
+	}
+#endif
+
+	tls_server_ready = 1;
+	LOGI("TLS server certificate loaded : %d bytes", (int)cert_len);
+	return ESP_OK;
+}
+
+// Listening socket of the TLS port, -1 on error
+int ota_tls_listen(int port)
+{
+	struct sockaddr_in addr;
+	int sock;
+
+	sock = socket(PF_INET, SOCK_STREAM, 0);
+	if(sock < 0) return -1;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = INADDR_ANY;
+	addr.sin_port = htons(port);
+
+	if(bind(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0 || listen(sock, 1) != 0)
+	{
+		LOGE("TLS listen ERROR : %d", port);
+		close(sock);
+		return -1;
+	}
+	return sock;
+}
+
+static void tls_stats_add(ota_tls_stats_t *s, int ms)
+{
+	s->last_ms = ms;
+	if(s->count == 0 || ms < s->min_ms) s->min_ms = ms;
+	if(ms > s->max_ms) s->max_ms = ms;
+	s->count++;
+}
+
+/*******************************************
+Handshake on an accepted socket. A client presenting a ticket of an earlier
+session skips the certificate and key exchange : compare the handshake times
+of 'tls', the resumed ones are the short ones.
+The socket stays blocking with a receive timeout : mbedtls_net_recv() turns
+the timeout into an error, so a silent client fails the handshake or the read
+instead of holding TaskServerOta.
+*******************************************/
+esp_err_t ota_link_accept_tls(ota_link_t *link, int sock)
+{
+	struct timeval tv = { .tv_sec = OTA_TLS_RECV_TIMEOUT };
+	int64_t start;
+	int ms;
+
+	link->sock = sock;
+	setsockopt(sock, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+	link->tls = esp_tls_init();
+	if(link->tls == NULL) return ESP_ERR_NO_MEM;
+
+	start = esp_timer_get_time();
+	if(esp_tls_server_session_create(&tls_server_cfg, sock, link->tls) != 0)
+	{
+		LOGE("TLS handshake ERROR");
+		esp_tls_server_session_delete(link->tls);
+		link->tls = NULL;
+		tls_server_stats.failed++;
+		return ESP_FAIL;
+	}
+	ms = (int)((esp_timer_get_time() - start) / 1000);
+	tls_stats_add(&tls_server_stats, ms);
+
+	LOGI("TLS handshake : %d ms", ms);
+	return ESP_OK;
+}
+
+/*******************************************
+Receive into the caller's buffer (the OTA session buffer) : mbedTLS decrypts
+the record in its input buffer, no other copy. all : like MSG_WAITALL.
+Return : bytes, 0 closed, < 0 error
+*******************************************/
+int ota_link_recv(ota_link_t *link, void *buf, int len, int all)
+{
+	int n, total = 0;
+
+	if(link->tls == NULL) return recv(link->sock, buf, len, all ? MSG_WAITALL : 0);
+
+	while(1)
+	{
+		n = esp_tls_conn_read(link->tls, (uint8_t *)buf + total, len - total);
+		if(n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE) continue;
+		if(n <= 0) return total ? total : n;
+		total += n;
+		if(!all || total >= len) return total;
+	}
+}
+
+int ota_link_send(ota_link_t *link, const void *buf, int len)
+{
+	int n, total = 0;
+
+	if(link->tls == NULL) return send(link->sock, buf, len, 0);
+
+	while(total < len)
+	{
+		n = esp_tls_conn_write(link->tls, (const uint8_t *)buf + total, len - total);
+		if(n == ESP_TLS_ERR_SSL_WANT_READ || n == ESP_TLS_ERR_SSL_WANT_WRITE) continue;
+		if(n < 0) return n;
+		total += n;
+	}
+	return total;
+}
+
+// Server side sessions leave the socket to the caller
+void ota_link_close(ota_link_t *link)
+{
+	if(link->tls) esp_tls_server_session_delete(link->tls);
+	link->tls = NULL;
+
+	if(link->sock >= 0) close(link->sock);
+	link->sock = -1;
+}
+
+/*---------------------------- Console -----------------------------------*/
+static void tls_print_stats(const char *name, ota_tls_stats_t *s)
+{
+	if(s->count == 0 && s->failed == 0)
+	{
+		LOGI("%s : no handshake", name);
+		return;
+	}
+	LOGI("%s : %d handshakes, last %d ms, min %d ms, max %d ms, %d failed",
+		name, s->count, s->last_ms, s->min_ms, s->max_ms, s->failed);
+}
+
+// tls [clear|forget]
+void ota_tls_command(char **token, int token_count)
+{
+	nvs_handle_t nvs;
+
+	if(token_count == 2 && strcmp(token[1], "clear") == 0)
+	{
+		// certificate and key : takes effect after a restart
+		if(nvs_open(TLS_NVS_NAMESPACE, NVS_READWRITE, &nvs) == ESP_OK)
+		{
+			nvs_erase_all(nvs);
+			nvs_commit(nvs);
+			nvs_close(nvs);
+		}
+	}
+	else if(token_count == 2 && strcmp(token[1], "forget") == 0)
+	{
+		memset(&tls_server_stats, 0, sizeof(tls_server_stats));
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : tls [clear|forget]");
+		return;
+	}
+
+	LOGI("TLS server : %s, port %d", tls_server_ready ? "on" : "off (no certificate)", OTA_TLS_PORT);
+	tls_print_stats("Server", &tls_server_stats);
+}
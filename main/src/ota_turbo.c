@@ -0,0 +1,206 @@
+/**
+ * @file ota_turbo.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief OTA turbo : radio, CPU frequency and task reconfiguration while an update runs
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_wifi.h"
+#if (CONFIG_ESP_COEX_SW_COEXIST_ENABLE)
+#include "esp_coexist.h"
+#endif
+#if (CONFIG_PM_ENABLE)
+#include "esp_pm.h"
+#endif
+
+#include "debug.h"
+#include "ota.h"
+#include "ota_turbo.h"
+#include "task_layout.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "TURBO"
+
+/*---------------------------- Variables ---------------------------------*/
+static int turbo_enabled = 1;	// console 'turbo on|off', from the next session
+static int turbo_active;		// running OTA sessions
+static int turbo_applied;		// reconfiguration applied by the first session
+static portMUX_TYPE turbo_lock = portMUX_INITIALIZER_UNLOCKED;
+
+static int turbo_ps_saved;
+static wifi_ps_type_t turbo_saved_ps;
+static int turbo_saved_adv;
+static int64_t turbo_start_us;
+static int64_t turbo_last_ms = -1;	// duration of the last session with turbo applied
+
+#if (CONFIG_PM_ENABLE)
+static esp_pm_lock_handle_t turbo_cpu_lock;
+static esp_pm_lock_handle_t turbo_sleep_lock;
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+
+// Outside of OTA the CPU runs at OTA_TURBO_CPU_MIN_MHZ, the CPU_FREQ_MAX lock raises it
+void ota_turbo_init(void)
+{
+#if (CONFIG_PM_ENABLE)
+	esp_pm_config_t pm = {
+		.max_freq_mhz = OTA_TURBO_CPU_MAX_MHZ,
+		.min_freq_mhz = OTA_TURBO_CPU_MIN_MHZ,
+		.light_sleep_enable = false,
+	};
+	esp_err_t err;
+
+	err = esp_pm_configure(&pm);
+	if(err != ESP_OK)
+	{
+		LOGE("PM configure ERROR : %s", esp_err_to_name(err));
+	}
+	esp_pm_lock_create(ESP_PM_CPU_FREQ_MAX, 0, "ota_cpu", &turbo_cpu_lock);
+	esp_pm_lock_create(ESP_PM_NO_LIGHT_SLEEP, 0, "ota_sleep", &turbo_sleep_lock);
+#endif
+}
+
+static void turbo_apply(int transport)
+{
+	turbo_start_us = esp_timer_get_time();
+
+#if (CONFIG_PM_ENABLE)
+	if(turbo_cpu_lock) esp_pm_lock_acquire(turbo_cpu_lock);
+	if(turbo_sleep_lock) esp_pm_lock_acquire(turbo_sleep_lock);
+#endif
+
+	// Wi-Fi not initialized : nothing to restore
+	turbo_ps_saved = (esp_wifi_get_ps(&turbo_saved_ps) == ESP_OK);
+#if (CONFIG_ESP_COEX_SW_COEXIST_ENABLE)
+	// Modem sleep is mandatory with software coexistence, shift the arbitration instead
+	esp_coex_preference_set(transport == OTA_TURBO_BLE ? ESP_COEX_PREFER_BT : ESP_COEX_PREFER_WIFI);
+#else
+	if(turbo_ps_saved) esp_wifi_set_ps(WIFI_PS_NONE);
+#endif
+
+	// BLE session : no second central may connect and terminate the link. TCP session : keep the device visible.
+	turbo_saved_adv = ble_adv_get_mode();
+	ble_adv_set_mode(transport == OTA_TURBO_BLE ? BLE_ADV_OFF : BLE_ADV_SLOW);
+
+	task_layout_pause(1);
+
+	LOGI("OTA turbo on : %s, CPU %d MHz", transport == OTA_TURBO_BLE ? "BLE" : "TCP",
+#if (CONFIG_PM_ENABLE)
+			OTA_TURBO_CPU_MAX_MHZ
+#else
+			CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ
+#endif
+			);
+}
+
+static void turbo_restore(void)
+{
+	task_layout_pause(0);
+
+	ble_adv_set_mode(turbo_saved_adv);
+
+#if (CONFIG_ESP_COEX_SW_COEXIST_ENABLE)
+	esp_coex_preference_set(ESP_COEX_PREFER_BALANCE);
+#else
+	if(turbo_ps_saved) esp_wifi_set_ps(turbo_saved_ps);
+#endif
+	turbo_ps_saved = 0;
+
+#if (CONFIG_PM_ENABLE)
+	if(turbo_sleep_lock) esp_pm_lock_release(turbo_sleep_lock);
+	if(turbo_cpu_lock) esp_pm_lock_release(turbo_cpu_lock);
+#endif
+
+	turbo_last_ms = (esp_timer_get_time() - turbo_start_us) / 1000;
+	LOGI("OTA turbo off after %lld ms", turbo_last_ms);
+}
+
+// Start of an OTA session, also applies the OTA priority profile. Every begin needs an ota_turbo_end().
+void ota_turbo_begin(int transport)
+{
+	int first;
+
+	task_layout_ota_begin();
+
+	portENTER_CRITICAL(&turbo_lock);
+	first = (turbo_active++ == 0);
+	portEXIT_CRITICAL(&turbo_lock);
+
+	if(!first || !turbo_enabled) return;
+
+	turbo_applied = 1;
+	turbo_apply(transport);
+}
+
+// End, abort or failure of the session
+void ota_turbo_end(void)
+{
+	int last;
+
+	portENTER_CRITICAL(&turbo_lock);
+	last = (turbo_active > 0 && --turbo_active == 0);
+	portEXIT_CRITICAL(&turbo_lock);
+
+	if(last && turbo_applied)
+	{
+		turbo_applied = 0;
+		turbo_restore();
+	}
+
+	task_layout_ota_end();
+}
+
+int ota_turbo_enabled(void)
+{
+	return turbo_enabled;
+}
+
+// Reconfiguration applied, the transfer loops drop their per packet progress output
+int ota_turbo_active(void)
+{
+	return turbo_applied;
+}
+
+/*---------------------------- Console -----------------------------------*/
+// turbo [on|off]
+void ota_turbo_command(char **token, int token_count)
+{
+	wifi_ps_type_t ps;
+
+	if(token_count == 2 && (strcmp(token[1], "on") == 0 || strcmp(token[1], "off") == 0))
+	{
+		turbo_enabled = (strcmp(token[1], "on") == 0);
+		LOGI("OTA turbo %s from the next session", turbo_enabled ? "on" : "off");
+		return;
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : turbo [on|off]");
+		return;
+	}
+
+	LOGI("OTA turbo : %s, sessions %d, %s", turbo_enabled ? "on" : "off", turbo_active, turbo_applied ? "applied" : "idle");
+#if (CONFIG_PM_ENABLE)
+	PrintConsole("CPU %d MHz, %d MHz during OTA\r\n", OTA_TURBO_CPU_MIN_MHZ, OTA_TURBO_CPU_MAX_MHZ);
+#else
+	PrintConsole("CPU %d MHz fixed, CONFIG_PM_ENABLE off\r\n", CONFIG_ESP_DEFAULT_CPU_FREQ_MHZ);
+#endif
+	if(esp_wifi_get_ps(&ps) == ESP_OK)
+	{
+		PrintConsole("Wi-Fi power save %s\r\n", ps == WIFI_PS_NONE ? "none" : (ps == WIFI_PS_MIN_MODEM ? "min modem" : "max modem"));
+	}
+	PrintConsole("BLE advertising %s\r\n", ble_adv_get_mode() == BLE_ADV_OFF ? "off" : (ble_adv_get_mode() == BLE_ADV_SLOW ? "slow" : "normal"));
+	if(turbo_last_ms >= 0)
+	{
+		PrintConsole("last session %lld ms\r\n", turbo_last_ms);
+	}
+}
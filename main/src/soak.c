@@ -0,0 +1,486 @@
+/**
+ * @file soak.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Fault injection soak runs of the BLE and TCP OTA transports
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <netdb.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_timer.h"
+#include "esp_random.h"
+#include "esp_partition.h"
+#include "esp_ota_ops.h"
+
+#include "debug.h"
+#include "ota.h"
+#include "ota_session.h"
+#include "ota_stage.h"
+#include "bench.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "SOAK"
+
+#define SOAK_DEFAULT_ITERATIONS	100
+#define SOAK_DEFAULT_KB			32
+#define SOAK_MAX_ATTEMPTS		10		// per update, like a user retrying
+#define SOAK_START_TIMEOUT		30000	// ms
+#define SOAK_END_TIMEOUT		5000	// ms : the phone / gateway gives up and drops the link
+
+#define SOAK_BLE_PAYLOAD		244		// ATT MTU 247 - 3
+#define SOAK_BLE_MBUF_SIZE		256
+#define SOAK_BLE_PACKETS		4		// writes per connection event
+#define SOAK_BLE_INTERVAL		15		// ms
+#define SOAK_TCP_CHUNK			1024
+#define SOAK_TCP_RETRANSMIT		200		// ms : a lost or reordered segment shows up as a delay on TCP
+
+typedef struct {
+	const char *name;
+	int loss;		// per mille of writes lost
+	int reorder;	// per mille of writes swapped with the next one
+	int stall;		// per mille of writes followed by a stall of up to stall_ms
+	int stall_ms;
+	int truncate;	// percent of attempts cut short at a random offset
+	int disconnect;	// percent of attempts dropped at a random offset (BLE disconnect, TCP reset)
+} soak_profile_t;
+
+typedef struct {
+	int attempts;
+	int success;
+	int failed;				// gave up after SOAK_MAX_ATTEMPTS
+	int corrupt_bootable;	// activated image differs from the one sent : must stay 0
+	int otadata_changed;	// flash : boot selection changed by an attempt that activated nothing, must stay 0
+	int64_t total_us;		// time to a successful update, failed attempts included
+	int64_t max_us;
+} soak_result_t;
+
+// What the gateway sends : the sim image, or with the flash backend the running firmware
+typedef struct {
+	const esp_partition_t *part;	// NULL : sim image
+	int size;
+	uint32_t crc;
+	ota_fingerprint_t fp;
+} soak_image_t;
+
+/*---------------------------- Variables ---------------------------------*/
+static const soak_profile_t soak_profiles[] = {
+	{ "clean",		0,	0,	0,	0,		0,	0 },
+	{ "loss",		5,	0,	0,	0,		0,	0 },
+	{ "reorder",	0,	5,	0,	0,		0,	0 },
+	{ "stall",		0,	0,	5,	1500,	0,	0 },
+	{ "truncate",	0,	0,	0,	0,		20,	0 },
+	{ "disconnect",	0,	0,	0,	0,		0,	20 },
+	{ "mixed",		2,	2,	2,	500,	10,	10 },
+};
+
+#define SOAK_PROFILE_COUNT	((int)(sizeof(soak_profiles) / sizeof(soak_profiles[0])))
+
+static soak_image_t soak_image;
+
+/*-------------------------- Function declares ---------------------------*/
+
+static int soak_chance(int per_mille)
+{
+	return per_mille > 0 && (int)(esp_random() % 1000) < per_mille;
+}
+
+// Offset where this attempt is cut, size if it isn't
+static int soak_cut(int percent, int size)
+{
+	if(percent > 0 && (int)(esp_random() % 100) < percent) return esp_random() % size;
+	return size;
+}
+
+static void soak_stall(const soak_profile_t *p)
+{
+	if(soak_chance(p->stall)) vTaskDelay((esp_random() % (p->stall_ms + 1)) / portTICK_PERIOD_MS);
+}
+
+static void soak_image_read(int offset, uint8_t *buf, int len)
+{
+	if(soak_image.part != NULL) esp_partition_read(soak_image.part, offset, buf, len);
+	else ota_sim_image_read(soak_image.size, offset, buf, len);
+}
+
+// Every started session ends, activated or aborted
+static int soak_wait_done(int before, int timeout_ms)
+{
+	while(1)
+	{
+		if(ota_session_ended() != before) return 0;
+		if(timeout_ms <= 0) return -1;
+		vTaskDelay(10 / portTICK_PERIOD_MS);
+		timeout_ms -= 10;
+	}
+}
+
+/*---------------------------- BLE ---------------------------------------*/
+#if (CONFIG_OTA_BLE_SIM)
+static void soak_ble_attempt(const soak_profile_t *p, int size)
+{
+	static uint8_t buf[2][SOAK_BLE_PAYLOAD];
+	int before = ota_session_ended();
+	char cmd[64];
+	int len[2], n, off = 0, held = 0, packets = 0;
+	int cut = soak_cut(p->truncate, size);
+	int drop = soak_cut(p->disconnect, size);
+
+	n = snprintf(cmd, sizeof(cmd), "{\"ota\":\"start\",\"ota size\":%d}\x04", size);
+	ble_sim_write((const uint8_t *)cmd, n, SOAK_BLE_MBUF_SIZE);
+
+	if(bench_wait(is_ota_receiving, 1, SOAK_START_TIMEOUT) != 0)
+	{
+		LOGE("Soak BLE : OTA session didn't start");
+		clear_ota_state();
+		return;
+	}
+
+	while(off < size)
+	{
+		if(off >= drop)
+		{
+			ble_sim_disconnect();
+			break;
+		}
+
+		if(off >= cut)
+		{
+			ble_sim_write(buf[0], 0, SOAK_BLE_MBUF_SIZE);	// empty write : end of image
+			break;
+		}
+
+		n = (size - off < SOAK_BLE_PAYLOAD) ? size - off : SOAK_BLE_PAYLOAD;
+		soak_image_read(off, buf[held], n);
+		len[held] = n;
+		off += n;
+
+		// hold this write back and send it after the next one
+		if(!held && off < size && soak_chance(p->reorder))
+		{
+			held = 1;
+			continue;
+		}
+
+		if(!soak_chance(p->loss)) ble_sim_write(buf[held], len[held], SOAK_BLE_MBUF_SIZE);
+		if(held)
+		{
+			ble_sim_write(buf[0], len[0], SOAK_BLE_MBUF_SIZE);
+			held = 0;
+		}
+
+		soak_stall(p);
+		if(++packets % SOAK_BLE_PACKETS == 0) vTaskDelay(SOAK_BLE_INTERVAL / portTICK_PERIOD_MS);
+	}
+
+	// lost writes leave the OTA task waiting : the phone times out and disconnects
+	if(soak_wait_done(before, SOAK_END_TIMEOUT) != 0)
+	{
+		ble_sim_disconnect();
+		soak_wait_done(before, SOAK_END_TIMEOUT);
+	}
+
+	bench_wait(is_ota_receiving, 0, SOAK_END_TIMEOUT);
+}
+#endif	// #if (CONFIG_OTA_BLE_SIM)
+
+/*---------------------------- TCP ---------------------------------------*/
+#if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_TCP_OTA))
+// Gateway side of TaskServerOta over the loopback interface
+static void soak_tcp_attempt(const soak_profile_t *p, int size)
+{
+	static uint8_t buf[SOAK_TCP_CHUNK];
+	struct sockaddr_in addr;
+	struct linger lg = { 1, 0 };
+	int before = ota_session_ended();
+	uint8_t ack[4];
+	int sock, n, off = 0;
+	int cut = soak_cut(p->truncate, size);
+	int drop = soak_cut(p->disconnect, size);
+
+	sock = socket(AF_INET, SOCK_STREAM, 0);
+	if(sock < 0)
+	{
+		LOGE("Soak TCP socket ERROR");
+		vTaskDelay(100 / portTICK_PERIOD_MS);
+		return;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_port = htons(OTA_SERVER_PORT);
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+	if(connect(sock, (struct sockaddr *)&addr, sizeof(addr)) != 0
+		|| send(sock, "ota", 3, 0) != 3
+		|| recv(sock, ack, sizeof(ack), MSG_WAITALL) != sizeof(ack)
+		|| memcmp(ack, "ACK", 3) != 0)
+	{
+		LOGE("Soak TCP handshake ERROR");
+		close(sock);
+		soak_wait_done(before, SOAK_END_TIMEOUT);
+		return;
+	}
+
+	while(off < size)
+	{
+		if(off >= drop)
+		{
+			setsockopt(sock, SOL_SOCKET, SO_LINGER, &lg, sizeof(lg));	// close() sends RST
+			break;
+		}
+
+		if(off >= cut) break;	// clean close : truncated image
+
+		n = (size - off < SOAK_TCP_CHUNK) ? size - off : SOAK_TCP_CHUNK;
+		soak_image_read(off, buf, n);
+		if(send(sock, buf, n, 0) != n) break;
+		off += n;
+
+		if(soak_chance(p->loss) || soak_chance(p->reorder)) vTaskDelay(SOAK_TCP_RETRANSMIT / portTICK_PERIOD_MS);
+		soak_stall(p);
+	}
+
+	close(sock);
+	soak_wait_done(before, SOAK_END_TIMEOUT);
+}
+#endif
+
+/*---------------------------- Soak --------------------------------------*/
+/*******************************************
+Flash backend : after each attempt, what the bootloader would start. An attempt
+that selected the update slot must have written the image sent, verified and
+of the same length and SHA-256. One that didn't must have left otadata as it
+was. The running slot is selected again and the image erased from the update
+slot, so the next update doesn't find a copy of it there to skip to.
+Returns 1 when the attempt activated the update slot.
+*******************************************/
+static int soak_flash_check(const esp_partition_t *otadata, const uint8_t *before, uint8_t *now, soak_result_t *r)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+	const esp_partition_t *boot = esp_ota_get_boot_partition();
+	ota_fingerprint_t fp;
+
+	if(boot == running)
+	{
+		if(esp_partition_read(otadata, 0, now, otadata->size) != ESP_OK || memcmp(before, now, otadata->size) != 0)
+		{
+			LOGE("otadata changed by an attempt that activated nothing");
+			r->otadata_changed++;
+		}
+		return 0;
+	}
+
+	ota_stage_invalidate(boot);
+	if(ota_stage_fingerprint(boot, &fp) != ESP_OK || fp.image_len != soak_image.fp.image_len
+		|| memcmp(fp.sha256, soak_image.fp.sha256, OTA_HASH_SIZE) != 0)
+	{
+		LOGE("Corrupt image marked bootable : %s, %u bytes", boot->label, (unsigned int)fp.image_len);
+		r->corrupt_bootable++;
+	}
+
+	if(esp_ota_set_boot_partition(running) != ESP_OK) LOGE("Boot partition restore ERROR : %s", running->label);
+	esp_partition_erase_range(boot, 0, (soak_image.size + SPI_FLASH_SEC_SIZE - 1) & ~(SPI_FLASH_SEC_SIZE - 1));
+	ota_stage_invalidate(boot);
+	return 1;
+}
+
+static void soak_run(int tcp, const soak_profile_t *p, int iterations)
+{
+	const esp_partition_t *otadata = NULL;
+	uint8_t *snapshot = NULL, *now = NULL;
+	soak_result_t r;
+	ota_sim_stats_t before, after;
+	int i, attempt, activated;
+	int64_t start, t;
+
+	memset(&r, 0, sizeof(r));
+	ota_sim_stats_reset();
+
+	if(soak_image.part != NULL)
+	{
+		otadata = esp_partition_find_first(ESP_PARTITION_TYPE_DATA, ESP_PARTITION_SUBTYPE_DATA_OTA, NULL);
+		if(otadata != NULL)
+		{
+			snapshot = malloc(otadata->size);
+			now = malloc(otadata->size);
+		}
+		if(snapshot == NULL || now == NULL)
+		{
+			LOGE("Soak : otadata can not be read");
+			free(snapshot);
+			free(now);
+			return;
+		}
+	}
+
+	for(i = 0; i < iterations; i++)
+	{
+		start = esp_timer_get_time();
+
+		for(attempt = 0; attempt < SOAK_MAX_ATTEMPTS; attempt++)
+		{
+			ota_sim_stats_get(&before);
+			if(snapshot != NULL) esp_partition_read(otadata, 0, snapshot, otadata->size);
+#if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_TCP_OTA))
+			if(tcp) soak_tcp_attempt(p, soak_image.size);
+#endif
+#if (CONFIG_OTA_BLE_SIM)
+			if(!tcp) soak_ble_attempt(p, soak_image.size);
+#endif
+			ota_sim_stats_get(&after);
+			r.attempts++;
+
+			if(snapshot != NULL)
+			{
+				activated = soak_flash_check(otadata, snapshot, now, &r);
+			}
+			else
+			{
+				activated = (after.activated != before.activated);
+				if(activated && (after.crc != soak_image.crc || after.size != soak_image.size))
+				{
+					LOGE("Corrupt image marked bootable : %d bytes, crc %08X", after.size, after.crc);
+					r.corrupt_bootable++;
+				}
+			}
+			if(activated) break;
+		}
+
+		if(attempt == SOAK_MAX_ATTEMPTS)
+		{
+			r.failed++;
+			continue;
+		}
+
+		r.success++;
+		t = esp_timer_get_time() - start;
+		r.total_us += t;
+		if(t > r.max_us) r.max_us = t;
+	}
+
+	free(snapshot);
+	free(now);
+
+	// aborted : attempts that activated nothing. rejected : sim backend only, the flash backend logs its verify failures
+	ota_sim_stats_get(&after);
+	PrintConsole("{\"soak\":\"%s\",\"backend\":\"%s\",\"profile\":\"%s\",\"iterations\":%d,\"size\":%d,\"attempts\":%d,"
+			"\"success\":%d,\"failed\":%d,\"rejected\":%d,\"aborted\":%d,\"corrupt_bootable\":%d,\"otadata_changed\":%d,"
+			"\"avg_ms\":%lld,\"max_ms\":%lld}\r\n",
+			tcp ? "tcp" : "ble", soak_image.part ? "flash" : "sim", p->name, iterations, soak_image.size, r.attempts,
+			r.success, r.failed, after.rejected, r.attempts - r.success, r.corrupt_bootable, r.otadata_changed,
+			r.success ? r.total_us / r.success / 1000 : 0LL, r.max_us / 1000);
+}
+
+/*******************************************
+"flash" instead of a size : the flash backend writes the running firmware to
+the update slot, activation included, without the restart. The running
+partition must hold a verified image, pushed once by a normal update.
+*******************************************/
+static int soak_flash_image(void)
+{
+	const esp_partition_t *running = esp_ota_get_running_partition();
+
+	memset(&soak_image, 0, sizeof(soak_image));
+	if(running == NULL || ota_stage_fingerprint(running, &soak_image.fp) != ESP_OK)
+	{
+		LOGE("Soak flash : no verified image in the running partition");
+		return -1;
+	}
+	soak_image.part = running;
+	soak_image.size = soak_image.fp.image_len;
+	return 0;
+}
+
+// soak ble|tcp [profile|all] [iterations] [size KB|flash]
+void soak_command(char **token, int token_count)
+{
+	const ota_backend_t *backend = ota_get_backend();
+	const char *profile = "mixed";
+	int iterations = SOAK_DEFAULT_ITERATIONS;
+	int size = SOAK_DEFAULT_KB;
+	int tcp = -1, i, flash = 0, found = 0;
+
+	if(token_count < 2)
+	{
+		LOGI("Usage : soak ble|tcp [profile|all] [iterations] [size KB|flash]");
+		for(i = 0; i < SOAK_PROFILE_COUNT; i++)
+		{
+			LOGI("  %-10s loss %d, reorder %d, stall %d (%d ms) per mille, truncate %d, disconnect %d %%",
+					soak_profiles[i].name, soak_profiles[i].loss, soak_profiles[i].reorder, soak_profiles[i].stall,
+					soak_profiles[i].stall_ms, soak_profiles[i].truncate, soak_profiles[i].disconnect);
+		}
+		return;
+	}
+
+	// ble needs the link simulation of a CONFIG_OTA_BLE_SIM build
+#if (CONFIG_OTA_BLE_SIM)
+	if(strcmp(token[1], "ble") == 0) tcp = 0;
+#endif
+#if (ENABLE_WIFI_OTA && (WIFI_OTA_TYPE == WIFI_TCP_OTA))
+	if(strcmp(token[1], "tcp") == 0) tcp = 1;
+#endif
+	if(tcp < 0)
+	{
+		LOGW("Unknown soak transport : %s", token[1]);
+		return;
+	}
+
+	if(token_count > 2) profile = token[2];
+	if(token_count > 3) iterations = atoi(token[3]);
+	if(token_count > 4)
+	{
+		flash = (strcmp(token[4], "flash") == 0);
+		if(!flash) size = atoi(token[4]);
+	}
+
+	if(iterations <= 0 || size <= 0 || size * 1024 > MAX_FIRMWARE_SIZE)
+	{
+		LOGI("Invalid soak parameter");
+		return;
+	}
+
+	if(is_ble_connected() || is_ota_ready())
+	{
+		LOGI("BLE link or OTA busy");
+		return;
+	}
+
+	if(flash)
+	{
+		if(soak_flash_image() != 0) return;
+		ota_set_backend("flash");
+		ota_session_hold_restart(1);
+	}
+	else
+	{
+		// images are verified and counted by the sim backend, the OTA partition is never touched
+		memset(&soak_image, 0, sizeof(soak_image));
+		soak_image.size = size * 1024;
+		soak_image.crc = ota_sim_image_crc(soak_image.size);
+		ota_set_backend("sim");
+	}
+
+	for(i = 0; i < SOAK_PROFILE_COUNT; i++)
+	{
+		if(strcmp(profile, "all") == 0 || strcmp(profile, soak_profiles[i].name) == 0)
+		{
+			soak_run(tcp, &soak_profiles[i], iterations);
+			found = 1;
+		}
+	}
+
+	if(!found) LOGW("Unknown soak profile : %s", profile);
+
+	ota_session_hold_restart(0);
+	ota_set_backend(backend->name);
+}
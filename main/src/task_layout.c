@@ -0,0 +1,221 @@
+/**
+ * @file task_layout.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Core, priority and stack of the application tasks, OTA priority profile
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "nvs.h"
+
+#include "debug.h"
+#include "task_layout.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "TASK"
+
+#define TASK_NVS_NAMESPACE	"task"
+#define TASK_NVS_PLAN		"plan"
+
+/*---------------------------- Variables ---------------------------------*/
+#define TASK_LAYOUT_DEF(id, name, stack, core, prio, ota_prio, ota_pause)	[id] = { name, stack, core, prio, ota_prio, ota_pause },
+static const task_layout_t task_layout[TASK_LAYOUT_COUNT] = {
+	TASK_LAYOUT_TABLE(TASK_LAYOUT_DEF)
+};
+#undef TASK_LAYOUT_DEF
+
+static TaskHandle_t task_handles[TASK_LAYOUT_COUNT];
+static int task_plan = 1;		// 0 : legacy layout, every task at TASK_LEGACY_PRIORITY on any core
+static int task_ota_active;		// running OTA sessions
+static int task_paused;
+static portMUX_TYPE task_ota_lock = portMUX_INITIALIZER_UNLOCKED;
+
+/*-------------------------- Function declares ---------------------------*/
+
+// Read the plan switch, before any task of the table is created
+void task_layout_init(void)
+{
+	nvs_handle_t nvs;
+	uint8_t plan;
+
+	if(nvs_open(TASK_NVS_NAMESPACE, NVS_READONLY, &nvs) != ESP_OK) return;
+
+	if(nvs_get_u8(nvs, TASK_NVS_PLAN, &plan) == ESP_OK)
+	{
+		task_plan = plan;
+	}
+	nvs_close(nvs);
+
+	LOGI("Task layout plan : %s", task_plan ? "on" : "off");
+}
+
+int task_layout_plan(void)
+{
+	return task_plan;
+}
+
+static UBaseType_t task_priority(int id, int ota)
+{
+	if(!task_plan) return TASK_LEGACY_PRIORITY;
+
+	return ota ? task_layout[id].ota_priority : task_layout[id].priority;
+}
+
+BaseType_t task_create(int id, TaskFunction_t fn, void *arg, TaskHandle_t *handle)
+{
+	const task_layout_t *t = &task_layout[id];
+	TaskHandle_t h = NULL;
+	BaseType_t ret;
+
+	ret = xTaskCreatePinnedToCore(fn, t->name, t->stack, arg, task_priority(id, task_ota_active > 0), &h,
+			task_plan ? t->core : tskNO_AFFINITY);
+	if(ret == pdPASS)
+	{
+		task_handles[id] = h;
+	}
+	if(handle) *handle = h;
+	return ret;
+}
+
+// End of a task that returns, instead of vTaskDelete(NULL)
+void task_exit(int id)
+{
+	task_handles[id] = NULL;
+	vTaskDelete(NULL);
+}
+
+const task_layout_t *task_layout_get(int id)
+{
+	return &task_layout[id];
+}
+
+// Task created by a component (esp_http_server) with the stack and core of its entry : priority and OTA profile from here on
+void task_layout_adopt(int id, TaskHandle_t handle)
+{
+	if(handle == NULL) return;
+
+	task_handles[id] = handle;
+	vTaskPrioritySet(handle, task_priority(id, task_ota_active > 0));
+}
+
+// Only tasks with a different OTA priority are touched, they never exit
+static void task_layout_profile(int ota)
+{
+	int i;
+
+	for(i = 0; i < TASK_LAYOUT_COUNT; i++)
+	{
+		if(task_handles[i] == NULL || task_layout[i].ota_priority == task_layout[i].priority) continue;
+
+		vTaskPrioritySet(task_handles[i], task_priority(i, ota));
+	}
+}
+
+void task_layout_ota_begin(void)
+{
+	int first;
+
+	portENTER_CRITICAL(&task_ota_lock);
+	first = (task_ota_active++ == 0);
+	portEXIT_CRITICAL(&task_ota_lock);
+
+	if(first && task_plan) task_layout_profile(1);
+}
+
+void task_layout_ota_end(void)
+{
+	int last;
+
+	portENTER_CRITICAL(&task_ota_lock);
+	last = (task_ota_active > 0 && --task_ota_active == 0);
+	portEXIT_CRITICAL(&task_ota_lock);
+
+	if(last && task_plan) task_layout_profile(0);
+}
+
+// Suspend the tasks marked ota_pause, they never exit. Called by OTA turbo, not reference counted.
+void task_layout_pause(int pause)
+{
+	int i;
+
+	if(pause == task_paused) return;
+	task_paused = pause;
+
+	for(i = 0; i < TASK_LAYOUT_COUNT; i++)
+	{
+		if(task_handles[i] == NULL || !task_layout[i].ota_pause) continue;
+
+		if(pause) vTaskSuspend(task_handles[i]);
+		else vTaskResume(task_handles[i]);
+	}
+}
+
+/*---------------------------- Console -----------------------------------*/
+static void task_print(void)
+{
+	char core[12];		// any int
+	int i;
+
+	LOGI("Task layout plan : %s (NVS), OTA profile %s%s", task_plan ? "on" : "off", task_ota_active ? "active" : "idle",
+			task_paused ? ", paused" : "");
+	PrintConsole("task          core  prio  normal  ota  stack  stack free\r\n");
+	for(i = 0; i < TASK_LAYOUT_COUNT; i++)
+	{
+		const task_layout_t *t = &task_layout[i];
+
+		if(!task_plan || t->core == tskNO_AFFINITY) strcpy(core, "-");
+		else snprintf(core, sizeof(core), "%d", (int)t->core);
+
+		if(task_handles[i] == NULL)
+		{
+			PrintConsole("%-13s %4s     - %7d %4d %6u           -\r\n", t->name, core,
+					(int)t->priority, (int)t->ota_priority, (unsigned int)t->stack);
+			continue;
+		}
+
+		PrintConsole("%-13s %4s %5d %7d %4d %6u %11u\r\n", t->name, core, (int)uxTaskPriorityGet(task_handles[i]),
+				(int)t->priority, (int)t->ota_priority, (unsigned int)t->stack,
+				(unsigned int)uxTaskGetStackHighWaterMark(task_handles[i]));
+	}
+}
+
+// task [plan on|off]
+void task_command(char **token, int token_count)
+{
+	nvs_handle_t nvs;
+	esp_err_t err;
+	uint8_t plan;
+
+	if(token_count == 3 && strcmp(token[1], "plan") == 0)
+	{
+		plan = (strcmp(token[2], "on") == 0);
+		err = nvs_open(TASK_NVS_NAMESPACE, NVS_READWRITE, &nvs);
+		if(err == ESP_OK)
+		{
+			err = nvs_set_u8(nvs, TASK_NVS_PLAN, plan);
+			if(err == ESP_OK) err = nvs_commit(nvs);
+			nvs_close(nvs);
+		}
+
+		if(err != ESP_OK)
+		{
+			LOGE("Task plan save ERROR : %s", esp_err_to_name(err));
+			return;
+		}
+		LOGI("Task layout plan %s after reboot", plan ? "on" : "off");
+		return;
+	}
+	else if(token_count != 1)
+	{
+		LOGI("Usage : task [plan on|off]");
+		return;
+	}
+
+	task_print();
+}
@@ -0,0 +1,124 @@
+/**
+ * @file trace.c
+ * @author Kwon Taeyoung (xlink69@gmail.com)
+ * @brief Binary event trace ring of the OTA and BLE hot paths
+ * @version 1.0
+ * @date 2024-01-13
+ */
+
+#include <string.h>
+
+#include "freertos/FreeRTOS.h"
+#include "freertos/task.h"
+#include "esp_system.h"
+#include "esp_log.h"
+#include "esp_cpu.h"
+#include "esp_rom_sys.h"
+
+#include "debug.h"
+#include "trace.h"
+
+/*---------------------------- User define -------------------------------*/
+#define TAG "TRACE"
+
+typedef struct {
+	const char *lane;
+	const char *name;
+	char phase;
+} trace_desc_t;
+
+/*---------------------------- Variables ---------------------------------*/
+#if (ENABLE_TRACE)
+#define TRACE_DESC(id, lane, name, phase)	{ lane, name, phase },
+static const trace_desc_t trace_desc[TRACE_EVENT_COUNT] = {
+	TRACE_EVENT_TABLE(TRACE_DESC)
+};
+
+volatile int trace_on;
+static trace_event_t trace_ring[TRACE_RING_SIZE];
+static uint32_t trace_head;		// total events recorded, the ring keeps the last TRACE_RING_SIZE
+#endif
+
+/*-------------------------- Function declares ---------------------------*/
+
+#if (ENABLE_TRACE)
+void trace_record(uint8_t id, uint32_t arg)
+{
+	trace_event_t *e = &trace_ring[__atomic_fetch_add(&trace_head, 1, __ATOMIC_RELAXED) & (TRACE_RING_SIZE - 1)];
+
+	e->cycles = esp_cpu_get_cycle_count();
+	e->id = id;
+	e->core = esp_cpu_get_core_id();
+	e->arg = arg;
+}
+
+/*******************************************
+Text dump, converted by tools/trace2perfetto.py :
+# trace cpu_mhz=<n> events=<n> lost=<n>
+E <id> <phase> <lane> <name>		event table
+T <cycles> <core> <id> <arg>		events, oldest first (hex)
+# trace end
+*******************************************/
+static void trace_dump(void)
+{
+	int on = trace_on;
+	uint32_t head, start, i;
+	trace_event_t *e;
+
+	trace_on = 0;
+	head = trace_head;
+	start = (head > TRACE_RING_SIZE) ? head - TRACE_RING_SIZE : 0;
+
+	PrintConsole("# trace cpu_mhz=%d events=%d lost=%d\r\n", (int)esp_rom_get_cpu_ticks_per_us(),
+			(int)(head - start), (int)start);
+
+	for(i = 0; i < TRACE_EVENT_COUNT; i++)
+	{
+		PrintConsole("E %d %c %s %s\r\n", (int)i, trace_desc[i].phase, trace_desc[i].lane, trace_desc[i].name);
+	}
+
+	for(i = start; i < head; i++)
+	{
+		e = &trace_ring[i & (TRACE_RING_SIZE - 1)];
+		PrintConsole("T %08X %d %d %X\r\n", (unsigned int)e->cycles, e->core, e->id, (unsigned int)e->arg);
+	}
+
+	PrintConsole("# trace end\r\n");
+	trace_on = on;
+}
+#endif
+
+// trace [start|stop|clear|dump]
+void trace_command(char **token, int token_count)
+{
+#if (ENABLE_TRACE)
+	if(token_count < 2)
+	{
+		LOGI("Trace %s, %d events recorded, ring %d", trace_on ? "on" : "off", (int)trace_head, TRACE_RING_SIZE);
+		LOGI("Usage : trace start|stop|clear|dump");
+	}
+	else if(strcmp(token[1], "start") == 0)
+	{
+		trace_on = 1;
+	}
+	else if(strcmp(token[1], "stop") == 0)
+	{
+		trace_on = 0;
+	}
+	else if(strcmp(token[1], "clear") == 0)
+	{
+		trace_on = 0;
+		trace_head = 0;
+	}
+	else if(strcmp(token[1], "dump") == 0)
+	{
+		trace_dump();
+	}
+	else
+	{
+		LOGW("Unknown trace command : %s", token[1]);
+	}
+#else
+	LOGI("Trace is disabled (ENABLE_TRACE)");
+#endif
+}
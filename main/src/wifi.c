@@ -13,6 +13,9 @@
 #include "esp_wifi.h"
 #include "esp_mac.h"
 #include "esp_log.h"
+#if CONFIG_ETH_USE_OPENETH
+#include "esp_eth.h"
+#endif
 
 #include "debug.h"
 #include "wifi.h"
@@ -212,4 +215,45 @@ void wifi_init_softap(void)
          wifi_config.ap.ssid, wifi_config.ap.password, ESP_WIFI_CHANNEL);
 }
 
+#if CONFIG_ETH_USE_OPENETH
+static void eth_got_ip_handler(void* arg, esp_event_base_t event_base,
+                                    int32_t event_id, void* event_data)
+{
+    ip_event_got_ip_t* event = (ip_event_got_ip_t*) event_data;
+    sprintf(strMyIp, IPSTR, IP2STR(&event->ip_info.ip));
+    LOGI("Ethernet got ip : %s", strMyIp);
+}
+
+// QEMU has no Wi-Fi : the emulated OpenCores Ethernet MAC is used instead (sdkconfig.qemu)
+void eth_init_openeth(void)
+{
+    esp_eth_handle_t eth_handle = NULL;
+
+    LOGI("Ethernet init (openeth)");
+
+    ESP_ERROR_CHECK(esp_netif_init());
+    ESP_ERROR_CHECK(esp_event_loop_create_default());
+
+    esp_netif_config_t netif_cfg = ESP_NETIF_DEFAULT_ETH();
+    esp_netif_t *eth_netif = esp_netif_new(&netif_cfg);
+
+    eth_mac_config_t mac_config = ETH_MAC_DEFAULT_CONFIG();
+    eth_phy_config_t phy_config = ETH_PHY_DEFAULT_CONFIG();
+    phy_config.autonego_timeout_ms = 100;
+
+    esp_eth_mac_t *mac = esp_eth_mac_new_openeth(&mac_config);
+    esp_eth_phy_t *phy = esp_eth_phy_new_dp83848(&phy_config);
+    esp_eth_config_t config = ETH_DEFAULT_CONFIG(mac, phy);
+
+    ESP_ERROR_CHECK(esp_eth_driver_install(&config, &eth_handle));
+    ESP_ERROR_CHECK(esp_netif_attach(eth_netif, esp_eth_new_netif_glue(eth_handle)));
+    ESP_ERROR_CHECK(esp_event_handler_instance_register(IP_EVENT,
+                                                        IP_EVENT_ETH_GOT_IP,
+                                                        &eth_got_ip_handler,
+                                                        NULL,
+                                                        NULL));
+    ESP_ERROR_CHECK(esp_eth_start(eth_handle));
+}
+#endif	// #if CONFIG_ETH_USE_OPENETH
+
 #endif	// #if defined(ENABLE_WIFI)
\ No newline at end of file
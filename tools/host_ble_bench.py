@@ -0,0 +1,91 @@
+#!/usr/bin/env python3
+"""
+BLE link simulation check against the Linux host build (host/).
+
+Runs host/ota_host with the sim backend and the 'bench ble' console command
+at several ATT MTUs, so the simulated GATT writes go through the real
+_uart_receive -> TaskBleOta path as one mbuf or a chain of them, plus a run
+the phone drops halfway. Each full run must deliver every byte and activate
+the image, the dropped one must activate nothing.
+
+    cmake -S host -B _host_build && cmake --build _host_build
+    tools/host_ble_bench.py --binary _host_build/ota_host
+
+Prints one JSON line with the bench results.
+"""
+
+import argparse
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+
+from host_ota_bench import start_host
+from qemu_ota_bench import RE_WAITING, reader, wait_for
+
+RE_BENCH = re.compile(r"(\{\"bench\":\"ble\".*\})")
+
+# size KB, mtu, interval ms, packets per event, disconnect after KB (0 : none)
+RUNS = [
+    (16, 23, 15, 4, 0),         # default MTU, 20 byte writes
+    (64, 247, 15, 4, 0),        # one mbuf per write
+    (64, 515, 15, 4, 0),        # 512 byte writes, a chain of two mbufs
+    (64, 247, 15, 4, 32),       # link lost halfway
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", default="_host_build/ota_host", help="host build of the firmware")
+    parser.add_argument("--timeout", type=float, default=120, help="per run")
+    parser.add_argument("--log", help="write the device console to this file")
+    args = parser.parse_args()
+
+    workdir = tempfile.TemporaryDirectory(prefix="ota_ble_")
+    flash = os.path.join(workdir.name, "flash.bin")
+    log = open(args.log, "w") if args.log else None
+    proc = start_host(args.binary, flash, None, "sim")
+    lines = queue.Queue()
+    threading.Thread(target=reader, args=(proc, lines, log), daemon=True).start()
+
+    result = {"bench": "host_ble", "runs": []}
+    rc = 1
+    try:
+        wait_for(lines, RE_WAITING, 60)
+
+        ok = True
+        for size, mtu, interval, packets, disconnect in RUNS:
+            proc.stdin.write(("bench ble %d %d %d %d %d\n" % (size, mtu, interval, packets, disconnect)).encode())
+            proc.stdin.flush()
+            run = json.loads(wait_for(lines, RE_BENCH, args.timeout).group(1))
+            result["runs"].append(run)
+            if disconnect:
+                # the write crossing the limit still goes out
+                ok = ok and disconnect * 1024 <= run["sent"] < size * 1024 and run["activated"] == 0
+            else:
+                ok = ok and run["sent"] == size * 1024 and run["activated"] == 1
+
+        rc = 0 if ok else 1
+    except (TimeoutError, OSError) as e:
+        result["error"] = str(e)
+    finally:
+        proc.terminate()
+        try:
+            proc.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        if log:
+            log.close()
+        workdir.cleanup()
+
+    print(json.dumps(result))
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,203 @@
+#!/usr/bin/env python3
+"""
+OTA benchmark and end-to-end check against the Linux host build (host/).
+
+Runs host/ota_host on a fresh flash file, pushes an image through the real
+TCP receive loop (port 12222, same handshake as tools/qemu_ota_bench.py) or,
+with --ble, through the BLE receive path via the phone link of the NimBLE
+stand-in, and waits for the restart into the other ota_x slot. --runs N
+pushes N times in a row, each run from the slot the previous one booted.
+
+Without --image a small valid image is made here : app description, XOR
+checksum and appended SHA-256, what esp_ota_end() and the boot check want.
+
+--wrap runs the binary under a tool, for example
+    --wrap "valgrind --trace-children=yes --error-exitcode=99"
+    --wrap "perf record -g -o ota.perf --"
+the restart re-executes the binary, valgrind needs --trace-children=yes to
+follow it.
+
+    cmake -S host -B _host_build && cmake --build _host_build
+    tools/host_ota_bench.py --binary _host_build/ota_host --runs 3
+
+Prints one JSON line with the results.
+"""
+
+import argparse
+import hashlib
+import json
+import os
+import queue
+import shlex
+import socket
+import struct
+import subprocess
+import sys
+import tempfile
+import threading
+import time
+
+from qemu_ota_bench import (OTA_SERVER_PORT, RE_DONE, RE_RUNNING, RE_WAITING, push_image, push_manifest,
+                            reader, recv_exact, wait_for)
+
+BLE_PHONE_PORT = 12224          # BLE_HOST_PHONE_PORT of host/port/include/host/ble_hs.h
+BLE_FRAME_MTU = 0xFFFF          # frame length value announcing an MTU exchange
+BLE_MTU = 247
+
+CHIP_ID_ESP32S3 = 9
+APP_DESC_MAGIC = 0xABCD5432
+IMAGE_LOAD_ADDR = 0x3C000020
+
+
+def make_image(size, version="V1.1-host"):
+    """Image header, one segment starting with esp_app_desc_t, checksum, SHA-256"""
+    desc = struct.pack("<II8x32s32s16s16s32s32sHHB3x72x", APP_DESC_MAGIC, 0, version.encode(), b"esp32ota",
+                       b"00:00:00", b"Jan  1 2024", b"v5.2-host", bytes(32), 0, 0, 16)
+    body = desc + bytes((i * 7) & 0xFF for i in range(max(size - len(desc) - 64, 0)))
+    body += bytes(-len(body) % 4)
+
+    header = struct.pack("<BBBBIB3sHBHH4sB", 0xE9, 1, 2, 0x2F, 0x40380000, 0xEE, bytes(3), CHIP_ID_ESP32S3,
+                         0, 0, 0, bytes(4), 1)
+    image = header + struct.pack("<II", IMAGE_LOAD_ADDR, len(body)) + body
+
+    checksum = 0xEF
+    for b in body:
+        checksum ^= b
+    image += bytes(15 - len(image) % 16) + bytes([checksum])
+    return image + hashlib.sha256(image).digest()
+
+
+def start_host(binary, flash, wrap, backend):
+    cmd = shlex.split(wrap) if wrap else []
+    cmd += [binary, "--flash", flash]
+    if backend:
+        cmd += ["--backend", backend]
+    return subprocess.Popen(cmd, stdin=subprocess.PIPE, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+
+def ble_frame(data):
+    return struct.pack("<H", len(data)) + data
+
+
+def ble_connect(timeout):
+    # the link is accepted while the device advertises
+    end = time.monotonic() + timeout
+    while True:
+        try:
+            return socket.create_connection(("127.0.0.1", BLE_PHONE_PORT), timeout=timeout)
+        except OSError:
+            if time.monotonic() > end:
+                raise
+            time.sleep(0.1)
+
+
+def ble_wait_notify(s, text):
+    data = b""
+    while text not in data:
+        length = struct.unpack("<H", recv_exact(s, 2))[0]
+        data += recv_exact(s, length)
+    return data
+
+
+def push_ble(image, lines, timeout, write_size):
+    result = {}
+    t0 = time.monotonic()
+
+    with ble_connect(timeout) as s:
+        s.sendall(struct.pack("<HH", BLE_FRAME_MTU, BLE_MTU))
+        s.sendall(ble_frame(json.dumps({"ota": "start", "ota size": len(image)}).encode()))
+        # the status notification says "ready" once the OTA task has begun the session
+        ble_wait_notify(s, b"ready")
+        t_ack = time.monotonic()
+
+        for i in range(0, len(image), write_size):
+            s.sendall(ble_frame(image[i:i + write_size]))
+        t_sent = time.monotonic()
+
+        done = wait_for(lines, RE_DONE, timeout)
+        t_done = time.monotonic()
+
+    result["handshake_ms"] = int((t_ack - t0) * 1000)
+    result["push_ms"] = int((t_sent - t_ack) * 1000)
+    result["total_ms"] = int((t_done - t0) * 1000)
+    result["host_kb_per_sec"] = int(len(image) / 1024 / max(t_done - t_ack, 1e-6))
+    result["device_bytes"] = int(done.group(1))
+    result["device_ms"] = int(done.group(2))
+    result["begin_ms"] = int(done.group(3))
+    result["device_kb_per_sec"] = int(done.group(4))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", default="_host_build/ota_host", help="host build of the firmware")
+    parser.add_argument("--image", help="image to push (default: a generated one of --size bytes)")
+    parser.add_argument("--size", type=int, default=512 * 1024)
+    parser.add_argument("--runs", type=int, default=1, help="updates in a row")
+    parser.add_argument("--timeout", type=float, default=60)
+    parser.add_argument("--log", help="write the device console to this file")
+    parser.add_argument("--wrap", help="command line the binary runs under (valgrind, perf record)")
+    parser.add_argument("--backend", help="OTA write backend, as the 'ota backend' console command")
+    parser.add_argument("--manifest", action="store_true", help="chunked transfer with a per chunk hash manifest")
+    parser.add_argument("--ble", action="store_true", help="push through the BLE phone link instead of TCP")
+    parser.add_argument("--ble-write", type=int, default=BLE_MTU - 3, help="bytes per GATT write")
+    args = parser.parse_args()
+
+    if args.image:
+        with open(args.image, "rb") as f:
+            image = f.read()
+    else:
+        image = make_image(args.size)
+
+    workdir = tempfile.TemporaryDirectory(prefix="ota_host_")
+    flash = os.path.join(workdir.name, "flash.bin")
+    log = open(args.log, "w") if args.log else None
+    proc = start_host(args.binary, flash, args.wrap, args.backend)
+    lines = queue.Queue()
+    threading.Thread(target=reader, args=(proc, lines, log), daemon=True).start()
+
+    transport = "ble" if args.ble else "manifest" if args.manifest else "tcp"
+    result = {"bench": "host_ota", "transport": transport, "size": len(image), "runs": []}
+    rc = 1
+    try:
+        t_boot = time.monotonic()
+        running = wait_for(lines, RE_RUNNING, args.timeout).group(1)
+        wait_for(lines, RE_WAITING, args.timeout)
+        result["boot_ms"] = int((time.monotonic() - t_boot) * 1000)
+
+        for _ in range(args.runs):
+            if args.ble:
+                run = push_ble(image, lines, args.timeout, args.ble_write)
+            elif args.manifest:
+                run = push_manifest(OTA_SERVER_PORT, image, lines, args.timeout)
+            else:
+                run = push_image(OTA_SERVER_PORT, image, lines, args.timeout)
+
+            run["boot_from"] = running
+            run["reboot_to"] = running = wait_for(lines, RE_RUNNING, args.timeout).group(1)
+            run["slot_switched"] = run["reboot_to"] != run["boot_from"] and run["reboot_to"].startswith("ota_")
+            result["runs"].append(run)
+            if not run["slot_switched"]:
+                break
+            wait_for(lines, RE_WAITING, args.timeout)
+
+        rc = 0 if len(result["runs"]) == args.runs and all(r["slot_switched"] for r in result["runs"]) else 1
+    except (TimeoutError, OSError) as e:
+        result["error"] = str(e)
+    finally:
+        proc.terminate()
+        try:
+            proc.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        if log:
+            log.close()
+        workdir.cleanup()
+
+    print(json.dumps(result))
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,105 @@
+#!/usr/bin/env python3
+"""
+Fault injection soak of the real flash path against the Linux host build (host/).
+
+Runs host/ota_host on a fresh flash file and pushes one valid image so the
+device runs from an ota_x slot. Then the 'soak <transport> <profile>
+<iterations> flash' console command sends that running image again and again
+through the BLE and TCP receive paths with lost, reordered, stalled, truncated
+and dropped writes, with the flash backend : esp_ota_begin/end,
+esp_image_verify, esp_ota_set_boot_partition and otadata as emulated by
+host/port. After each attempt the device checks what the bootloader would
+start (see soak_flash_check() in main/src/soak.c).
+
+Fails when an attempt left a corrupt image selected for boot, or changed
+otadata without activating anything.
+
+    cmake -S host -B _host_build && cmake --build _host_build
+    tools/host_soak.py --binary _host_build/ota_host --iterations 3
+
+Prints one JSON line with the soak results.
+"""
+
+import argparse
+import json
+import os
+import queue
+import re
+import subprocess
+import sys
+import tempfile
+import threading
+
+from host_ota_bench import make_image, start_host
+from qemu_ota_bench import OTA_SERVER_PORT, RE_RUNNING, RE_WAITING, push_image, reader, wait_for
+
+RE_SOAK = re.compile(r"(\{\"soak\":.*\})")
+
+
+def soak(proc, lines, transport, profile, iterations, timeout):
+    proc.stdin.write(("soak %s %s %d flash\n" % (transport, profile, iterations)).encode())
+    proc.stdin.flush()
+
+    runs = []
+    # one line per profile, 'all' gives every one of them
+    while True:
+        run = json.loads(wait_for(lines, RE_SOAK, timeout).group(1))
+        runs.append(run)
+        if profile != "all" or run["profile"] == "mixed":
+            return runs
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--binary", default="_host_build/ota_host", help="host build of the firmware")
+    parser.add_argument("--size", type=int, default=32 * 1024, help="size of the image soaked")
+    parser.add_argument("--profile", default="all", help="fault profile of the 'soak' console command")
+    parser.add_argument("--iterations", type=int, default=3, help="updates per profile")
+    parser.add_argument("--transport", action="append", choices=["ble", "tcp"], help="default: both")
+    parser.add_argument("--timeout", type=float, default=600, help="per transport")
+    parser.add_argument("--log", help="write the device console to this file")
+    args = parser.parse_args()
+
+    workdir = tempfile.TemporaryDirectory(prefix="ota_soak_")
+    flash = os.path.join(workdir.name, "flash.bin")
+    log = open(args.log, "w") if args.log else None
+    proc = start_host(args.binary, flash, None, None)
+    lines = queue.Queue()
+    threading.Thread(target=reader, args=(proc, lines, log), daemon=True).start()
+
+    result = {"soak": "host_flash", "size": args.size, "runs": []}
+    rc = 1
+    try:
+        wait_for(lines, RE_RUNNING, 60)
+        wait_for(lines, RE_WAITING, 60)
+
+        # the factory partition of a fresh flash file holds no image : one normal update first
+        push_image(OTA_SERVER_PORT, make_image(args.size), lines, 60)
+        result["running"] = wait_for(lines, RE_RUNNING, 60).group(1)
+        wait_for(lines, RE_WAITING, 60)
+
+        for transport in args.transport or ["ble", "tcp"]:
+            result["runs"] += soak(proc, lines, transport, args.profile, args.iterations, args.timeout)
+
+        rc = 0 if result["running"].startswith("ota_") and result["runs"] and all(
+            r["backend"] == "flash" and r["corrupt_bootable"] == 0 and r["otadata_changed"] == 0
+            for r in result["runs"]) else 1
+    except (TimeoutError, OSError) as e:
+        result["error"] = str(e)
+    finally:
+        proc.terminate()
+        try:
+            proc.wait(timeout=10)
+        except subprocess.TimeoutExpired:
+            proc.kill()
+            proc.wait()
+        if log:
+            log.close()
+        workdir.cleanup()
+
+    print(json.dumps(result))
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""
+Encrypt an OTA image for the streaming decryption of main/src/ota_crypt.c.
+
+    "OTAE", mode (1 CTR, 2 GCM), 3 reserved, 16 byte IV,
+    AES-256 ciphertext of the .bin file, GCM: 16 byte tag
+
+CTR: the IV is the initial counter block (big endian increment).
+GCM: 12 byte IV + 4 zero bytes, the 24 byte head is the AAD.
+The key is the one set on the device with 'crypt key <64 hex>'.
+
+    tools/ota_encrypt.py --key-hex <64 hex> build/esp32ota.bin -o esp32ota.bin.enc
+    tools/ota_encrypt.py --key-hex <64 hex> --decrypt esp32ota.bin.enc -o check.bin
+
+--selftest runs both modes on random data against the reference
+vectors below (NIST SP 800-38A F.5.5, GCM spec test case 16).
+
+Needs the 'cryptography' package (already part of the ESP-IDF Python environment).
+"""
+
+import argparse
+import os
+import struct
+import sys
+
+from cryptography.hazmat.primitives.ciphers import Cipher, algorithms, modes
+from cryptography.hazmat.primitives.ciphers.aead import AESGCM
+
+MAGIC = b"OTAE"
+MODE_CTR = 1
+MODE_GCM = 2
+HEAD_SIZE = 24
+TAG_SIZE = 16
+
+
+def encrypt(image, key, mode, iv=None):
+    if mode == MODE_CTR:
+        iv = iv or os.urandom(16)
+        head = MAGIC + struct.pack("<B3x", mode) + iv
+        enc = Cipher(algorithms.AES(key), modes.CTR(iv)).encryptor()
+        return head + enc.update(image) + enc.finalize()
+
+    iv = iv or os.urandom(12)
+    head = MAGIC + struct.pack("<B3x", mode) + iv + bytes(4)
+    # AESGCM appends the tag
+    return head + AESGCM(key).encrypt(iv, image, head)
+
+
+def decrypt(data, key):
+    if len(data) < HEAD_SIZE or data[:4] != MAGIC:
+        raise ValueError("not an encrypted image")
+    head, mode = data[:HEAD_SIZE], data[4]
+    if mode == MODE_CTR:
+        dec = Cipher(algorithms.AES(key), modes.CTR(head[8:24])).decryptor()
+        return dec.update(data[HEAD_SIZE:]) + dec.finalize()
+    if mode == MODE_GCM:
+        return AESGCM(key).decrypt(head[8:20], data[HEAD_SIZE:], head)
+    raise ValueError("unknown mode %d" % mode)
+
+
+def selftest():
+    # NIST SP 800-38A F.5.5 CTR-AES256.Encrypt, first block
+    key = bytes.fromhex("603deb1015ca71be2b73aef0857d77811f352c073b6108d72d9810a30914dff4")
+    ctr = bytes.fromhex("f0f1f2f3f4f5f6f7f8f9fafbfcfdfeff")
+    enc = encrypt(bytes.fromhex("6bc1bee22e409f96e93d7e117393172a"), key, MODE_CTR, ctr)
+    assert enc[HEAD_SIZE:] == bytes.fromhex("601ec313775789a5b7a7f504bbf3d228"), "CTR vector"
+
+    # GCM test case 16 (AES-256, 60 byte plaintext), AAD replaced by the head : ciphertext only
+    key = bytes.fromhex("feffe9928665731c6d6a8f9467308308feffe9928665731c6d6a8f9467308308")
+    iv = bytes.fromhex("cafebabefacedbaddecaf888")
+    pt = bytes.fromhex("d9313225f88406e5a55909c5aff5269a86a7a9531534f7da2e4c303d8a318a72"
+                       "1c3c0c95956809532fcf0e2449a6b525b16aedf5aa0de657ba637b39")
+    enc = encrypt(pt, key, MODE_GCM, iv)
+    assert enc[HEAD_SIZE:-TAG_SIZE] == bytes.fromhex(
+        "522dc1f099567d07f47f37a32a84427d643a8cdcbfe5c0c97598a2bd2555d1aa"
+        "8cb08e48590dbb3da7b08b1056828838c5f61e6393ba7a0abcc9f662"), "GCM vector"
+
+    key = os.urandom(32)
+    for size in (1, 15, 16, 17, 4096, 100001):
+        image = os.urandom(size)
+        for mode in (MODE_CTR, MODE_GCM):
+            data = encrypt(image, key, mode)
+            assert len(data) == HEAD_SIZE + size + (TAG_SIZE if mode == MODE_GCM else 0)
+            assert decrypt(data, key) == image
+    print("selftest OK")
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("input", nargs="?")
+    parser.add_argument("-o", "--output")
+    parser.add_argument("--key-hex", help="AES-256 key, 64 hex digits")
+    parser.add_argument("--mode", choices=["ctr", "gcm"], default="gcm")
+    parser.add_argument("--decrypt", action="store_true", help="reverse, for checking")
+    parser.add_argument("--selftest", action="store_true")
+    args = parser.parse_args()
+
+    if args.selftest:
+        selftest()
+        return 0
+
+    if not args.input or not args.output or not args.key_hex:
+        parser.error("input, --output and --key-hex are required")
+    key = bytes.fromhex(args.key_hex)
+    if len(key) != 32:
+        parser.error("--key-hex : 64 hex digits")
+
+    with open(args.input, "rb") as f:
+        data = f.read()
+    if args.decrypt:
+        out = decrypt(data, key)
+    else:
+        out = encrypt(data, key, MODE_CTR if args.mode == "ctr" else MODE_GCM)
+    with open(args.output, "wb") as f:
+        f.write(out)
+    print("%s : %d -> %d bytes" % (args.output, len(data), len(out)))
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,119 @@
+#!/usr/bin/env python3
+"""
+Push an image to the TLS port of TaskServerOta (OTA_TLS_PORT 12223).
+
+    tools/ota_tls_push.py --host 192.168.0.10 --ca server.crt build/esp32ota.bin
+
+--handshakes N first opens N connections that only do the TLS handshake
+(the device logs "OTA command ERROR" for them and keeps listening), each
+one offering the session of the previous : prints the handshake time and
+whether the device resumed it. The image push reuses the session too.
+The device supports TLS 1.2 only (no CONFIG_MBEDTLS_SSL_PROTO_TLS1_3).
+
+Without a device, the same handshake loop runs against a stand-in :
+
+    openssl s_server -accept 12223 -cert server.crt -key server.key -tls1_2
+    tools/ota_tls_push.py --host 127.0.0.1 --ca server.crt --handshakes 3
+
+Prints one JSON line with the results.
+"""
+
+import argparse
+import json
+import socket
+import ssl
+import sys
+import time
+
+OTA_TLS_PORT = 12223
+CHUNK = 1024
+
+
+def make_context(ca):
+    ctx = ssl.create_default_context(cafile=ca) if ca else ssl._create_unverified_context()
+    ctx.check_hostname = False
+    ctx.maximum_version = ssl.TLSVersion.TLSv1_2
+    return ctx
+
+
+def connect(ctx, host, port, session, timeout):
+    t0 = time.monotonic()
+    raw = socket.create_connection((host, port), timeout=timeout)
+    s = ctx.wrap_socket(raw, session=session)
+    return s, int((time.monotonic() - t0) * 1000)
+
+
+def handshakes(ctx, host, port, count, timeout):
+    result, session = [], None
+    for _ in range(count):
+        s, ms = connect(ctx, host, port, session, timeout)
+        result.append({"ms": ms, "resumed": s.session_reused, "cipher": s.cipher()[0]})
+        session = s.session
+        s.close()
+    return result, session
+
+
+def push(ctx, host, port, image, session, timeout):
+    result = {}
+    s, ms = connect(ctx, host, port, session, timeout)
+    with s:
+        result["handshake_ms"] = ms
+        result["resumed"] = s.session_reused
+        t0 = time.monotonic()
+        s.sendall(b"ota")
+        ack = b""
+        while len(ack) < 4:
+            data = s.recv(4 - len(ack))
+            if not data:
+                raise ConnectionError("connection closed before ACK")
+            ack += data
+        if ack[:3] != b"ACK":
+            raise ConnectionError("unexpected handshake reply %r" % ack)
+        t_ack = time.monotonic()
+
+        for i in range(0, len(image), CHUNK):
+            s.sendall(image[i:i + CHUNK])
+        s.unwrap()
+        t_sent = time.monotonic()
+
+    result["ack_ms"] = int((t_ack - t0) * 1000)
+    result["push_ms"] = int((t_sent - t_ack) * 1000)
+    result["kb_per_sec"] = int(len(image) / 1024 / max(t_sent - t_ack, 1e-6))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("image", nargs="?")
+    parser.add_argument("--host", required=True)
+    parser.add_argument("--port", type=int, default=OTA_TLS_PORT)
+    parser.add_argument("--ca", help="certificate to verify the device with (default: not verified)")
+    parser.add_argument("--handshakes", type=int, default=0, help="handshake only connections before the push")
+    parser.add_argument("--timeout", type=float, default=60)
+    args = parser.parse_args()
+
+    if not args.image and not args.handshakes:
+        parser.error("image or --handshakes N")
+
+    ctx = make_context(args.ca)
+    result = {"bench": "ota_tls", "host": args.host, "port": args.port}
+    rc = 1
+    try:
+        session = None
+        if args.handshakes:
+            result["handshakes"], session = handshakes(ctx, args.host, args.port, args.handshakes, args.timeout)
+        if args.image:
+            with open(args.image, "rb") as f:
+                image = f.read()
+            result["size"] = len(image)
+            result.update(push(ctx, args.host, args.port, image, session, args.timeout))
+        rc = 0
+    except (OSError, ssl.SSLError) as e:
+        result["error"] = str(e)
+
+    print(json.dumps(result))
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
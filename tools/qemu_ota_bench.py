@@ -0,0 +1,294 @@
+#!/usr/bin/env python3
+"""
+End-to-end TCP OTA benchmark under Espressif QEMU.
+
+Boots the QEMU build (sdkconfig.qemu) with emulated flash and OpenCores
+Ethernet, pushes an image through the TaskServerOta handshake ("ota" / "ACK")
+and waits for the reboot into the other ota_x slot. With --stage the
+handshake carries the image SHA-256 ("ots"), a device that already holds
+the image in a slot replies "STG" and reboots without any transfer.
+With --manifest the image goes as 4 KB chunks with a per chunk SHA-256
+manifest ("otm"), last chunk first; --corrupt N damages chunk N once to
+exercise the re-request path. --encrypt <64 hex> pushes the image
+encrypted with tools/ota_encrypt.py (AES-256-GCM, same key as 'crypt key').
+--http raw|multipart POSTs the image to /update of the HTTP server instead
+(port 80 forwarded to --port + 1), the throughput to compare with TCP.
+
+    idf.py -B build_qemu -D SDKCONFIG=build_qemu/sdkconfig \
+           -D SDKCONFIG_DEFAULTS="sdkconfig.defaults;sdkconfig.qemu" build
+    tools/qemu_ota_bench.py --build build_qemu
+
+Prints one JSON line with the results.
+"""
+
+import argparse
+import hashlib
+import http.client
+import json
+import os
+import queue
+import re
+import socket
+import struct
+import subprocess
+import sys
+import threading
+import time
+
+OTA_SERVER_PORT = 12222
+OTA_HTTP_PORT = 80
+CHUNK = 1024
+MANIFEST_CHUNK = 4096
+
+RE_RUNNING = re.compile(r"Running partition : (\S+)")
+RE_WAITING = re.compile(r"Waiting for OTA client")
+RE_DONE = re.compile(r"Total Write binary data length : (\d+), (\d+) ms \(begin (\d+) ms\), (\d+) KB/s")
+
+
+def merge_flash(build, flash_size):
+    out = os.path.join(build, "qemu_flash.bin")
+    subprocess.check_call(["esptool.py", "--chip", "esp32", "merge_bin", "--fill-flash-size", flash_size,
+                           "-o", "qemu_flash.bin", "@flash_args"], cwd=build, stdout=subprocess.DEVNULL)
+    return out
+
+
+def start_qemu(qemu, flash, host_port):
+    cmd = [qemu, "-nographic", "-machine", "esp32",
+           "-drive", "file=%s,if=mtd,format=raw" % flash,
+           "-nic", "user,model=open_eth,hostfwd=tcp:127.0.0.1:%d-:%d,hostfwd=tcp:127.0.0.1:%d-:%d"
+           % (host_port, OTA_SERVER_PORT, host_port + 1, OTA_HTTP_PORT)]
+    return subprocess.Popen(cmd, stdin=subprocess.DEVNULL, stdout=subprocess.PIPE, stderr=subprocess.STDOUT)
+
+
+def reader(proc, lines, log):
+    for raw in iter(proc.stdout.readline, b""):
+        line = raw.decode("utf-8", "replace").rstrip()
+        if log:
+            log.write(line + "\n")
+        lines.put(line)
+
+
+def wait_for(lines, pattern, timeout):
+    end = time.monotonic() + timeout
+    while time.monotonic() < end:
+        try:
+            line = lines.get(timeout=end - time.monotonic())
+        except queue.Empty:
+            break
+        m = pattern.search(line)
+        if m:
+            return m
+    raise TimeoutError("timeout waiting for '%s'" % pattern.pattern)
+
+
+def merkle_root(leaves):
+    level = list(leaves)
+    while len(level) > 1:
+        level = [hashlib.sha256(level[i] + level[i + 1]).digest() if i + 1 < len(level) else level[i]
+                 for i in range(0, len(level), 2)]
+    return level[0]
+
+
+def build_manifest(image):
+    chunks = [image[i:i + MANIFEST_CHUNK] for i in range(0, len(image), MANIFEST_CHUNK)]
+    leaves = [hashlib.sha256(c).digest() for c in chunks]
+    head = b"OTAM" + struct.pack("<III", len(image), MANIFEST_CHUNK, len(chunks)) + merkle_root(leaves)
+    return chunks, head + b"".join(leaves)
+
+
+def recv_exact(s, n):
+    data = b""
+    while len(data) < n:
+        part = s.recv(n - len(data))
+        if not part:
+            raise ConnectionError("connection closed")
+        data += part
+    return data
+
+
+def push_manifest(host_port, image, lines, timeout, corrupt=None):
+    result = {}
+    chunks, manifest = build_manifest(image)
+    t0 = time.monotonic()
+
+    with socket.create_connection(("127.0.0.1", host_port), timeout=timeout) as s:
+        s.sendall(b"otm" + manifest)
+        ack = recv_exact(s, 4)
+        if ack[:3] != b"ACK":
+            raise ConnectionError("unexpected handshake reply %r" % ack)
+        need = recv_exact(s, (len(chunks) + 7) // 8)
+        pending = [i for i in range(len(chunks)) if need[i // 8] >> (i % 8) & 1]
+        result["resumed"] = len(chunks) - len(pending)
+        result["resent"] = 0
+        t_ack = time.monotonic()
+
+        # any order : last chunk first
+        pending.reverse()
+        while pending:
+            for i in pending:
+                data = chunks[i]
+                if i == corrupt:
+                    data = bytes([data[0] ^ 0xFF]) + data[1:]
+                    corrupt = None
+                s.sendall(struct.pack("<II", i, len(data)) + data)
+            retry = []
+            for _ in pending:
+                reply = recv_exact(s, 5)
+                if reply[:1] == b"N":
+                    retry.append(struct.unpack("<I", reply[1:])[0])
+            result["resent"] += len(retry)
+            pending = retry
+        t_sent = time.monotonic()
+
+        end = recv_exact(s, 4)
+        if end[:3] != b"END":
+            raise ConnectionError("image refused by the device %r" % end)
+        done = wait_for(lines, RE_DONE, timeout)
+        t_done = time.monotonic()
+
+    result["handshake_ms"] = int((t_ack - t0) * 1000)
+    result["push_ms"] = int((t_sent - t_ack) * 1000)
+    result["total_ms"] = int((t_done - t0) * 1000)
+    result["device_bytes"] = int(done.group(1))
+    result["device_ms"] = int(done.group(2))
+    result["device_kb_per_sec"] = int(done.group(4))
+    return result
+
+
+def push_image(host_port, image, lines, timeout, stage=False):
+    result = {}
+    t0 = time.monotonic()
+
+    with socket.create_connection(("127.0.0.1", host_port), timeout=timeout) as s:
+        if stage:
+            s.sendall(b"ots" + struct.pack("<I", len(image)) + hashlib.sha256(image).digest())
+        else:
+            s.sendall(b"ota")
+        # esp_ota_begin() erases the partition before the ACK is sent
+        ack = b""
+        while len(ack) < 4:
+            data = s.recv(4 - len(ack))
+            if not data:
+                raise ConnectionError("connection closed before ACK")
+            ack += data
+        if ack[:3] == b"STG":
+            result["staged"] = True
+            result["total_ms"] = int((time.monotonic() - t0) * 1000)
+            return result
+        if ack[:3] != b"ACK":
+            raise ConnectionError("unexpected handshake reply %r" % ack)
+        t_ack = time.monotonic()
+
+        for i in range(0, len(image), CHUNK):
+            s.sendall(image[i:i + CHUNK])
+        s.shutdown(socket.SHUT_WR)
+        t_sent = time.monotonic()
+
+        done = wait_for(lines, RE_DONE, timeout)
+        t_done = time.monotonic()
+
+    result["handshake_ms"] = int((t_ack - t0) * 1000)
+    result["push_ms"] = int((t_sent - t_ack) * 1000)
+    result["total_ms"] = int((t_done - t0) * 1000)
+    result["host_kb_per_sec"] = int(len(image) / 1024 / max(t_done - t_ack, 1e-6))
+    result["device_bytes"] = int(done.group(1))
+    result["device_ms"] = int(done.group(2))
+    result["begin_ms"] = int(done.group(3))
+    result["device_kb_per_sec"] = int(done.group(4))
+    return result
+
+
+def push_http(host_port, image, lines, timeout, multipart=False):
+    result = {}
+    headers = {"Content-Type": "application/octet-stream"}
+    body = image
+    if multipart:
+        boundary = "----ota%016x" % int.from_bytes(os.urandom(8), "big")
+        headers["Content-Type"] = "multipart/form-data; boundary=" + boundary
+        body = (("--%s\r\nContent-Disposition: form-data; name=\"firmware\"; filename=\"esp32ota.bin\"\r\n"
+                 "Content-Type: application/octet-stream\r\n\r\n" % boundary).encode()
+                + image + ("\r\n--%s--\r\n" % boundary).encode())
+    t0 = time.monotonic()
+
+    conn = http.client.HTTPConnection("127.0.0.1", host_port + 1, timeout=timeout)
+    conn.request("POST", "/update", body=body, headers=headers)
+    reply = conn.getresponse()
+    text = reply.read().decode("utf-8", "replace").strip()
+    t_reply = time.monotonic()
+    conn.close()
+    if reply.status != 200:
+        raise ConnectionError("HTTP %d : %s" % (reply.status, text))
+
+    done = wait_for(lines, RE_DONE, timeout)
+    result["reply"] = text
+    result["total_ms"] = int((t_reply - t0) * 1000)
+    result["host_kb_per_sec"] = int(len(image) / 1024 / max(t_reply - t0, 1e-6))
+    result["device_bytes"] = int(done.group(1))
+    result["device_ms"] = int(done.group(2))
+    result["begin_ms"] = int(done.group(3))
+    result["device_kb_per_sec"] = int(done.group(4))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("--build", default="build_qemu", help="QEMU build directory")
+    parser.add_argument("--image", help="image to push (default: <build>/esp32ota.bin)")
+    parser.add_argument("--qemu", default="qemu-system-xtensa")
+    parser.add_argument("--port", type=int, default=OTA_SERVER_PORT + 10000, help="host port forwarded to the device")
+    parser.add_argument("--flash-size", default="8MB")
+    parser.add_argument("--timeout", type=float, default=120)
+    parser.add_argument("--log", help="write the device console to this file")
+    parser.add_argument("--stage", action="store_true", help="send the image hash, no transfer if already staged")
+    parser.add_argument("--manifest", action="store_true", help="chunked transfer with a per chunk hash manifest")
+    parser.add_argument("--corrupt", type=int, help="with --manifest, damage this chunk once")
+    parser.add_argument("--encrypt", metavar="KEY_HEX", help="push the image AES-256-GCM encrypted")
+    parser.add_argument("--http", choices=["raw", "multipart"], help="POST /update instead of the TCP port")
+    args = parser.parse_args()
+
+    image_path = args.image or os.path.join(args.build, "esp32ota.bin")
+    with open(image_path, "rb") as f:
+        image = f.read()
+    if args.encrypt:
+        from ota_encrypt import encrypt, MODE_GCM
+        image = encrypt(image, bytes.fromhex(args.encrypt), MODE_GCM)
+
+    flash = merge_flash(args.build, args.flash_size)
+    log = open(args.log, "w") if args.log else None
+    proc = start_qemu(args.qemu, flash, args.port)
+    lines = queue.Queue()
+    threading.Thread(target=reader, args=(proc, lines, log), daemon=True).start()
+
+    result = {"bench": "qemu_ota", "image": os.path.basename(image_path), "size": len(image)}
+    rc = 1
+    try:
+        t_boot = time.monotonic()
+        result["boot_from"] = wait_for(lines, RE_RUNNING, args.timeout).group(1)
+        wait_for(lines, RE_WAITING, args.timeout)
+        result["boot_ms"] = int((time.monotonic() - t_boot) * 1000)
+
+        if args.http:
+            result.update(push_http(args.port, image, lines, args.timeout, args.http == "multipart"))
+        elif args.manifest:
+            result.update(push_manifest(args.port, image, lines, args.timeout, args.corrupt))
+        else:
+            result.update(push_image(args.port, image, lines, args.timeout, args.stage))
+
+        result["reboot_to"] = wait_for(lines, RE_RUNNING, args.timeout).group(1)
+        result["slot_switched"] = (result["reboot_to"] != result["boot_from"]
+                                   and result["reboot_to"].startswith("ota_"))
+        rc = 0 if result["slot_switched"] or result.get("staged") else 1
+    except (TimeoutError, OSError) as e:
+        result["error"] = str(e)
+    finally:
+        proc.kill()
+        proc.wait()
+        if log:
+            log.close()
+
+    print(json.dumps(result))
+    return rc
+
+
+if __name__ == "__main__":
+    sys.exit(main())
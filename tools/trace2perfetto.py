@@ -0,0 +1,101 @@
+#!/usr/bin/env python3
+"""
+Convert a 'trace dump' console capture into Chrome / Perfetto trace JSON.
+
+    tools/trace2perfetto.py console.log -o ota_trace.json
+
+Open the result in https://ui.perfetto.dev or chrome://tracing.
+One track per lane (tcp_ota, http_ota, ble_ota, flash, ble_rx, ble_tx), the core
+that recorded the event is kept in the event args.
+"""
+
+import argparse
+import json
+import re
+import sys
+
+RE_HEADER = re.compile(r"# trace cpu_mhz=(\d+) events=(\d+) lost=(\d+)")
+RE_DESC = re.compile(r"^E (\d+) (\S) (\S+) (\S+)$")
+RE_EVENT = re.compile(r"^T ([0-9A-Fa-f]+) (\d+) (\d+) ([0-9A-Fa-f]+)$")
+
+
+def parse(lines):
+    """Return (cpu_mhz, {id: (phase, lane, name)}, [(cycles, core, id, arg)]) of the last dump."""
+    mhz, desc, events, inside = None, {}, [], False
+
+    for line in lines:
+        line = line.strip()
+        m = RE_HEADER.search(line)
+        if m:
+            mhz, desc, events, inside = int(m.group(1)), {}, [], True
+            continue
+        if not inside:
+            continue
+        if line.startswith("# trace end"):
+            inside = False
+            continue
+        m = RE_DESC.match(line)
+        if m:
+            desc[int(m.group(1))] = (m.group(2), m.group(3), m.group(4))
+            continue
+        m = RE_EVENT.match(line)
+        if m:
+            events.append((int(m.group(1), 16), int(m.group(2)), int(m.group(3)), int(m.group(4), 16)))
+
+    if mhz is None:
+        raise ValueError("no '# trace' dump found")
+    return mhz, desc, events
+
+
+def convert(mhz, desc, events):
+    lanes = {}
+    out = []
+    t0 = None
+    now = None      # unwrapped cycle count of the previous event
+
+    for cycles, core, eid, arg in events:
+        # events are in record order and the counters wrap every 2^32 cycles,
+        # take the signed distance to the previous event (also absorbs the small skew between cores)
+        if now is None:
+            now = cycles
+        else:
+            delta = (cycles - now) & 0xFFFFFFFF
+            now += delta - (1 << 32) if delta & 0x80000000 else delta
+        if t0 is None:
+            t0 = now
+        ts = (now - t0) / mhz
+
+        phase, lane, name = desc.get(eid, ("i", "unknown", "event_%d" % eid))
+        tid = lanes.setdefault(lane, len(lanes) + 1)
+        ev = {"name": name, "ph": phase, "ts": round(ts, 3), "pid": 1, "tid": tid,
+              "args": {"arg": arg if arg < 0x80000000 else arg - (1 << 32), "core": core}}
+        if phase == "i":
+            ev["s"] = "t"
+        out.append(ev)
+
+    for lane, tid in lanes.items():
+        out.append({"name": "thread_name", "ph": "M", "pid": 1, "tid": tid, "args": {"name": lane}})
+    out.append({"name": "process_name", "ph": "M", "pid": 1, "args": {"name": "esp32ota"}})
+    return {"traceEvents": out, "displayTimeUnit": "ms"}
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument("log", nargs="?", help="console capture (default: stdin)")
+    parser.add_argument("-o", "--output", help="output file (default: stdout)")
+    args = parser.parse_args()
+
+    with (open(args.log, errors="replace") if args.log else sys.stdin) as f:
+        mhz, desc, events = parse(f)
+
+    trace = convert(mhz, desc, events)
+    if args.output:
+        with open(args.output, "w") as f:
+            json.dump(trace, f)
+    else:
+        json.dump(trace, sys.stdout)
+    return 0
+
+
+if __name__ == "__main__":
+    sys.exit(main())